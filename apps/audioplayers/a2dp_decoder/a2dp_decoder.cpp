@@ -29,6 +29,7 @@
 #include "hal_location.h"
 #include "hal_timer.h"
 #include "heap_api.h"
+#include "perf_probe.h"
 #include "plat_types.h"
 #include <string.h>
 #if defined(IBRT)
@@ -72,6 +73,15 @@
 
 #define A2DP_AUDIO_UNDERFLOW_CAUSE_AUDIO_RETRIGGER (1)
 
+#define A2DP_AUDIO_LATENCY_ADAPT_MIN_FACTOR (0.5f)
+#define A2DP_AUDIO_LATENCY_ADAPT_MAX_FACTOR (2.5f)
+#define A2DP_AUDIO_LATENCY_ADAPT_INTERVAL_MS (1000)
+// peak lateness decays by 1/32 per interval, a half life of ~22s
+#define A2DP_AUDIO_LATENCY_ADAPT_DECAY_SHIFT (5)
+#define A2DP_AUDIO_LATENCY_ADAPT_MARGIN_MS (40)
+// inaudible (< 2 cents) rate offset used to walk the depth to a new target
+#define A2DP_AUDIO_LATENCY_ADAPT_SLEW (0.001f)
+
 extern A2DP_AUDIO_DECODER_T a2dp_audio_sbc_decoder_config;
 #if defined(A2DP_AAC_ON)
 extern A2DP_AUDIO_DECODER_T a2dp_audio_aac_lc_decoder_config;
@@ -124,6 +134,9 @@ A2DP_AUDIO_CONTEXT_T a2dp_audio_context;
 
 static heap_handle_t a2dp_audio_heap;
 
+static A2DP_AUDIO_SLAB_T *a2dp_audio_slab_list = NULL;
+static A2DP_AUDIO_SLAB_T a2dp_audio_node_slab;
+
 static A2DP_AUDIO_LASTFRAME_INFO_T a2dp_audio_lastframe_info;
 
 static A2DP_AUDIO_DETECT_NEXT_PACKET_CALLBACK
@@ -136,6 +149,46 @@ static float sync_tune_dest_ratio = 1.0f;
 
 static uint32_t store_packet_history_loctime = 0;
 
+typedef struct {
+  uint16_t codec_type;
+  uint32_t calls;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint64_t total_us;
+} A2DP_AUDIO_STATS_DECODE_ACC_T;
+
+static A2DP_AUDIO_STATS_T a2dp_audio_stats;
+static A2DP_AUDIO_STATS_DECODE_ACC_T
+    a2dp_audio_stats_decode_acc[A2DP_AUDIO_STATS_CODEC_MAX];
+static A2DP_AUDIO_STATS_DECODE_ACC_T *a2dp_audio_stats_decode_curr = NULL;
+static uint32_t a2dp_audio_stats_start_ms = 0;
+static uint32_t a2dp_audio_stats_last_arrival = 0;
+static uint32_t a2dp_audio_stats_avg_gap_q4 = 0;
+static uint16_t a2dp_audio_stats_last_seq = 0;
+
+typedef struct {
+  A2DP_AUDIO_LATENCY_POLICY_E policy;
+  float min_factor;
+  float max_factor;
+  // dest_packet_mut at latency factor 1.0
+  float base_mut;
+  uint32_t mtu_limiter;
+  // how far the arrivals run behind their schedule, and its decaying peak
+  uint32_t late_us;
+  uint32_t peak_us;
+  uint32_t step_ms;
+} A2DP_AUDIO_LATENCY_ADAPT_T;
+
+static A2DP_AUDIO_LATENCY_ADAPT_T a2dp_audio_latency_adapt = {
+#ifdef A2DP_AUDIO_LATENCY_ADAPTIVE
+    A2DP_AUDIO_LATENCY_POLICY_ADAPTIVE,
+#else
+    A2DP_AUDIO_LATENCY_POLICY_STATIC,
+#endif
+    A2DP_AUDIO_LATENCY_ADAPT_MIN_FACTOR,
+    A2DP_AUDIO_LATENCY_ADAPT_MAX_FACTOR,
+};
+
 static uint32_t check_sum_seed = 0;
 
 static int a2dp_audio_internal_lastframe_info_ptr_get(
@@ -146,6 +199,7 @@ int8_t a2dp_audio_get_current_buf_size(void);
 
 void a2dp_audio_heap_init(void *begin_addr, uint32_t size) {
   a2dp_audio_heap = heap_register(begin_addr, size);
+  a2dp_audio_slab_list = NULL;
 }
 
 void *a2dp_audio_heap_malloc(uint32_t size) {
@@ -184,6 +238,128 @@ void a2dp_audio_heap_info(size_t *total, size_t *used, size_t *max_used) {
 
   if (max_used != NULL)
     *max_used = info.total_bytes - info.minimum_free_bytes;
+
+  for (A2DP_AUDIO_SLAB_T *slab = a2dp_audio_slab_list; slab;
+       slab = slab->next) {
+    TRACE_A2DP_DECODER_I("[SLAB] %s cnt:%d used:%d max_used:%d fallback:%d",
+                         slab->name, slab->block_cnt, slab->used,
+                         slab->max_used, slab->fallback);
+  }
+}
+
+int a2dp_audio_slab_init(A2DP_AUDIO_SLAB_T *slab, const char *name,
+                         uint32_t block_size, uint32_t block_cnt) {
+  multi_heap_info_t info;
+  uint8_t *block = NULL;
+
+  memset(slab, 0, sizeof(A2DP_AUDIO_SLAB_T));
+  slab->name = name;
+  slab->block_size = ALIGN(MAX(block_size, sizeof(void *)), 4);
+
+  // Leave at least half of the free heap for oversized requests and for
+  // whatever the codec allocates after its slab.
+  heap_get_info(a2dp_audio_heap, &info);
+  block_cnt = MIN(block_cnt, info.total_free_bytes / 2 / slab->block_size);
+  if (block_cnt) {
+    slab->base =
+        (uint8_t *)heap_malloc(a2dp_audio_heap, block_cnt * slab->block_size);
+  }
+  if (slab->base) {
+    slab->block_cnt = block_cnt;
+    slab->end = slab->base + block_cnt * slab->block_size;
+    for (block = slab->end - slab->block_size; block >= slab->base;
+         block -= slab->block_size) {
+      *(void **)block = slab->free_list;
+      slab->free_list = block;
+    }
+  }
+
+  slab->next = a2dp_audio_slab_list;
+  a2dp_audio_slab_list = slab;
+
+  TRACE_A2DP_DECODER_I("[SLAB] %s init block:%d cnt:%d", name,
+                       slab->block_size, slab->block_cnt);
+  return slab->block_cnt ? 0 : -1;
+}
+
+void *a2dp_audio_slab_malloc(A2DP_AUDIO_SLAB_T *slab, uint32_t size) {
+  void *ptr = NULL;
+  uint32_t lock;
+
+  if (size <= slab->block_size) {
+    lock = int_lock();
+    ptr = slab->free_list;
+    if (ptr) {
+      slab->free_list = *(void **)ptr;
+      if (++slab->used > slab->max_used) {
+        slab->max_used = slab->used;
+      }
+    }
+    int_unlock(lock);
+  }
+
+  if (ptr == NULL) {
+    slab->fallback++;
+    ptr = a2dp_audio_heap_malloc(size);
+  }
+  return ptr;
+}
+
+void a2dp_audio_slab_free(A2DP_AUDIO_SLAB_T *slab, void *ptr) {
+  uint32_t lock;
+
+  if ((uint8_t *)ptr >= slab->base && (uint8_t *)ptr < slab->end) {
+    lock = int_lock();
+    *(void **)ptr = slab->free_list;
+    slab->free_list = ptr;
+    slab->used--;
+    int_unlock(lock);
+  } else {
+    a2dp_audio_heap_free(ptr);
+  }
+}
+
+static uint32_t a2dp_audio_dest_packet_mut_max(void) {
+  A2DP_AUDIO_LATENCY_ADAPT_T *adapt = &a2dp_audio_latency_adapt;
+  uint32_t mut_max = a2dp_audio_context.dest_packet_mut;
+
+  if (adapt->policy == A2DP_AUDIO_LATENCY_POLICY_ADAPTIVE) {
+    mut_max = MAX(mut_max, (uint32_t)(adapt->base_mut * adapt->max_factor));
+  }
+  return mut_max;
+}
+
+uint32_t a2dp_audio_slab_depth_get(uint32_t mtu_limiter) {
+  // every codec sizes its slab here, so this is where its limiter is learnt
+  a2dp_audio_latency_adapt.mtu_limiter = mtu_limiter;
+  return MIN(mtu_limiter,
+             a2dp_audio_dest_packet_mut_max() * A2DP_AUDIO_SLAB_DEPTH_FACTOR);
+}
+
+static void a2dp_audio_slab_deinit_all(void) {
+  A2DP_AUDIO_SLAB_T *slab = a2dp_audio_slab_list;
+
+  // The list is kept until a2dp_audio_deinit() has reported the high-water
+  // marks
+  while (slab) {
+    if (slab->base) {
+      heap_free(a2dp_audio_heap, slab->base);
+    }
+    slab->base = slab->end = NULL;
+    slab->free_list = NULL;
+    slab->block_size = 0;
+    slab = slab->next;
+  }
+}
+
+static void *a2dp_audio_list_node_zmalloc(size_t size) {
+  void *ptr = a2dp_audio_slab_malloc(&a2dp_audio_node_slab, size);
+  memset(ptr, 0, size);
+  return ptr;
+}
+
+static void a2dp_audio_list_node_free(void *ptr) {
+  a2dp_audio_slab_free(&a2dp_audio_node_slab, ptr);
 }
 
 int inline a2dp_audio_semaphore_init(void) {
@@ -231,6 +407,39 @@ int inline a2dp_audio_status_mutex_unlock(void) {
   return 0;
 }
 
+void a2dp_audio_pcm_carry_reset(A2DP_AUDIO_PCM_CARRY_T *carry) {
+  carry->len = 0;
+  carry->off = 0;
+}
+
+// Moves the PCM still carried to out and returns its length in bytes.
+uint32_t a2dp_audio_pcm_carry_get(A2DP_AUDIO_PCM_CARRY_T *carry, uint8_t *out,
+                                  uint32_t out_bytes) {
+  uint32_t len = carry->len - carry->off;
+
+  if (len > out_bytes) {
+    len = out_bytes;
+  }
+  if (len) {
+    memcpy(out, carry->buf + carry->off, len);
+    carry->off += len;
+  }
+  return len;
+}
+
+// carry->buf holds a frame of len bytes: fills out_bytes of out with its
+// head and keeps the rest for the next output buffer.
+void a2dp_audio_pcm_carry_split(A2DP_AUDIO_PCM_CARRY_T *carry, uint32_t len,
+                                uint8_t *out, uint32_t out_bytes) {
+  if (out_bytes > len) {
+    memset(out + len, 0, out_bytes - len);
+    out_bytes = len;
+  }
+  memcpy(out, carry->buf, out_bytes);
+  carry->len = len;
+  carry->off = out_bytes;
+}
+
 int inline a2dp_audio_semaphore_wait(uint32_t timeout_ms) {
   osSemaphoreId semaphore_id =
       (osSemaphoreId)a2dp_audio_context.audio_semaphore.semaphore;
@@ -307,6 +516,38 @@ bool a2dp_audio_list_remove(list_t *list, void *data) {
   return nRet;
 }
 
+// Copies the data of up to max frames from the head of list, and the list
+// length if length is not NULL, under one lock. The frames stay queued.
+uint32_t a2dp_audio_list_peek_batch(const list_t *list, void **frames,
+                                    uint32_t max, uint32_t *length) {
+  list_node_t *node = NULL;
+  uint32_t num = 0;
+
+  a2dp_audio_buffer_mutex_lock();
+  for (node = list_begin(list); node != list_end(list) && num < max;
+       node = list_next(node)) {
+    frames[num++] = list_node(node);
+  }
+  if (length) {
+    *length = list_length(list);
+  }
+  a2dp_audio_buffer_mutex_unlock();
+  return num;
+}
+
+// Frees frames taken with a2dp_audio_list_peek_batch(). They are still at
+// the head of list unless it was flushed meanwhile, so each removal is O(1).
+void a2dp_audio_list_remove_batch(list_t *list, void *const *frames,
+                                  uint32_t num) {
+  uint32_t i;
+
+  a2dp_audio_buffer_mutex_lock();
+  for (i = 0; i < num; i++) {
+    list_remove(list, frames[i]);
+  }
+  a2dp_audio_buffer_mutex_unlock();
+}
+
 bool a2dp_audio_list_append(list_t *list, void *data) {
   a2dp_audio_buffer_mutex_lock();
   bool nRet = list_append(list, data);
@@ -412,6 +653,312 @@ static void a2dp_decoder_info_checker(void) {
   //    (uint32_t)bt_drv_reg_op_bt_info_checker);
 }
 
+static float a2dp_audio_latency_adapt_mut_ms(void) {
+  uint32_t sample_rate = a2dp_audio_context.output_cfg.sample_rate;
+  uint32_t list_samples = a2dp_audio_lastframe_info.list_samples;
+
+  if (!sample_rate || !list_samples) {
+    return 0;
+  }
+  return (float)list_samples * 1000 / sample_rate;
+}
+
+static void a2dp_audio_latency_adapt_start(uint16_t dest_packet_mut) {
+  A2DP_AUDIO_LATENCY_ADAPT_T *adapt = &a2dp_audio_latency_adapt;
+
+  // the stream layer scales its delay by the latency factor, so the base is
+  // what it asks for at 1.0
+  adapt->base_mut = (float)dest_packet_mut / a2dp_audio_latency_factor;
+  adapt->mtu_limiter = 0;
+  adapt->late_us = 0;
+  adapt->step_ms = TICKS_TO_MS(hal_sys_timer_get());
+}
+
+static void a2dp_audio_latency_adapt_arrival(uint32_t gap_us, uint32_t avg_us,
+                                             uint32_t lost) {
+  A2DP_AUDIO_LATENCY_ADAPT_T *adapt = &a2dp_audio_latency_adapt;
+
+  // a lost packet takes its share of audio out of the list as surely as a
+  // late one does
+  gap_us += lost * avg_us;
+  if (adapt->late_us + gap_us > avg_us) {
+    adapt->late_us += gap_us - avg_us;
+  } else {
+    adapt->late_us = 0;
+  }
+  if (adapt->late_us > adapt->peak_us) {
+    adapt->peak_us = adapt->late_us;
+  }
+}
+
+static void a2dp_audio_latency_adapt_apply(uint32_t dest_packet_mut) {
+  A2DP_AUDIO_LATENCY_ADAPT_T *adapt = &a2dp_audio_latency_adapt;
+
+  TRACE_A2DP_DECODER_I("[LATENCY] dest:%d->%d peak:%dus",
+                       a2dp_audio_context.dest_packet_mut, dest_packet_mut,
+                       adapt->peak_us);
+  a2dp_audio_context.dest_packet_mut = dest_packet_mut;
+  a2dp_audio_latency_factor = (float)dest_packet_mut / adapt->base_mut;
+}
+
+static uint32_t a2dp_audio_latency_adapt_target(void) {
+  A2DP_AUDIO_LATENCY_ADAPT_T *adapt = &a2dp_audio_latency_adapt;
+  float mut_ms = a2dp_audio_latency_adapt_mut_ms();
+  float target, lo, hi;
+
+  lo = adapt->base_mut * adapt->min_factor;
+  hi = adapt->base_mut * adapt->max_factor;
+  if (adapt->mtu_limiter) {
+    hi = MIN(hi, (float)adapt->mtu_limiter * 3 / 4);
+  }
+  if (mut_ms == 0) {
+    return a2dp_audio_context.dest_packet_mut;
+  }
+  target = ((float)adapt->peak_us * 5 / 4 / 1000 +
+            A2DP_AUDIO_LATENCY_ADAPT_MARGIN_MS) /
+           mut_ms;
+  target = MIN(MAX(target, lo), hi);
+  return (uint32_t)(target + 0.5f);
+}
+
+// Moves the list depth target toward what the measured lateness asks for,
+// upward quickly and downward one list entry per interval.
+static void a2dp_audio_latency_adapt_proc(void) {
+  A2DP_AUDIO_LATENCY_ADAPT_T *adapt = &a2dp_audio_latency_adapt;
+  uint32_t now_ms = TICKS_TO_MS(hal_sys_timer_get());
+  uint32_t dest = a2dp_audio_context.dest_packet_mut;
+  uint32_t target;
+
+  if (adapt->policy != A2DP_AUDIO_LATENCY_POLICY_ADAPTIVE ||
+      now_ms - adapt->step_ms < A2DP_AUDIO_LATENCY_ADAPT_INTERVAL_MS) {
+    return;
+  }
+  adapt->step_ms = now_ms;
+  adapt->peak_us -= adapt->peak_us >> A2DP_AUDIO_LATENCY_ADAPT_DECAY_SHIFT;
+
+  target = a2dp_audio_latency_adapt_target();
+  if (target > dest) {
+    dest += MAX(1, (target - dest) / 4);
+  } else if (target + dest / 8 < dest) {
+    dest--;
+  }
+  if (dest != a2dp_audio_context.dest_packet_mut) {
+    a2dp_audio_latency_adapt_apply(dest);
+  }
+}
+
+// An underflow refills the list anyway, so the target can jump.
+static void a2dp_audio_latency_adapt_underflow(void) {
+  A2DP_AUDIO_LATENCY_ADAPT_T *adapt = &a2dp_audio_latency_adapt;
+  uint32_t dest = a2dp_audio_context.dest_packet_mut;
+  uint32_t target;
+
+  // the stall that caused it is already in the peak, but keep climbing if
+  // the estimate keeps coming up short
+  adapt->peak_us += adapt->peak_us / 4;
+  target = a2dp_audio_latency_adapt_target();
+  if (target > dest) {
+    a2dp_audio_latency_adapt_apply(target);
+  }
+}
+
+// Rate offset to walk the list depth toward a target that moved. The PID
+// loop only runs every A2DP_AUDIO_SYNC_INTERVAL and is held to a few hundred
+// ppm, which would take minutes to follow a step. Whether a walk is under way
+// is read back from the last requested ratio, so a tune that was refused
+// while another was in flight is simply asked for again.
+static bool a2dp_audio_latency_adapt_slew(float *ratio) {
+  float ref = a2dp_audio_context.init_factor_reference;
+  float diff, band;
+  int32_t dir, cur_dir = 0;
+
+  if (a2dp_audio_latency_adapt.policy != A2DP_AUDIO_LATENCY_POLICY_ADAPTIVE) {
+    return false;
+  }
+  if (sync_tune_dest_ratio > ref + A2DP_AUDIO_LATENCY_ADAPT_SLEW / 2) {
+    cur_dir = 1;
+  } else if (sync_tune_dest_ratio < ref - A2DP_AUDIO_LATENCY_ADAPT_SLEW / 2) {
+    cur_dir = -1;
+  }
+  diff = a2dp_audio_context.average_packet_mut -
+         (float)a2dp_audio_context.dest_packet_mut;
+  band = MAX((float)a2dp_audio_context.dest_packet_mut / 8, 1.0f);
+  if (diff > band) {
+    dir = 1;
+  } else if (diff < -band) {
+    dir = -1;
+  } else if (cur_dir && diff * cur_dir > 1.0f) {
+    dir = cur_dir;
+  } else {
+    dir = 0;
+  }
+  if (dir == 0 && cur_dir == 0) {
+    return false;
+  }
+  *ratio = ref + dir * A2DP_AUDIO_LATENCY_ADAPT_SLEW;
+  return true;
+}
+
+static const uint32_t
+    a2dp_audio_stats_jitter_edge_us[A2DP_AUDIO_STATS_JITTER_BINS - 1] = {
+        1000, 2000, 5000, 10000, 20000, 50000, 100000,
+};
+
+static void a2dp_audio_stats_stream_start(A2DP_AUDIO_CODEC_TYPE codec_type) {
+  A2DP_AUDIO_STATS_DECODE_ACC_T *acc = NULL;
+  uint32_t i;
+
+  for (i = 0; i < A2DP_AUDIO_STATS_CODEC_MAX; i++) {
+    acc = &a2dp_audio_stats_decode_acc[i];
+    if (acc->codec_type == codec_type || acc->codec_type == 0) {
+      break;
+    }
+  }
+  // table full, the last slot is shared by whatever codec comes next
+  if (acc->codec_type != codec_type) {
+    memset(acc, 0, sizeof(*acc));
+    acc->codec_type = codec_type;
+  }
+  a2dp_audio_stats_decode_curr = acc;
+  a2dp_audio_stats_last_arrival = 0;
+  a2dp_audio_stats_avg_gap_q4 = 0;
+}
+
+static void a2dp_audio_stats_arrival(btif_media_header_t *header) {
+  uint32_t now = hal_fast_sys_timer_get();
+  uint32_t gap_us, avg_us, dev_us, gap_ms;
+  uint32_t lost = 0;
+  uint16_t seq_diff;
+  uint32_t bin;
+
+  a2dp_audio_stats.packets++;
+  if (a2dp_audio_stats_last_arrival == 0) {
+    a2dp_audio_stats_last_arrival = now;
+    a2dp_audio_stats_last_seq = header->sequenceNumber;
+    return;
+  }
+
+  seq_diff = header->sequenceNumber - a2dp_audio_stats_last_seq;
+  if (seq_diff > 1 && seq_diff < 0x8000) {
+    lost = seq_diff - 1;
+    a2dp_audio_stats.seq_gaps += lost;
+  }
+  a2dp_audio_stats_last_seq = header->sequenceNumber;
+
+  gap_us = FAST_TICKS_TO_US(now - a2dp_audio_stats_last_arrival);
+  a2dp_audio_stats_last_arrival = now;
+  gap_ms = gap_us / 1000;
+  if (gap_ms > a2dp_audio_stats.max_gap_ms) {
+    a2dp_audio_stats.max_gap_ms = gap_ms;
+  }
+
+  if (a2dp_audio_stats_avg_gap_q4 == 0) {
+    a2dp_audio_stats_avg_gap_q4 = gap_us << 4;
+    return;
+  }
+  avg_us = a2dp_audio_stats_avg_gap_q4 >> 4;
+  dev_us = gap_us > avg_us ? gap_us - avg_us : avg_us - gap_us;
+  for (bin = 0; bin < A2DP_AUDIO_STATS_JITTER_BINS - 1; bin++) {
+    if (dev_us < a2dp_audio_stats_jitter_edge_us[bin]) {
+      break;
+    }
+  }
+  a2dp_audio_stats.jitter_hist[bin]++;
+  a2dp_audio_latency_adapt_arrival(gap_us, avg_us, lost);
+  // a stall is counted above but kept out of the average gap
+  if (gap_us <= avg_us * 8) {
+    a2dp_audio_stats_avg_gap_q4 += gap_us - avg_us;
+  }
+}
+
+static void a2dp_audio_stats_depth(list_t *list) {
+  uint32_t sample_rate = a2dp_audio_context.output_cfg.sample_rate;
+  uint32_t list_samples = a2dp_audio_lastframe_info.list_samples;
+  uint32_t depth_ms;
+  uint32_t bin;
+
+  if (!sample_rate || !list_samples) {
+    return;
+  }
+  depth_ms = (a2dp_audio_list_length(list) + get_in_cp_frame_cnt()) *
+             list_samples * 1000 / sample_rate;
+  bin = depth_ms / A2DP_AUDIO_STATS_DEPTH_BIN_MS;
+  if (bin >= A2DP_AUDIO_STATS_DEPTH_BINS) {
+    bin = A2DP_AUDIO_STATS_DEPTH_BINS - 1;
+  }
+  a2dp_audio_stats.depth_hist[bin]++;
+}
+
+static void a2dp_audio_stats_decode(uint32_t start_tick) {
+  A2DP_AUDIO_STATS_DECODE_ACC_T *acc = a2dp_audio_stats_decode_curr;
+  uint32_t us;
+
+  if (!acc) {
+    return;
+  }
+  us = FAST_TICKS_TO_US(hal_fast_sys_timer_get() - start_tick);
+  if (acc->calls == 0 || us < acc->min_us) {
+    acc->min_us = us;
+  }
+  if (us > acc->max_us) {
+    acc->max_us = us;
+  }
+  acc->total_us += us;
+  acc->calls++;
+}
+
+static void a2dp_audio_stats_pid(float ratio) {
+  int32_t ppm = (int32_t)((ratio - A2DP_AUDIO_SYNC_FACTOR_REFERENCE) * 1e6f);
+
+  a2dp_audio_stats.pid_corrections++;
+  a2dp_audio_stats.pid_last_ppm = ppm;
+  if (ABS(ppm) > ABS(a2dp_audio_stats.pid_peak_ppm)) {
+    a2dp_audio_stats.pid_peak_ppm = ppm;
+  }
+}
+
+void a2dp_audio_stats_get(A2DP_AUDIO_STATS_T *stats) {
+  A2DP_AUDIO_STATS_DECODE_ACC_T *acc;
+  A2DP_AUDIO_STATS_DECODE_T *dec;
+  uint32_t lock;
+  uint32_t i;
+
+  lock = int_lock();
+  memcpy(stats, &a2dp_audio_stats, sizeof(*stats));
+  for (i = 0; i < A2DP_AUDIO_STATS_CODEC_MAX; i++) {
+    acc = &a2dp_audio_stats_decode_acc[i];
+    dec = &stats->decode[i];
+    dec->codec_type = acc->codec_type;
+    dec->reserved = 0;
+    dec->calls = acc->calls;
+    dec->min_us = acc->min_us;
+    dec->max_us = acc->max_us;
+    dec->avg_us = acc->calls ? (uint32_t)(acc->total_us / acc->calls) : 0;
+  }
+  int_unlock(lock);
+
+  stats->version = A2DP_AUDIO_STATS_VERSION;
+  stats->size = sizeof(A2DP_AUDIO_STATS_T);
+  stats->elapsed_ms =
+      TICKS_TO_MS(hal_sys_timer_get()) - a2dp_audio_stats_start_ms;
+}
+
+void a2dp_audio_stats_reset(void) {
+  uint32_t lock;
+  uint32_t i;
+
+  lock = int_lock();
+  memset(&a2dp_audio_stats, 0, sizeof(a2dp_audio_stats));
+  for (i = 0; i < A2DP_AUDIO_STATS_CODEC_MAX; i++) {
+    uint16_t codec_type = a2dp_audio_stats_decode_acc[i].codec_type;
+    memset(&a2dp_audio_stats_decode_acc[i], 0,
+           sizeof(A2DP_AUDIO_STATS_DECODE_ACC_T));
+    a2dp_audio_stats_decode_acc[i].codec_type = codec_type;
+  }
+  a2dp_audio_stats_start_ms = TICKS_TO_MS(hal_sys_timer_get());
+  int_unlock(lock);
+}
+
 int a2dp_audio_sync_pid_config(void) {
   A2DP_AUDIO_SYNC_T *audio_sync = &a2dp_audio_context.audio_sync;
   A2DP_AUDIO_SYNC_PID_T *pid = &audio_sync->pid;
@@ -850,6 +1397,7 @@ int a2dp_audio_sync_handler(uint8_t *buffer, uint32_t buffer_bytes) {
         if (a2dp_audio_context.output_cfg.factor_reference != dest_pid_result) {
           if (!a2dp_audio_sync_tune(dest_pid_result)) {
             audio_sync->cnt = 0;
+            a2dp_audio_stats_pid(dest_pid_result);
           }
           TRACE_A2DP_DECODER_I(
               "[SYNC] tune diff_factor:%10.9f pid:%10.9f tune:%10.9f",
@@ -883,6 +1431,8 @@ int a2dp_audio_sync_handler(uint8_t *buffer, uint32_t buffer_bytes) {
       dest_pid_result = a2dp_audio_context.init_factor_reference +
                         A2DP_AUDIO_SYNC_FACTOR_SLOW_LIMIT;
       need_tune = true;
+    } else if (a2dp_audio_latency_adapt_slew(&dest_pid_result)) {
+      need_tune = true;
     }
 #if defined(IBRT)
     if (!app_tws_ibrt_audio_sync_tune_onprocess() &&
@@ -895,6 +1445,7 @@ int a2dp_audio_sync_handler(uint8_t *buffer, uint32_t buffer_bytes) {
       if (a2dp_audio_context.output_cfg.factor_reference != dest_pid_result) {
         a2dp_audio_sync_reset_data();
         a2dp_audio_sync_tune(dest_pid_result);
+        a2dp_audio_stats.force_slow_tunes++;
         TRACE_A2DP_DECODER_I("[SYNC] tune ratio force slow %d/%d->%d",
                              lastframe_info->undecode_min_frames,
                              lastframe_info->undecode_max_frames,
@@ -1257,6 +1808,7 @@ int a2dp_audio_store_packet(btif_media_header_t *header, unsigned char *buf,
       A2DP_AUDIO_DECODER_STORE_PACKET_STATUS_BUSY);
   if (a2dp_audio_get_status() == A2DP_AUDIO_DECODER_STATUS_START) {
     a2dp_audio_store_packet_checker(header);
+    a2dp_audio_stats_arrival(header);
     if (a2dp_audio_context.need_detect_first_packet) {
       a2dp_audio_context.need_detect_first_packet = false;
       a2dp_audio_context.audio_decoder.audio_decoder_preparse_packet(header,
@@ -1275,6 +1827,7 @@ int a2dp_audio_store_packet(btif_media_header_t *header, unsigned char *buf,
       app_ibrt_if_force_audio_retrigger();
     }
     if (nRet == A2DP_DECODER_MTU_LIMTER_ERROR) {
+      a2dp_audio_stats.mtu_limiter++;
       if (app_tws_ibrt_mobile_link_connected()) {
         // try again
         // a2dp_audio_semaphore_wait(A2DP_AUDIO_WAIT_TIMEOUT_MS);
@@ -1306,6 +1859,7 @@ int a2dp_audio_store_packet(btif_media_header_t *header, unsigned char *buf,
     }
 
     if (nRet == A2DP_DECODER_MTU_LIMTER_ERROR) {
+      a2dp_audio_stats.mtu_limiter++;
       a2dp_audio_synchronize_dest_packet_mut(
           a2dp_audio_context.dest_packet_mut);
       a2dp_audio_context.audio_decoder.audio_decoder_store_packet(header, buf,
@@ -1332,6 +1886,7 @@ uint32_t a2dp_audio_playback_handler(uint8_t *buffer, uint32_t buffer_bytes) {
   int nRet = A2DP_DECODER_NO_ERROR;
   A2DP_AUDIO_LASTFRAME_INFO_T *lastframe_info = NULL;
   list_t *list = a2dp_audio_context.audio_datapath.input_raw_packet_list;
+  uint32_t decode_tick;
 
   a2dp_audio_set_playback_status(A2DP_AUDIO_DECODER_PLAYBACK_STATUS_BUSY);
   if (a2dp_audio_get_status() != A2DP_AUDIO_DECODER_STATUS_START) {
@@ -1341,6 +1896,11 @@ uint32_t a2dp_audio_playback_handler(uint8_t *buffer, uint32_t buffer_bytes) {
   }
 
   a2dp_audio_sysfreq_boost_porc();
+  a2dp_audio_stats_depth(list);
+  a2dp_audio_latency_adapt_proc();
+  if (a2dp_audio_refill_packet()) {
+    a2dp_audio_stats.refill_callbacks++;
+  }
   if (a2dp_audio_context.average_packet_mut == 0) {
     A2DP_AUDIO_HEADFRAME_INFO_T headframe_info;
     a2dp_audio_decoder_headframe_info_get(&headframe_info);
@@ -1396,8 +1956,14 @@ uint32_t a2dp_audio_playback_handler(uint8_t *buffer, uint32_t buffer_bytes) {
 
       len = len / (sizeof(int32_t) / sizeof(int16_t));
 
+      decode_tick = hal_fast_sys_timer_get();
+      PERF_PROBE_BEGIN(PERF_PROBE_A2DP_DECODE);
       nRet = a2dp_audio_context.audio_decoder.audio_decoder_decode_frame(buffer,
                                                                          len);
+      PERF_PROBE_END(PERF_PROBE_A2DP_DECODE);
+      if (nRet == A2DP_DECODER_NO_ERROR) {
+        a2dp_audio_stats_decode(decode_tick);
+      }
       if (nRet < 0 || a2dp_audio_context.mute_frame_cnt_after_no_cache) {
         TRACE_A2DP_DECODER_I("[PLAYBACK] decode failed nRet=%d mute_cnt:%d",
                              nRet,
@@ -1415,8 +1981,14 @@ uint32_t a2dp_audio_playback_handler(uint8_t *buffer, uint32_t buffer_bytes) {
     } else if (a2dp_audio_context.output_cfg.bits_depth ==
                a2dp_audio_context.audio_decoder.stream_info.bits_depth) {
 
+      decode_tick = hal_fast_sys_timer_get();
+      PERF_PROBE_BEGIN(PERF_PROBE_A2DP_DECODE);
       nRet = a2dp_audio_context.audio_decoder.audio_decoder_decode_frame(buffer,
                                                                          len);
+      PERF_PROBE_END(PERF_PROBE_A2DP_DECODE);
+      if (nRet == A2DP_DECODER_NO_ERROR) {
+        a2dp_audio_stats_decode(decode_tick);
+      }
       if (nRet < 0 || a2dp_audio_context.mute_frame_cnt_after_no_cache) {
         // mute frame
         TRACE_A2DP_DECODER_I("[PLAYBACK] decode failed nRet=%d mute_cnt:%d",
@@ -1437,6 +2009,11 @@ uint32_t a2dp_audio_playback_handler(uint8_t *buffer, uint32_t buffer_bytes) {
     }
     TRACE(2, "CACHE_UNDERFLOW lastseq:%d ftick:%d",
           lastframe_info->sequenceNumber, hal_fast_sys_timer_get());
+    a2dp_audio_stats.underflows++;
+    if (a2dp_audio_latency_adapt.policy ==
+        A2DP_AUDIO_LATENCY_POLICY_ADAPTIVE) {
+      a2dp_audio_latency_adapt_underflow();
+    }
     a2dp_audio_show_history_seq();
     uint32_t mute_frames = A2DP_AUDIO_MUTE_FRAME_CNT_AFTER_NO_CACHE;
     uint32_t skip_frames =
@@ -1481,8 +2058,19 @@ exit:
 #else
     bool force_audio_retrigger = false;
 #endif
-    if (a2dp_audio_latency_factor_get() == A2DP_AUDIO_LATENCY_LOW_FACTOR &&
+    if (a2dp_audio_latency_adapt.policy ==
+            A2DP_AUDIO_LATENCY_POLICY_ADAPTIVE &&
         app_tws_ibrt_mobile_link_connected()) {
+      // already raised by the adaptive target, keep the peer's restart in step
+      if (app_tws_ibrt_tws_link_connected() &&
+          app_ibrt_ui_is_profile_exchanged()) {
+        float latency_factor = a2dp_audio_latency_factor_get();
+        tws_ctrl_send_cmd(APP_TWS_CMD_SET_LATENCYFACTOR,
+                          (uint8_t *)&latency_factor, sizeof(latency_factor));
+      }
+    } else if (a2dp_audio_latency_factor_get() ==
+                   A2DP_AUDIO_LATENCY_LOW_FACTOR &&
+               app_tws_ibrt_mobile_link_connected()) {
       a2dp_audio_latency_factor_sethigh();
       if (app_tws_ibrt_tws_link_connected() &&
           app_ibrt_ui_is_profile_exchanged()) {
@@ -1560,14 +2148,19 @@ int a2dp_audio_init(uint32_t sysfreq, A2DP_AUDIO_CODEC_TYPE codec_type,
 
   memset(&a2dp_audio_lastframe_info, 0, sizeof(A2DP_AUDIO_LASTFRAME_INFO_T));
 
+  a2dp_audio_context.dest_packet_mut = dest_packet_mut;
+  a2dp_audio_latency_adapt_start(dest_packet_mut);
+  a2dp_audio_slab_init(&a2dp_audio_node_slab, "node", sizeof(list_node_t),
+                       a2dp_audio_dest_packet_mut_max() *
+                           A2DP_AUDIO_SLAB_DEPTH_FACTOR);
+
   a2dp_audio_context.audio_datapath.input_raw_packet_list = a2dp_audio_list_new(
-      a2dp_audio_packet_free, (list_mempool_zmalloc)a2dp_audio_heap_cmalloc,
-      (list_mempool_free)a2dp_audio_heap_free);
+      a2dp_audio_packet_free, a2dp_audio_list_node_zmalloc,
+      a2dp_audio_list_node_free);
 
   a2dp_audio_context.audio_datapath.output_pcm_packet_list =
-      a2dp_audio_list_new(a2dp_audio_packet_free,
-                          (list_mempool_zmalloc)a2dp_audio_heap_cmalloc,
-                          (list_mempool_free)a2dp_audio_heap_free);
+      a2dp_audio_list_new(a2dp_audio_packet_free, a2dp_audio_list_node_zmalloc,
+                          a2dp_audio_list_node_free);
 
   memcpy(&(a2dp_audio_context.output_cfg), config,
          sizeof(A2DP_AUDIO_OUTPUT_CONFIG_T));
@@ -1576,7 +2169,6 @@ int a2dp_audio_init(uint32_t sysfreq, A2DP_AUDIO_CODEC_TYPE codec_type,
 
   a2dp_audio_context.init_factor_reference = config->factor_reference;
   a2dp_audio_context.chnl_sel = chnl_sel;
-  a2dp_audio_context.dest_packet_mut = dest_packet_mut;
   a2dp_audio_context.average_packet_mut = 0;
 
   switch (codec_type) {
@@ -1657,6 +2249,7 @@ int a2dp_audio_init(uint32_t sysfreq, A2DP_AUDIO_CODEC_TYPE codec_type,
   a2dp_audio_reset_history_seq();
 #endif
   a2dp_audio_store_packet_checker_start();
+  a2dp_audio_stats_stream_start(codec_type);
 
   a2dp_audio_status_mutex_unlock();
 
@@ -1685,11 +2278,14 @@ int a2dp_audio_deinit(void) {
       a2dp_audio_context.audio_datapath.output_pcm_packet_list);
   a2dp_audio_context.audio_datapath.output_pcm_packet_list = NULL;
 
+  a2dp_audio_slab_deinit_all();
+
   size_t total = 0, used = 0, max_used = 0;
   a2dp_audio_heap_info(&total, &used, &max_used);
   TRACE_A2DP_DECODER_I(
       "[DEINIT] heap info: total - %d, used - %d, max_used - %d.", total, used,
       max_used);
+  a2dp_audio_slab_list = NULL;
   // ASSERT_A2DP_DECODER(used == 0, "[%s] used != 0", __func__);
 
   a2dp_audio_set_store_packet_status(
@@ -1783,6 +2379,7 @@ int a2dp_audio_discards_packet(uint32_t packets) {
     nRet =
         a2dp_audio_context.audio_decoder.audio_decoder_discards_packet(packets);
     a2dp_audio_status_mutex_unlock();
+    a2dp_audio_stats.discard_packets += packets;
   } else {
     nRet = -1;
   }
@@ -1812,6 +2409,7 @@ int a2dp_audio_synchronize_dest_packet_mut(uint32_t mtu) {
 }
 
 int a2dp_audio_discards_samples(uint32_t samples) {
+  a2dp_audio_stats.discard_samples += samples;
   return a2dp_audio_context.audio_decoder.a2dp_audio_discards_samples(samples);
 }
 
@@ -2032,6 +2630,30 @@ int a2dp_audio_latency_factor_status_get(
   return 0;
 }
 
+int a2dp_audio_latency_policy_set(A2DP_AUDIO_LATENCY_POLICY_E policy,
+                                  float min_factor, float max_factor) {
+  A2DP_AUDIO_LATENCY_ADAPT_T *adapt = &a2dp_audio_latency_adapt;
+  uint32_t lock;
+
+  ASSERT_A2DP_DECODER(min_factor > 0 && min_factor <= max_factor,
+                      "%s factor:%d/%d", __func__, (int32_t)(min_factor * 100),
+                      (int32_t)(max_factor * 100));
+  lock = int_lock();
+  adapt->policy = policy;
+  adapt->min_factor = min_factor;
+  adapt->max_factor = max_factor;
+  adapt->peak_us = 0;
+  int_unlock(lock);
+  TRACE_A2DP_DECODER_I("[LATENCY] policy:%d factor:%d/%d", policy,
+                       (int32_t)(min_factor * 100),
+                       (int32_t)(max_factor * 100));
+  return 0;
+}
+
+A2DP_AUDIO_LATENCY_POLICY_E a2dp_audio_latency_policy_get(void) {
+  return a2dp_audio_latency_adapt.policy;
+}
+
 int a2dp_audio_frame_delay_get(void) { return get_in_cp_frame_delay(); }
 
 int a2dp_audio_dest_packet_mut_get(void) {
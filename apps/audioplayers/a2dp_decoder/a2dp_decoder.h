@@ -50,6 +50,15 @@ typedef enum {
     A2DP_AUDIO_LATENCY_STATUS_HIGH,
 } A2DP_AUDIO_LATENCY_STATUS_E;
 
+// STATIC keeps the list depth target the stream was started with (scaled by
+// the latency factor). ADAPTIVE moves it between min_factor and max_factor
+// times the unscaled target, following the measured arrival lateness, and
+// keeps the latency factor in step so a restart begins at the learnt depth.
+typedef enum {
+    A2DP_AUDIO_LATENCY_POLICY_STATIC,
+    A2DP_AUDIO_LATENCY_POLICY_ADAPTIVE,
+} A2DP_AUDIO_LATENCY_POLICY_E;
+
 typedef struct  {
     uint32_t sample_rate;
     uint8_t num_channels;
@@ -101,6 +110,50 @@ typedef A2DP_AUDIO_LASTFRAME_INFO_T A2DP_AUDIO_SYNCFRAME_INFO_T;
 
 typedef int(*A2DP_AUDIO_DETECT_NEXT_PACKET_CALLBACK)(btif_media_header_t *, unsigned char *, unsigned int len);
 
+// Jitter-buffer statistics, counted since boot or the last
+// a2dp_audio_stats_reset(). The record is sent as is over TOTA, so the layout
+// is little endian, packed and only ever extended at the end; bump
+// A2DP_AUDIO_STATS_VERSION when it changes.
+#define A2DP_AUDIO_STATS_VERSION          (1)
+#define A2DP_AUDIO_STATS_DEPTH_BINS       (16)
+#define A2DP_AUDIO_STATS_DEPTH_BIN_MS     (25)
+#define A2DP_AUDIO_STATS_JITTER_BINS      (8)
+#define A2DP_AUDIO_STATS_CODEC_MAX        (4)
+
+typedef struct {
+    uint16_t codec_type;                // A2DP_AUDIO_CODEC_TYPE_*, 0 if unused
+    uint16_t reserved;
+    uint32_t calls;                     // one per playback callback
+    uint32_t min_us;
+    uint32_t avg_us;
+    uint32_t max_us;
+} __attribute__ ((__packed__)) A2DP_AUDIO_STATS_DECODE_T;
+
+typedef struct {
+    uint16_t version;
+    uint16_t size;
+    uint32_t elapsed_ms;
+    // playback callbacks by list depth, bin n is [n*25, (n+1)*25) ms and the
+    // last bin is open ended
+    uint32_t depth_hist[A2DP_AUDIO_STATS_DEPTH_BINS];
+    // packets by |gap - average gap| between arrivals, bin upper edges are
+    // 1, 2, 5, 10, 20, 50, 100 ms and the last bin is open ended
+    uint32_t jitter_hist[A2DP_AUDIO_STATS_JITTER_BINS];
+    uint32_t packets;
+    uint32_t seq_gaps;                  // packets missing from the sequence
+    uint32_t max_gap_ms;                // longest silence between packets
+    A2DP_AUDIO_STATS_DECODE_T decode[A2DP_AUDIO_STATS_CODEC_MAX];
+    uint32_t pid_corrections;           // tunes issued by the PID loop
+    uint32_t force_slow_tunes;          // tunes issued on a low watermark
+    int32_t pid_last_ppm;
+    int32_t pid_peak_ppm;               // largest |correction| seen
+    uint32_t discard_packets;
+    uint32_t discard_samples;
+    uint32_t mtu_limiter;               // packets stored into a full list
+    uint32_t refill_callbacks;          // callbacks muted or skipped to refill
+    uint32_t underflows;
+} __attribute__ ((__packed__)) A2DP_AUDIO_STATS_T;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -144,10 +197,14 @@ int a2dp_audio_latency_factor_set(float factor);
 int a2dp_audio_frame_delay_get(void);
 int a2dp_audio_dest_packet_mut_get(void);
 int a2dp_audio_latency_factor_status_get(A2DP_AUDIO_LATENCY_STATUS_E *latency_status, float *more_latency_factor);
+int a2dp_audio_latency_policy_set(A2DP_AUDIO_LATENCY_POLICY_E policy, float min_factor, float max_factor);
+A2DP_AUDIO_LATENCY_POLICY_E a2dp_audio_latency_policy_get(void);
 #if A2DP_DECODER_HISTORY_SEQ_SAVE    
 int a2dp_audio_show_history_seq(void);
 #endif
 int a2dp_audio_set_channel_select(A2DP_AUDIO_CHANNEL_SELECT_E chnl_sel);
+void a2dp_audio_stats_get(A2DP_AUDIO_STATS_T *stats);
+void a2dp_audio_stats_reset(void);
 
 #ifdef __cplusplus
 }
@@ -35,6 +35,7 @@
 #endif
 #define AAC_OUTPUT_FRAME_SAMPLES (1024)
 #define DECODE_AAC_PCM_FRAME_LENGTH (2048)
+#define AAC_OUTPUT_FRAME_BYTES (AAC_OUTPUT_FRAME_SAMPLES * 2 * 2)
 
 #define AAC_READBUF_SIZE (900)
 
@@ -66,24 +67,25 @@ static a2dp_audio_aac_decoder_frame_t aac_decoder_last_valid_frame = {
 };
 static bool aac_decoder_last_valid_frame_ready = false;
 
+static A2DP_AUDIO_SLAB_T a2dp_audio_aac_slab;
+
+// Only allocated once an output buffer ends inside a frame
+static A2DP_AUDIO_PCM_CARRY_T a2dp_audio_aac_carry;
+
 static void *a2dp_audio_aac_lc_frame_malloc(uint32_t packet_len) {
   a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p = NULL;
-  uint8_t *aac_buffer = NULL;
 
-  aac_buffer = (uint8_t *)a2dp_audio_heap_malloc(AAC_READBUF_SIZE);
   aac_decoder_frame_p =
-      (a2dp_audio_aac_decoder_frame_t *)a2dp_audio_heap_malloc(
-          sizeof(a2dp_audio_aac_decoder_frame_t));
-  aac_decoder_frame_p->aac_buffer = aac_buffer;
+      (a2dp_audio_aac_decoder_frame_t *)a2dp_audio_slab_malloc(
+          &a2dp_audio_aac_slab,
+          sizeof(a2dp_audio_aac_decoder_frame_t) + AAC_READBUF_SIZE);
+  aac_decoder_frame_p->aac_buffer = (uint8_t *)(aac_decoder_frame_p + 1);
   aac_decoder_frame_p->aac_buffer_len = packet_len;
   return (void *)aac_decoder_frame_p;
 }
 
 static void a2dp_audio_aac_lc_free(void *packet) {
-  a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p =
-      (a2dp_audio_aac_decoder_frame_t *)packet;
-  a2dp_audio_heap_free(aac_decoder_frame_p->aac_buffer);
-  a2dp_audio_heap_free(aac_decoder_frame_p);
+  a2dp_audio_slab_free(&a2dp_audio_aac_slab, packet);
 }
 
 static void a2dp_audio_aac_lc_decoder_init(void) {
@@ -508,6 +510,7 @@ int a2dp_audio_aac_lc_init(A2DP_AUDIO_OUTPUT_CONFIG_T *config, void *context) {
   a2dp_audio_aac_lastframe_info.list_samples = AAC_OUTPUT_FRAME_SAMPLES;
   a2dp_audio_decoder_internal_lastframe_info_set(
       &a2dp_audio_aac_lastframe_info);
+  memset(&a2dp_audio_aac_carry, 0, sizeof(a2dp_audio_aac_carry));
 
   ASSERT_A2DP_DECODER(a2dp_audio_context_p->dest_packet_mut < AAC_MTU_LIMITER,
                       "%s MTU OVERFLOW:%u/%u", __func__,
@@ -515,7 +518,15 @@ int a2dp_audio_aac_lc_init(A2DP_AUDIO_OUTPUT_CONFIG_T *config, void *context) {
 
   aac_mempoll = (uint8_t *)a2dp_audio_heap_malloc(AAC_MEMPOOL_SIZE);
   ASSERT_A2DP_DECODER(aac_mempoll, "aac_mempoll = NULL");
+  a2dp_audio_aac_carry.buf =
+      (uint8_t *)a2dp_audio_heap_malloc(AAC_OUTPUT_FRAME_BYTES);
+  ASSERT_A2DP_DECODER(a2dp_audio_aac_carry.buf, "aac carry buf = NULL");
+  a2dp_audio_aac_carry.size = AAC_OUTPUT_FRAME_BYTES;
   aac_memhandle = heap_register(aac_mempoll, AAC_MEMPOOL_SIZE);
+  a2dp_audio_slab_init(&a2dp_audio_aac_slab, "aac",
+                       sizeof(a2dp_audio_aac_decoder_frame_t) +
+                           AAC_READBUF_SIZE,
+                       a2dp_audio_slab_depth_get(aac_mtu_limiter));
 
 #ifdef A2DP_CP_ACCEL
   int ret;
@@ -541,6 +552,8 @@ int a2dp_audio_aac_lc_deinit(void) {
 #endif
   a2dp_audio_aac_lc_decoder_deinit();
   a2dp_audio_aac_lc_reorder_deinit();
+  a2dp_audio_heap_free(a2dp_audio_aac_carry.buf);
+  a2dp_audio_aac_carry.buf = NULL;
   size_t total = 0, used = 0, max_used = 0;
   heap_memory_info(aac_memhandle, &total, &used, &max_used);
   a2dp_audio_heap_free(aac_mempoll);
@@ -551,18 +564,87 @@ int a2dp_audio_aac_lc_deinit(void) {
   return A2DP_DECODER_NO_ERROR;
 }
 
-int a2dp_audio_aac_lc_mcu_decode_frame(uint8_t *buffer, uint32_t buffer_bytes) {
-  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
-  list_node_t *node = NULL;
-  a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p = NULL;
-
+// Decodes one frame into pcm. Returns the PCM length in bytes, or 0 if the
+// frame could not be decoded.
+static int a2dp_audio_aac_lc_decode_one(
+    a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p, uint8_t *pcm,
+    uint32_t pcm_bytes) {
   UINT bufferSize = 0, bytesValid = 0;
   AAC_DECODER_ERROR decoder_err = AAC_DEC_OK;
   CStreamInfo *stream_info = NULL;
+  uint32_t aac_maxreadBytes = AAC_READBUF_SIZE;
+  int output_byte = 0;
+
+  if (aac_decoder_frame_p->aac_buffer_len < 64)
+    aac_maxreadBytes = 64;
+  else if (aac_decoder_frame_p->aac_buffer_len < 128)
+    aac_maxreadBytes = 128;
+  else if (aac_decoder_frame_p->aac_buffer_len < 256)
+    aac_maxreadBytes = 256;
+  else if (aac_decoder_frame_p->aac_buffer_len < 512)
+    aac_maxreadBytes = 512;
+  else if (aac_decoder_frame_p->aac_buffer_len < 1024)
+    aac_maxreadBytes = 1024;
+
+  bufferSize = aac_maxreadBytes;
+  bytesValid = aac_maxreadBytes;
+  decoder_err =
+      aacDecoder_Fill(aacDec_handle, &(aac_decoder_frame_p->aac_buffer),
+                      &bufferSize, &bytesValid);
+  if (decoder_err != AAC_DEC_OK) {
+    TRACE_A2DP_DECODER_W("[MCU][AAC] aacDecoder_Fill failed:0x%x", decoder_err);
+    // if aac failed reopen it again
+    if (is_aacDecoder_Close(aacDec_handle)) {
+      a2dp_audio_aac_lc_decoder_reinit();
+      TRACE_A2DP_DECODER_I("[MCU][AAC] aac_lc_decode reinin codec \n");
+    }
+    return 0;
+  }
+
+  /* decode one AAC frame */
+  decoder_err = aacDecoder_DecodeFrame(aacDec_handle, (short *)pcm,
+                                       pcm_bytes / 2, 0 /* flags */);
+  TRACE_A2DP_DECODER_D("[MCU][AAC] decoder seq:%d len:%d err:%x",
+                       aac_decoder_frame_p->sequenceNumber,
+                       aac_decoder_frame_p->aac_buffer_len, decoder_err);
+  if (decoder_err != AAC_DEC_OK) {
+    TRACE_A2DP_DECODER_W("[MCU][AAC]aac_lc_decode failed:0x%x", decoder_err);
+    // if aac failed reopen it again
+    if (is_aacDecoder_Close(aacDec_handle)) {
+      a2dp_audio_aac_lc_decoder_reinit();
+      TRACE_A2DP_DECODER_I("[MCU][AAC]aac_lc_decode reinin codec \n");
+    }
+    return 0;
+  }
+
+  stream_info = aacDecoder_GetStreamInfo(aacDec_handle);
+  if (!stream_info || stream_info->sampleRate <= 0) {
+    TRACE_A2DP_DECODER_W("[MCU][AAC]aac_lc_decode invalid stream info");
+    return 0;
+  }
 
+  output_byte = stream_info->frameSize * stream_info->numChannels *
+                2; // sizeof(pcm_buffer[0]);
+  ASSERT_A2DP_DECODER(AAC_OUTPUT_FRAME_SAMPLES == output_byte / 4,
+                      "aac_lc_decode output mismatch samples:%d",
+                      output_byte / 4);
+  return output_byte;
+}
+
+// Fills buffer with as many frames as it takes, taking them off the list up
+// to A2DP_AUDIO_DECODE_BATCH_MAX at a time. A frame that cannot be decoded
+// is output as silence. Returns the bytes output.
+int a2dp_audio_aac_lc_mcu_decode_frame(uint8_t *buffer, uint32_t buffer_bytes) {
+  list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
+  a2dp_audio_aac_decoder_frame_t *aac_decoder_frame_p = NULL;
+  void *frames[A2DP_AUDIO_DECODE_BATCH_MAX];
+  uint32_t list_len = 0;
+  uint32_t remain = 0;
+  uint32_t num = 0;
+  uint32_t i = 0;
   bool cache_underflow = false;
-  uint32_t aac_maxreadBytes = AAC_READBUF_SIZE;
   int output_byte = 0;
+  int frame_byte = 0;
 
   if (buffer_bytes < DECODE_AAC_PCM_FRAME_LENGTH) {
     TRACE_A2DP_DECODER_W("[MCU][AAC] pcm_len = %d \n", buffer_bytes);
@@ -573,89 +655,65 @@ int a2dp_audio_aac_lc_mcu_decode_frame(uint8_t *buffer, uint32_t buffer_bytes) {
     return A2DP_DECODER_NO_ERROR;
   }
 
-  node = a2dp_audio_list_begin(list);
-  if (!node) {
-    TRACE_A2DP_DECODER_W("[MCU][AAC] cache underflow");
-    cache_underflow = true;
-    goto exit;
-  } else {
-    aac_decoder_frame_p =
-        (a2dp_audio_aac_decoder_frame_t *)a2dp_audio_list_node(node);
-
-    if (aac_decoder_frame_p->aac_buffer_len < 64)
-      aac_maxreadBytes = 64;
-    else if (aac_decoder_frame_p->aac_buffer_len < 128)
-      aac_maxreadBytes = 128;
-    else if (aac_decoder_frame_p->aac_buffer_len < 256)
-      aac_maxreadBytes = 256;
-    else if (aac_decoder_frame_p->aac_buffer_len < 512)
-      aac_maxreadBytes = 512;
-    else if (aac_decoder_frame_p->aac_buffer_len < 1024)
-      aac_maxreadBytes = 1024;
+  output_byte =
+      a2dp_audio_pcm_carry_get(&a2dp_audio_aac_carry, buffer, buffer_bytes);
 
-    bufferSize = aac_maxreadBytes;
-    bytesValid = aac_maxreadBytes;
-    decoder_err =
-        aacDecoder_Fill(aacDec_handle, &(aac_decoder_frame_p->aac_buffer),
-                        &bufferSize, &bytesValid);
-    if (decoder_err != AAC_DEC_OK) {
-      TRACE_A2DP_DECODER_W("[MCU][AAC] aacDecoder_Fill failed:0x%x",
-                           decoder_err);
-      // if aac failed reopen it again
-      if (is_aacDecoder_Close(aacDec_handle)) {
-        a2dp_audio_aac_lc_decoder_reinit();
-        TRACE_A2DP_DECODER_I("[MCU][AAC] aac_lc_decode reinin codec \n");
-      }
-      goto end_decode;
+  while ((uint32_t)output_byte < buffer_bytes) {
+    num = (buffer_bytes - output_byte + AAC_OUTPUT_FRAME_BYTES - 1) /
+          AAC_OUTPUT_FRAME_BYTES;
+    if (num > A2DP_AUDIO_DECODE_BATCH_MAX) {
+      num = A2DP_AUDIO_DECODE_BATCH_MAX;
     }
-
-    /* decode one AAC frame */
-    decoder_err = aacDecoder_DecodeFrame(aacDec_handle, (short *)buffer,
-                                         buffer_bytes / 2, 0 /* flags */);
-    TRACE_A2DP_DECODER_D("[MCU][AAC] decoder seq:%d len:%d err:%x",
-                         aac_decoder_frame_p->sequenceNumber,
-                         aac_decoder_frame_p->aac_buffer_len, decoder_err);
-    if (decoder_err != AAC_DEC_OK) {
-      TRACE_A2DP_DECODER_W("[MCU][AAC]aac_lc_decode failed:0x%x", decoder_err);
-      // if aac failed reopen it again
-      if (is_aacDecoder_Close(aacDec_handle)) {
-        a2dp_audio_aac_lc_decoder_reinit();
-        TRACE_A2DP_DECODER_I("[MCU][AAC]aac_lc_decode reinin codec \n");
-      }
-      goto end_decode;
+    num = a2dp_audio_list_peek_batch(list, frames, num, &list_len);
+    if (num == 0) {
+      TRACE_A2DP_DECODER_W("[MCU][AAC] cache underflow");
+      cache_underflow = true;
+      goto exit;
     }
 
-    stream_info = aacDecoder_GetStreamInfo(aacDec_handle);
-    if (!stream_info || stream_info->sampleRate <= 0) {
-      TRACE_A2DP_DECODER_W("[MCU][AAC]aac_lc_decode invalid stream info");
-      goto end_decode;
+    for (i = 0; i < num; i++) {
+      aac_decoder_frame_p = (a2dp_audio_aac_decoder_frame_t *)frames[i];
+      remain = buffer_bytes - output_byte;
+      if (remain >= AAC_OUTPUT_FRAME_BYTES) {
+        frame_byte = a2dp_audio_aac_lc_decode_one(
+            aac_decoder_frame_p, buffer + output_byte, AAC_OUTPUT_FRAME_BYTES);
+        if (frame_byte == 0) {
+          memset(buffer + output_byte, 0, AAC_OUTPUT_FRAME_BYTES);
+        }
+        output_byte += AAC_OUTPUT_FRAME_BYTES;
+      } else {
+        frame_byte = a2dp_audio_aac_lc_decode_one(
+            aac_decoder_frame_p, a2dp_audio_aac_carry.buf,
+            AAC_OUTPUT_FRAME_BYTES);
+        if (frame_byte == 0) {
+          memset(a2dp_audio_aac_carry.buf, 0, AAC_OUTPUT_FRAME_BYTES);
+        }
+        a2dp_audio_pcm_carry_split(&a2dp_audio_aac_carry,
+                                   AAC_OUTPUT_FRAME_BYTES,
+                                   buffer + output_byte, remain);
+        output_byte = buffer_bytes;
+      }
     }
 
-    output_byte = stream_info->frameSize * stream_info->numChannels *
-                  2; // sizeof(pcm_buffer[0]);
-    ASSERT_A2DP_DECODER(AAC_OUTPUT_FRAME_SAMPLES == output_byte / 4,
-                        "aac_lc_decode output mismatch samples:%d",
-                        output_byte / 4);
-  end_decode:
     a2dp_audio_aac_lastframe_info.sequenceNumber =
         aac_decoder_frame_p->sequenceNumber;
     a2dp_audio_aac_lastframe_info.timestamp = aac_decoder_frame_p->timestamp;
     a2dp_audio_aac_lastframe_info.curSubSequenceNumber = 0;
     a2dp_audio_aac_lastframe_info.totalSubSequenceNumber = 0;
     a2dp_audio_aac_lastframe_info.frame_samples = AAC_OUTPUT_FRAME_SAMPLES;
-    a2dp_audio_aac_lastframe_info.decoded_frames++;
-    a2dp_audio_aac_lastframe_info.undecode_frames =
-        a2dp_audio_list_length(list) - 1;
+    a2dp_audio_aac_lastframe_info.decoded_frames += num;
+    a2dp_audio_aac_lastframe_info.undecode_frames = list_len - num;
     a2dp_audio_aac_lastframe_info.check_sum =
         a2dp_audio_decoder_internal_check_sum_generate(
             aac_decoder_frame_p->aac_buffer,
             aac_decoder_frame_p->aac_buffer_len);
     a2dp_audio_decoder_internal_lastframe_info_set(
         &a2dp_audio_aac_lastframe_info);
-    a2dp_audio_list_remove(list, aac_decoder_frame_p);
+    a2dp_audio_list_remove_batch(list, frames, num);
   }
 exit:
   if (cache_underflow) {
+    a2dp_audio_pcm_carry_reset(&a2dp_audio_aac_carry);
     a2dp_audio_aac_lastframe_info.undecode_frames = 0;
     a2dp_audio_aac_lastframe_info.check_sum = 0;
     a2dp_audio_decoder_internal_lastframe_info_set(
@@ -133,6 +133,43 @@ typedef struct {
     uint32_t cnt;
 } A2DP_AUDIO_SYNC_T;
 
+// Fixed-size block pool carved out of the a2dp audio heap at decoder init.
+// Requests larger than block_size, or made while the pool is exhausted, are
+// served by the heap so callers never need to check which one they got.
+#define A2DP_AUDIO_SLAB_DEPTH_FACTOR (2)
+
+typedef struct A2DP_AUDIO_SLAB {
+    const char *name;
+    uint8_t *base;
+    uint8_t *end;
+    void *free_list;
+    uint32_t block_size;
+    uint32_t block_cnt;
+    uint32_t used;
+    uint32_t max_used;
+    uint32_t fallback;
+    struct A2DP_AUDIO_SLAB *next;
+} A2DP_AUDIO_SLAB_T;
+
+// Most frames a batch decoder takes off the packet list per lock. Frames are
+// taken as a batch with a2dp_audio_list_peek_batch(), decoded without the
+// buffer mutex, then freed with a2dp_audio_list_remove_batch().
+#ifndef A2DP_AUDIO_DECODE_BATCH_MAX
+#define A2DP_AUDIO_DECODE_BATCH_MAX (16)
+#endif
+
+// PCM of the frame that straddled the end of the previous output buffer.
+// The decoder writes the whole frame to buf, sends the head of it out with
+// a2dp_audio_pcm_carry_split() and the rest leads the next output buffer
+// through a2dp_audio_pcm_carry_get(), so output buffers need not hold a
+// whole number of frames.
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t len;
+    uint32_t off;
+} A2DP_AUDIO_PCM_CARRY_T;
+
 typedef struct {    
     A2DP_AUDIO_OUTPUT_CONFIG_T output_cfg;
     float init_factor_reference;
@@ -176,12 +213,24 @@ void *a2dp_audio_heap_cmalloc(uint32_t size);
 void *a2dp_audio_heap_realloc(void *rmem, uint32_t newsize);
 void a2dp_audio_heap_free(void *rmem);
 
+int a2dp_audio_slab_init(A2DP_AUDIO_SLAB_T *slab, const char *name, uint32_t block_size, uint32_t block_cnt);
+void *a2dp_audio_slab_malloc(A2DP_AUDIO_SLAB_T *slab, uint32_t size);
+void a2dp_audio_slab_free(A2DP_AUDIO_SLAB_T *slab, void *ptr);
+uint32_t a2dp_audio_slab_depth_get(uint32_t mtu_limiter);
+
+
+void a2dp_audio_pcm_carry_reset(A2DP_AUDIO_PCM_CARRY_T *carry);
+uint32_t a2dp_audio_pcm_carry_get(A2DP_AUDIO_PCM_CARRY_T *carry, uint8_t *out, uint32_t out_bytes);
+void a2dp_audio_pcm_carry_split(A2DP_AUDIO_PCM_CARRY_T *carry, uint32_t len, uint8_t *out, uint32_t out_bytes);
+
 list_node_t *a2dp_audio_list_begin(const list_t *list);
 list_node_t *a2dp_audio_list_end(const list_t *list);
 uint32_t a2dp_audio_list_length(const list_t *list);
 void *a2dp_audio_list_node(const list_node_t *node);
 list_node_t *a2dp_audio_list_next(const list_node_t *node);
 bool a2dp_audio_list_remove(list_t *list, void *data);
+uint32_t a2dp_audio_list_peek_batch(const list_t *list, void **frames, uint32_t max, uint32_t *length);
+void a2dp_audio_list_remove_batch(list_t *list, void *const *frames, uint32_t num);
 bool a2dp_audio_list_append(list_t *list, void *data);
 void a2dp_audio_list_clear(list_t *list);
 void a2dp_audio_list_free(list_t *list);
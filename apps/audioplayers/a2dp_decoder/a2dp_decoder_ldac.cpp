@@ -36,6 +36,8 @@ typedef struct {
 #ifndef LDAC_MTU_LIMITER
 #define LDAC_MTU_LIMITER (200)
 #endif
+/* one frame at 990kbps, 44.1/48kHz */
+#define LDAC_SLAB_FRAME_SIZE (660)
 #define DECODE_LDAC_PCM_FRAME_LENGTH (256 * 4 * 2 * 2)
 
 #define LDAC_LIST_SAMPLES (256)
@@ -652,23 +654,21 @@ int a2dp_audio_ldac_preparse_packet(btif_media_header_t *header,
   return A2DP_DECODER_NO_ERROR;
 }
 
+static A2DP_AUDIO_SLAB_T a2dp_audio_ldac_slab;
+
 static void *a2dp_audio_ldac_frame_malloc(uint32_t packet_len) {
   a2dp_audio_ldac_decoder_frame_t *decoder_frame_p = NULL;
-  uint8_t *buffer = NULL;
 
-  buffer = (uint8_t *)a2dp_audio_heap_malloc(packet_len);
-  decoder_frame_p = (a2dp_audio_ldac_decoder_frame_t *)a2dp_audio_heap_malloc(
-      sizeof(a2dp_audio_ldac_decoder_frame_t));
-  decoder_frame_p->buffer = buffer;
+  decoder_frame_p = (a2dp_audio_ldac_decoder_frame_t *)a2dp_audio_slab_malloc(
+      &a2dp_audio_ldac_slab,
+      sizeof(a2dp_audio_ldac_decoder_frame_t) + packet_len);
+  decoder_frame_p->buffer = (uint8_t *)(decoder_frame_p + 1);
   decoder_frame_p->buffer_len = packet_len;
   return (void *)decoder_frame_p;
 }
 
 void a2dp_audio_ldac_free(void *packet) {
-  a2dp_audio_ldac_decoder_frame_t *decoder_frame_p =
-      (a2dp_audio_ldac_decoder_frame_t *)packet;
-  a2dp_audio_heap_free(decoder_frame_p->buffer);
-  a2dp_audio_heap_free(decoder_frame_p);
+  a2dp_audio_slab_free(&a2dp_audio_ldac_slab, packet);
 }
 
 int a2dp_audio_ldac_header_parser(btif_media_header_t *header,
@@ -889,6 +889,10 @@ int a2dp_audio_ldac_init(A2DP_AUDIO_OUTPUT_CONFIG_T *config, void *context) {
   ASSERT(ret == 0, "%s: a2dp_cp_init() failed: ret=%d", __func__, ret);
 #endif
   a2dp_audio_ldac_decoder_init();
+  a2dp_audio_slab_init(&a2dp_audio_ldac_slab, "ldac",
+                       sizeof(a2dp_audio_ldac_decoder_frame_t) +
+                           LDAC_SLAB_FRAME_SIZE,
+                       a2dp_audio_slab_depth_get(ldac_mtu_limiter));
   a2dp_audio_ldac_list_checker();
 
   return A2DP_DECODER_NO_ERROR;
@@ -205,14 +205,15 @@ static void sav_lhdc_get_next_info(struct A2DP_CP_LHDC_IN_FRM_INFO_T *f_info) {
 }
 #endif
 
+static A2DP_AUDIO_SLAB_T a2dp_audio_lhdc_slab;
+
 static void *a2dp_audio_lhdc_frame_malloc(uint32_t packet_len) {
   a2dp_audio_lhdc_decoder_frame_t *decoder_frame_p = NULL;
-  uint8_t *buffer = NULL;
 
-  buffer = (uint8_t *)a2dp_audio_heap_malloc(packet_len);
-  decoder_frame_p = (a2dp_audio_lhdc_decoder_frame_t *)a2dp_audio_heap_malloc(
-      sizeof(a2dp_audio_lhdc_decoder_frame_t));
-  decoder_frame_p->buffer = buffer;
+  decoder_frame_p = (a2dp_audio_lhdc_decoder_frame_t *)a2dp_audio_slab_malloc(
+      &a2dp_audio_lhdc_slab,
+      sizeof(a2dp_audio_lhdc_decoder_frame_t) + packet_len);
+  decoder_frame_p->buffer = (uint8_t *)(decoder_frame_p + 1);
   decoder_frame_p->buffer_len = packet_len;
   return (void *)decoder_frame_p;
 }
@@ -908,10 +909,7 @@ int a2dp_audio_lhdc_preparse_packet(btif_media_header_t *header,
 }
 
 void a2dp_audio_lhdc_free(void *packet) {
-  a2dp_audio_lhdc_decoder_frame_t *decoder_frame_p =
-      (a2dp_audio_lhdc_decoder_frame_t *)packet;
-  a2dp_audio_heap_free(decoder_frame_p->buffer);
-  a2dp_audio_heap_free(decoder_frame_p);
+  a2dp_audio_slab_free(&a2dp_audio_lhdc_slab, packet);
 }
 
 int a2dp_audio_lhdc_store_packet(btif_media_header_t *header, uint8_t *buffer,
@@ -1063,6 +1061,10 @@ int a2dp_audio_lhdc_init(A2DP_AUDIO_OUTPUT_CONFIG_T *config, void *context) {
   lhdcInit(config->bits_depth, config->sample_rate, 0, VERSION_2);
 #endif
   initial_lhdc_assemble_packet(false);
+  a2dp_audio_slab_init(&a2dp_audio_lhdc_slab, "lhdc",
+                       sizeof(a2dp_audio_lhdc_decoder_frame_t) +
+                           LHDC_READBUF_SIZE,
+                       a2dp_audio_slab_depth_get(lhdc_mtu_limiter));
 
 #ifdef A2DP_CP_ACCEL
   int ret;
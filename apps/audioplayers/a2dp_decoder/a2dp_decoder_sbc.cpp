@@ -20,6 +20,7 @@
 #include "cmsis.h"
 #include "cmsis_os.h"
 #include "codec_sbc.h"
+#include "crc8.h"
 #include "hal_location.h"
 #include "hal_timer.h"
 #include "heap_api.h"
@@ -33,6 +34,9 @@
 
 #define SBC_LIST_SAMPLES (128)
 
+/* joint stereo, 16 blocks, 8 subbands, bitpool 53 is 119 bytes */
+#define SBC_SLAB_FRAME_SIZE (128)
+
 static A2DP_AUDIO_CONTEXT_T *a2dp_audio_context_p = NULL;
 extern A2DP_AUDIO_DECODER_T a2dp_audio_sbc_decoder_config;
 
@@ -65,24 +69,26 @@ static bool sbc_chnl_mode_mono = false;
 
 static int a2dp_audio_sbc_header_parser_init(void);
 
+static A2DP_AUDIO_SLAB_T a2dp_audio_sbc_slab;
+
+static uint8_t a2dp_audio_sbc_carry_buf[SBC_PCMLEN_DEFAULT];
+static A2DP_AUDIO_PCM_CARRY_T a2dp_audio_sbc_carry = {
+    a2dp_audio_sbc_carry_buf, sizeof(a2dp_audio_sbc_carry_buf), 0, 0};
+
 static void *a2dp_audio_sbc_subframe_malloc(uint32_t sbc_len) {
   a2dp_audio_sbc_decoder_frame_t *sbc_decoder_frame_p = NULL;
-  uint8_t *sbc_buffer = NULL;
 
-  sbc_buffer = (uint8_t *)a2dp_audio_heap_malloc(sbc_len);
   sbc_decoder_frame_p =
-      (a2dp_audio_sbc_decoder_frame_t *)a2dp_audio_heap_malloc(
-          sizeof(a2dp_audio_sbc_decoder_frame_t));
-  sbc_decoder_frame_p->sbc_buffer = sbc_buffer;
+      (a2dp_audio_sbc_decoder_frame_t *)a2dp_audio_slab_malloc(
+          &a2dp_audio_sbc_slab,
+          sizeof(a2dp_audio_sbc_decoder_frame_t) + sbc_len);
+  sbc_decoder_frame_p->sbc_buffer = (uint8_t *)(sbc_decoder_frame_p + 1);
   sbc_decoder_frame_p->sbc_buffer_len = sbc_len;
   return (void *)sbc_decoder_frame_p;
 }
 
 static void a2dp_audio_sbc_subframe_free(void *packet) {
-  a2dp_audio_sbc_decoder_frame_t *sbc_decoder_frame_p =
-      (a2dp_audio_sbc_decoder_frame_t *)packet;
-  a2dp_audio_heap_free(sbc_decoder_frame_p->sbc_buffer);
-  a2dp_audio_heap_free(sbc_decoder_frame_p);
+  a2dp_audio_slab_free(&a2dp_audio_sbc_slab, packet);
 }
 
 static void sbc_codec_init(void) {
@@ -90,6 +96,7 @@ static void sbc_codec_init(void) {
   a2dp_audio_sbc_decoder.sbc_decoder->maxPcmLen = SBC_PCMLEN_DEFAULT;
   a2dp_audio_sbc_decoder.pcm_data->data = NULL;
   a2dp_audio_sbc_decoder.pcm_data->dataLen = 0;
+  a2dp_audio_pcm_carry_reset(&a2dp_audio_sbc_carry);
 }
 
 #ifdef A2DP_CP_ACCEL
@@ -125,7 +132,8 @@ static int TEXT_SBC_LOC a2dp_cp_sbc_after_cache_underflow(void) {
 
 static int a2dp_cp_sbc_mcu_decode(uint8_t *buffer, uint32_t buffer_bytes) {
   a2dp_audio_sbc_decoder_frame_t *sbc_decoder_frame = NULL;
-  list_node_t *node = NULL;
+  void *frames[A2DP_AUDIO_DECODE_BATCH_MAX];
+  uint32_t num, i;
   list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
   int ret, dec_ret;
   struct A2DP_CP_SBC_IN_FRM_INFO_T in_info;
@@ -153,26 +161,33 @@ static int a2dp_cp_sbc_mcu_decode(uint8_t *buffer, uint32_t buffer_bytes) {
     set_cp_reset_flag(true);
     return A2DP_DECODER_DECODE_ERROR;
   }
-  while ((node = a2dp_audio_list_begin(list)) != NULL) {
-    sbc_decoder_frame =
-        (a2dp_audio_sbc_decoder_frame_t *)a2dp_audio_list_node(node);
-
-    in_info.sequenceNumber = sbc_decoder_frame->sequenceNumber;
-    in_info.timestamp = sbc_decoder_frame->timestamp;
-    in_info.curSubSequenceNumber = sbc_decoder_frame->curSubSequenceNumber;
-    in_info.totalSubSequenceNumber = sbc_decoder_frame->totalSubSequenceNumber;
+  do {
+    num = a2dp_audio_list_peek_batch(list, frames, A2DP_AUDIO_DECODE_BATCH_MAX,
+                                     NULL);
+    for (i = 0; i < num; i++) {
+      sbc_decoder_frame = (a2dp_audio_sbc_decoder_frame_t *)frames[i];
+
+      in_info.sequenceNumber = sbc_decoder_frame->sequenceNumber;
+      in_info.timestamp = sbc_decoder_frame->timestamp;
+      in_info.curSubSequenceNumber = sbc_decoder_frame->curSubSequenceNumber;
+      in_info.totalSubSequenceNumber =
+          sbc_decoder_frame->totalSubSequenceNumber;
 
-    ret = a2dp_cp_put_in_frame(&in_info, sizeof(in_info),
-                               sbc_decoder_frame->sbc_buffer,
-                               sbc_decoder_frame->sbc_buffer_len);
-    if (ret) {
-      TRACE_A2DP_DECODER_D("[MCU][SBC] piff !!!!!!ret: %d ", ret);
-      break;
+      ret = a2dp_cp_put_in_frame(&in_info, sizeof(in_info),
+                                 sbc_decoder_frame->sbc_buffer,
+                                 sbc_decoder_frame->sbc_buffer_len);
+      if (ret) {
+        TRACE_A2DP_DECODER_D("[MCU][SBC] piff !!!!!!ret: %d ", ret);
+        break;
+      }
     }
-    check_sum = a2dp_audio_decoder_internal_check_sum_generate(
-        sbc_decoder_frame->sbc_buffer, sbc_decoder_frame->sbc_buffer_len);
-    a2dp_audio_list_remove(list, sbc_decoder_frame);
-  }
+    if (i) {
+      sbc_decoder_frame = (a2dp_audio_sbc_decoder_frame_t *)frames[i - 1];
+      check_sum = a2dp_audio_decoder_internal_check_sum_generate(
+          sbc_decoder_frame->sbc_buffer, sbc_decoder_frame->sbc_buffer_len);
+      a2dp_audio_list_remove_batch(list, frames, i);
+    }
+  } while (num && i == num);
 
   ret = a2dp_cp_get_full_out_frame((void **)&out, &out_len);
   if (ret) {
@@ -428,6 +443,10 @@ int a2dp_audio_sbc_init(A2DP_AUDIO_OUTPUT_CONFIG_T *config, void *context) {
           sizeof(btif_sbc_pcm_data_t));
   a2dp_audio_sbc_decoder_preparse =
       (btif_sbc_decoder_t *)a2dp_audio_heap_malloc(sizeof(btif_sbc_decoder_t));
+  a2dp_audio_slab_init(&a2dp_audio_sbc_slab, "sbc",
+                       sizeof(a2dp_audio_sbc_decoder_frame_t) +
+                           SBC_SLAB_FRAME_SIZE,
+                       a2dp_audio_slab_depth_get(sbc_mtu_limiter));
 #ifdef A2DP_CP_ACCEL
   int ret;
   cp_codec_reset = true;
@@ -455,45 +474,69 @@ int a2dp_audio_sbc_deinit(void) {
   return A2DP_DECODER_NO_ERROR;
 }
 
+// Decodes into buffer the frames needed to fill it, taking them off the list
+// up to A2DP_AUDIO_DECODE_BATCH_MAX at a time. The last frame info is set
+// once per batch, from its last frame.
 int a2dp_audio_sbc_mcu_decode_frame(uint8_t *buffer, uint32_t buffer_bytes) {
   bt_status_t ret = BT_STS_SUCCESS;
   uint16_t bytes_parsed = 0;
   float sbc_subbands_gain[8] = {1, 1, 1, 1, 1, 1, 1, 1};
   btif_sbc_decoder_t *sbc_decoder = NULL;
   btif_sbc_pcm_data_t *pcm_data = NULL;
-  uint16_t frame_pcmbyte = 0;
-  uint16_t pcm_output_byte = 0;
+  uint32_t frame_pcmbyte = 0;
+  uint32_t pcm_output_byte = 0;
+  uint32_t remain = 0;
+  uint32_t list_len = 0;
+  uint32_t num = 0;
+  uint32_t i = 0;
   bool cache_underflow = false;
+  bool decode_failed = false;
 
   sbc_decoder = a2dp_audio_sbc_decoder.sbc_decoder;
   pcm_data = a2dp_audio_sbc_decoder.pcm_data;
-  frame_pcmbyte = sbc_decoder->maxPcmLen;
 
   a2dp_audio_sbc_decoder_frame_t *sbc_decoder_frame = NULL;
-  list_node_t *node = NULL;
+  void *frames[A2DP_AUDIO_DECODE_BATCH_MAX];
 
   list_t *list = a2dp_audio_context_p->audio_datapath.input_raw_packet_list;
 
-  pcm_data->data = buffer;
-  pcm_data->dataLen = 0;
-
-  TRACE_A2DP_DECODER_D("[MCU][SBC] size:%d", a2dp_audio_list_length(list));
+  pcm_output_byte =
+      a2dp_audio_pcm_carry_get(&a2dp_audio_sbc_carry, buffer, buffer_bytes);
 
-  for (pcm_output_byte = 0; pcm_output_byte < buffer_bytes;
-       pcm_output_byte += frame_pcmbyte) {
-    node = a2dp_audio_list_begin(list);
+  while (pcm_output_byte < buffer_bytes) {
+    frame_pcmbyte = sbc_decoder->maxPcmLen;
+    num = (buffer_bytes - pcm_output_byte + frame_pcmbyte - 1) / frame_pcmbyte;
+    if (num > A2DP_AUDIO_DECODE_BATCH_MAX) {
+      num = A2DP_AUDIO_DECODE_BATCH_MAX;
+    }
+    num = a2dp_audio_list_peek_batch(list, frames, num, &list_len);
+    if (num == 0) {
+      TRACE_A2DP_DECODER_W("[MCU][SBC] A2DP PACKET CACHE UNDERFLOW");
+      ret = BT_STS_FAILED;
+      cache_underflow = true;
+      goto exit;
+    }
+    TRACE_A2DP_DECODER_D("[MCU][SBC] size:%d batch:%d", list_len, num);
 
-    if (node) {
+    for (i = 0; i < num && pcm_output_byte < buffer_bytes; i++) {
       uint32_t lock;
 
-      sbc_decoder_frame =
-          (a2dp_audio_sbc_decoder_frame_t *)a2dp_audio_list_node(node);
+      sbc_decoder_frame = (a2dp_audio_sbc_decoder_frame_t *)frames[i];
+      remain = buffer_bytes - pcm_output_byte;
+      if (remain >= sbc_decoder->maxPcmLen) {
+        pcm_data->data = buffer;
+        pcm_data->dataLen = pcm_output_byte;
+      } else {
+        pcm_data->data = a2dp_audio_sbc_carry.buf;
+        pcm_data->dataLen = 0;
+      }
 
       lock = int_lock();
-      ret = btif_sbc_decode_frames(sbc_decoder, sbc_decoder_frame->sbc_buffer,
-                                   sbc_decoder_frame->sbc_buffer_len,
-                                   &bytes_parsed, pcm_data, buffer_bytes,
-                                   sbc_subbands_gain);
+      ret = btif_sbc_decode_frames(
+          sbc_decoder, sbc_decoder_frame->sbc_buffer,
+          sbc_decoder_frame->sbc_buffer_len, &bytes_parsed, pcm_data,
+          pcm_data->data == buffer ? buffer_bytes : a2dp_audio_sbc_carry.size,
+          sbc_subbands_gain);
       int_unlock(lock);
       TRACE_A2DP_DECODER_D("[MCU][SBC] seq:%d/%d/%d len:%d ret:%d used:%d",
                            sbc_decoder_frame->curSubSequenceNumber,
@@ -502,40 +545,16 @@ int a2dp_audio_sbc_mcu_decode_frame(uint8_t *buffer, uint32_t buffer_bytes) {
                            sbc_decoder_frame->sbc_buffer_len, ret,
                            bytes_parsed);
 
-      a2dp_audio_sbc_lastframe_info.sequenceNumber =
-          sbc_decoder_frame->sequenceNumber;
-      a2dp_audio_sbc_lastframe_info.timestamp = sbc_decoder_frame->timestamp;
-      a2dp_audio_sbc_lastframe_info.curSubSequenceNumber =
-          sbc_decoder_frame->curSubSequenceNumber;
-      a2dp_audio_sbc_lastframe_info.totalSubSequenceNumber =
-          sbc_decoder_frame->totalSubSequenceNumber;
-      a2dp_audio_sbc_lastframe_info.frame_samples = sbc_decoder->maxPcmLen / 4;
-      a2dp_audio_sbc_lastframe_info.decoded_frames++;
-      a2dp_audio_sbc_lastframe_info.undecode_frames =
-          a2dp_audio_list_length(list) - 1;
-      a2dp_audio_sbc_lastframe_info.check_sum =
-          a2dp_audio_decoder_internal_check_sum_generate(
-              sbc_decoder_frame->sbc_buffer, sbc_decoder_frame->sbc_buffer_len);
-      a2dp_audio_decoder_internal_lastframe_info_set(
-          &a2dp_audio_sbc_lastframe_info);
-      a2dp_audio_list_remove(list, sbc_decoder_frame);
       switch (ret) {
       case BT_STS_SUCCESS:
-        if (pcm_data->dataLen != buffer_bytes) {
-          TRACE_A2DP_DECODER_W("[MCU][SBC] WARNING pcm buff mismatch %d/%d",
-                               pcm_data->dataLen, buffer_bytes);
-        }
-        if (pcm_data->dataLen == buffer_bytes) {
-          if (pcm_output_byte + frame_pcmbyte != buffer_bytes) {
-            TRACE_A2DP_DECODER_W(
-                "[MCU][SBC]WARNING loop not break %d/%d frame_pcm:%d",
-                pcm_output_byte, buffer_bytes, frame_pcmbyte);
-            goto exit;
-          }
-        }
-        break;
       case BT_STS_CONTINUE:
-        continue;
+        if (pcm_data->data == buffer) {
+          pcm_output_byte = pcm_data->dataLen;
+        } else {
+          a2dp_audio_pcm_carry_split(&a2dp_audio_sbc_carry, pcm_data->dataLen,
+                                     buffer + pcm_output_byte, remain);
+          pcm_output_byte = buffer_bytes;
+        }
         break;
       case BT_STS_NO_RESOURCES:
         ASSERT_A2DP_DECODER(0, "sbc_decode BT_STS_NO_RESOURCES pcm has no more "
@@ -543,20 +562,44 @@ int a2dp_audio_sbc_mcu_decode_frame(uint8_t *buffer, uint32_t buffer_bytes) {
         break;
       case BT_STS_FAILED:
       default:
-        sbc_codec_init();
-        goto exit;
+        decode_failed = true;
+        break;
       }
-    } else {
-      TRACE_A2DP_DECODER_W("[MCU][SBC] A2DP PACKET CACHE UNDERFLOW");
-      ret = BT_STS_FAILED;
-      cache_underflow = true;
+      if (decode_failed) {
+        i++;
+        break;
+      }
+    }
+
+    // i frames were used, sbc_decoder_frame is the last of them
+    a2dp_audio_sbc_lastframe_info.sequenceNumber =
+        sbc_decoder_frame->sequenceNumber;
+    a2dp_audio_sbc_lastframe_info.timestamp = sbc_decoder_frame->timestamp;
+    a2dp_audio_sbc_lastframe_info.curSubSequenceNumber =
+        sbc_decoder_frame->curSubSequenceNumber;
+    a2dp_audio_sbc_lastframe_info.totalSubSequenceNumber =
+        sbc_decoder_frame->totalSubSequenceNumber;
+    a2dp_audio_sbc_lastframe_info.frame_samples = sbc_decoder->maxPcmLen / 4;
+    a2dp_audio_sbc_lastframe_info.decoded_frames += i;
+    a2dp_audio_sbc_lastframe_info.undecode_frames = list_len - i;
+    a2dp_audio_sbc_lastframe_info.check_sum =
+        a2dp_audio_decoder_internal_check_sum_generate(
+            sbc_decoder_frame->sbc_buffer, sbc_decoder_frame->sbc_buffer_len);
+    a2dp_audio_decoder_internal_lastframe_info_set(
+        &a2dp_audio_sbc_lastframe_info);
+    a2dp_audio_list_remove_batch(list, frames, i);
+
+    if (decode_failed) {
+      sbc_codec_init();
       goto exit;
     }
   }
+  ret = BT_STS_SUCCESS;
 exit:
   if (cache_underflow) {
     TRACE_A2DP_DECODER_W(
         "[MCU][SBC] A2DP PACKET CACHE UNDERFLOW need add some process");
+    a2dp_audio_pcm_carry_reset(&a2dp_audio_sbc_carry);
     a2dp_audio_sbc_lastframe_info.undecode_frames = 0;
     a2dp_audio_sbc_lastframe_info.check_sum = 0;
     a2dp_audio_decoder_internal_lastframe_info_set(
@@ -612,7 +655,8 @@ int a2dp_audio_sbc_preparse_packet(btif_media_header_t *header, uint8_t *buffer,
   //       during CP process. CP process is triggered by audioflinger PCM
   //       callback.
 
-  if (*parser_p != 0x9c) {
+  if (*parser_p != CRC8_SBC_SYNCWORD ||
+      crc8_sbc_frame_check(parser_p, buffer_bytes) < 0) {
     TRACE_A2DP_DECODER_I("[SBC][PRE] ERROR SBC FRAME !!! frame_num:%d",
                          frame_num);
     DUMP8("%02x ", parser_p, 12);
@@ -777,6 +821,16 @@ int a2dp_audio_sbc_store_packet(btif_media_header_t *header, uint8_t *buffer,
           find_err = true;
           break;
         }
+#ifdef A2DP_SBC_CRC_CHECK
+        // Drop the whole packet so that packet recover conceals it, rather
+        // than resetting the decoder when it reaches the frame.
+        if (crc8_sbc_frame_check(parser_p + i, bytes_parsed) < 0) {
+          TRACE_A2DP_DECODER_W("[SBC][INPUT] ERROR SBC FRAME CRC !!!");
+          DUMP8("%02x ", parser_p + i, 12);
+          find_err = true;
+          break;
+        }
+#endif
         a2dp_audio_sbc_decoder_frame_t *frame_p =
             (a2dp_audio_sbc_decoder_frame_t *)a2dp_audio_sbc_subframe_malloc(
                 bytes_parsed);
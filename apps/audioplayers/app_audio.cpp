@@ -20,8 +20,10 @@
 #include "app_audio.h"
 #include "app_media_player.h"
 #include "app_ring_merge.h"
+#include "audio_mix.h"
 #include "app_thread.h"
 #include "cqueue.h"
+#include "spsc_cqueue.h"
 #include "hal_aud.h"
 #include "list.h"
 #include "nvrecord.h"
@@ -90,10 +92,9 @@ osPoolId app_audio_status_mempool = NULL;
 osMutexId g_app_audio_queue_mutex_id = NULL;
 osMutexDef(g_app_audio_queue_mutex);
 
-// control pcmbuff access
-static CQueue app_audio_pcm_queue;
-static osMutexId app_audio_pcmbuff_mutex_id = NULL;
-osMutexDef(app_audio_pcmbuff_mutex);
+// pcmbuff is filled by one stream callback and drained by another, the
+// lock-free spsc queue keeps them from contending on a mutex
+static SpscCQueue app_audio_pcm_queue;
 
 #ifdef __AUDIO_QUEUE_SUPPORT__
 
@@ -112,25 +113,18 @@ void LOCK_APP_AUDIO_QUEUE() {
 void UNLOCK_APP_AUDIO_QUEUE() { osMutexRelease(g_app_audio_queue_mutex_id); }
 
 uint32_t app_audio_lr_balance(uint8_t *buf, uint32_t len, int8_t balance) {
-  short *balance_buf = (short *)buf;
-  uint32_t balance_len = len / 2;
-  float factor;
-
   ASSERT((balance >= -100) && (balance <= 100), "balance = %d is invalid!",
          balance);
 
   if (balance > 0) {
     // reduce L channel
-    factor = 1 - 0.01 * balance;
-    for (uint32_t i = 0; i < balance_len; i += 2) {
-      balance_buf[i] = (short)(factor * balance_buf[i]);
-    }
+    audio_mix_scale_stereo_16((int16_t *)buf, len / 4,
+                              audio_mix_gain_q30(1 - 0.01f * balance),
+                              AUDIO_MIX_GAIN_Q30_ONE);
   } else if (balance < 0) {
     // reduce R channel
-    factor = 1 + 0.01 * balance;
-    for (uint32_t i = 0; i < balance_len; i += 2) {
-      balance_buf[i + 1] = (short)(factor * balance_buf[i + 1]);
-    }
+    audio_mix_scale_stereo_16((int16_t *)buf, len / 4, AUDIO_MIX_GAIN_Q30_ONE,
+                              audio_mix_gain_q30(1 + 0.01f * balance));
   }
   return 0;
 }
@@ -140,70 +134,37 @@ void app_audio_mempool_init_with_specific_size(uint32_t size) {
 }
 
 int app_audio_pcmbuff_init(uint8_t *buff, uint16_t len) {
-  if (app_audio_pcmbuff_mutex_id == NULL)
-    app_audio_pcmbuff_mutex_id =
-        osMutexCreate((osMutex(app_audio_pcmbuff_mutex)));
-
-  if ((buff == NULL) || (app_audio_pcmbuff_mutex_id == NULL))
+  if (buff == NULL)
     return -1;
 
-  osMutexWait(app_audio_pcmbuff_mutex_id, osWaitForever);
-  InitCQueue(&app_audio_pcm_queue, len, buff);
   memset(buff, 0x00, len);
-  osMutexRelease(app_audio_pcmbuff_mutex_id);
+  InitSpscCQueue(&app_audio_pcm_queue, len, buff);
 
   return 0;
 }
 
 int app_audio_pcmbuff_length(void) {
-  int len;
-
-  osMutexWait(app_audio_pcmbuff_mutex_id, osWaitForever);
-  len = LengthOfCQueue(&app_audio_pcm_queue);
-  osMutexRelease(app_audio_pcmbuff_mutex_id);
-
-  return len;
+  return LengthOfSpscCQueue(&app_audio_pcm_queue);
 }
 
 int app_audio_pcmbuff_put(uint8_t *buff, uint16_t len) {
-  int status;
-
-  osMutexWait(app_audio_pcmbuff_mutex_id, osWaitForever);
-  status = EnCQueue(&app_audio_pcm_queue, buff, len);
-  osMutexRelease(app_audio_pcmbuff_mutex_id);
-
-  return status;
+  return EnSpscCQueue(&app_audio_pcm_queue, buff, len);
 }
 
 int app_audio_pcmbuff_get(uint8_t *buff, uint16_t len) {
-  unsigned char *e1 = NULL, *e2 = NULL;
-  unsigned int len1 = 0, len2 = 0;
   int status;
 
-  osMutexWait(app_audio_pcmbuff_mutex_id, osWaitForever);
-  status = PeekCQueue(&app_audio_pcm_queue, len, &e1, &len1, &e2, &len2);
-  if (len == (len1 + len2)) {
-    memcpy(buff, e1, len1);
-    memcpy(buff + len1, e2, len2);
-    DeCQueue(&app_audio_pcm_queue, 0, len1);
-    DeCQueue(&app_audio_pcm_queue, 0, len2);
-  } else {
+  status = DeSpscCQueue(&app_audio_pcm_queue, buff, len);
+  if (status != CQ_OK) {
     memset(buff, 0x00, len);
     status = -1;
   }
-  osMutexRelease(app_audio_pcmbuff_mutex_id);
 
   return status;
 }
 
 int app_audio_pcmbuff_discard(uint16_t len) {
-  int status;
-
-  osMutexWait(app_audio_pcmbuff_mutex_id, osWaitForever);
-  status = DeCQueue(&app_audio_pcm_queue, 0, len);
-  osMutexRelease(app_audio_pcmbuff_mutex_id);
-
-  return status;
+  return DeSpscCQueue(&app_audio_pcm_queue, NULL, len);
 }
 
 void __attribute__((section(".fast_text_sram")))
@@ -117,6 +117,18 @@ SPEAKER_WEIGHTING_FILTER_SUPPRESS | Default EQ                       | 0.5     \
 
 #endif
 
+#if defined(SCO_CP_PIPELINE)
+#include "bt_sco_chain_cp.h"
+#include "hal_location.h"
+
+// RX runs on the CP, see sco_cp_rx_pipe_process()
+#define SPEECH_RX_PROCESS_LOC CP_TEXT_SRAM_LOC
+#define SPEECH_RX_PROCESS sco_cp_rx_pipe_process
+#else
+#define SPEECH_RX_PROCESS_LOC
+#define SPEECH_RX_PROCESS _speech_rx_process_
+#endif
+
 #if defined(SCO_OPTIMIZE_FOR_RAM)
 extern uint8_t *sco_overlay_ram_buf;
 extern int sco_overlay_ram_buf_len;
@@ -332,6 +344,7 @@ static int speech_tx_frame_len = 256;
 static int speech_rx_frame_len = 256;
 static bool speech_tx_frame_resizer_enable = false;
 static bool speech_rx_frame_resizer_enable = false;
+static bool speech_rx_on_cp = false;
 
 static int32_t _speech_tx_process_(void *pcm_buf, void *ref_buf,
                                    int32_t *pcm_len);
@@ -633,7 +646,7 @@ int speech_init(int tx_sample_rate, int rx_sample_rate, int tx_frame_ms,
   CAPTURE_HANDLER_T tx_handler =
       (tx_frame_ms == sco_frame_ms) ? NULL : _speech_tx_process_;
   PLAYBACK_HANDLER_T rx_handler =
-      (rx_frame_ms == sco_frame_ms) ? NULL : _speech_rx_process_;
+      (rx_frame_ms == sco_frame_ms) ? NULL : SPEECH_RX_PROCESS;
 
   speech_tx_frame_resizer_enable = (tx_handler != NULL);
   speech_rx_frame_resizer_enable = (rx_handler != NULL);
@@ -653,6 +666,12 @@ int speech_init(int tx_sample_rate, int rx_sample_rate, int tx_frame_ms,
   speech_tx_init(speech_tx_sample_rate, speech_tx_frame_len);
   speech_rx_init(speech_rx_sample_rate, speech_rx_frame_len);
 
+#if defined(SCO_CP_PIPELINE)
+  speech_rx_on_cp =
+      (sco_cp_rx_pipe_init(speech_rx_sample_rate, speech_rx_frame_len,
+                           playback_sample_size, _speech_rx_process_) == 0);
+#endif
+
 #if !defined(SCO_CP_ACCEL)
   int needed_freq = 0;
   enum APP_SYSFREQ_FREQ_T min_system_freq =
@@ -838,6 +857,11 @@ int speech_rx_deinit(void) {
 int speech_deinit(void) {
   TRACE(1, "[%s] Start...", __func__);
 
+#if defined(SCO_CP_PIPELINE)
+  sco_cp_rx_pipe_deinit();
+  speech_rx_on_cp = false;
+#endif
+
   speech_rx_deinit();
   speech_tx_deinit();
 
@@ -1017,7 +1041,11 @@ float speech_rx_get_required_mips(void) {
   return mips;
 }
 
+// MIPS needed on the MCU
 float speech_get_required_mips(void) {
+  if (speech_rx_on_cp) {
+    return speech_tx_get_required_mips();
+  }
   return speech_tx_get_required_mips() + speech_rx_get_required_mips();
 }
 
@@ -1146,6 +1174,9 @@ void _speech_tx_process_pre(short *pcm_buf, short *ref_buf, int *_pcm_len) {
 
 #ifdef AUDIO_DEBUG_V0_1_0
   if (speech_tuning_get_status()) {
+#if defined(SCO_CP_PIPELINE)
+    sco_cp_rx_pipe_sync();
+#endif
     speech_set_config(speech_cfg);
 
     speech_tuning_set_status(false);
@@ -1422,6 +1453,7 @@ int32_t _speech_tx_process_(void *pcm_buf, void *ref_buf, int32_t *_pcm_len) {
   return 0;
 }
 
+SPEECH_RX_PROCESS_LOC
 int32_t _speech_rx_process_(void *pcm_buf, int32_t *_pcm_len) {
   int32_t pcm_len = *_pcm_len;
 
@@ -1519,7 +1551,7 @@ int speech_tx_process(void *pcm_buf, void *ref_buf, int *pcm_len) {
 
 int speech_rx_process(void *pcm_buf, int *pcm_len) {
   if (speech_rx_frame_resizer_enable == false) {
-    _speech_rx_process_(pcm_buf, (int32_t *)pcm_len);
+    SPEECH_RX_PROCESS(pcm_buf, (int32_t *)pcm_len);
   } else {
     frame_resize_process_playback(speech_frame_resize_st, pcm_buf,
                                   (int32_t *)pcm_len);
@@ -229,3 +229,127 @@ int sco_cp_deinit(void) {
   return 0;
 }
 #endif
+
+#if defined(SCO_CP_PIPELINE)
+#include "bt_sco_chain_cp.h"
+#include "cp_job.h"
+#include "hal_location.h"
+#include "hal_timer.h"
+#include "hal_trace.h"
+#include "string.h"
+
+// RX speech chain pipelined on the CP.
+//
+// Each RX frame is queued to the CP with cp_job, and the frame queued by
+// the previous call is returned instead. RX of frame N thus runs on the CP
+// while the MCU runs TX, at the cost of one frame of downlink delay. The
+// delay is fixed: if the CP has not started a frame half a frame period
+// after it was queued, the MCU runs it itself when it needs the result, so
+// the output does not depend on which core ran the frame.
+//
+// The RX handler and the RX algorithms it calls run on the CP, so they
+// must be in RAM, not in flash: see SCO_CP_PIPELINE in best1000.lds.S and
+// config/common.mk. The SCO overlay is in CP RAM on chips with a CP.
+
+#define RX_PIPE_FRAME_LEN_MAX (256)
+
+static CP_BSS_LOC int32_t g_rx_pipe_buf[2][RX_PIPE_FRAME_LEN_MAX];
+static CP_BSS_LOC int32_t g_rx_pipe_len[2];
+static CP_BSS_LOC SCO_CP_RX_HANDLER_T g_rx_pipe_handler;
+
+static uint32_t g_rx_pipe_idx;
+static int g_rx_pipe_id;
+static int g_rx_pipe_sample_size;
+static uint32_t g_rx_pipe_deadline;
+
+CP_TEXT_SRAM_LOC
+static int sco_cp_rx_pipe_job(void *ctx, const void *in, uint32_t in_len,
+                              void *out, uint32_t out_len) {
+  return g_rx_pipe_handler(out, (int32_t *)ctx);
+}
+
+int sco_cp_rx_pipe_init(int sample_rate, int frame_len, int sample_size,
+                        SCO_CP_RX_HANDLER_T handler) {
+  int ret;
+
+  TRACE(3, "[%s] sample_rate: %d, frame_len: %d", __func__, sample_rate,
+        frame_len);
+  ASSERT(frame_len <= RX_PIPE_FRAME_LEN_MAX,
+         "[%s] frame_len(%d) > RX_PIPE_FRAME_LEN_MAX", __func__, frame_len);
+  ASSERT(sample_size <= (int)sizeof(int32_t), "[%s] sample_size(%d)",
+         __func__, sample_size);
+
+  memset(g_rx_pipe_buf, 0, sizeof(g_rx_pipe_buf));
+  // Nothing to return before the first frame is processed
+  g_rx_pipe_len[0] = -1;
+  g_rx_pipe_len[1] = -1;
+  g_rx_pipe_handler = handler;
+  g_rx_pipe_idx = 0;
+  g_rx_pipe_id = -1;
+  g_rx_pipe_sample_size = sample_size;
+  g_rx_pipe_deadline =
+      US_TO_FAST_TICKS((uint32_t)frame_len * 1000000 / sample_rate / 2);
+
+  ret = cp_job_open(NULL);
+  if (ret) {
+    TRACE(1, "[%s] WARNING: no CP, RX stays on the MCU", __func__);
+  }
+  return ret;
+}
+
+int sco_cp_rx_pipe_deinit(void) {
+  TRACE(1, "[%s] ...", __func__);
+
+  // The frame in flight uses the RX state, which goes away next
+  sco_cp_rx_pipe_sync();
+  cp_job_close();
+
+  return 0;
+}
+
+void sco_cp_rx_pipe_sync(void) {
+  if (g_rx_pipe_id >= 0) {
+    cp_job_wait(g_rx_pipe_id);
+    g_rx_pipe_id = -1;
+  }
+}
+
+int32_t sco_cp_rx_pipe_process(void *pcm_buf, int32_t *pcm_len) {
+  struct CP_JOB_T job;
+  uint32_t cur = g_rx_pipe_idx;
+  uint32_t prev = cur ^ 1;
+  uint32_t bytes = *pcm_len * g_rx_pipe_sample_size;
+
+  ASSERT(*pcm_len <= RX_PIPE_FRAME_LEN_MAX,
+         "[%s] pcm_len(%d) > RX_PIPE_FRAME_LEN_MAX", __func__, *pcm_len);
+
+  // Frame N-1, from whichever core ran it. It must be done before frame N
+  // is queued: if the MCU took it back, the CP could otherwise start frame
+  // N while the MCU still runs N-1 on the same RX state.
+  sco_cp_rx_pipe_sync();
+
+  memcpy(g_rx_pipe_buf[cur], pcm_buf, bytes);
+  g_rx_pipe_len[cur] = *pcm_len;
+
+  job.func = sco_cp_rx_pipe_job;
+  job.done = NULL;
+  job.ctx = &g_rx_pipe_len[cur];
+  job.in = g_rx_pipe_buf[cur];
+  job.in_len = bytes;
+  job.out = g_rx_pipe_buf[cur];
+  job.out_len = bytes;
+  job.deadline = cp_job_port_now() + g_rx_pipe_deadline;
+  g_rx_pipe_id = cp_job_submit(&job);
+
+  if (g_rx_pipe_len[prev] < 0) {
+    memset(pcm_buf, 0, bytes);
+  } else {
+    memcpy(pcm_buf, g_rx_pipe_buf[prev],
+           g_rx_pipe_len[prev] * g_rx_pipe_sample_size);
+    *pcm_len = g_rx_pipe_len[prev];
+  }
+  g_rx_pipe_idx = prev;
+
+  return 0;
+}
+#endif
@@ -41,6 +41,21 @@ int sco_cp_deinit(void);
 
 int sco_cp_process(short *pcm_buf, short *ref_buf, int *_pcm_len);
 
+typedef int32_t (*SCO_CP_RX_HANDLER_T)(void *pcm_buf, int32_t *pcm_len);
+
+// Returns 0 if RX runs on the CP, or an error if the CP could not be
+// started, in which case the pipeline still works with RX on the MCU.
+int sco_cp_rx_pipe_init(int sample_rate, int frame_len, int sample_size,
+                        SCO_CP_RX_HANDLER_T handler);
+
+int sco_cp_rx_pipe_deinit(void);
+
+// Runs handler on pcm_buf one frame late: returns the previous frame.
+int32_t sco_cp_rx_pipe_process(void *pcm_buf, int32_t *pcm_len);
+
+// Waits for the frame being processed, before touching the RX state.
+void sco_cp_rx_pipe_sync(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -18,6 +18,8 @@
 #include "hal_timer.h"
 #include "hal_trace.h"
 #include "hal_uart.h"
+#include "plat_types.h"
+#include "spsc_cqueue.h"
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -27,20 +29,18 @@
 #include "cmsis_os.h"
 #endif
 
-/* mutex */
-osMutexId g_flac_queue_mutex_id;
-osMutexDef(g_flac_queue_mutex);
-
 /* flac queue */
 #define FLAC_TEMP_BUFFER_SIZE 2048
 #define FLAC_QUEUE_SIZE (FLAC_TEMP_BUFFER_SIZE * 4)
-unsigned char flac_queue_buf[FLAC_QUEUE_SIZE];
-CQueue flac_queue;
-static uint32_t ok_to_decode = 0;
 
-#define LOCK_FLAC_QUEUE() osMutexWait(g_flac_queue_mutex_id, osWaitForever)
-
-#define UNLOCK_FLAC_QUEUE() osMutexRelease(g_flac_queue_mutex_id)
+/* The decoder thread is the only producer and the playback handler the only
+ * consumer, so the queue needs no lock and the handler never waits. When the
+ * decoder is behind, the handler plays silence for what is missing and waits
+ * for the queue to fill past FLAC_TEMP_BUFFER_SIZE * 2 again. */
+unsigned char flac_queue_buf[FLAC_QUEUE_SIZE];
+SpscCQueue flac_queue;
+static volatile uint32_t ok_to_decode = 0;
+static uint32_t flac_underflows;
 
 static void copy_one_trace_to_two_track_16bits(uint16_t *src_buf,
                                                uint16_t *dst_buf,
@@ -52,54 +52,44 @@ static void copy_one_trace_to_two_track_16bits(uint16_t *src_buf,
 }
 
 int store_flac_buffer(unsigned char *buf, unsigned int len) {
-  LOCK_FLAC_QUEUE();
-  EnCQueue(&flac_queue, buf, len);
-  if (LengthOfCQueue(&flac_queue) > FLAC_TEMP_BUFFER_SIZE * 2) {
+  if (EnSpscCQueue(&flac_queue, buf, len) != CQ_OK) {
+    return -1;
+  }
+  if (LengthOfSpscCQueue(&flac_queue) > FLAC_TEMP_BUFFER_SIZE * 2) {
     ok_to_decode = 1;
   }
-  UNLOCK_FLAC_QUEUE();
 
   return 0;
 }
 
 int decode_flac_frame(unsigned char *pcm_buffer, unsigned int pcm_len) {
-  uint32_t r = 0, got_len = 0;
+  uint32_t got_len = 0, want;
   unsigned char *e1 = NULL, *e2 = NULL;
   unsigned int len1 = 0, len2 = 0;
-get_again:
-  LOCK_FLAC_QUEUE();
-  r = PeekCQueue(&flac_queue, (pcm_len - got_len) / 2, &e1, &len1, &e2, &len2);
-  UNLOCK_FLAC_QUEUE();
-
-  if (r == CQ_ERR || len1 == 0) {
-    osDelay(2);
-    goto get_again;
-  }
-
-  // memcpy(pcm_buffer + got_len, e1, len1);
-  copy_one_trace_to_two_track_16bits(
-      (uint16_t *)e1, (uint16_t *)(pcm_buffer + got_len), len1 / 2);
-
-  LOCK_FLAC_QUEUE();
-  DeCQueue(&flac_queue, 0, len1);
-  UNLOCK_FLAC_QUEUE();
 
-  got_len += len1 * 2;
-
-  if (len2 != 0) {
-    // memcpy(pcm_buffer + got_len, e2, len2);
+  /* whole mono samples, each one is played on both channels */
+  want = MIN(LengthOfSpscCQueue(&flac_queue), pcm_len / 2) & ~1;
+  if (want &&
+      PeekSpscCQueue(&flac_queue, want, &e1, &len1, &e2, &len2) == CQ_OK) {
+    // memcpy(pcm_buffer + got_len, e1, len1);
     copy_one_trace_to_two_track_16bits(
-        (uint16_t *)e2, (uint16_t *)(pcm_buffer + got_len), len2 / 2);
-
-    LOCK_FLAC_QUEUE();
-    DeCQueue(&flac_queue, 0, len2);
-    UNLOCK_FLAC_QUEUE();
+        (uint16_t *)e1, (uint16_t *)(pcm_buffer + got_len), len1 / 2);
+    got_len += len1 * 2;
+
+    if (len2 != 0) {
+      // memcpy(pcm_buffer + got_len, e2, len2);
+      copy_one_trace_to_two_track_16bits(
+          (uint16_t *)e2, (uint16_t *)(pcm_buffer + got_len), len2 / 2);
+      got_len += len2 * 2;
+    }
+    DeSpscCQueue(&flac_queue, NULL, want);
   }
 
-  got_len += len2 * 2;
-
-  if (got_len < pcm_len)
-    goto get_again;
+  if (got_len < pcm_len) {
+    memset(pcm_buffer + got_len, 0, pcm_len - got_len);
+    flac_underflows++;
+    ok_to_decode = 0;
+  }
 
   return pcm_len;
 }
@@ -114,8 +104,10 @@ uint32_t flac_audio_more_data(uint8_t *buf, uint32_t len) {
   uint32_t l = 0;
   // uint32_t cur_ticks = 0, ticks = 0;
 
-  if (ok_to_decode == 0)
+  if (ok_to_decode == 0) {
+    memset(buf, 0, len);
     return 0;
+  }
 
   // ticks = hal_sys_timer_get();
   l = decode_flac_frame(buf, len);
@@ -125,10 +117,17 @@ uint32_t flac_audio_more_data(uint8_t *buf, uint32_t len) {
   return l;
 }
 
+/* The decoder has no more frames, play out what is queued without priming */
+void flac_audio_data_end(void) { ok_to_decode = 1; }
+
+uint32_t flac_audio_get_underflows(void) { return flac_underflows; }
+
 int flac_audio_init(void) {
-  g_flac_queue_mutex_id = osMutexCreate((osMutex(g_flac_queue_mutex)));
-  /* flac queue*/
-  InitCQueue(&flac_queue, FLAC_QUEUE_SIZE, (unsigned char *)&flac_queue_buf);
+  /* flac queue, the stream is not started yet */
+  InitSpscCQueue(&flac_queue, FLAC_QUEUE_SIZE,
+                 (unsigned char *)&flac_queue_buf);
+  ok_to_decode = 0;
+  flac_underflows = 0;
 
   return 0;
 }
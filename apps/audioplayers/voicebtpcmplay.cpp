@@ -26,6 +26,7 @@
 #include "hal_uart.h"
 #include "hfp_api.h"
 #include "iir_resample.h"
+#include "perf_probe.h"
 #include "plat_types.h"
 #include "tgt_hardware.h"
 #include <math.h>
@@ -1724,7 +1725,9 @@ uint32_t voicebtpcm_pcm_audio_data_come(uint8_t *buf, uint32_t len) {
 #endif
 
   if (app_get_current_overlay() == APP_OVERLAY_HFP) {
+    PERF_PROBE_BEGIN(PERF_PROBE_SPEECH_TX);
     speech_tx_process(pcm_buf, aec_echo_buf, &pcm_len);
+    PERF_PROBE_END(PERF_PROBE_SPEECH_TX);
 
 #if defined(SPEECH_TX_24BIT)
     int32_t *buf24 = (int32_t *)pcm_buf;
@@ -1871,7 +1874,9 @@ fail:
   }
 #endif
 
+  PERF_PROBE_BEGIN(PERF_PROBE_SPEECH_RX);
   speech_rx_process(pcm_buf, &pcm_len);
+  PERF_PROBE_END(PERF_PROBE_SPEECH_RX);
 
   buf = (uint8_t *)pcm_buf;
   len = pcm_len * sizeof(short);
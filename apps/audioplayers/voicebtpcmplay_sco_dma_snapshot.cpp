@@ -26,6 +26,7 @@
 #include "hal_uart.h"
 #include "hfp_api.h"
 #include "iir_resample.h"
+#include "perf_probe.h"
 #include "plat_types.h"
 #include "tgt_hardware.h"
 #include <math.h>
@@ -206,7 +207,9 @@ int process_downlink_bt_voice_frames(uint8_t *in_buf, uint32_t in_len,
   }
 #endif
 
+  PERF_PROBE_BEGIN(PERF_PROBE_SPEECH_RX);
   speech_rx_process(pcm_buf, &pcm_len);
+  PERF_PROBE_END(PERF_PROBE_SPEECH_RX);
 
 #if defined(SPEECH_RX_24BIT)
   out_len *= 2;
@@ -261,7 +264,9 @@ int process_uplink_bt_voice_frames(uint8_t *in_buf, uint32_t in_len,
     aec_echo_buf[i] = ref_buf[i];
   }
 #endif
+  PERF_PROBE_BEGIN(PERF_PROBE_SPEECH_TX);
   speech_tx_process(pcm_buf, aec_echo_buf, &pcm_len);
+  PERF_PROBE_END(PERF_PROBE_SPEECH_TX);
 
 #if defined(SPEECH_TX_24BIT)
   int32_t *buf24 = (int32_t *)pcm_buf;
@@ -23,9 +23,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "cmsis_os.h"
 #include "hal_timer.h"
 #include "hal_trace.h"
 #include "hal_uart.h"
+#include "spsc_cqueue.h"
 
 /*!
  *  * @brief Standard Winodws PCM wave file header length
@@ -66,6 +68,38 @@ static char g_wav_header[WAVE_FILE_HEADER_SIZE];
 FILE *g_wave_file_handle = NULL;
 static int32_t (*wav_file_playback_callback)(int32_t) = NULL;
 
+/* read-ahead */
+#ifndef WAV_FILE_READAHEAD_SIZE
+#define WAV_FILE_READAHEAD_SIZE (1024 * 8)
+#endif
+
+#ifndef WAV_FILE_READ_SIZE
+#define WAV_FILE_READ_SIZE (1024 * 1)
+#endif
+
+#define WAV_FILE_SIGNAL_FILL 0x01
+
+/* The playback handler only dequeues from the ring, the reader thread does
+ * the fread() calls and enqueues, so that a slow flash operation delays the
+ * reader instead of the audio DMA. The reader fills the ring under the
+ * mutex, which stop_wav_file() takes to close the file. */
+static uint8_t wav_file_ring_buf[WAV_FILE_READAHEAD_SIZE];
+static uint8_t wav_file_read_buf[WAV_FILE_READ_SIZE];
+static SpscCQueue wav_file_ring;
+static volatile bool wav_file_read_end = true;
+static uint32_t wav_file_underflows;
+
+static osThreadId wav_file_reader_tid = NULL;
+static void wav_file_reader_thread(void const *argument);
+osThreadDef(wav_file_reader_thread, osPriorityHigh, 1, 1024 * 2,
+            "wav_reader");
+
+static osMutexId wav_file_mutex_id = NULL;
+static osMutexDef(wav_file_mutex);
+
+#define LOCK_WAV_FILE() osMutexWait(wav_file_mutex_id, osWaitForever)
+#define UNLOCK_WAV_FILE() osMutexRelease(wav_file_mutex_id)
+
 ////////////////////////////////////////////////////////////////////////////////
 // Code
 ////////////////////////////////////////////////////////////////////////////////
@@ -75,11 +109,44 @@ void wav_file_set_playeback_cb(int32_t (*cb)(int32_t)) {
 bool wav_file_isplaydone(void) {
   return (g_curr_play_index >= g_total_play_count) ? true : false;
 }
+
+/* Reads whole WAV_FILE_READ_SIZE blocks while there is room for one */
+static void wav_file_fill(void) {
+  uint32_t n;
+
+  LOCK_WAV_FILE();
+  while (g_wave_file_handle && !wav_file_read_end &&
+         AvailableOfSpscCQueue(&wav_file_ring) >= WAV_FILE_READ_SIZE) {
+    n = fread(wav_file_read_buf, 1, WAV_FILE_READ_SIZE, g_wave_file_handle);
+    if (n) {
+      EnSpscCQueue(&wav_file_ring, wav_file_read_buf, n);
+    }
+    if (n != WAV_FILE_READ_SIZE) {
+      wav_file_read_end = true;
+    }
+  }
+  UNLOCK_WAV_FILE();
+}
+
+static void wav_file_reader_thread(void const *argument) {
+  while (1) {
+    osSignalWait(WAV_FILE_SIGNAL_FILL, osWaitForever);
+    wav_file_fill();
+  }
+}
+
+static void wav_file_kick(void) {
+  if (wav_file_reader_tid) {
+    osSignalSet(wav_file_reader_tid, WAV_FILE_SIGNAL_FILL);
+  }
+}
+
 uint32_t wav_file_audio_more_data(uint8_t *buf, uint32_t len) {
   //    static uint32_t g_preIrqTime = 0;
   uint32_t reallen = 0;
   //    int32_t stime,etime;
   int32_t status;
+  bool end;
 
   /* play done ? */
   if (wav_file_isplaydone()) {
@@ -90,10 +157,22 @@ uint32_t wav_file_audio_more_data(uint8_t *buf, uint32_t len) {
     return (len);
   }
   //    stime = hal_sys_timer_get();
-  /* read file */
-  if (g_wave_file_handle)
-    reallen = fread(buf, 1, len, g_wave_file_handle);
+  /* take from the read-ahead; end first, so no data comes after it */
+  end = wav_file_read_end;
+  if (LengthOfSpscCQueue(&wav_file_ring) >= len) {
+    DeSpscCQueue(&wav_file_ring, buf, len);
+    reallen = len;
+  } else if (!end) {
+    /* the reader is behind, play silence without moving the index */
+    memset(buf, 0, len);
+    wav_file_underflows++;
+    wav_file_kick();
+    return (len);
+  }
   //    etime = hal_sys_timer_get();
+  if (AvailableOfSpscCQueue(&wav_file_ring) >= WAV_FILE_READ_SIZE) {
+    wav_file_kick();
+  }
   if (reallen != len) {
     memset(buf, 0, len);
     status = -1;
@@ -221,6 +300,24 @@ uint32_t play_wav_file(char *file_path) {
   // by default
   bytesToRead = (newWav->header.length - WAVE_FILE_HEADER_SIZE);
 
+  if (wav_file_mutex_id == NULL) {
+    wav_file_mutex_id = osMutexCreate(osMutex(wav_file_mutex));
+    ASSERT(wav_file_mutex_id, "%s: no mutex", __func__);
+  }
+  if (wav_file_reader_tid == NULL) {
+    wav_file_reader_tid =
+        osThreadCreate(osThread(wav_file_reader_thread), NULL);
+    ASSERT(wav_file_reader_tid, "%s: no thread", __func__);
+  }
+
+  // The stream is not started yet, so the ring is idle
+  LOCK_WAV_FILE();
+  InitSpscCQueue(&wav_file_ring, sizeof(wav_file_ring_buf), wav_file_ring_buf);
+  wav_file_read_end = false;
+  wav_file_underflows = 0;
+  UNLOCK_WAV_FILE();
+  wav_file_fill();
+
   g_curr_play_index = 0;
   g_total_play_count = bytesToRead;
 
@@ -231,10 +328,20 @@ uint32_t stop_wav_file(void) {
   memset(&g_wave_file_info, 0, sizeof(g_wave_file_info));
   g_curr_play_index = 0;
   g_total_play_count = 0;
+  if (wav_file_mutex_id) {
+    LOCK_WAV_FILE();
+  }
+  wav_file_read_end = true;
   if (g_wave_file_handle) {
     fclose(g_wave_file_handle);
     g_wave_file_handle = NULL;
   }
+  if (wav_file_mutex_id) {
+    UNLOCK_WAV_FILE();
+  }
+  if (wav_file_underflows) {
+    TRACE(1, "WAV read-ahead underflows %u\n", wav_file_underflows);
+  }
   if (wav_file_playback_callback)
     wav_file_playback_callback = NULL;
 
@@ -41,6 +41,14 @@
 #include "app_mic_alg.h"
 #endif
 
+#ifdef THREAD_PROF_ENABLED
+#include "thread_prof.h"
+#endif
+
+#ifdef PERF_PROBE_ENABLED
+#include "perf_probe.h"
+#endif
+
 #ifdef AUDIO_DEBUG_V0_1_0
 extern "C" int speech_tuning_init(void);
 #endif
@@ -1835,6 +1843,17 @@ static void cpu_usage_timer_handler(void const *param) {
 }
 #endif
 
+#ifdef THREAD_PROF_ENABLED
+#ifndef THREAD_PROF_PERIOD_MS
+#define THREAD_PROF_PERIOD_MS 5000
+#endif
+static void thread_prof_timer_handler(void const *param);
+osTimerDef(thread_prof_timer, thread_prof_timer_handler);
+static void thread_prof_timer_handler(void const *param) {
+  thread_prof_print(false, true);
+}
+#endif
+
 #ifdef USER_REBOOT_PLAY_MUSIC_AUTO
 bool a2dp_need_to_play = false;
 #endif
@@ -1954,6 +1973,19 @@ int app_init(void) {
     osTimerStart(cpu_usage_timer_id, CPU_USAGE_TIMER_TMO_VALUE);
   }
 #endif
+#ifdef PERF_PROBE_ENABLED
+  perf_probe_init();
+#endif
+#ifdef THREAD_PROF_ENABLED
+  thread_prof_start();
+  {
+    osTimerId thread_prof_timer_id =
+        osTimerCreate(osTimer(thread_prof_timer), osTimerPeriodic, NULL);
+    if (thread_prof_timer_id != NULL) {
+      osTimerStart(thread_prof_timer_id, THREAD_PROF_PERIOD_MS);
+    }
+  }
+#endif
 
   // app_status_indication_init();
 
@@ -831,6 +831,11 @@ endif
 
 export KERNEL
 
+export THREAD_PROF ?= 0
+ifeq ($(THREAD_PROF)-$(filter RTX5,$(KERNEL)),1-)
+$(error THREAD_PROF requires KERNEL=RTX5)
+endif
+
 VALID_KERNEL_LIST := RTX RTX5 FREERTOS
 
 ifeq ($(filter $(VALID_KERNEL_LIST),$(KERNEL)),)
@@ -853,6 +858,12 @@ KBUILD_CPPFLAGS += \
 	-Iinclude/rtos/rtx5/
 KBUILD_CPPFLAGS += -D__RTX_CPU_STATISTICS__=1
 #KBUILD_CPPFLAGS += -DTASK_HUNG_CHECK_ENABLED=1
+ifeq ($(THREAD_PROF),1)
+core-y += utils/thread_prof/
+KBUILD_CPPFLAGS += -DTHREAD_PROF_ENABLED
+KBUILD_CPPFLAGS += -DCMSIS_VECTAB_VIRTUAL
+KBUILD_CPPFLAGS += -DOS_STACK_WATERMARK=1
+endif
 else #!rtx
 ifeq ($(KERNEL),FREERTOS)
 KBUILD_CPPFLAGS += \
@@ -1226,6 +1237,9 @@ ifeq ($(SW_IIR_EQ_PROCESS),1)
 export A2DP_EQ_24BIT = 1
 endif
 
+# Run the SW IIR EQ on services/audio_process/sw_iir_biquad.c
+export SW_IIR_BIQUAD ?= 0
+
 export HW_IIR_EQ_PROCESS ?= 0
 
 export HW_DAC_IIR_EQ_PROCESS ?= 0
@@ -1234,6 +1248,19 @@ export AUDIO_DRC ?= 0
 
 export AUDIO_DRC2 ?= 0
 
+# Run the SW IIR EQ with the mono downmix and upmix in one pass over the
+# buffer, block by block. DRC, the limiter and the HW EQs work on whole
+# buffers, so they cannot be enabled with it.
+export AUDIO_PROCESS_FUSED ?= 0
+ifeq ($(AUDIO_PROCESS_FUSED),1)
+ifneq ($(SW_IIR_EQ_PROCESS),1)
+$(error AUDIO_PROCESS_FUSED needs SW_IIR_EQ_PROCESS)
+endif
+ifneq ($(filter 1,$(HW_FIR_EQ_PROCESS) $(HW_IIR_EQ_PROCESS) $(AUDIO_DRC) $(AUDIO_DRC2)),)
+$(error AUDIO_PROCESS_FUSED cannot run with HW_FIR_EQ_PROCESS, HW_IIR_EQ_PROCESS, AUDIO_DRC or AUDIO_DRC2)
+endif
+endif
+
 export HW_DC_FILTER_WITH_IIR ?= 0
 ifeq ($(HW_DC_FILTER_WITH_IIR),1)
 KBUILD_CPPFLAGS += -DHW_DC_FILTER_WITH_IIR
@@ -1652,6 +1679,24 @@ KBUILD_CPPFLAGS += -DSCO_CP_ACCEL
 KBUILD_CPPFLAGS += -DUSE_CMSIS_F32_FFT
 endif
 
+# Pipelines the RX speech chain on the CP while TX runs on the MCU, with one
+# frame of extra downlink delay
+export SCO_CP_PIPELINE ?= 0
+ifeq ($(SCO_CP_PIPELINE),1)
+ifeq ($(SCO_CP_ACCEL),1)
+$(error SCO_CP_PIPELINE conflicts with SCO_CP_ACCEL)
+endif
+# The CP cannot read flash. The link script keeps the RX NS2/NS2FLOAT/NS3,
+# EQ and post gain stages in RAM, but not the NS and AGC libraries, nor the
+# stages left out of the overlay by SCO_OPTIMIZE_FOR_RAM.
+ifneq ($(filter 1,$(SPEECH_RX_NS) $(SPEECH_RX_AGC) $(SCO_OPTIMIZE_FOR_RAM)),)
+$(error SCO_CP_PIPELINE cannot run SPEECH_RX_NS, SPEECH_RX_AGC or SCO_OPTIMIZE_FOR_RAM on the CP)
+endif
+KBUILD_CPPFLAGS += -DSCO_CP_PIPELINE
+# TX and RX run at the same time, each needs its own FFT buffers
+KBUILD_CPPFLAGS += -DUSE_CMSIS_F32_FFT
+endif
+
 export SCO_TRACE_CP_ACCEL ?= 0
 ifeq ($(SCO_TRACE_CP_ACCEL),1)
 KBUILD_CPPFLAGS += -DSCO_TRACE_CP_ACCEL
@@ -1786,11 +1831,33 @@ KBUILD_CPPFLAGS += -DMIX_AUDIO_PROMPT_WITH_A2DP_MEDIA_ENABLED
 export RESAMPLE_ANY_SAMPLE_RATE ?= 1
 endif
 
+# Keep the mixed prompts as PCM at the stream sample rate in an LRU cache of
+# AUDIO_PROMPT_PCM_CACHE_SIZE bytes (32 KB by default, set it in the target
+# to cache longer prompts). A prompt is cached as it is first played, so it
+# is not decoded or resampled again while it is mixed the next times.
+export AUDIO_PROMPT_PCM_CACHE ?= 0
+ifeq ($(AUDIO_PROMPT_PCM_CACHE),1)
+ifneq ($(MIX_AUDIO_PROMPT_WITH_A2DP_MEDIA_ENABLED),1)
+$(error AUDIO_PROMPT_PCM_CACHE needs MIX_AUDIO_PROMPT_WITH_A2DP_MEDIA_ENABLED)
+endif
+endif
+
 #ifeq ($(AUDIO_RESAMPLE),0)
 export RESAMPLE_ANY_SAMPLE_RATE ?= 1
 KBUILD_CPPFLAGS += -DRESAMPLE_ANY_SAMPLE_RATE
 #endif
 
+# Run the any rate resampling of app_bt_stream on the in-tree polyphase
+# resampler. RESAMPLE_POLY_A2DP_TAPS (A2DP and prompts) and
+# RESAMPLE_POLY_SCO_TAPS pick the filter length: 16 (default), 24, 32 or 36
+# taps. Longer is slower but not better, see audio_resample_poly.h.
+export RESAMPLE_POLY ?= 0
+ifeq ($(RESAMPLE_POLY),1)
+ifneq ($(RESAMPLE_ANY_SAMPLE_RATE),1)
+$(error RESAMPLE_POLY needs RESAMPLE_ANY_SAMPLE_RATE)
+endif
+endif
+
 export MEDIA_PLAY_24BIT ?= 0
 
 export LBRT ?= 0
@@ -2527,6 +2594,13 @@ ifneq ($(NO_BOOT_STRUCT),1)
 core-y += $(call add_if_exists,utils/boot_struct/)
 endif
 
+export PERF_PROBE ?= 0
+ifeq ($(PERF_PROBE),1)
+core-y += utils/perf_probe/
+KBUILD_CPPFLAGS += -DPERF_PROBE_ENABLED
+endif
+KBUILD_CPPFLAGS += -Iutils/perf_probe
+
 export DEFAULT_CFG_SRC ?= _default_cfg_src_
 
 ifneq ($(wildcard $(srctree)/config/$(T)/tgt_hardware.h $(srctree)/config/$(T)/res/),)
@@ -0,0 +1,1024 @@
+/*
+ * A2DP decoder host replay.
+ *
+ * Feeds captured (or synthesised) AVDTP media packets through
+ * a2dp_audio_store_packet() and pulls PCM through
+ * a2dp_audio_playback_handler() on a virtual DMA clock, then reports
+ * decode time per frame, jitter-buffer depth over time and underflows.
+ *
+ *   a2dp_replay gen    [opts] out.a2rp            synthesise an SBC capture
+ *   a2dp_replay import [opts] btsnoop.log out.a2rp extract a media channel
+ *   a2dp_replay run    [opts] capture.a2rp        replay and report
+ *   a2dp_replay bench-crc [opts]                  SBC CRC-8 micro-benchmark
+ */
+#include "a2dp_decoder.h"
+#include "a2dp_decoder_internal.h"
+#include "a2dp_replay.h"
+#include "app_utils.h"
+#include "avdtp_api.h"
+#include "codec_sbc.h"
+#include "crc8.h"
+#include "hal_trace.h"
+#include "perf_probe.h"
+#include <algorithm>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+extern A2DP_AUDIO_CONTEXT_T a2dp_audio_context;
+
+#define REPLAY_MEMPOOL_SIZE (256 * 1024)
+#define REPLAY_SBC_LIST_SAMPLES (128)
+/* AUDIO_ANALYSIS_INTERVAL in app_tws_ibrt_audio_analysis.h */
+#define REPLAY_ANALYSIS_INTERVAL (25)
+
+/* ---------------------------------------------------------------------- */
+/* capture file io                                                         */
+
+static void put_le16(std::vector<uint8_t> &out, uint16_t v) {
+  out.push_back(v & 0xff);
+  out.push_back(v >> 8);
+}
+
+static void put_le32(std::vector<uint8_t> &out, uint32_t v) {
+  put_le16(out, v & 0xffff);
+  put_le16(out, v >> 16);
+}
+
+static uint16_t get_le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+static uint32_t get_le32(const uint8_t *p) {
+  return get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+static uint16_t get_be16(const uint8_t *p) { return (p[0] << 8) | p[1]; }
+
+static uint32_t get_be32(const uint8_t *p) {
+  return ((uint32_t)get_be16(p) << 16) | get_be16(p + 2);
+}
+
+static bool read_file(const char *path, std::vector<uint8_t> &data) {
+  FILE *f = fopen(path, "rb");
+  uint8_t buf[4096];
+  size_t n;
+
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    data.insert(data.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+static bool write_capture(const char *path, const a2dp_replay_stream_t &stream,
+                          const std::vector<a2dp_replay_packet_t> &packets) {
+  std::vector<uint8_t> out;
+  FILE *f;
+
+  out.insert(out.end(), A2DP_REPLAY_MAGIC, A2DP_REPLAY_MAGIC + 4);
+  put_le16(out, A2DP_REPLAY_VERSION);
+  put_le16(out, stream.codec_type);
+  put_le32(out, stream.sample_rate);
+  out.push_back(stream.num_channels);
+  out.push_back(stream.bits_depth);
+  put_le16(out, 0);
+  for (size_t i = 0; i < packets.size(); i++) {
+    put_le32(out, packets[i].arrival_us);
+    put_le16(out, packets[i].sequenceNumber);
+    put_le32(out, packets[i].timestamp);
+    put_le16(out, packets[i].len);
+    out.insert(out.end(), packets[i].payload,
+               packets[i].payload + packets[i].len);
+  }
+
+  f = fopen(path, "wb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  fwrite(&out[0], 1, out.size(), f);
+  fclose(f);
+  return true;
+}
+
+static bool read_capture(const char *path, std::vector<uint8_t> &data,
+                         a2dp_replay_stream_t &stream,
+                         std::vector<a2dp_replay_packet_t> &packets) {
+  size_t off = 16;
+
+  if (!read_file(path, data))
+    return false;
+  if (data.size() < 16 || memcmp(&data[0], A2DP_REPLAY_MAGIC, 4) ||
+      get_le16(&data[4]) != A2DP_REPLAY_VERSION) {
+    fprintf(stderr, "%s: not an a2dp replay capture\n", path);
+    return false;
+  }
+  stream.codec_type = get_le16(&data[6]);
+  stream.sample_rate = get_le32(&data[8]);
+  stream.num_channels = data[12];
+  stream.bits_depth = data[13];
+
+  while (off + 12 <= data.size()) {
+    a2dp_replay_packet_t pkt;
+    pkt.arrival_us = get_le32(&data[off]);
+    pkt.sequenceNumber = get_le16(&data[off + 4]);
+    pkt.timestamp = get_le32(&data[off + 6]);
+    pkt.len = get_le16(&data[off + 10]);
+    off += 12;
+    if (off + pkt.len > data.size()) {
+      fprintf(stderr, "%s: truncated packet %zu\n", path, packets.size());
+      break;
+    }
+    pkt.payload = &data[off];
+    off += pkt.len;
+    packets.push_back(pkt);
+  }
+  return true;
+}
+
+/* ---------------------------------------------------------------------- */
+/* gen: synthetic SBC stream with jitter, loss bursts and clock drift       */
+
+static uint32_t prng_state = 1;
+
+static uint32_t prng_next(void) {
+  prng_state ^= prng_state << 13;
+  prng_state ^= prng_state >> 17;
+  prng_state ^= prng_state << 5;
+  return prng_state;
+}
+
+static double prng_unit(void) { return (prng_next() >> 8) / 16777216.0; }
+
+struct bit_writer {
+  std::vector<uint8_t> *out;
+  uint32_t pos;
+  void put(uint32_t v, int n) {
+    while (n--) {
+      if ((pos & 7) == 0)
+        out->push_back(0);
+      if ((v >> n) & 1)
+        (*out)[out->size() - 1] |= 0x80 >> (pos & 7);
+      pos++;
+    }
+  }
+};
+
+/* One joint-stereo SBC frame with random scale factors and samples. The
+ * header and CRC are valid, so the frame exercises the full decode path. */
+static void gen_sbc_frame(std::vector<uint8_t> &out, int freq_idx,
+                          int bitpool) {
+  const int nsb = 8, nblk = 16, nch = 2;
+  std::vector<uint8_t> frame;
+  bit_writer bw;
+  btif_sbc_stream_info_t info;
+  uint16_t frame_len;
+  uint8_t crc_buf[12];
+
+  frame.push_back(0x9C);
+  frame.push_back((uint8_t)((freq_idx << 6) | (3 << 4) |
+                            (BTIF_SBC_CHNL_MODE_JOINT_STEREO << 2) | 1));
+  frame.push_back((uint8_t)bitpool);
+  frame.push_back(0);
+  bw.out = &frame;
+  bw.pos = 32;
+  for (int sb = 0; sb < nsb; sb++)
+    bw.put(sb < nsb - 1 ? prng_next() & 1 : 0, 1);
+  for (int ch = 0; ch < nch; ch++)
+    for (int sb = 0; sb < nsb; sb++)
+      bw.put(4 + (prng_next() % 8) - sb / 2, 4);
+
+  crc_buf[0] = frame[1];
+  crc_buf[1] = frame[2];
+  memcpy(&crc_buf[2], &frame[4], (bw.pos - 32 + 7) / 8);
+  frame[3] = sbc_host_crc8(crc_buf, 16 + bw.pos - 32);
+
+  memset(&info, 0, sizeof(info));
+  info.sampleFreq = freq_idx;
+  info.numBlocks = nblk;
+  info.channelMode = BTIF_SBC_CHNL_MODE_JOINT_STEREO;
+  info.numSubBands = nsb;
+  info.bitPool = bitpool;
+  frame_len = btif_sbc_frame_len(&info);
+  while (bw.pos < (uint32_t)frame_len * 8)
+    bw.put(prng_next() & 1, 1);
+  frame.resize(frame_len);
+  out.insert(out.end(), frame.begin(), frame.end());
+}
+
+static int cmd_gen(int argc, char **argv) {
+  uint32_t packets = 3000, frames = 5, bitpool = 53, rate = 44100;
+  double jitter_ms = 2.0, loss = 0.0, burst = 1.0, drift_ppm = 0;
+  double stall_every_s = 0, stall_ms = 0;
+  const char *out_path = NULL;
+  static std::vector<std::vector<uint8_t> > store;
+
+  for (int i = 0; i < argc; i++) {
+    if (!strcmp(argv[i], "--packets") && i + 1 < argc)
+      packets = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+      frames = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--bitpool") && i + 1 < argc)
+      bitpool = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--rate") && i + 1 < argc)
+      rate = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--jitter-ms") && i + 1 < argc)
+      jitter_ms = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--loss") && i + 1 < argc)
+      loss = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--burst") && i + 1 < argc)
+      burst = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--drift-ppm") && i + 1 < argc)
+      drift_ppm = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--stall-every-s") && i + 1 < argc)
+      stall_every_s = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--stall-ms") && i + 1 < argc)
+      stall_ms = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+      prng_state = (uint32_t)atoi(argv[++i]) | 1;
+    else if (argv[i][0] != '-')
+      out_path = argv[i];
+    else {
+      fprintf(stderr, "gen: unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (!out_path) {
+    fprintf(stderr, "gen: missing output path\n");
+    return 2;
+  }
+
+  int freq_idx = rate == 16000 ? 0 : rate == 32000 ? 1 : rate == 44100 ? 2 : 3;
+  a2dp_replay_stream_t stream = {A2DP_AUDIO_CODEC_TYPE_SBC, rate, 2, 16};
+  std::vector<a2dp_replay_packet_t> list;
+  double packet_us = frames * REPLAY_SBC_LIST_SAMPLES * 1e6 / rate;
+  double last_arrival = 0, next_stall = stall_every_s * 1e6;
+  uint32_t burst_left = 0;
+
+  store.resize(packets);
+  for (uint32_t n = 0; n < packets; n++) {
+    double nominal = n * packet_us * (1.0 + drift_ppm * 1e-6);
+    double arrival = nominal + prng_unit() * jitter_ms * 1000;
+
+    if (stall_every_s > 0 && nominal >= next_stall) {
+      arrival += stall_ms * 1000;
+      next_stall += stall_every_s * 1e6;
+    }
+    if (burst_left == 0 && loss > 0 && prng_unit() < loss) {
+      burst_left = 1 + (uint32_t)(prng_unit() * 2 * (burst - 1) + 0.5);
+    }
+    if (burst_left) {
+      burst_left--;
+      continue;
+    }
+    arrival = std::max(arrival, last_arrival);
+    last_arrival = arrival;
+
+    std::vector<uint8_t> &payload = store[n];
+    payload.push_back((uint8_t)frames);
+    for (uint32_t f = 0; f < frames; f++)
+      gen_sbc_frame(payload, freq_idx, bitpool);
+
+    a2dp_replay_packet_t pkt;
+    pkt.arrival_us = (uint32_t)arrival;
+    pkt.sequenceNumber = (uint16_t)n;
+    pkt.timestamp = n * frames * REPLAY_SBC_LIST_SAMPLES;
+    pkt.len = (uint16_t)payload.size();
+    pkt.payload = &payload[0];
+    list.push_back(pkt);
+  }
+  if (!write_capture(out_path, stream, list))
+    return 1;
+  printf("gen: %zu/%u packets, %u frames/packet, %.1f ms span -> %s\n",
+         list.size(), packets, frames,
+         list.empty() ? 0.0 : list.back().arrival_us / 1000.0, out_path);
+  return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+/* import: btsnoop (H4 or unencapsulated HCI) -> capture                    */
+
+struct l2cap_rx {
+  std::vector<uint8_t> buf;
+  uint32_t expected;
+};
+
+static int cmd_import(int argc, char **argv) {
+  const char *in_path = NULL, *out_path = NULL;
+  int want_cid = -1;
+  uint16_t codec_type = A2DP_AUDIO_CODEC_TYPE_SBC;
+  uint32_t rate = 0;
+  std::vector<uint8_t> data;
+
+  for (int i = 0; i < argc; i++) {
+    if (!strcmp(argv[i], "--cid") && i + 1 < argc)
+      want_cid = (int)strtol(argv[++i], NULL, 0);
+    else if (!strcmp(argv[i], "--codec") && i + 1 < argc) {
+      i++;
+      codec_type = !strcmp(argv[i], "aac") ? A2DP_AUDIO_CODEC_TYPE_MPEG2_4_AAC
+                                           : A2DP_AUDIO_CODEC_TYPE_SBC;
+    } else if (!strcmp(argv[i], "--rate") && i + 1 < argc)
+      rate = atoi(argv[++i]);
+    else if (argv[i][0] != '-') {
+      if (!in_path)
+        in_path = argv[i];
+      else
+        out_path = argv[i];
+    } else {
+      fprintf(stderr, "import: unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (!in_path || !out_path) {
+    fprintf(stderr, "import: need <btsnoop> <out.a2rp>\n");
+    return 2;
+  }
+  if (!read_file(in_path, data))
+    return 1;
+  if (data.size() < 16 || memcmp(&data[0], "btsnoop", 8)) {
+    fprintf(stderr, "%s: not a btsnoop file\n", in_path);
+    return 1;
+  }
+
+  uint32_t datalink = get_be32(&data[12]);
+  std::map<uint16_t, l2cap_rx> rx;
+  std::map<uint16_t, std::vector<a2dp_replay_packet_t> > by_cid;
+  std::vector<std::vector<uint8_t> *> owned;
+  uint64_t first_ts = 0;
+  size_t off = 16;
+
+  while (off + 24 <= data.size()) {
+    uint32_t incl = get_be32(&data[off + 4]);
+    uint32_t flags = get_be32(&data[off + 8]);
+    uint64_t ts = ((uint64_t)get_be32(&data[off + 16]) << 32) |
+                  get_be32(&data[off + 20]);
+    const uint8_t *p = &data[off + 24];
+    uint32_t len = incl;
+
+    off += 24 + incl;
+    if (off > data.size())
+      break;
+    if (!(flags & 1))
+      continue;
+    if (datalink == 1002) {
+      if (len < 1 || p[0] != 0x02)
+        continue;
+      p++;
+      len--;
+    } else if (flags & 2) {
+      continue;
+    }
+    if (len < 4)
+      continue;
+    if (!first_ts)
+      first_ts = ts;
+
+    uint16_t handle = get_le16(p) & 0x0fff;
+    uint8_t pb = (get_le16(p) >> 12) & 3;
+    uint16_t acl_len = get_le16(p + 2);
+    l2cap_rx &r = rx[handle];
+
+    p += 4;
+    len = std::min<uint32_t>(len - 4, acl_len);
+    if (pb != 1) {
+      r.buf.assign(p, p + len);
+      r.expected = len >= 2 ? get_le16(p) + 4 : 0;
+    } else if (!r.buf.empty()) {
+      r.buf.insert(r.buf.end(), p, p + len);
+    }
+    if (r.buf.size() < 4 || r.buf.size() < r.expected)
+      continue;
+
+    uint16_t cid = get_le16(&r.buf[2]);
+    const uint8_t *rtp = &r.buf[4];
+    uint32_t rtp_len = r.expected - 4;
+    if (rtp_len >= 12 && (rtp[0] >> 6) == 2 && (rtp[1] & 0x7f) >= 96 &&
+        (want_cid < 0 || want_cid == cid)) {
+      uint32_t hdr = 12 + (rtp[0] & 0x0f) * 4;
+      if (rtp_len > hdr) {
+        std::vector<uint8_t> *payload =
+            new std::vector<uint8_t>(rtp + hdr, rtp + rtp_len);
+        a2dp_replay_packet_t pkt;
+        owned.push_back(payload);
+        pkt.arrival_us = (uint32_t)(ts - first_ts);
+        pkt.sequenceNumber = get_be16(rtp + 2);
+        pkt.timestamp = get_be32(rtp + 4);
+        pkt.len = (uint16_t)payload->size();
+        pkt.payload = &(*payload)[0];
+        by_cid[cid].push_back(pkt);
+      }
+    }
+    r.buf.clear();
+  }
+
+  std::vector<a2dp_replay_packet_t> *best = NULL;
+  uint16_t best_cid = 0;
+  for (std::map<uint16_t, std::vector<a2dp_replay_packet_t> >::iterator it =
+           by_cid.begin();
+       it != by_cid.end(); ++it) {
+    if (!best || it->second.size() > best->size()) {
+      best = &it->second;
+      best_cid = it->first;
+    }
+  }
+  if (!best) {
+    fprintf(stderr, "import: no media packets found\n");
+    return 1;
+  }
+
+  if (!rate) {
+    static const uint32_t rates[4] = {16000, 32000, 44100, 48000};
+    const a2dp_replay_packet_t &pkt = (*best)[0];
+    rate = 44100;
+    if (codec_type == A2DP_AUDIO_CODEC_TYPE_SBC && pkt.len > 2 &&
+        pkt.payload[1] == 0x9C)
+      rate = rates[pkt.payload[2] >> 6];
+  }
+  a2dp_replay_stream_t stream = {codec_type, rate, 2, 16};
+  if (!write_capture(out_path, stream, *best))
+    return 1;
+  printf("import: cid 0x%04x, %zu packets, %u Hz -> %s\n", best_cid,
+         best->size(), rate, out_path);
+  for (size_t i = 0; i < owned.size(); i++)
+    delete owned[i];
+  return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+/* run                                                                     */
+
+struct replay_stats {
+  std::vector<uint32_t> frame_ns;
+  std::vector<uint32_t> store_ns;
+  std::vector<uint32_t> depth_frames;
+  uint32_t callbacks;
+  uint32_t decoded_frames;
+  uint32_t underflows;
+  uint32_t retriggers;
+  uint32_t mute_callbacks;
+};
+
+static uint64_t host_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t replay_list_depth(void) {
+  list_t *list = a2dp_audio_context.audio_datapath.input_raw_packet_list;
+  return list ? a2dp_audio_list_length(list) : 0;
+}
+
+static uint32_t percentile(std::vector<uint32_t> v, double p) {
+  if (v.empty())
+    return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5))];
+}
+
+static double average(const std::vector<uint32_t> &v) {
+  double sum = 0;
+  for (size_t i = 0; i < v.size(); i++)
+    sum += v[i];
+  return v.empty() ? 0 : sum / v.size();
+}
+
+static void replay_decoder_open(const a2dp_replay_stream_t &stream,
+                                uint32_t frame_samples,
+                                uint16_t dest_packet_mut) {
+  A2DP_AUDIO_OUTPUT_CONFIG_T config;
+
+  a2dp_replay_host_mempool_reset();
+  memset(&config, 0, sizeof(config));
+  config.sample_rate = stream.sample_rate;
+  config.num_channels = 2;
+  config.bits_depth = stream.bits_depth;
+  config.frame_samples = frame_samples;
+  config.factor_reference = 1.0f;
+  a2dp_audio_init(APP_SYSFREQ_52M, stream.codec_type, &config,
+                  A2DP_AUDIO_CHANNEL_SELECT_STEREO, dest_packet_mut);
+  a2dp_audio_start();
+}
+
+static void replay_decoder_close(void) {
+  a2dp_audio_stop();
+  a2dp_audio_deinit();
+}
+
+static void print_stats(void) {
+  static const char *const jitter_bins[A2DP_AUDIO_STATS_JITTER_BINS] = {
+      "<1", "<2", "<5", "<10", "<20", "<50", "<100", ">=100"};
+  A2DP_AUDIO_STATS_T s;
+  uint32_t i;
+
+  a2dp_audio_stats_get(&s);
+  printf("stats record   : v%u, %u bytes, %u ms\n", s.version, s.size,
+         s.elapsed_ms);
+  printf("  depth ms     :");
+  for (i = 0; i < A2DP_AUDIO_STATS_DEPTH_BINS; i++)
+    printf(" %u%s:%u", i * A2DP_AUDIO_STATS_DEPTH_BIN_MS,
+           i == A2DP_AUDIO_STATS_DEPTH_BINS - 1 ? "+" : "", s.depth_hist[i]);
+  printf("\n  jitter ms    :");
+  for (i = 0; i < A2DP_AUDIO_STATS_JITTER_BINS; i++)
+    printf(" %s:%u", jitter_bins[i], s.jitter_hist[i]);
+  printf("\n  packets      : %u (seq gaps %u, max gap %u ms)\n", s.packets,
+         s.seq_gaps, s.max_gap_ms);
+  for (i = 0; i < A2DP_AUDIO_STATS_CODEC_MAX; i++) {
+    if (!s.decode[i].codec_type)
+      continue;
+    printf("  decode 0x%02x  : %u calls, us min %u avg %u max %u\n",
+           s.decode[i].codec_type, s.decode[i].calls, s.decode[i].min_us,
+           s.decode[i].avg_us, s.decode[i].max_us);
+  }
+  printf("  sync         : pid %u (last %+d ppm, peak %+d ppm), "
+         "force slow %u\n",
+         s.pid_corrections, s.pid_last_ppm, s.pid_peak_ppm,
+         s.force_slow_tunes);
+  printf("  discards     : %u packets, %u samples, mtu limiter %u\n",
+         s.discard_packets, s.discard_samples, s.mtu_limiter);
+  printf("  refill/uflow : %u callbacks / %u\n", s.refill_callbacks,
+         s.underflows);
+#ifdef PERF_PROBE_ENABLED
+  struct PERF_PROBE_STAT_T p;
+
+  perf_probe_get(PERF_PROBE_A2DP_DECODE, &p);
+  printf("  decode probe : %u calls, ns avg %u max %u\n", p.count,
+         p.count ? (uint32_t)(p.sum / p.count) : 0, p.max);
+  for (i = 0; i < PERF_PROBE_BUCKETS; i++) {
+    if (p.hist[i])
+      printf("    < 2^%-2u ns : %u\n", i, p.hist[i]);
+  }
+#endif
+}
+
+struct replay_options {
+  const char *in_path;
+  const char *csv_path;
+  uint32_t frame_samples;
+  int dest_packet_mut;
+  bool retrigger;
+  bool stats;
+  float adapt_min;
+  float adapt_max;
+};
+
+struct replay_summary {
+  const char *policy;
+  double minutes;
+  double depth_ms_avg;
+  double depth_ms_p99;
+  uint32_t underflows;
+  uint32_t dest_packet_mut;
+};
+
+static void replay_policy_print(const std::vector<replay_summary> &sums) {
+  printf("\npolicy     minutes  depth ms avg  p99   underflows  /min  "
+         "final dest\n");
+  for (size_t i = 0; i < sums.size(); i++) {
+    const replay_summary &r = sums[i];
+    printf("%-10s %7.2f  %12.1f  %5.1f %10u  %4.2f  %10u\n", r.policy,
+           r.minutes, r.depth_ms_avg, r.depth_ms_p99, r.underflows,
+           r.minutes > 0 ? r.underflows / r.minutes : 0, r.dest_packet_mut);
+  }
+}
+
+// One pass over the capture. The decoder is reopened after an underflow the
+// way app_bt_stream restarts the stream: base target times the current
+// latency factor, which the adaptive policy keeps moving.
+static int replay_once(const replay_options &opt,
+                       A2DP_AUDIO_LATENCY_POLICY_E policy,
+                       const char *policy_name, const char *csv_path,
+                       replay_summary &sum) {
+  std::vector<uint8_t> data;
+  a2dp_replay_stream_t stream;
+  std::vector<a2dp_replay_packet_t> packets;
+  uint32_t frame_samples = opt.frame_samples;
+  int base_packet_mut = opt.dest_packet_mut;
+  int dest_packet_mut;
+
+  if (!read_capture(opt.in_path, data, stream, packets))
+    return 1;
+  if (packets.empty()) {
+    fprintf(stderr, "run: capture has no packets\n");
+    return 1;
+  }
+
+  switch (stream.codec_type) {
+  case A2DP_AUDIO_CODEC_TYPE_SBC:
+    a2dp_replay_host.bt_codec_type = BTIF_AVDTP_CODEC_TYPE_SBC;
+    if (base_packet_mut < 0)
+      base_packet_mut = 50;
+    break;
+#if defined(A2DP_AAC_ON)
+  case A2DP_AUDIO_CODEC_TYPE_MPEG2_4_AAC:
+    a2dp_replay_host.bt_codec_type = BTIF_AVDTP_CODEC_TYPE_MPEG2_4_AAC;
+    if (base_packet_mut < 0)
+      base_packet_mut = 6;
+    break;
+#endif
+  default:
+    fprintf(stderr, "run: codec 0x%x not built into this replay\n",
+            stream.codec_type);
+    return 1;
+  }
+
+  a2dp_replay_host.sample_bit = 16;
+  a2dp_replay_host.dma_buffer_samples = frame_samples * 2;
+  a2dp_replay_host.underflow_triggers = 0;
+  a2dp_replay_host.resample_tunes = 0;
+  a2dp_replay_host.resample_ratio = 0;
+  a2dp_replay_now_us = 0;
+  a2dp_audio_latency_factor_setlow();
+  a2dp_audio_latency_policy_set(policy, opt.adapt_min, opt.adapt_max);
+  a2dp_audio_stats_reset();
+
+  FILE *csv = NULL;
+  if (csv_path) {
+    csv = fopen(csv_path, "w");
+    if (!csv) {
+      perror(csv_path);
+      return 1;
+    }
+    fprintf(csv, "time_ms,depth_frames,depth_ms,ratio_ppm,callback_ns,"
+                 "frames,dest_frames\n");
+  }
+
+  replay_stats st = replay_stats();
+  uint32_t bytes_per_sample = stream.bits_depth == 24 ? 4 : 2;
+  uint32_t dma_bytes = frame_samples * 2 * bytes_per_sample;
+  std::vector<uint8_t> pcm(dma_bytes);
+  size_t next_pkt = 0;
+  bool playing = false;
+  double next_dma_us = 0;
+  uint32_t list_samples = REPLAY_SBC_LIST_SAMPLES;
+
+  dest_packet_mut = base_packet_mut;
+  replay_decoder_open(stream, frame_samples, (uint16_t)dest_packet_mut);
+
+  while (true) {
+    bool have_pkt = next_pkt < packets.size();
+    bool dma_due = playing && (!have_pkt ||
+                               next_dma_us <= packets[next_pkt].arrival_us);
+
+    if (!have_pkt && (!playing || replay_list_depth() == 0))
+      break;
+
+    if (!dma_due) {
+      a2dp_replay_packet_t &pkt = packets[next_pkt++];
+      btif_media_header_t header;
+      uint64_t t0;
+
+      memset(&header, 0, sizeof(header));
+      header.version = 2;
+      header.sequenceNumber = pkt.sequenceNumber;
+      header.timestamp = pkt.timestamp;
+      a2dp_replay_now_us = pkt.arrival_us;
+      t0 = host_ns();
+      a2dp_audio_store_packet(&header, pkt.payload, pkt.len);
+      st.store_ns.push_back((uint32_t)(host_ns() - t0));
+
+      if (!playing && replay_list_depth() >= (uint32_t)dest_packet_mut) {
+        playing = true;
+        next_dma_us = a2dp_replay_now_us;
+      }
+      continue;
+    }
+
+    A2DP_AUDIO_LASTFRAME_INFO_T before, after;
+    uint32_t triggers = a2dp_replay_host.underflow_triggers;
+    uint64_t t0, ns;
+    uint32_t frames;
+
+    a2dp_replay_now_us = (uint64_t)next_dma_us;
+    a2dp_audio_lastframe_info_get(&before);
+    t0 = host_ns();
+    a2dp_audio_playback_handler(&pcm[0], dma_bytes);
+    ns = host_ns() - t0;
+    a2dp_audio_lastframe_info_get(&after);
+    if (after.list_samples)
+      list_samples = after.list_samples;
+
+    frames = after.decoded_frames - before.decoded_frames;
+    st.callbacks++;
+    // the IBRT audio analysis restarts the low watermark window this often;
+    // without it the first-callback minimum pins the sync loop to "fill"
+    if (st.callbacks % REPLAY_ANALYSIS_INTERVAL == 0)
+      a2dp_audio_lastframe_info_reset_undecodeframe();
+    st.decoded_frames += frames;
+    if (frames)
+      st.frame_ns.push_back((uint32_t)(ns / frames));
+    else
+      st.mute_callbacks++;
+
+    uint32_t depth = replay_list_depth();
+    st.depth_frames.push_back(depth);
+    if (csv) {
+      fprintf(csv, "%.3f,%u,%.2f,%d,%llu,%u,%d\n",
+              a2dp_replay_now_us / 1000.0, depth,
+              depth * list_samples * 1000.0 / stream.sample_rate,
+              (int)(a2dp_replay_host.resample_ratio * 1e6),
+              (unsigned long long)ns, frames, a2dp_audio_dest_packet_mut_get());
+    }
+
+    next_dma_us += frame_samples * 1e6 /
+                   (stream.sample_rate * (1.0 + a2dp_replay_host.resample_ratio));
+
+    if (a2dp_replay_host.underflow_triggers != triggers) {
+      st.underflows++;
+      if (opt.retrigger) {
+        st.retriggers++;
+        replay_decoder_close();
+        dest_packet_mut =
+            (int)(base_packet_mut * a2dp_audio_latency_factor_get() + 0.5f);
+        replay_decoder_open(stream, frame_samples, (uint16_t)dest_packet_mut);
+        playing = false;
+      }
+    }
+  }
+  sum.dest_packet_mut = a2dp_audio_dest_packet_mut_get();
+  replay_decoder_close();
+  if (csv)
+    fclose(csv);
+
+  std::vector<uint32_t> &d = st.depth_frames;
+  double ms_per_frame = list_samples * 1000.0 / stream.sample_rate;
+  uint32_t dmin = d.empty() ? 0 : *std::min_element(d.begin(), d.end());
+  uint32_t dmax = d.empty() ? 0 : *std::max_element(d.begin(), d.end());
+
+  printf("capture        : %s (%zu packets, codec 0x%x, %u Hz)\n", opt.in_path,
+         packets.size(), stream.codec_type, stream.sample_rate);
+  printf("config         : dma %u samples, dest_packet_mut %d, policy %s\n",
+         frame_samples, base_packet_mut, policy_name);
+  printf("callbacks      : %u (%u without decode)\n", st.callbacks,
+         st.mute_callbacks);
+  printf("decoded frames : %u\n", st.decoded_frames);
+  printf("decode ns/frame: min %u avg %.0f p50 %u p99 %u max %u\n",
+         percentile(st.frame_ns, 0), average(st.frame_ns),
+         percentile(st.frame_ns, 0.5), percentile(st.frame_ns, 0.99),
+         percentile(st.frame_ns, 1.0));
+  printf("store ns/packet: avg %.0f p99 %u max %u\n", average(st.store_ns),
+         percentile(st.store_ns, 0.99), percentile(st.store_ns, 1.0));
+  printf("depth ms       : min %.1f avg %.1f max %.1f\n", dmin * ms_per_frame,
+         average(d) * ms_per_frame, dmax * ms_per_frame);
+  printf("underflows     : %u (retriggers %u)\n", st.underflows,
+         st.retriggers);
+  printf("sync tunes     : %u (last ratio %+d ppm)\n",
+         a2dp_replay_host.resample_tunes,
+         (int)(a2dp_replay_host.resample_ratio * 1e6));
+  if (opt.stats)
+    print_stats();
+
+  sum.policy = policy_name;
+  sum.minutes = st.callbacks * (double)frame_samples / stream.sample_rate / 60;
+  sum.depth_ms_avg = average(d) * ms_per_frame;
+  sum.depth_ms_p99 = percentile(d, 0.99) * ms_per_frame;
+  sum.underflows = st.underflows;
+  return 0;
+}
+
+static int cmd_run(int argc, char **argv) {
+  replay_options opt;
+  const char *policy = "static";
+  static const struct {
+    const char *name;
+    A2DP_AUDIO_LATENCY_POLICY_E policy;
+  } policies[] = {
+      {"static", A2DP_AUDIO_LATENCY_POLICY_STATIC},
+      {"adaptive", A2DP_AUDIO_LATENCY_POLICY_ADAPTIVE},
+  };
+  std::vector<replay_summary> sums;
+  int ret = 0;
+
+  memset(&opt, 0, sizeof(opt));
+  opt.frame_samples = 640;
+  opt.dest_packet_mut = -1;
+  opt.retrigger = true;
+  opt.adapt_min = 0.5f;
+  opt.adapt_max = 2.5f;
+
+  for (int i = 0; i < argc; i++) {
+    if (!strcmp(argv[i], "--dma-samples") && i + 1 < argc)
+      opt.frame_samples = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--dest-mut") && i + 1 < argc)
+      opt.dest_packet_mut = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--csv") && i + 1 < argc)
+      opt.csv_path = argv[++i];
+    else if (!strcmp(argv[i], "--policy") && i + 1 < argc)
+      policy = argv[++i];
+    else if (!strcmp(argv[i], "--adapt-range") && i + 1 < argc) {
+      if (sscanf(argv[++i], "%f:%f", &opt.adapt_min, &opt.adapt_max) != 2 ||
+          opt.adapt_min <= 0 || opt.adapt_min > opt.adapt_max) {
+        fprintf(stderr, "run: bad --adapt-range %s\n", argv[i]);
+        return 2;
+      }
+    }
+    else if (!strcmp(argv[i], "--no-retrigger"))
+      opt.retrigger = false;
+    else if (!strcmp(argv[i], "--stats"))
+      opt.stats = true;
+    else if (!strcmp(argv[i], "-v"))
+      hal_trace_host_verbose = 1;
+    else if (argv[i][0] != '-')
+      opt.in_path = argv[i];
+    else {
+      fprintf(stderr, "run: unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (!opt.in_path) {
+    fprintf(stderr, "run: missing capture path\n");
+    return 2;
+  }
+  bool all = !strcmp(policy, "all");
+  if (!all && strcmp(policy, "static") && strcmp(policy, "adaptive")) {
+    fprintf(stderr, "run: unknown policy %s\n", policy);
+    return 2;
+  }
+
+  a2dp_replay_host.mempool_size = REPLAY_MEMPOOL_SIZE;
+  a2dp_replay_host.mempool = (uint8_t *)malloc(REPLAY_MEMPOOL_SIZE);
+  list_init();
+
+  for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+    std::string csv_path;
+    replay_summary sum;
+
+    if (!all && strcmp(policy, policies[i].name))
+      continue;
+    if (opt.csv_path) {
+      csv_path = opt.csv_path;
+      if (all)
+        csv_path += std::string(".") + policies[i].name;
+    }
+    if (!sums.empty())
+      printf("\n");
+    ret = replay_once(opt, policies[i].policy, policies[i].name,
+                      opt.csv_path ? csv_path.c_str() : NULL, sum);
+    if (ret)
+      break;
+    sums.push_back(sum);
+  }
+  if (!ret)
+    replay_policy_print(sums);
+  free(a2dp_replay_host.mempool);
+  return ret;
+}
+
+/* ---------------------------------------------------------------------- */
+/* SBC CRC-8 micro-benchmark                                               */
+
+/* CRC region of one frame in bits, after the two header bytes. */
+static uint32_t bench_crc_bits(const uint8_t *frame) {
+  uint32_t nsb, nch, mode;
+
+  if (frame[0] == CRC8_MSBC_SYNCWORD)
+    return 4 * 8;
+  nsb = (frame[1] & 1) ? 8 : 4;
+  mode = (frame[1] >> 2) & 3;
+  nch = mode == BTIF_SBC_CHNL_MODE_MONO ? 1 : 2;
+  return 4 * nsb * nch + (mode == BTIF_SBC_CHNL_MODE_JOINT_STEREO ? nsb : 0);
+}
+
+/* The bit loop the host decoder uses, one frame at a time. */
+static int bench_crc_bitwise_check(const uint8_t *frame) {
+  uint32_t bits = bench_crc_bits(frame);
+  uint8_t crc_buf[12];
+
+  crc_buf[0] = frame[1];
+  crc_buf[1] = frame[2];
+  memcpy(&crc_buf[2], &frame[4], (bits + 7) / 8);
+  return sbc_host_crc8(crc_buf, 16 + bits) == frame[3] ? 0 : -2;
+}
+
+/* Headers and scale factors of every SBC mode plus mSBC, random
+ * otherwise, with the CRC set by the bit loop. */
+static void bench_crc_frames(std::vector<std::vector<uint8_t> > &frames,
+                             uint32_t count) {
+  for (uint32_t n = 0; n < count; n++) {
+    std::vector<uint8_t> frame(4 + 9);
+    uint32_t cfg = n % 9, bits;
+    uint8_t crc_buf[12];
+
+    for (size_t i = 0; i < frame.size(); i++)
+      frame[i] = (uint8_t)prng_next();
+    if (cfg == 8) {
+      frame[0] = CRC8_MSBC_SYNCWORD;
+      frame[1] = 0;
+      frame[2] = 0;
+    } else {
+      frame[0] = CRC8_SBC_SYNCWORD;
+      frame[1] = (uint8_t)((frame[1] & 0xF2) | ((cfg & 3) << 2) | (cfg >> 2));
+    }
+    bits = bench_crc_bits(&frame[0]);
+    crc_buf[0] = frame[1];
+    crc_buf[1] = frame[2];
+    memcpy(&crc_buf[2], &frame[4], (bits + 7) / 8);
+    frame[3] = sbc_host_crc8(crc_buf, 16 + bits);
+    frames.push_back(frame);
+  }
+}
+
+static int cmd_bench_crc(int argc, char **argv) {
+  uint32_t count = 900, iters = 2000, errors = 0, bad = 0;
+  std::vector<std::vector<uint8_t> > frames;
+  uint64_t t0, t_bit, t_tbl;
+  volatile int sink = 0;
+
+  for (int i = 0; i < argc; i++) {
+    if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+      count = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--iters") && i + 1 < argc)
+      iters = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "bench-crc: unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (!count || !iters)
+    return 2;
+  bench_crc_frames(frames, count);
+
+  /* both must accept every frame and reject every single bit error in
+   * the CRC region, except in the mode and subband bits: those change the
+   * region itself */
+  for (uint32_t n = 0; n < count; n++) {
+    std::vector<uint8_t> f = frames[n];
+    uint32_t bits = bench_crc_bits(&f[0]);
+
+    if (bench_crc_bitwise_check(&f[0]) ||
+        crc8_sbc_frame_check(&f[0], f.size()))
+      errors++;
+    for (uint32_t b = 0; b < 16 + bits; b++) {
+      uint32_t pos = b < 16 ? 8 + b : 32 + b - 16;
+
+      if (b < 16 &&
+          (f[0] == CRC8_MSBC_SYNCWORD || (pos >= 12 && pos < 16)))
+        continue;
+      f[pos >> 3] ^= 0x80 >> (pos & 7);
+      if (!bench_crc_bitwise_check(&f[0]) ||
+          crc8_sbc_frame_check(&f[0], f.size()) != -2)
+        bad++;
+      f[pos >> 3] ^= 0x80 >> (pos & 7);
+    }
+  }
+
+  t0 = host_ns();
+  for (uint32_t it = 0; it < iters; it++)
+    for (uint32_t n = 0; n < count; n++)
+      sink += bench_crc_bitwise_check(&frames[n][0]);
+  t_bit = host_ns() - t0;
+
+  t0 = host_ns();
+  for (uint32_t it = 0; it < iters; it++)
+    for (uint32_t n = 0; n < count; n++)
+      sink += crc8_sbc_frame_check(&frames[n][0], frames[n].size());
+  t_tbl = host_ns() - t0;
+
+  printf("frames         %u x %u (8 SBC modes + mSBC)\n", count, iters);
+  printf("mismatches     %u valid, %u single bit errors missed\n", errors,
+         bad);
+  printf("bit loop       %.1f ns/frame\n", (double)t_bit / count / iters);
+  printf("crc8 table     %.1f ns/frame\n", (double)t_tbl / count / iters);
+  printf("speedup        %.2fx\n", t_tbl ? (double)t_bit / t_tbl : 0.0);
+  return errors || bad || sink ? 1 : 0;
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: a2dp_replay gen [--packets N] [--frames N] [--bitpool N]\n"
+          "                       [--rate HZ] [--jitter-ms MS] [--loss P]\n"
+          "                       [--burst N] [--drift-ppm PPM]\n"
+          "                       [--stall-every-s S --stall-ms MS]\n"
+          "                       [--seed N] out.a2rp\n"
+          "       a2dp_replay import [--cid CID] [--codec sbc|aac]\n"
+          "                       [--rate HZ] btsnoop.log out.a2rp\n"
+          "       a2dp_replay run [--dma-samples N] [--dest-mut N]\n"
+          "                       [--csv depth.csv] [--no-retrigger]\n"
+          "                       [--policy static|adaptive|all]\n"
+          "                       [--adapt-range MIN:MAX] [--stats] [-v]\n"
+          "                       capture.a2rp\n"
+          "       a2dp_replay bench-crc [--frames N] [--iters N]\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+    return 2;
+  }
+  if (!strcmp(argv[1], "gen"))
+    return cmd_gen(argc - 2, argv + 2);
+  if (!strcmp(argv[1], "import"))
+    return cmd_import(argc - 2, argv + 2);
+  if (!strcmp(argv[1], "run"))
+    return cmd_run(argc - 2, argv + 2);
+  if (!strcmp(argv[1], "bench-crc"))
+    return cmd_bench_crc(argc - 2, argv + 2);
+  usage();
+  return 2;
+}
@@ -0,0 +1,71 @@
+/*
+ * A2DP decoder host replay: capture format and the hooks the host shims
+ * expose to the replay loop.
+ */
+#ifndef __A2DP_REPLAY_H__
+#define __A2DP_REPLAY_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Capture file layout, all fields little endian:
+ *
+ *   file header  "A2RP" | u16 version | u16 codec_type (A2DP_AUDIO_CODEC_TYPE_*)
+ *                | u32 sample_rate | u8 num_channels | u8 bits_depth
+ *                | u16 reserved
+ *   per packet   u32 arrival_us | u16 sequenceNumber | u32 timestamp
+ *                | u16 len | u8 payload[len]
+ *
+ * payload is the AVDTP media payload after the RTP header, i.e. exactly
+ * what the stack hands to a2dp_audio_store_packet().
+ */
+#define A2DP_REPLAY_MAGIC "A2RP"
+#define A2DP_REPLAY_VERSION (1)
+
+typedef struct {
+  uint16_t codec_type;
+  uint32_t sample_rate;
+  uint8_t num_channels;
+  uint8_t bits_depth;
+} a2dp_replay_stream_t;
+
+typedef struct {
+  uint32_t arrival_us;
+  uint16_t sequenceNumber;
+  uint32_t timestamp;
+  uint16_t len;
+  uint8_t *payload;
+} a2dp_replay_packet_t;
+
+typedef struct {
+  /* answered to the decoder framework */
+  uint8_t bt_codec_type;
+  uint8_t sample_bit;
+  uint32_t dma_buffer_samples;
+  /* recorded from the decoder framework */
+  uint32_t underflow_triggers;
+  uint32_t sysfreq_reqs;
+  uint32_t sysfreq;
+  uint32_t resample_tunes;
+  float resample_ratio;
+  /* audio mempool */
+  uint8_t *mempool;
+  uint32_t mempool_size;
+  uint32_t mempool_used;
+} a2dp_replay_host_t;
+
+extern a2dp_replay_host_t a2dp_replay_host;
+extern uint64_t a2dp_replay_now_us;
+
+void a2dp_replay_host_mempool_reset(void);
+uint8_t sbc_host_crc8(const uint8_t *data, uint32_t bits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * Host shim for apps/audioplayers/app_audio.h: the audio mempool is a single
+ * malloc'ed arena handed out by the replay harness.
+ */
+#ifndef __APP_AUDIO_H__
+#define __APP_AUDIO_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int app_audio_mempool_get_buff(uint8_t **buff, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * Host shim for services/bt_app/app_bt.h and the btapp.h player queries the
+ * decoder framework makes. The replay harness answers them from the capture
+ * header.
+ */
+#ifndef __APP_BT_H__
+#define __APP_BT_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint8_t bt_sbc_player_get_codec_type(void);
+uint8_t bt_sbc_player_get_sample_bit(void);
+uint32_t app_bt_stream_get_dma_buffer_samples(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ * Host shim for services/bt_app/app_bt_media_manager.h.
+ */
+#ifndef __APP_BT_MEDIA_MANAGER_H__
+#define __APP_BT_MEDIA_MANAGER_H__
+
+#include "audioflinger.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int app_audio_manager_tune_samplerate_ratio(enum AUD_STREAM_T stream,
+                                            float ratio);
+void app_audio_decode_err_force_trigger(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
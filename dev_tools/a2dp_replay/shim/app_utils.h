@@ -0,0 +1,39 @@
+/*
+ * Host shim for apps/common/app_utils.h.
+ */
+#ifndef __APP_UTILS_H__
+#define __APP_UTILS_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_SYSFREQ_USER_BT_A2DP APP_SYSFREQ_USER_APP_3
+
+enum APP_SYSFREQ_USER_T {
+  APP_SYSFREQ_USER_APP_0,
+  APP_SYSFREQ_USER_APP_1,
+  APP_SYSFREQ_USER_APP_2,
+  APP_SYSFREQ_USER_APP_3,
+  APP_SYSFREQ_USER_QTY
+};
+
+enum APP_SYSFREQ_FREQ_T {
+  APP_SYSFREQ_32K,
+  APP_SYSFREQ_26M,
+  APP_SYSFREQ_52M,
+  APP_SYSFREQ_78M,
+  APP_SYSFREQ_104M,
+  APP_SYSFREQ_208M,
+  APP_SYSFREQ_FREQ_QTY
+};
+
+int app_sysfreq_req(enum APP_SYSFREQ_USER_T user, enum APP_SYSFREQ_FREQ_T freq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
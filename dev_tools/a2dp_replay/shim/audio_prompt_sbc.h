@@ -0,0 +1,6 @@
+/*
+ * Host shim: prompt mixing is not part of the replay.
+ */
+#ifndef __AUDIO_PROMPT_SBC_H__
+#define __AUDIO_PROMPT_SBC_H__
+#endif
@@ -0,0 +1,25 @@
+/*
+ * Host shim for services/audioflinger/audioflinger.h.
+ */
+#ifndef __AUDIOFLINGER_H__
+#define __AUDIOFLINGER_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum AUD_STREAM_T {
+  AUD_STREAM_PLAYBACK = 0,
+  AUD_STREAM_CAPTURE,
+  AUD_STREAM_NUM,
+};
+
+void af_codec_direct_tune(enum AUD_STREAM_T stream, float ratio);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * Host shim for services/bt_if_enhanced/inc/avdtp_api.h: only the media
+ * header and the codec type ids used by the decoder framework.
+ */
+#ifndef __AVDTP_API_H__
+#define __AVDTP_API_H__
+
+#include "bluetooth.h"
+
+#define BTIF_AVDTP_CODEC_TYPE_SBC 0x00
+#define BTIF_AVDTP_CODEC_TYPE_MPEG1_2_AUDIO 0x01
+#define BTIF_AVDTP_CODEC_TYPE_MPEG2_4_AAC 0x02
+#define BTIF_AVDTP_CODEC_TYPE_ATRAC 0x04
+#define BTIF_AVDTP_CODEC_TYPE_OPUS 0x08
+#define BTIF_AVDTP_CODEC_TYPE_H263 0x01
+#define BTIF_AVDTP_CODEC_TYPE_MPEG4_VSP 0x02
+#define BTIF_AVDTP_CODEC_TYPE_H263_PROF3 0x03
+#define BTIF_AVDTP_CODEC_TYPE_H263_PROF8 0x04
+#define BTIF_AVDTP_CODEC_TYPE_LHDC 0xFF
+#define BTIF_AVDTP_CODEC_TYPE_NON_A2DP 0xFF
+
+typedef struct {
+  U8 version;
+  U8 padding;
+  U8 marker;
+  U8 payloadType;
+  U16 sequenceNumber;
+  U32 timestamp;
+  U32 ssrc;
+  U8 csrcCount;
+  U32 csrcList[15];
+} btif_avdtp_media_header_t;
+typedef btif_avdtp_media_header_t btif_media_header_t;
+
+#endif
@@ -0,0 +1,37 @@
+/*
+ * Host shim for services/bt_if_enhanced/inc/bluetooth.h: the scalar types and
+ * status codes codec_sbc.h and avdtp_api.h depend on.
+ */
+#ifndef __BLUETOOTH_H__
+#define __BLUETOOTH_H__
+
+#include "plat_types.h"
+
+typedef unsigned int U32;
+typedef unsigned short U16;
+typedef unsigned char U8;
+typedef int S32;
+typedef short S16;
+typedef char S8;
+typedef unsigned char BOOL;
+
+typedef struct _list_entry_t {
+  struct _list_entry_t *Flink;
+  struct _list_entry_t *Blink;
+} list_entry_t;
+
+typedef struct {
+  list_entry_t node;
+  uint8_t *data;
+  uint16_t dataLen;
+} btif_bt_packet_t;
+
+enum {
+  BT_STS_SUCCESS = 0,
+  BT_STS_FAILED = 1,
+  BT_STS_NO_RESOURCES = 12,
+  BT_STS_CONTINUE = 24,
+};
+typedef uint32_t bt_status_t;
+
+#endif
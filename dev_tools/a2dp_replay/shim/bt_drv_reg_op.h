@@ -0,0 +1,6 @@
+/*
+ * Host shim: nothing from the BT controller register layer is used on host.
+ */
+#ifndef __BT_DRV_REG_OP_H__
+#define __BT_DRV_REG_OP_H__
+#endif
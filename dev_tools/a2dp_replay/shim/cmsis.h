@@ -0,0 +1,28 @@
+/*
+ * Host shim for the CMSIS core header. Interrupt masking maps onto a single
+ * recursive process-wide lock so that int_lock()/int_unlock() sections keep
+ * their mutual exclusion when the replay runs the BT and audio paths on
+ * separate threads.
+ */
+#ifndef __CMSIS_H__
+#define __CMSIS_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t int_lock(void);
+void int_unlock(uint32_t flags);
+
+#define __DMB() __sync_synchronize()
+#define __DSB() __sync_synchronize()
+#define __ISB() __sync_synchronize()
+#define __NOP() do {} while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
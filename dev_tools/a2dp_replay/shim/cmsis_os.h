@@ -0,0 +1,77 @@
+/*
+ * Host shim for the RTX5 CMSIS-RTOS v1 compatibility layer. Only the
+ * primitives the A2DP decoder framework and utils/list touch are provided;
+ * they are backed by pthreads so the replay can run the store and playback
+ * paths on different threads.
+ */
+#ifndef __CMSIS_OS_H__
+#define __CMSIS_OS_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define osWaitForever 0xFFFFFFFFU
+
+typedef enum {
+  osOK = 0,
+  osEventSignal = 0x08,
+  osEventTimeout = 0x40,
+  osErrorResource = -3,
+  osErrorParameter = -4,
+} osStatus;
+
+typedef struct os_mutex_host *osMutexId;
+typedef struct os_semaphore_host *osSemaphoreId;
+typedef struct os_pool_host *osPoolId;
+typedef void *osThreadId;
+
+typedef struct os_mutex_def {
+  const char *name;
+} osMutexDef_t;
+
+typedef struct os_semaphore_def {
+  const char *name;
+} osSemaphoreDef_t;
+
+typedef struct os_pool_def {
+  uint32_t pool_sz;
+  uint32_t item_sz;
+} osPoolDef_t;
+
+#define osMutexDef(name) static const osMutexDef_t os_mutex_def_##name = {#name}
+#define osMutex(name) (&os_mutex_def_##name)
+#define osSemaphoreDef(name)                                                   \
+  static const osSemaphoreDef_t os_semaphore_def_##name = {#name}
+#define osSemaphore(name) (&os_semaphore_def_##name)
+#define osPoolDef(name, no, type)                                              \
+  static const osPoolDef_t os_pool_def_##name = {(no), sizeof(type)}
+#define osPool(name) (&os_pool_def_##name)
+
+osMutexId osMutexCreate(const osMutexDef_t *mutex_def);
+osStatus osMutexWait(osMutexId mutex_id, uint32_t millisec);
+osStatus osMutexRelease(osMutexId mutex_id);
+osStatus osMutexDelete(osMutexId mutex_id);
+
+osSemaphoreId osSemaphoreCreate(const osSemaphoreDef_t *semaphore_def,
+                                int32_t count);
+int32_t osSemaphoreWait(osSemaphoreId semaphore_id, uint32_t millisec);
+osStatus osSemaphoreRelease(osSemaphoreId semaphore_id);
+osStatus osSemaphoreDelete(osSemaphoreId semaphore_id);
+
+osPoolId osPoolCreate(const osPoolDef_t *pool_def);
+void *osPoolAlloc(osPoolId pool_id);
+void *osPoolCAlloc(osPoolId pool_id);
+osStatus osPoolFree(osPoolId pool_id, void *block);
+
+osStatus osThreadYield(void);
+osStatus osDelay(uint32_t millisec);
+osThreadId osThreadGetId(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ * Host shim for platform/hal/hal_location.h: all placement attributes are
+ * dropped, the host linker keeps everything in .text/.data/.bss.
+ */
+#ifndef __HAL_LOCATION_H__
+#define __HAL_LOCATION_H__
+
+#define BOOT_TEXT_SRAM_LOC
+#define BOOT_TEXT_FLASH_LOC
+#define BOOT_RODATA_SRAM_LOC
+#define BOOT_DATA_LOC
+#define BOOT_BSS_LOC
+#define SRAM_TEXT_LOC
+#define SRAM_DATA_LOC
+#define SRAM_BSS_LOC
+#define SRAM_STACK_LOC
+#define FRAM_TEXT_LOC
+#define FLASH_TEXT_LOC
+#define FLASH_RODATA_LOC
+#define SYNC_FLAGS_LOC
+#define CP_TEXT_SRAM_LOC
+#define CP_DATA_LOC
+#define CP_BSS_LOC
+
+#endif
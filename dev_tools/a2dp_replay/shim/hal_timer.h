@@ -0,0 +1,32 @@
+/*
+ * Host shim for platform/hal/hal_timer.h. Time is virtual: the replay loop
+ * advances it from the capture's arrival stamps and the simulated DMA
+ * period, so every run of the same capture sees the same tick values.
+ */
+#ifndef __HAL_TIMER_H__
+#define __HAL_TIMER_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CONFIG_SYSTICK_HZ 1000
+#define CONFIG_FAST_SYSTICK_HZ 1000000
+
+#define MS_TO_TICKS(ms) ((uint32_t)(ms))
+#define TICKS_TO_MS(tick) ((uint32_t)(tick))
+#define MS_TO_FAST_TICKS(ms) ((uint32_t)(ms)*1000)
+#define US_TO_FAST_TICKS(us) ((uint32_t)(us))
+#define FAST_TICKS_TO_MS(tick) ((uint32_t)(tick) / 1000)
+#define FAST_TICKS_TO_US(tick) ((uint32_t)(tick))
+
+uint32_t hal_sys_timer_get(void);
+uint32_t hal_fast_sys_timer_get(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Host shim for platform/hal/hal_trace.h. Traces go to stderr only when the
+ * replay runs with -v, otherwise they are compiled in but discarded so the
+ * decode timings are not dominated by stdio.
+ */
+#ifndef __HAL_TRACE_H__
+#define __HAL_TRACE_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int hal_trace_host_verbose;
+
+int hal_trace_printf(uint32_t attr, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+void hal_trace_dump(const char *fmt, unsigned int size, unsigned int count,
+                    const void *buffer);
+void hal_trace_assert_fail(const char *file, int line, const char *fmt, ...)
+    __attribute__((noreturn));
+
+static inline int hal_trace_dummy(const char *fmt, ...) { return 0; }
+
+#define LOG_MOD(m) 0
+#define LOG_ATTR_ARG_NUM(n) 0
+#define COUNT_ARG_NUM(...) 0
+
+#define LOG_DEBUG(attr, str, ...) hal_trace_dummy(str, ##__VA_ARGS__)
+#define LOG_INFO(attr, str, ...) hal_trace_printf(attr, str, ##__VA_ARGS__)
+#define LOG_WARN(attr, str, ...) hal_trace_printf(attr, str, ##__VA_ARGS__)
+#define LOG_ERROR(attr, str, ...) hal_trace_printf(attr, str, ##__VA_ARGS__)
+#define LOG_VERBOSE(attr, str, ...) hal_trace_dummy(str, ##__VA_ARGS__)
+
+#define TRACE(attr, str, ...) LOG_INFO(attr, str, ##__VA_ARGS__)
+#define TRACE_IMM(attr, str, ...) LOG_INFO(attr, str, ##__VA_ARGS__)
+
+#define DUMP8(str, buf, cnt) hal_trace_dump(str, 1, cnt, buf)
+#define DUMP16(str, buf, cnt) hal_trace_dump(str, 2, cnt, buf)
+#define DUMP32(str, buf, cnt) hal_trace_dump(str, 4, cnt, buf)
+
+#define ASSERT(cond, str, ...)                                                 \
+  {                                                                            \
+    if (!(cond)) {                                                             \
+      hal_trace_assert_fail(__FILE__, __LINE__, str, ##__VA_ARGS__);           \
+    }                                                                          \
+  }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
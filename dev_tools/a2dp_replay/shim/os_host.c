@@ -0,0 +1,182 @@
+/*
+ * pthread backing for the cmsis_os.h / cmsis.h host shims.
+ */
+#include "cmsis.h"
+#include "cmsis_os.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct os_mutex_host {
+  pthread_mutex_t mutex;
+};
+
+struct os_semaphore_host {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int32_t count;
+};
+
+struct os_pool_host {
+  uint32_t item_sz;
+  uint32_t free_cnt;
+};
+
+static pthread_mutex_t int_lock_mutex;
+static pthread_once_t int_lock_once = PTHREAD_ONCE_INIT;
+
+static void recursive_mutex_init(pthread_mutex_t *mutex) {
+  pthread_mutexattr_t attr;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+static void int_lock_init(void) { recursive_mutex_init(&int_lock_mutex); }
+
+uint32_t int_lock(void) {
+  pthread_once(&int_lock_once, int_lock_init);
+  pthread_mutex_lock(&int_lock_mutex);
+  return 0;
+}
+
+void int_unlock(uint32_t flags) {
+  (void)flags;
+  pthread_mutex_unlock(&int_lock_mutex);
+}
+
+/* RTX5 creates CMSIS v1 mutexes as recursive, the decoder relies on it. */
+osMutexId osMutexCreate(const osMutexDef_t *mutex_def) {
+  osMutexId mutex = (osMutexId)calloc(1, sizeof(*mutex));
+
+  (void)mutex_def;
+  recursive_mutex_init(&mutex->mutex);
+  return mutex;
+}
+
+osStatus osMutexWait(osMutexId mutex_id, uint32_t millisec) {
+  (void)millisec;
+  pthread_mutex_lock(&mutex_id->mutex);
+  return osOK;
+}
+
+osStatus osMutexRelease(osMutexId mutex_id) {
+  pthread_mutex_unlock(&mutex_id->mutex);
+  return osOK;
+}
+
+osStatus osMutexDelete(osMutexId mutex_id) {
+  pthread_mutex_destroy(&mutex_id->mutex);
+  free(mutex_id);
+  return osOK;
+}
+
+osSemaphoreId osSemaphoreCreate(const osSemaphoreDef_t *semaphore_def,
+                                int32_t count) {
+  osSemaphoreId sem = (osSemaphoreId)calloc(1, sizeof(*sem));
+
+  (void)semaphore_def;
+  pthread_mutex_init(&sem->lock, NULL);
+  pthread_cond_init(&sem->cond, NULL);
+  sem->count = count;
+  return sem;
+}
+
+/* Returns the number of available tokens before the wait, or 0 on timeout,
+ * which is what the CMSIS v1 wrapper reports. */
+int32_t osSemaphoreWait(osSemaphoreId semaphore_id, uint32_t millisec) {
+  int32_t ret = 0;
+
+  pthread_mutex_lock(&semaphore_id->lock);
+  if (millisec == osWaitForever) {
+    while (semaphore_id->count == 0)
+      pthread_cond_wait(&semaphore_id->cond, &semaphore_id->lock);
+  } else if (millisec && semaphore_id->count == 0) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += millisec / 1000;
+    ts.tv_nsec += (long)(millisec % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+    while (semaphore_id->count == 0) {
+      if (pthread_cond_timedwait(&semaphore_id->cond, &semaphore_id->lock,
+                                 &ts) == ETIMEDOUT)
+        break;
+    }
+  }
+  if (semaphore_id->count > 0) {
+    ret = semaphore_id->count--;
+  }
+  pthread_mutex_unlock(&semaphore_id->lock);
+  return ret;
+}
+
+osStatus osSemaphoreRelease(osSemaphoreId semaphore_id) {
+  pthread_mutex_lock(&semaphore_id->lock);
+  semaphore_id->count++;
+  pthread_cond_signal(&semaphore_id->cond);
+  pthread_mutex_unlock(&semaphore_id->lock);
+  return osOK;
+}
+
+osStatus osSemaphoreDelete(osSemaphoreId semaphore_id) {
+  pthread_cond_destroy(&semaphore_id->cond);
+  pthread_mutex_destroy(&semaphore_id->lock);
+  free(semaphore_id);
+  return osOK;
+}
+
+osPoolId osPoolCreate(const osPoolDef_t *pool_def) {
+  osPoolId pool = (osPoolId)calloc(1, sizeof(*pool));
+
+  pool->item_sz = pool_def->item_sz;
+  pool->free_cnt = pool_def->pool_sz;
+  return pool;
+}
+
+void *osPoolAlloc(osPoolId pool_id) {
+  void *block = NULL;
+
+  if (pool_id->free_cnt) {
+    block = malloc(pool_id->item_sz);
+    pool_id->free_cnt--;
+  }
+  return block;
+}
+
+void *osPoolCAlloc(osPoolId pool_id) {
+  void *block = osPoolAlloc(pool_id);
+
+  if (block)
+    memset(block, 0, pool_id->item_sz);
+  return block;
+}
+
+osStatus osPoolFree(osPoolId pool_id, void *block) {
+  free(block);
+  pool_id->free_cnt++;
+  return osOK;
+}
+
+osStatus osThreadYield(void) {
+  sched_yield();
+  return osOK;
+}
+
+osStatus osDelay(uint32_t millisec) {
+  struct timespec ts;
+
+  ts.tv_sec = millisec / 1000;
+  ts.tv_nsec = (long)(millisec % 1000) * 1000000L;
+  nanosleep(&ts, NULL);
+  return osOK;
+}
+
+osThreadId osThreadGetId(void) { return (osThreadId)pthread_self(); }
@@ -0,0 +1,23 @@
+/*
+ * Host shim for platform/hal/plat_types.h.
+ */
+#ifndef __PLAT_TYPES_H__
+#define __PLAT_TYPES_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ALIGN
+#define ALIGN(val, exp) (((val) + ((exp)-1)) & ~((exp)-1))
+#endif
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+#define BOUND(x, min, max) ((x) < (min) ? (min) : ((x) > (max) ? (max) : (x)))
+#define ABS(x) ((x < 0) ? (-(x)) : (x))
+
+#define __STATIC_FORCEINLINE static inline __attribute__((always_inline))
+#define WEAK __attribute__((weak))
+#define POSSIBLY_UNUSED __attribute__((unused))
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * Host implementations of the platform, trace and BT app hooks the A2DP
+ * decoder framework calls out to.
+ */
+#include "a2dp_replay.h"
+#include "app_audio.h"
+#include "app_bt.h"
+#include "app_bt_media_manager.h"
+#include "app_utils.h"
+#include "hal_timer.h"
+#include "hal_trace.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+a2dp_replay_host_t a2dp_replay_host;
+uint64_t a2dp_replay_now_us;
+int hal_trace_host_verbose;
+
+uint32_t hal_sys_timer_get(void) {
+  return (uint32_t)(a2dp_replay_now_us / 1000);
+}
+
+uint32_t hal_fast_sys_timer_get(void) { return (uint32_t)a2dp_replay_now_us; }
+
+int hal_trace_printf(uint32_t attr, const char *fmt, ...) {
+  va_list ap;
+
+  (void)attr;
+  if (!hal_trace_host_verbose)
+    return 0;
+  fprintf(stderr, "%10.3f ", a2dp_replay_now_us / 1000.0);
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+  return 0;
+}
+
+void hal_trace_dump(const char *fmt, unsigned int size, unsigned int count,
+                    const void *buffer) {
+  unsigned int i;
+
+  if (!hal_trace_host_verbose)
+    return;
+  for (i = 0; i < count; i++) {
+    if (size == 1)
+      fprintf(stderr, fmt, ((const uint8_t *)buffer)[i]);
+    else if (size == 2)
+      fprintf(stderr, fmt, ((const uint16_t *)buffer)[i]);
+    else
+      fprintf(stderr, fmt, ((const uint32_t *)buffer)[i]);
+  }
+  fputc('\n', stderr);
+}
+
+void hal_trace_assert_fail(const char *file, int line, const char *fmt, ...) {
+  va_list ap;
+
+  fprintf(stderr, "ASSERT %s:%d: ", file, line);
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+  abort();
+}
+
+void a2dp_replay_host_mempool_reset(void) { a2dp_replay_host.mempool_used = 0; }
+
+int app_audio_mempool_get_buff(uint8_t **buff, uint32_t size) {
+  size = ALIGN(size, 8);
+  if (a2dp_replay_host.mempool_used + size > a2dp_replay_host.mempool_size) {
+    *buff = NULL;
+    return -1;
+  }
+  *buff = a2dp_replay_host.mempool + a2dp_replay_host.mempool_used;
+  a2dp_replay_host.mempool_used += size;
+  return 0;
+}
+
+int app_sysfreq_req(enum APP_SYSFREQ_USER_T user,
+                    enum APP_SYSFREQ_FREQ_T freq) {
+  (void)user;
+  a2dp_replay_host.sysfreq = freq;
+  a2dp_replay_host.sysfreq_reqs++;
+  return 0;
+}
+
+uint8_t bt_sbc_player_get_codec_type(void) {
+  return a2dp_replay_host.bt_codec_type;
+}
+
+uint8_t bt_sbc_player_get_sample_bit(void) {
+  return a2dp_replay_host.sample_bit;
+}
+
+uint32_t app_bt_stream_get_dma_buffer_samples(void) {
+  return a2dp_replay_host.dma_buffer_samples;
+}
+
+int app_audio_manager_tune_samplerate_ratio(enum AUD_STREAM_T stream,
+                                            float ratio) {
+  (void)stream;
+  a2dp_replay_host.resample_ratio = ratio;
+  a2dp_replay_host.resample_tunes++;
+  return 0;
+}
+
+void af_codec_direct_tune(enum AUD_STREAM_T stream, float ratio) {
+  app_audio_manager_tune_samplerate_ratio(stream, ratio);
+}
+
+void app_audio_decode_err_force_trigger(void) {
+  a2dp_replay_host.underflow_triggers++;
+}
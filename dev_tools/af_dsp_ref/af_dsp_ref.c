@@ -0,0 +1,230 @@
+/*
+ * Host check of the audioflinger sample kernels
+ * (services/audioflinger/af_dsp.c) against a 64-bit reference. Built twice,
+ * the plain C kernels and the Cortex-M4 DSP kernels on C models of the
+ * intrinsics must both match the reference, and so each other.
+ */
+#include "af_dsp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REF_MAX_CH 6
+#define REF_MAX_FRAMES 96
+
+static uint32_t ref_rounds = 20000;
+static uint32_t ref_fnv = 2166136261u;
+static int ref_failed;
+
+static uint32_t ref_rand(void) {
+  static uint32_t s = 12345;
+
+  s = s * 1103515245 + 12345;
+  return s >> 8;
+}
+
+static void ref_hash(const void *p, uint32_t bytes) {
+  const uint8_t *b = (const uint8_t *)p;
+  uint32_t i;
+
+  for (i = 0; i < bytes; i++) {
+    ref_fnv = (ref_fnv ^ b[i]) * 16777619u;
+  }
+}
+
+static int32_t ref_clamp(int64_t v, uint32_t bits) {
+  int64_t max = ((int64_t)1 << (bits - 1)) - 1;
+
+  if (v > max) {
+    return (int32_t)max;
+  } else if (v < -max - 1) {
+    return (int32_t)(-max - 1);
+  }
+  return (int32_t)v;
+}
+
+// Full-scale values often, to exercise the saturation
+static int32_t ref_sample(uint32_t bits) {
+  int32_t max = (1 << (bits - 1)) - 1;
+
+  switch (ref_rand() % 8) {
+  case 0:
+    return max;
+  case 1:
+    return -max - 1;
+  default:
+    return (int32_t)(ref_rand() % (2u * max + 2)) - max - 1;
+  }
+}
+
+// A gain and a step that keep the Q14 factor within [0, 2) over frames,
+// as audioflinger.c does for the software gain and the fade-out
+static void ref_gain(int32_t *gain, int32_t *step, uint32_t frames) {
+  int32_t end;
+
+  switch (ref_rand() % 4) {
+  case 0:
+    *gain = AF_DSP_GAIN_Q30_ONE;
+    break;
+  case 1:
+    *gain = 0;
+    break;
+  default:
+    *gain = (int32_t)(ref_rand() % 0x7FFF0000u);
+    break;
+  }
+  *step = 0;
+  if (frames && (ref_rand() % 2)) {
+    end = (int32_t)(ref_rand() % 0x7FFF0000u);
+    *step = (int32_t)(((int64_t)end - *gain) / (int64_t)frames);
+  }
+}
+
+static void ref_report(const char *name, const int32_t *got,
+                       const int32_t *want, uint32_t n, uint32_t chans) {
+  uint32_t i;
+
+  for (i = 0; i < n; i++) {
+    if (got[i] != want[i]) {
+      printf("%s mismatch at %u (%u chans): %d, expected %d\n", name, i, chans,
+             got[i], want[i]);
+      ref_failed = 1;
+      return;
+    }
+  }
+}
+
+// Random lengths, channel counts, gains and ramps. Each ramp is applied in
+// two calls, to check the returned gain, and the 16-bit buffers start at
+// odd offsets too, for unaligned sample pairs.
+static void ref_check_gain(uint32_t bits) {
+  static int16_t buf16[REF_MAX_FRAMES * REF_MAX_CH + 1];
+  static int32_t buf24[REF_MAX_FRAMES * REF_MAX_CH];
+  static int32_t got[REF_MAX_FRAMES * REF_MAX_CH];
+  static int32_t want[REF_MAX_FRAMES * REF_MAX_CH];
+  int32_t gain, step, g, want_gain;
+  uint32_t r, i, c, n, frames, split, chans, off;
+
+  for (r = 0; r < ref_rounds && !ref_failed; r++) {
+    chans = ref_rand() % REF_MAX_CH + 1;
+    frames = ref_rand() % (REF_MAX_FRAMES + 1);
+    split = frames ? ref_rand() % (frames + 1) : 0;
+    off = (bits == 16) ? ref_rand() % 2 : 0;
+    n = frames * chans;
+    ref_gain(&gain, &step, frames);
+
+    g = gain;
+    for (i = 0; i < frames; i++) {
+      for (c = 0; c < chans; c++) {
+        int32_t x = ref_sample(bits);
+
+        if (bits == 16) {
+          buf16[off + i * chans + c] = (int16_t)x;
+        } else {
+          buf24[i * chans + c] = x;
+        }
+        want[i * chans + c] =
+            ref_clamp(((int64_t)x * (g >> 16) + 8192) >> 14, bits);
+      }
+      g += step;
+    }
+    want_gain = g;
+
+    if (bits == 16) {
+      g = af_dsp_gain_ramp_16(buf16 + off, split, chans, gain, step);
+      g = af_dsp_gain_ramp_16(buf16 + off + split * chans, frames - split,
+                              chans, g, step);
+      for (i = 0; i < n; i++) {
+        got[i] = buf16[off + i];
+      }
+      ref_hash(buf16 + off, n * sizeof(*buf16));
+    } else {
+      g = af_dsp_gain_ramp_24(buf24, split, chans, gain, step);
+      g = af_dsp_gain_ramp_24(buf24 + split * chans, frames - split, chans, g,
+                              step);
+      memcpy(got, buf24, n * sizeof(*got));
+      ref_hash(buf24, n * sizeof(*buf24));
+    }
+    ref_report(bits == 16 ? "gain_ramp_16" : "gain_ramp_24", got, want, n,
+               chans);
+    if (g != want_gain) {
+      printf("gain_ramp_%u returned %d, expected %d\n", bits, g, want_gain);
+      ref_failed = 1;
+    }
+  }
+}
+
+// The left offset goes to the even samples and the right one to the odd
+// samples, or to all of them in mono
+static void ref_check_dc(uint32_t bits) {
+  static int16_t buf16[REF_MAX_FRAMES * REF_MAX_CH + 1];
+  static int32_t buf24[REF_MAX_FRAMES * REF_MAX_CH];
+  static int32_t got[REF_MAX_FRAMES * REF_MAX_CH];
+  static int32_t want[REF_MAX_FRAMES * REF_MAX_CH];
+  int32_t dc_l, dc_r, dc;
+  uint32_t r, i, n, frames, chans, off, shift;
+
+  for (r = 0; r < ref_rounds && !ref_failed; r++) {
+    chans = ref_rand() % REF_MAX_CH + 1;
+    frames = ref_rand() % (REF_MAX_FRAMES + 1);
+    off = (bits == 16) ? ref_rand() % 2 : 0;
+    shift = (bits == 16) ? 0 : ref_rand() % 9;
+    n = frames * chans;
+    dc_l = ref_sample(bits);
+    dc_r = ref_sample(bits);
+
+    for (i = 0; i < n; i++) {
+      int32_t x = ref_sample(bits);
+
+      if (bits == 16) {
+        buf16[off + i] = (int16_t)x;
+      } else {
+        buf24[i] = x;
+      }
+      dc = ((chans == 1) || !(i & 1)) ? dc_l : dc_r;
+      want[i] = ref_clamp((int64_t)x + dc, bits) >> shift;
+    }
+
+    if (bits == 16) {
+      af_dsp_dc_offset_16(buf16 + off, frames, chans, (int16_t)dc_l,
+                          (int16_t)dc_r);
+      for (i = 0; i < n; i++) {
+        got[i] = buf16[off + i];
+      }
+      ref_hash(buf16 + off, n * sizeof(*buf16));
+    } else {
+      af_dsp_dc_offset_24(buf24, frames, chans, dc_l, dc_r, shift);
+      memcpy(got, buf24, n * sizeof(*got));
+      ref_hash(buf24, n * sizeof(*buf24));
+    }
+    ref_report(bits == 16 ? "dc_offset_16" : "dc_offset_24", got, want, n,
+               chans);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--rounds") && i + 1 < argc) {
+      ref_rounds = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--rounds N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  ref_check_gain(16);
+  ref_check_gain(24);
+  ref_check_dc(16);
+  ref_check_dc(24);
+  printf("output hash %08x\n", ref_fnv);
+
+  if (ref_failed) {
+    printf("FAILED\n");
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,13 @@
+/*
+ * Host shim for platform/hal/plat_types.h.
+ */
+#ifndef __PLAT_TYPES_H__
+#define __PLAT_TYPES_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+#endif
@@ -0,0 +1,545 @@
+/*
+ * Host check of the mixing kernels (utils/audio_mix/audio_mix.c) against a
+ * 64-bit reference, and against the float and shift loops they replace in
+ * audio_prompt_sbc.cpp, app_ring_merge.cpp and app_audio.cpp.
+ */
+#include "audio_mix.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#define REF_DSP_MODEL
+#endif
+
+#define REF_MAX_CH 6
+#define REF_MAX_FRAMES 96
+// Default prompt mix of audio_prompt_sbc.cpp: music at 0.4 and the prompt
+// at 1, with a 128 frame crossfade at 16 kHz, i.e. 384 frames at 48 kHz
+#define REF_COEFF_SOURCE 0.4f
+#define REF_COEFF_PROMPT 1.0f
+#define REF_OVERLAP 384
+#define REF_TIME_FRAMES 1024
+
+static uint32_t ref_rounds = 20000;
+static uint32_t ref_fnv = 2166136261u;
+static int ref_failed;
+
+static uint32_t ref_rand(void) {
+  static uint32_t s = 12345;
+
+  s = s * 1103515245 + 12345;
+  return s >> 8;
+}
+
+static void ref_hash(const void *p, uint32_t bytes) {
+  const uint8_t *b = (const uint8_t *)p;
+  uint32_t i;
+
+  for (i = 0; i < bytes; i++) {
+    ref_fnv = (ref_fnv ^ b[i]) * 16777619u;
+  }
+}
+
+static double ref_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int64_t ref_factor(int32_t gain) {
+  return ((int64_t)gain + 32768) >> 16;
+}
+
+static int32_t ref_clamp(int64_t v, uint32_t bits) {
+  int64_t max = ((int64_t)1 << (bits - 1)) - 1;
+
+  if (v > max) {
+    return (int32_t)max;
+  } else if (v < -max - 1) {
+    return (int32_t)(-max - 1);
+  }
+  return (int32_t)v;
+}
+
+// Full-scale values often, to exercise the saturation
+static int32_t ref_sample(uint32_t bits) {
+  int32_t max = (1 << (bits - 1)) - 1;
+
+  switch (ref_rand() % 8) {
+  case 0:
+    return max;
+  case 1:
+    return -max - 1;
+  default:
+    return (int32_t)(ref_rand() % (2u * max + 2)) - max - 1;
+  }
+}
+
+// A gain and a step that keep the factor within [0, 2) over frames
+static void ref_gain(struct AUDIO_MIX_GAIN_T *g, uint32_t frames) {
+  int32_t end;
+
+  switch (ref_rand() % 4) {
+  case 0:
+    g->gain = AUDIO_MIX_GAIN_Q30_ONE;
+    break;
+  case 1:
+    g->gain = AUDIO_MIX_GAIN_Q30_ONE / 2;
+    break;
+  default:
+    g->gain = (int32_t)(ref_rand() % 0x7FFF0000u);
+    break;
+  }
+  g->step = 0;
+  if (frames && (ref_rand() % 2)) {
+    end = (int32_t)(ref_rand() % 0x7FFF0000u);
+    g->step = (int32_t)(((int64_t)end - g->gain) / (int64_t)frames);
+  }
+}
+
+// dst = dst * gx + (mono << (bits - 16)) * gy, with the gains advanced as
+// the kernels do: Q14 factors at 16 bits, the Q30 gains at 24 bits
+static void ref_mix(int32_t *dst, const int16_t *mono, uint32_t frames,
+                    uint32_t chans, uint32_t bits, struct AUDIO_MIX_GAIN_T gx,
+                    struct AUDIO_MIX_GAIN_T gy) {
+  uint32_t i, c;
+
+  for (i = 0; i < frames; i++) {
+    int64_t y = (int64_t)mono[i] * (1 << (bits - 16));
+
+    for (c = 0; c < chans; c++, dst++) {
+      if (bits == 16) {
+        *dst = ref_clamp(
+            (*dst * ref_factor(gx.gain) + y * ref_factor(gy.gain) + 8192) >>
+                14,
+            bits);
+      } else {
+        *dst = ref_clamp(
+            (*dst * (int64_t)gx.gain + y * gy.gain + (1 << 29)) >> 30, bits);
+      }
+    }
+    gx.gain += gx.step;
+    gy.gain += gy.step;
+  }
+}
+
+static void ref_report(const char *name, int32_t *got, int32_t *want,
+                       uint32_t n) {
+  uint32_t i;
+
+  for (i = 0; i < n; i++) {
+    if (got[i] != want[i]) {
+      printf("%s mismatch at %u: %d, expected %d\n", name, i, got[i],
+             want[i]);
+      ref_failed = 1;
+      return;
+    }
+  }
+}
+
+// Random lengths, channel counts, gains, ramps and offsets, each mixed in
+// two calls to check that the gains carry over
+static void ref_check_mix(uint32_t bits) {
+  static int16_t mono[REF_MAX_FRAMES + 1];
+  static int16_t dst16[REF_MAX_FRAMES * REF_MAX_CH + 1];
+  static int32_t dst24[REF_MAX_FRAMES * REF_MAX_CH];
+  static int32_t got[REF_MAX_FRAMES * REF_MAX_CH];
+  static int32_t want[REF_MAX_FRAMES * REF_MAX_CH];
+  static const uint32_t chans_list[] = {1, 2, 3, 4, 6};
+  struct AUDIO_MIX_GAIN_T gx, gy;
+  uint32_t r, i, n, frames, split, chans, moff, doff;
+
+  for (r = 0; r < ref_rounds; r++) {
+    chans = chans_list[ref_rand() % 5];
+    frames = ref_rand() % (REF_MAX_FRAMES + 1);
+    split = frames ? ref_rand() % (frames + 1) : 0;
+    // Odd offsets for unaligned sample pairs
+    moff = ref_rand() % 2;
+    doff = (bits == 16) ? ref_rand() % 2 : 0;
+    n = frames * chans;
+    ref_gain(&gx, frames);
+    ref_gain(&gy, frames);
+
+    for (i = 0; i < frames; i++) {
+      mono[moff + i] = (int16_t)ref_sample(16);
+    }
+    for (i = 0; i < n; i++) {
+      want[i] = ref_sample(bits);
+      if (bits == 16) {
+        dst16[doff + i] = (int16_t)want[i];
+      } else {
+        dst24[i] = want[i];
+      }
+    }
+    ref_mix(want, mono + moff, frames, chans, bits, gx, gy);
+
+    if (bits == 16) {
+      audio_mix_mono_16(dst16 + doff, mono + moff, split, chans, &gx, &gy);
+      audio_mix_mono_16(dst16 + doff + split * chans, mono + moff + split,
+                        frames - split, chans, &gx, &gy);
+      for (i = 0; i < n; i++) {
+        got[i] = dst16[doff + i];
+      }
+      ref_report("mono_16", got, want, n);
+      ref_hash(dst16 + doff, n * sizeof(*dst16));
+    } else {
+      audio_mix_mono_24(dst24, mono + moff, split, chans, &gx, &gy);
+      audio_mix_mono_24(dst24 + split * chans, mono + moff + split,
+                        frames - split, chans, &gx, &gy);
+      ref_report("mono_24", dst24, want, n);
+      ref_hash(dst24, n * sizeof(*dst24));
+    }
+    if (ref_failed) {
+      return;
+    }
+  }
+}
+
+// Random lengths and odd offsets, with full-scale samples
+static void ref_check_avg(uint32_t bits) {
+  static int16_t src[REF_MAX_FRAMES + 1];
+  static int16_t dst16[REF_MAX_FRAMES + 1];
+  static int32_t dst24[REF_MAX_FRAMES];
+  static int32_t got[REF_MAX_FRAMES];
+  static int32_t want[REF_MAX_FRAMES];
+  uint32_t r, i, n, soff, doff;
+
+  for (r = 0; r < ref_rounds && !ref_failed; r++) {
+    n = ref_rand() % (REF_MAX_FRAMES + 1);
+    soff = ref_rand() % 2;
+    doff = (bits == 16) ? ref_rand() % 2 : 0;
+    for (i = 0; i < n; i++) {
+      src[soff + i] = (int16_t)ref_sample(16);
+      want[i] = ref_sample(bits);
+      if (bits == 16) {
+        dst16[doff + i] = (int16_t)want[i];
+      } else {
+        dst24[i] = want[i];
+      }
+      want[i] =
+          (int32_t)(((int64_t)want[i] + src[soff + i] * (1 << (bits - 16))) >>
+                    1);
+    }
+
+    if (bits == 16) {
+      audio_mix_avg_16(dst16 + doff, src + soff, n);
+      for (i = 0; i < n; i++) {
+        got[i] = dst16[doff + i];
+      }
+      ref_report("avg_16", got, want, n);
+      ref_hash(dst16 + doff, n * sizeof(*dst16));
+    } else {
+      audio_mix_avg_24(dst24, src + soff, n);
+      ref_report("avg_24", dst24, want, n);
+      ref_hash(dst24, n * sizeof(*dst24));
+    }
+  }
+}
+
+static void ref_check_scale(void) {
+  static int16_t buf[REF_MAX_FRAMES * 2];
+  static int32_t got[REF_MAX_FRAMES * 2];
+  static int32_t want[REF_MAX_FRAMES * 2];
+  struct AUDIO_MIX_GAIN_T gl, gr;
+  uint32_t r, i, frames;
+
+  for (r = 0; r < ref_rounds && !ref_failed; r++) {
+    frames = ref_rand() % (REF_MAX_FRAMES + 1);
+    ref_gain(&gl, 0);
+    ref_gain(&gr, 0);
+    for (i = 0; i < frames * 2; i++) {
+      buf[i] = (int16_t)ref_sample(16);
+      want[i] = ref_clamp(
+          (buf[i] * ref_factor(i & 1 ? gr.gain : gl.gain) + 8192) >> 14,
+          16);
+    }
+    audio_mix_scale_stereo_16(buf, frames, gl.gain, gr.gain);
+    for (i = 0; i < frames * 2; i++) {
+      got[i] = buf[i];
+    }
+    ref_report("scale_stereo_16", got, want, frames * 2);
+    ref_hash(buf, frames * 2 * sizeof(*buf));
+  }
+}
+
+// The legacy loops are kept out of line, as they were in the firmware,
+// where the lengths are only known at run time. Inlined in the timing loop,
+// the compiler would vectorize them on the constant length.
+#define REF_LEGACY __attribute__((noipa))
+
+// The crossfade loop of audio_prompt_sbc.cpp before audio_mix, on a stereo
+// stream, with the prompt already copied to both channels. w == 1 and
+// step == 0 gives the loop between the fades.
+static REF_LEGACY void legacy_crossfade(int32_t *dst, const int32_t *prompt,
+                             uint32_t frames, uint32_t bits, float w,
+                             float step) {
+  uint32_t i, c;
+
+  for (i = 0; i < frames; i++) {
+    float coeff0 = 1 - w + w * REF_COEFF_SOURCE;
+    float coeff1 = w * REF_COEFF_PROMPT;
+
+    for (c = 0; c < 2; c++) {
+      float tmp = coeff0 * dst[2 * i + c] + coeff1 * prompt[2 * i + c];
+      dst[2 * i + c] = ref_clamp((int32_t)tmp, bits);
+    }
+    w += step;
+  }
+}
+
+// app_ring_merge_track_2_in_1() before audio_mix
+static REF_LEGACY void legacy_ring_merge_16(int16_t *src_buf0,
+                                            int16_t *src_buf1,
+                                            int16_t *dst_buf,
+                                            uint32_t src_len) {
+  uint32_t i;
+
+  for (i = 0; i < src_len; i++) {
+    dst_buf[i] = (src_buf0[i] >> 1) + (src_buf1[i] >> 1);
+  }
+}
+
+// app_audio_lr_balance() before audio_mix
+static REF_LEGACY void legacy_lr_balance(uint8_t *buf, uint32_t len,
+                                         int8_t balance) {
+  short *balance_buf = (short *)buf;
+  uint32_t balance_len = len / 2;
+  float factor;
+
+  if (balance > 0) {
+    factor = 1 - 0.01 * balance;
+    for (uint32_t i = 0; i < balance_len; i += 2) {
+      balance_buf[i] = (short)(factor * balance_buf[i]);
+    }
+  } else if (balance < 0) {
+    factor = 1 + 0.01 * balance;
+    for (uint32_t i = 0; i < balance_len; i += 2) {
+      balance_buf[i + 1] = (short)(factor * balance_buf[i + 1]);
+    }
+  }
+}
+
+// The gains audio_prompt_set_mix_gain() computes
+static void new_crossfade_gain(struct AUDIO_MIX_GAIN_T *gx,
+                               struct AUDIO_MIX_GAIN_T *gy, float w,
+                               float step) {
+  gx->gain = audio_mix_gain_q30(1 - w + w * REF_COEFF_SOURCE);
+  gx->step = (int32_t)(-step * (1 - REF_COEFF_SOURCE) * AUDIO_MIX_GAIN_Q30_ONE);
+  gy->gain = audio_mix_gain_q30(w * REF_COEFF_PROMPT);
+  gy->step = (int32_t)(step * REF_COEFF_PROMPT * AUDIO_MIX_GAIN_Q30_ONE);
+}
+
+static int32_t ref_max_diff(const int32_t *a, const int32_t *b, uint32_t n) {
+  int32_t d, max = 0;
+  uint32_t i;
+
+  for (i = 0; i < n; i++) {
+    d = abs(a[i] - b[i]);
+    if (d > max) {
+      max = d;
+    }
+  }
+  return max;
+}
+
+static void ref_check_limit(const char *name, int32_t diff, int32_t limit) {
+  printf("%-28s max diff %6d LSB\n", name, diff);
+  if (diff > limit) {
+    printf("%s over %d LSB\n", name, limit);
+    ref_failed = 1;
+  }
+}
+
+// The error against the legacy loops, from the rounding and from the gain
+// precision: the Q14 factors give about 1 LSB at 16 bits. At 24 bits the
+// gains are Q30, and the fades differ by the drift of the float weight the
+// legacy loop steps, a few tens of LSB.
+static void ref_check_legacy(void) {
+  static int16_t mono[REF_OVERLAP];
+  static int16_t d16[REF_OVERLAP * 2];
+  static int32_t d24[REF_OVERLAP * 2];
+  static int32_t prompt[REF_OVERLAP * 2];
+  static int32_t legacy[REF_OVERLAP * 2];
+  static int32_t got[REF_OVERLAP * 2];
+  float step = 1.f / (REF_OVERLAP - 1);
+  struct AUDIO_MIX_GAIN_T gx, gy;
+  uint32_t bits, fade, i, n = REF_OVERLAP * 2;
+  int32_t diff;
+  char name[32];
+
+  for (bits = 16; bits <= 24; bits += 8) {
+    for (fade = 0; fade < 3; fade++) {
+      float w = (fade == 0) ? 0.f : 1.f;
+      float s = (fade == 0) ? step : (fade == 1) ? 0.f : -step;
+
+      for (i = 0; i < REF_OVERLAP; i++) {
+        mono[i] = (int16_t)ref_sample(16);
+        prompt[2 * i] = prompt[2 * i + 1] = mono[i] * (1 << (bits - 16));
+      }
+      for (i = 0; i < n; i++) {
+        legacy[i] = ref_sample(bits);
+        d16[i] = (int16_t)legacy[i];
+        d24[i] = legacy[i];
+      }
+      legacy_crossfade(legacy, prompt, REF_OVERLAP, bits, w, s);
+      new_crossfade_gain(&gx, &gy, w, s);
+      if (bits == 16) {
+        audio_mix_mono_16(d16, mono, REF_OVERLAP, 2, &gx, &gy);
+        for (i = 0; i < n; i++) {
+          got[i] = d16[i];
+        }
+      } else {
+        audio_mix_mono_24(d24, mono, REF_OVERLAP, 2, &gx, &gy);
+        memcpy(got, d24, sizeof(got));
+      }
+      diff = ref_max_diff(got, legacy, n);
+      snprintf(name, sizeof(name), "prompt %s %u-bit",
+               (fade == 0) ? "fade in" : (fade == 1) ? "mix" : "fade out",
+               bits);
+      ref_check_limit(name, diff, (bits == 16) ? 2 : 64);
+    }
+  }
+
+  // app_ring_merge_track_2_in_1(): (x >> 1) + (y >> 1)
+  for (bits = 16; bits <= 24; bits += 8) {
+    for (i = 0; i < REF_OVERLAP; i++) {
+      mono[i] = (int16_t)ref_sample(16);
+      d24[i] = ref_sample(bits);
+      d16[i] = (int16_t)d24[i];
+      legacy[i] = (d24[i] >> 1) + ((mono[i] * (1 << (bits - 16))) >> 1);
+    }
+    if (bits == 16) {
+      audio_mix_avg_16(d16, mono, REF_OVERLAP);
+      for (i = 0; i < REF_OVERLAP; i++) {
+        got[i] = d16[i];
+      }
+    } else {
+      audio_mix_avg_24(d24, mono, REF_OVERLAP);
+      memcpy(got, d24, REF_OVERLAP * sizeof(*got));
+    }
+    snprintf(name, sizeof(name), "ring merge %u-bit", bits);
+    ref_check_limit(name, ref_max_diff(got, legacy, REF_OVERLAP), 1);
+  }
+
+  // app_audio_lr_balance(): (short)(factor * x) on one channel
+  for (i = 0; i < n; i++) {
+    d16[i] = (int16_t)ref_sample(16);
+    got[i] = d16[i];
+  }
+  legacy_lr_balance((uint8_t *)d16, n * sizeof(*d16), 37);
+  for (i = 0; i < n; i++) {
+    legacy[i] = d16[i];
+    d16[i] = (int16_t)got[i];
+  }
+  audio_mix_scale_stereo_16(d16, REF_OVERLAP,
+                            audio_mix_gain_q30(1 - 0.01f * 37),
+                            AUDIO_MIX_GAIN_Q30_ONE);
+  for (i = 0; i < n; i++) {
+    got[i] = d16[i];
+  }
+  ref_check_limit("lr balance 37", ref_max_diff(got, legacy, n), 2);
+}
+
+#ifndef REF_DSP_MODEL
+static void ref_time(const char *name, double t_new, double t_legacy,
+                     uint32_t samples) {
+  printf("%-28s %6.2f ns/sample, legacy %6.2f ns/sample\n", name,
+         t_new * 1e9 / samples, t_legacy * 1e9 / samples);
+}
+
+// Host time of the kernels and of the loops they replace. This compares
+// the plain C builds only, it does not give Cortex-M4 cycles.
+static void ref_check_time(void) {
+  static int16_t mono[REF_TIME_FRAMES];
+  static int16_t d16[REF_TIME_FRAMES * 2];
+  static int32_t d32[REF_TIME_FRAMES * 2];
+  static int32_t prompt[REF_TIME_FRAMES * 2];
+  struct AUDIO_MIX_GAIN_T gx, gy;
+  uint32_t i, r, reps = 2000, n = REF_TIME_FRAMES * 2;
+  double t0, t_new, t_legacy;
+
+  for (i = 0; i < REF_TIME_FRAMES; i++) {
+    mono[i] = (int16_t)ref_sample(16);
+    prompt[2 * i] = prompt[2 * i + 1] = mono[i];
+  }
+  for (i = 0; i < n; i++) {
+    d16[i] = (int16_t)ref_sample(16);
+    d32[i] = d16[i];
+  }
+
+  t0 = ref_now();
+  for (r = 0; r < reps; r++) {
+    new_crossfade_gain(&gx, &gy, 0.f, 1.f / (REF_TIME_FRAMES - 1));
+    audio_mix_mono_16(d16, mono, REF_TIME_FRAMES, 2, &gx, &gy);
+  }
+  t_new = ref_now() - t0;
+  t0 = ref_now();
+  for (r = 0; r < reps; r++) {
+    legacy_crossfade(d32, prompt, REF_TIME_FRAMES, 16, 0.f,
+                     1.f / (REF_TIME_FRAMES - 1));
+  }
+  t_legacy = ref_now() - t0;
+  ref_time("prompt fade in 16-bit", t_new, t_legacy, reps * n);
+
+  t0 = ref_now();
+  for (r = 0; r < reps; r++) {
+    audio_mix_avg_16(d16, mono, REF_TIME_FRAMES);
+  }
+  t_new = ref_now() - t0;
+  t0 = ref_now();
+  for (r = 0; r < reps; r++) {
+    legacy_ring_merge_16(d16, mono, d16, REF_TIME_FRAMES);
+  }
+  t_legacy = ref_now() - t0;
+  ref_time("ring merge 16-bit", t_new, t_legacy, reps * REF_TIME_FRAMES);
+
+  t0 = ref_now();
+  for (r = 0; r < reps; r++) {
+    audio_mix_scale_stereo_16(d16, REF_TIME_FRAMES,
+                              audio_mix_gain_q30(1 - 0.01f * 37),
+                              AUDIO_MIX_GAIN_Q30_ONE);
+  }
+  t_new = ref_now() - t0;
+  t0 = ref_now();
+  for (r = 0; r < reps; r++) {
+    legacy_lr_balance((uint8_t *)d16, n * sizeof(*d16), 37);
+  }
+  t_legacy = ref_now() - t0;
+  ref_time("lr balance", t_new, t_legacy, reps * REF_TIME_FRAMES);
+}
+#endif
+
+int main(int argc, char *argv[]) {
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--rounds") && i + 1 < argc) {
+      ref_rounds = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--rounds N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  ref_check_mix(16);
+  ref_check_mix(24);
+  ref_check_avg(16);
+  ref_check_avg(24);
+  ref_check_scale();
+  printf("output hash %08x\n", ref_fnv);
+  ref_check_legacy();
+#ifndef REF_DSP_MODEL
+  ref_check_time();
+#endif
+
+  if (ref_failed) {
+    printf("FAILED\n");
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * Host shim for platform/cmsis/inc/cmsis.h.
+ *
+ * When the tool is built with __ARM_FEATURE_DSP, the DSP intrinsics the
+ * mixing kernels use are C models.
+ */
+#ifndef __CMSIS_H__
+#define __CMSIS_H__
+
+#include <stdint.h>
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+static inline int32_t shim_ssat(int32_t v, uint32_t bits) {
+  int32_t max = (1 << (bits - 1)) - 1;
+
+  if (v > max) {
+    return max;
+  } else if (v < -max - 1) {
+    return -max - 1;
+  }
+  return v;
+}
+
+#define __SSAT(v, bits) shim_ssat((v), (bits))
+
+static inline uint32_t __PKHBT(uint32_t op1, uint32_t op2, uint32_t sh) {
+  return (op1 & 0xFFFF) | ((op2 << sh) & 0xFFFF0000);
+}
+
+static inline uint32_t __PKHTB(uint32_t op1, uint32_t op2, uint32_t sh) {
+  return (op1 & 0xFFFF0000) | (((uint32_t)((int32_t)op2 >> sh)) & 0xFFFF);
+}
+
+static inline int32_t __SMLAD(uint32_t op1, uint32_t op2, int32_t acc) {
+  return (int32_t)((uint32_t)acc +
+                   (uint32_t)((int16_t)op1 * (int16_t)op2) +
+                   (uint32_t)((int16_t)(op1 >> 16) * (int16_t)(op2 >> 16)));
+}
+
+static inline int32_t __SMLADX(uint32_t op1, uint32_t op2, int32_t acc) {
+  return (int32_t)((uint32_t)acc +
+                   (uint32_t)((int16_t)op1 * (int16_t)(op2 >> 16)) +
+                   (uint32_t)((int16_t)(op1 >> 16) * (int16_t)op2));
+}
+
+static inline uint32_t __QADD16(uint32_t op1, uint32_t op2) {
+  int32_t lo = shim_ssat((int16_t)op1 + (int16_t)op2, 16);
+  int32_t hi = shim_ssat((int16_t)(op1 >> 16) + (int16_t)(op2 >> 16), 16);
+
+  return ((uint32_t)lo & 0xFFFF) | ((uint32_t)hi << 16);
+}
+
+static inline uint32_t __SHADD16(uint32_t op1, uint32_t op2) {
+  int32_t lo = ((int16_t)op1 + (int16_t)op2) >> 1;
+  int32_t hi = ((int16_t)(op1 >> 16) + (int16_t)(op2 >> 16)) >> 1;
+
+  return ((uint32_t)lo & 0xFFFF) | ((uint32_t)hi << 16);
+}
+#endif
+
+#endif
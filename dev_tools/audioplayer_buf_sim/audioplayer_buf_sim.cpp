@@ -0,0 +1,331 @@
+/*
+ * wavplay / flacplay buffer host simulation.
+ *
+ * Runs apps/audioplayers/wavplay.cpp and flacplay.cpp on pthread-backed
+ * shims, with the playback handler called from a thread as from the DMA
+ * interrupt, and random delays, some of several milliseconds, added to
+ * fread() and to the decoder as on a slow flash.
+ *
+ * - wavplay: what the handler plays must be silence or the next bytes of
+ *   the file, up to the end of the file or a stop
+ * - flacplay: tracks of numbered mono samples stored in random pieces,
+ *   every stereo frame out must be silence or the next number on both
+ *   channels, and the whole track must play out after
+ *   flac_audio_data_end()
+ *
+ *   audioplayer_buf_sim [--tracks N] [--files N] [--seed N]
+ */
+#include "audioflinger.h"
+#include "cmsis_os.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// wavplay.cpp has no header
+uint32_t play_wav_file(char *file_path);
+uint32_t stop_wav_file(void);
+uint32_t wav_file_audio_more_data(uint8_t *buf, uint32_t len);
+void wav_file_set_playeback_cb(int32_t (*cb)(int32_t));
+
+// nor does flacplay.cpp
+int flac_audio_init(void);
+int store_flac_buffer(unsigned char *buf, unsigned int len);
+uint32_t flac_audio_more_data(uint8_t *buf, uint32_t len);
+void flac_audio_data_end(void);
+uint32_t flac_audio_get_underflows(void);
+
+#define SIM_WAV_HEADER_SIZE 44
+#define SIM_WAV_DMA_SIZE 4096 // so the handler takes up to 2048 bytes
+#define SIM_FLAC_DMA_SIZE 4096
+#define SIM_WAIT_MS 10000
+
+enum sim_sink_mode {
+  SIM_SINK_FLAC,
+  SIM_SINK_WAV,
+};
+
+static uint32_t sim_errors;
+static char sim_path[] = "/tmp/audioplayer_buf_sim_XXXXXX";
+
+static void sim_error(const char *what, uint32_t at) {
+  if (sim_errors++ < 10) {
+    fprintf(stderr, "  error: %s at %u\n", what, at);
+  }
+}
+
+static uint8_t sim_file_byte(uint32_t pos) {
+  return (uint8_t)(pos * 7 + (pos >> 9) + (pos >> 17));
+}
+
+static uint32_t sim_now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+// Slow flash
+
+static __thread unsigned int sim_io_seed = 1;
+
+static void sim_io_delay(void) {
+  uint32_t r = rand_r(&sim_io_seed) % 100;
+
+  if (r < 5) {
+    usleep(1000 + rand_r(&sim_io_seed) % 2000);
+  } else {
+    usleep(rand_r(&sim_io_seed) % 20);
+  }
+}
+
+extern "C" {
+size_t __real_fread(void *ptr, size_t size, size_t nmemb, FILE *stream);
+
+size_t __wrap_fread(void *ptr, size_t size, size_t nmemb, FILE *stream) {
+  sim_io_delay();
+  return __real_fread(ptr, size, nmemb, stream);
+}
+}
+
+// Playback sink, on the DMA thread
+
+static volatile enum sim_sink_mode sim_sink_mode;
+
+static volatile uint32_t sim_flac_next;
+static volatile uint32_t sim_flac_silent;
+
+static const uint8_t *sim_wav_data;
+static uint32_t sim_wav_size;
+static volatile uint32_t sim_wav_pos;
+static volatile uint32_t sim_wav_silent;
+static volatile int sim_wav_done;
+static volatile int32_t sim_wav_status;
+
+// Samples run from 1 to 0xffff, so 0 is only ever silence
+static uint16_t sim_flac_sample(uint32_t n) { return n % 0xffff + 1; }
+
+static void sim_flac_sink(const uint8_t *buf, uint32_t len) {
+  uint16_t lr[2];
+  uint32_t i;
+
+  for (i = 0; i + 4 <= len; i += 4) {
+    memcpy(lr, buf + i, 4);
+    if (lr[0] != lr[1]) {
+      sim_error("flac channels differ", sim_flac_next);
+    } else if (lr[0] == 0) {
+      sim_flac_silent++;
+    } else if (lr[0] == sim_flac_sample(sim_flac_next)) {
+      sim_flac_next++;
+    } else {
+      sim_error("flac sample out of order", sim_flac_next);
+      sim_flac_next++;
+    }
+  }
+}
+
+static void sim_wav_sink(const uint8_t *buf, uint32_t len) {
+  uint32_t i;
+
+  for (i = 0; i < len && buf[i] == 0; i++)
+    ;
+  if (i == len) {
+    if (!sim_wav_done) {
+      sim_wav_silent++;
+    }
+  } else if (sim_wav_pos + len > sim_wav_size ||
+             memcmp(buf, sim_wav_data + sim_wav_pos, len)) {
+    sim_error("wav data differs from the file", sim_wav_pos);
+  } else {
+    sim_wav_pos += len;
+  }
+}
+
+void af_stream_host_sink(const uint8_t *buf, uint32_t len) {
+  if (sim_sink_mode == SIM_SINK_FLAC) {
+    sim_flac_sink(buf, len);
+  } else {
+    sim_wav_sink(buf, len);
+  }
+}
+
+// wavplay
+
+static int32_t sim_wav_cb(int32_t status) {
+  if (!sim_wav_done) {
+    sim_wav_status = status;
+    sim_wav_done = 1;
+  }
+  return 0;
+}
+
+static int sim_wav_file(bool stop_early) {
+  struct AF_STREAM_CONFIG_T cfg;
+  static uint8_t dma_buf[SIM_WAV_DMA_SIZE];
+  uint32_t size = 50000 + rand() % 200000;
+  uint8_t *file = (uint8_t *)malloc(SIM_WAV_HEADER_SIZE + size);
+  uint32_t total = size - SIM_WAV_HEADER_SIZE;
+  uint32_t i, start;
+  int fd;
+
+  // The data size in the header is the data chunk size, though wavplay
+  // takes it for the file size
+  memcpy(file, "RIFF", 4);
+  i = SIM_WAV_HEADER_SIZE - 8 + size;
+  memcpy(file + 4, &i, 4);
+  memcpy(file + 8, "WAVEfmt ", 8);
+  memcpy(file + 16, "\x10\0\0\0\x01\0\x02\0\x44\xac\0\0\x10\xb1\x02\0\x04\0\x10\0",
+         20);
+  memcpy(file + 36, "data", 4);
+  memcpy(file + 40, &size, 4);
+  for (i = 0; i < size; i++) {
+    file[SIM_WAV_HEADER_SIZE + i] = sim_file_byte(i) % 255 + 1;
+  }
+  fd = mkstemp(sim_path);
+  if (fd < 0 || write(fd, file, SIM_WAV_HEADER_SIZE + size) !=
+                    (ssize_t)(SIM_WAV_HEADER_SIZE + size)) {
+    perror("audioplayer_buf_sim");
+    exit(2);
+  }
+  close(fd);
+
+  sim_errors = 0;
+  sim_wav_data = file + SIM_WAV_HEADER_SIZE;
+  sim_wav_size = size;
+  sim_wav_pos = 0;
+  sim_wav_silent = 0;
+  sim_wav_done = 0;
+  sim_sink_mode = SIM_SINK_WAV;
+
+  if (play_wav_file(sim_path) != 44100) {
+    sim_error("wav header", 0);
+  }
+  wav_file_set_playeback_cb(sim_wav_cb);
+
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.handler = wav_file_audio_more_data;
+  cfg.data_ptr = dma_buf;
+  cfg.data_size = sizeof(dma_buf);
+  af_stream_open(AUD_STREAM_ID_0, AUD_STREAM_PLAYBACK, &cfg);
+  af_stream_start(AUD_STREAM_ID_0, AUD_STREAM_PLAYBACK);
+
+  start = sim_now_ms();
+  if (stop_early) {
+    usleep(rand() % 10000);
+  } else {
+    while (!sim_wav_done && sim_now_ms() - start < SIM_WAIT_MS) {
+      usleep(100);
+    }
+    if (!sim_wav_done) {
+      sim_error("wav end not reported", sim_wav_pos);
+    } else if (sim_wav_status == 0 ? sim_wav_pos < total
+                                   : size - sim_wav_pos >=
+                                         SIM_WAV_DMA_SIZE / 2) {
+      sim_error("wav ended early", sim_wav_pos);
+    }
+  }
+  af_stream_stop(AUD_STREAM_ID_0, AUD_STREAM_PLAYBACK);
+  af_stream_close(AUD_STREAM_ID_0, AUD_STREAM_PLAYBACK);
+  stop_wav_file();
+
+  printf("wavplay size=%u played=%u silent=%u %s : %s\n", size, sim_wav_pos,
+         sim_wav_silent, stop_early ? "stopped" : "to the end",
+         sim_errors ? "FAIL" : "ok");
+  unlink(sim_path);
+  strcpy(sim_path + strlen(sim_path) - 6, "XXXXXX");
+  free(file);
+  return sim_errors ? 1 : 0;
+}
+
+// flacplay
+
+static int sim_flac_track(uint32_t samples) {
+  struct AF_STREAM_CONFIG_T cfg;
+  static uint8_t dma_buf[SIM_FLAC_DMA_SIZE];
+  static uint16_t piece[1024];
+  uint32_t n = 0, len, i, start, stalls = 0;
+
+  sim_errors = 0;
+  sim_flac_next = 0;
+  sim_flac_silent = 0;
+  sim_sink_mode = SIM_SINK_FLAC;
+  flac_audio_init();
+
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.handler = flac_audio_more_data;
+  cfg.data_ptr = dma_buf;
+  cfg.data_size = sizeof(dma_buf);
+  af_stream_open(AUD_STREAM_ID_0, AUD_STREAM_PLAYBACK, &cfg);
+  af_stream_start(AUD_STREAM_ID_0, AUD_STREAM_PLAYBACK);
+
+  // The decoder stores frames of random length, and retries while the
+  // queue is full
+  while (n < samples) {
+    len = rand() % ARRAY_SIZE(piece) + 1;
+    len = MIN(len, samples - n);
+    for (i = 0; i < len; i++) {
+      piece[i] = sim_flac_sample(n + i);
+    }
+    sim_io_delay();
+    while (store_flac_buffer((unsigned char *)piece, len * 2) != 0) {
+      stalls++;
+      usleep(200);
+    }
+    n += len;
+  }
+  flac_audio_data_end();
+
+  start = sim_now_ms();
+  while (sim_flac_next < samples && sim_now_ms() - start < SIM_WAIT_MS) {
+    usleep(100);
+  }
+  af_stream_stop(AUD_STREAM_ID_0, AUD_STREAM_PLAYBACK);
+  af_stream_close(AUD_STREAM_ID_0, AUD_STREAM_PLAYBACK);
+  if (sim_flac_next != samples) {
+    sim_error("flac track did not play out", sim_flac_next);
+  }
+
+  printf("flacplay samples=%u played=%u silent=%u stalls=%u underflows=%u : "
+         "%s\n",
+         samples, sim_flac_next, sim_flac_silent, stalls,
+         flac_audio_get_underflows(), sim_errors ? "FAIL" : "ok");
+  return sim_errors ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  uint32_t tracks = 20, files = 8;
+  unsigned seed = 1;
+  int fail = 0;
+  uint32_t i;
+
+  for (i = 1; i < (uint32_t)argc; i++) {
+    if (strcmp(argv[i], "--tracks") == 0 && i + 1 < (uint32_t)argc) {
+      tracks = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--files") == 0 && i + 1 < (uint32_t)argc) {
+      files = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < (uint32_t)argc) {
+      seed = strtoul(argv[++i], NULL, 0);
+    } else {
+      fprintf(stderr, "usage: audioplayer_buf_sim [--tracks N] [--files N] "
+                      "[--seed N]\n");
+      return 2;
+    }
+  }
+  srand(seed);
+  sim_io_seed = seed;
+
+  for (i = 0; i < tracks; i++) {
+    fail |= sim_flac_track(20000 + rand() % 100000);
+  }
+  for (i = 0; i < files; i++) {
+    fail |= sim_wav_file(i % 4 == 3);
+  }
+
+  if (fail) {
+    printf("FAILED\n");
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * Host shim for services/audioflinger/audioflinger.h. A started playback
+ * stream calls its handler from a thread, like the DMA interrupt, and hands
+ * the data to af_stream_host_sink().
+ */
+#ifndef __AUDIOFLINGER_H__
+#define __AUDIOFLINGER_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum AUD_STREAM_ID_T { AUD_STREAM_ID_0 = 0 };
+enum AUD_STREAM_T { AUD_STREAM_PLAYBACK = 0 };
+enum AUD_BITS_T { AUD_BITS_16 = 16 };
+enum AUD_SAMPRATE_T { AUD_SAMPRATE_44100 = 44100 };
+enum AUD_CHANNEL_NUM_T { AUD_CHANNEL_NUM_2 = 2 };
+enum AUD_STREAM_USE_DEVICE_T { AUD_STREAM_USE_INT_CODEC = 0 };
+enum AUD_IO_PATH_T { AUD_OUTPUT_PATH_SPEAKER = 0 };
+
+typedef uint32_t (*AF_STREAM_HANDLER_T)(uint8_t *buf, uint32_t len);
+
+struct AF_STREAM_CONFIG_T {
+  enum AUD_BITS_T bits;
+  enum AUD_SAMPRATE_T sample_rate;
+  enum AUD_CHANNEL_NUM_T channel_num;
+  enum AUD_STREAM_USE_DEVICE_T device;
+  enum AUD_IO_PATH_T io_path;
+  uint8_t vol;
+  AF_STREAM_HANDLER_T handler;
+  uint8_t *data_ptr;
+  uint32_t data_size;
+};
+
+uint32_t af_stream_open(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream,
+                        const struct AF_STREAM_CONFIG_T *cfg);
+uint32_t af_stream_start(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream);
+uint32_t af_stream_stop(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream);
+uint32_t af_stream_close(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream);
+
+// Provided by the simulation, called with what the handler filled
+void af_stream_host_sink(const uint8_t *buf, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,9 @@
+/*
+ * Host shim for the CMSIS core header.
+ */
+#ifndef __CMSIS_H__
+#define __CMSIS_H__
+
+#define __DMB() __sync_synchronize()
+
+#endif
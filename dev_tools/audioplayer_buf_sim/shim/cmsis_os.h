@@ -0,0 +1,79 @@
+/*
+ * Host shim for the CMSIS-RTOS v1 API: the thread, signal, mutex and delay
+ * calls that rbplay and wavplay use, backed by pthreads in os_host.c.
+ */
+#ifndef __CMSIS_OS_H__
+#define __CMSIS_OS_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define osWaitForever 0xFFFFFFFF
+
+typedef enum {
+  osOK = 0,
+  osEventSignal = 0x08,
+  osEventTimeout = 0x40,
+  osErrorResource = 0x81,
+} osStatus;
+
+typedef enum {
+  osPriorityNormal = 0,
+  osPriorityAboveNormal = 1,
+  osPriorityHigh = 2,
+} osPriority;
+
+typedef void (*os_pthread)(void const *argument);
+
+typedef struct {
+  os_pthread pthread;
+  osPriority tpriority;
+  uint32_t instances;
+  uint32_t stacksize;
+  const char *name;
+} osThreadDef_t;
+
+typedef struct {
+  int dummy;
+} osMutexDef_t;
+
+typedef struct {
+  osStatus status;
+  union {
+    uint32_t v;
+    void *p;
+    int32_t signals;
+  } value;
+} osEvent;
+
+typedef struct os_thread_host *osThreadId;
+typedef struct os_mutex_host *osMutexId;
+
+#define osThreadDef(name, priority, instances, stacksz, task_name)            \
+  const osThreadDef_t os_thread_def_##name = {(name), (priority), (instances), \
+                                              (stacksz), (task_name)}
+#define osThread(name) &os_thread_def_##name
+
+#define osMutexDef(name) const osMutexDef_t os_mutex_def_##name = {0}
+#define osMutex(name) &os_mutex_def_##name
+
+osThreadId osThreadCreate(const osThreadDef_t *thread_def, void *argument);
+osThreadId osThreadGetId(void);
+
+int32_t osSignalSet(osThreadId thread_id, int32_t signals);
+osEvent osSignalWait(int32_t signals, uint32_t millisec);
+
+osMutexId osMutexCreate(const osMutexDef_t *mutex_def);
+osStatus osMutexWait(osMutexId mutex_id, uint32_t millisec);
+osStatus osMutexRelease(osMutexId mutex_id);
+
+osStatus osDelay(uint32_t millisec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
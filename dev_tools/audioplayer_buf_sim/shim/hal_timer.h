@@ -0,0 +1,6 @@
+/*
+ * Host shim for hal_timer.h, nothing in it is used.
+ */
+#ifndef __HAL_TIMER_H__
+#define __HAL_TIMER_H__
+#endif
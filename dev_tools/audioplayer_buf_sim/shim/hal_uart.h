@@ -0,0 +1,6 @@
+/*
+ * Host shim for hal_uart.h, nothing in it is used.
+ */
+#ifndef __HAL_UART_H__
+#define __HAL_UART_H__
+#endif
@@ -0,0 +1,187 @@
+/*
+ * pthread backing for the cmsis_os.h and audioflinger.h host shims.
+ */
+#include "audioflinger.h"
+#include "cmsis_os.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+struct os_thread_host {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int32_t signals;
+  os_pthread func;
+  void *arg;
+};
+
+struct os_mutex_host {
+  pthread_mutex_t mutex;
+};
+
+static __thread struct os_thread_host *os_self;
+
+static struct os_thread_host *os_thread_alloc(void) {
+  struct os_thread_host *t = calloc(1, sizeof(*t));
+
+  pthread_mutex_init(&t->lock, NULL);
+  pthread_cond_init(&t->cond, NULL);
+  return t;
+}
+
+static void *os_thread_main(void *arg) {
+  struct os_thread_host *t = arg;
+
+  os_self = t;
+  t->func(t->arg);
+  return NULL;
+}
+
+// The threads run until the process exits, as they do on the target
+osThreadId osThreadCreate(const osThreadDef_t *thread_def, void *argument) {
+  struct os_thread_host *t = os_thread_alloc();
+
+  t->func = thread_def->pthread;
+  t->arg = argument;
+  if (pthread_create(&t->thread, NULL, os_thread_main, t)) {
+    free(t);
+    return NULL;
+  }
+  pthread_detach(t->thread);
+  return t;
+}
+
+// Threads not made by osThreadCreate() get an id on first use
+osThreadId osThreadGetId(void) {
+  if (os_self == NULL) {
+    os_self = os_thread_alloc();
+    os_self->thread = pthread_self();
+  }
+  return os_self;
+}
+
+int32_t osSignalSet(osThreadId thread_id, int32_t signals) {
+  int32_t old;
+
+  pthread_mutex_lock(&thread_id->lock);
+  old = thread_id->signals;
+  thread_id->signals |= signals;
+  pthread_cond_broadcast(&thread_id->cond);
+  pthread_mutex_unlock(&thread_id->lock);
+  return old;
+}
+
+osEvent osSignalWait(int32_t signals, uint32_t millisec) {
+  struct os_thread_host *t = osThreadGetId();
+  struct timespec ts;
+  osEvent evt;
+  int32_t got;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  if (millisec != osWaitForever) {
+    ts.tv_sec += millisec / 1000;
+    ts.tv_nsec += (long)(millisec % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000;
+    }
+  }
+
+  pthread_mutex_lock(&t->lock);
+  while (1) {
+    got = signals ? (t->signals & signals) : t->signals;
+    if (signals ? (got == signals) : (got != 0)) {
+      break;
+    }
+    if (millisec == osWaitForever) {
+      pthread_cond_wait(&t->cond, &t->lock);
+    } else if (pthread_cond_timedwait(&t->cond, &t->lock, &ts) == ETIMEDOUT) {
+      got = 0;
+      break;
+    }
+  }
+  t->signals &= ~got;
+  pthread_mutex_unlock(&t->lock);
+
+  memset(&evt, 0, sizeof(evt));
+  evt.status = got ? osEventSignal : osEventTimeout;
+  evt.value.signals = got;
+  return evt;
+}
+
+/* RTX5 creates CMSIS v1 mutexes as recursive */
+osMutexId osMutexCreate(const osMutexDef_t *mutex_def) {
+  osMutexId mutex = calloc(1, sizeof(*mutex));
+  pthread_mutexattr_t attr;
+
+  (void)mutex_def;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&mutex->mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+  return mutex;
+}
+
+osStatus osMutexWait(osMutexId mutex_id, uint32_t millisec) {
+  (void)millisec;
+  pthread_mutex_lock(&mutex_id->mutex);
+  return osOK;
+}
+
+osStatus osMutexRelease(osMutexId mutex_id) {
+  pthread_mutex_unlock(&mutex_id->mutex);
+  return osOK;
+}
+
+osStatus osDelay(uint32_t millisec) {
+  usleep(millisec * 1000);
+  return osOK;
+}
+
+// Playback stream: random lengths up to half the DMA buffer, at about
+// 16 bytes per microsecond
+
+static struct AF_STREAM_CONFIG_T af_cfg;
+static pthread_t af_thread;
+static volatile int af_running;
+
+static void *af_dma_main(void *arg) {
+  unsigned int seed = (unsigned int)(uintptr_t)arg;
+  uint32_t len;
+
+  while (af_running) {
+    len = (rand_r(&seed) % (af_cfg.data_size / 2 / 4) + 1) * 4;
+    af_cfg.handler(af_cfg.data_ptr, len);
+    af_stream_host_sink(af_cfg.data_ptr, len);
+    usleep(len / 16);
+  }
+  return NULL;
+}
+
+uint32_t af_stream_open(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream,
+                        const struct AF_STREAM_CONFIG_T *cfg) {
+  af_cfg = *cfg;
+  return 0;
+}
+
+uint32_t af_stream_start(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream) {
+  af_running = 1;
+  pthread_create(&af_thread, NULL, af_dma_main, (void *)(uintptr_t)rand());
+  return 0;
+}
+
+uint32_t af_stream_stop(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream) {
+  if (af_running) {
+    af_running = 0;
+    pthread_join(af_thread, NULL);
+  }
+  return 0;
+}
+
+uint32_t af_stream_close(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream) {
+  return 0;
+}
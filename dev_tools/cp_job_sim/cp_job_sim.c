@@ -0,0 +1,303 @@
+/*
+ * cp_job host simulation.
+ *
+ * Runs services/cp_accel/cp_job.c with the main thread as the MCU and a
+ * second thread as the CP, and checks the protocol under a few CP
+ * behaviours: every job runs once (twice only if the CP dies in it), the
+ * callbacks come in submission order with the right result and flags, and
+ * the output buffers hold what the job computed.
+ *
+ *   cp_job_sim [--jobs N] [--seed N]
+ */
+#include "cp_job.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SIM_IN_LEN 64
+
+enum sim_cp_mode {
+  SIM_CP_FAST,  // CP well within the deadlines
+  SIM_CP_SLOW,  // CP often misses, the MCU takes jobs back
+  SIM_CP_STALL, // CP stops for a while now and then
+  SIM_CP_NONE,  // CP never opened
+  SIM_CP_CRASH, // CP dies in the middle of a job
+};
+
+static const char *const sim_cp_mode_name[] = {"fast", "slow", "stall",
+                                               "none", "crash"};
+
+struct sim_job {
+  uint32_t index;
+  uint8_t in[SIM_IN_LEN];
+  uint32_t out;
+  volatile uint32_t runs;
+  volatile int last_on_cp;
+};
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t sim_kick_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_kick_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t sim_cp_thread;
+static pthread_t sim_mcu_thread;
+static volatile int sim_kicked;
+static volatile int sim_cp_exit;
+static volatile uint32_t sim_notified;
+
+static enum sim_cp_mode sim_mode;
+static uint32_t sim_crash_at;
+static struct sim_job *sim_jobs;
+static uint32_t sim_next_done;
+static uint32_t sim_errors;
+
+// Port
+
+uint32_t cp_job_port_lock(void) {
+  pthread_mutex_lock(&sim_lock);
+  return 0;
+}
+
+void cp_job_port_unlock(uint32_t lock) { pthread_mutex_unlock(&sim_lock); }
+
+void cp_job_port_kick_cp(void) {
+  pthread_mutex_lock(&sim_kick_lock);
+  sim_kicked = 1;
+  pthread_cond_signal(&sim_kick_cond);
+  pthread_mutex_unlock(&sim_kick_lock);
+}
+
+void cp_job_port_notify_mcu(void) { cp_job_notify(); }
+
+uint32_t cp_job_port_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+void cp_job_port_relax(void) { sched_yield(); }
+
+static void sim_busy_us(uint32_t us) {
+  uint32_t start = cp_job_port_now();
+
+  while (cp_job_port_now() - start < us)
+    ;
+}
+
+static void *sim_cp_main(void *arg) {
+  int exit;
+
+  while (1) {
+    pthread_mutex_lock(&sim_kick_lock);
+    while (!sim_kicked && !sim_cp_exit) {
+      pthread_cond_wait(&sim_kick_cond, &sim_kick_lock);
+    }
+    sim_kicked = 0;
+    exit = sim_cp_exit;
+    pthread_mutex_unlock(&sim_kick_lock);
+    if (exit) {
+      break;
+    }
+    if (sim_mode == SIM_CP_STALL && (rand() % 16) == 0) {
+      usleep(3000);
+    }
+    cp_job_cp_run();
+  }
+  return NULL;
+}
+
+int cp_job_open(CP_JOB_NOTIFY_T notify) {
+  cp_job_start(notify);
+  if (sim_mode == SIM_CP_NONE) {
+    cp_job_stop();
+    return -1;
+  }
+  sim_cp_exit = 0;
+  sim_kicked = 0;
+  pthread_create(&sim_cp_thread, NULL, sim_cp_main, NULL);
+  return 0;
+}
+
+void cp_job_close(void) {
+  cp_job_stop();
+  if (sim_mode == SIM_CP_NONE) {
+    return;
+  }
+  pthread_mutex_lock(&sim_kick_lock);
+  sim_cp_exit = 1;
+  pthread_cond_signal(&sim_kick_cond);
+  pthread_mutex_unlock(&sim_kick_lock);
+  pthread_join(sim_cp_thread, NULL);
+}
+
+// Jobs
+
+static uint32_t sim_sum(const uint8_t *in, uint32_t len, uint32_t index) {
+  uint32_t sum = index * 2654435761u;
+  uint32_t i;
+
+  for (i = 0; i < len; i++) {
+    sum = sum * 31 + in[i];
+  }
+  return sum;
+}
+
+static int sim_job_func(void *ctx, const void *in, uint32_t in_len,
+                        void *out, uint32_t out_len) {
+  struct sim_job *job = (struct sim_job *)ctx;
+  int on_cp = !pthread_equal(pthread_self(), sim_mcu_thread);
+
+  __sync_fetch_and_add(&job->runs, 1);
+  job->last_on_cp = on_cp;
+  if (on_cp) {
+    if (sim_mode == SIM_CP_SLOW) {
+      sim_busy_us(300 + rand() % 600);
+    } else if (sim_mode == SIM_CP_CRASH && job->index == sim_crash_at) {
+      // Dies half way through, with out half written. The crash
+      // notification reaches the MCU asynchronously, as it does on target.
+      memset(out, 0xAA, out_len / 2);
+      cp_job_cp_lost();
+      pthread_exit(NULL);
+    } else {
+      sim_busy_us(20);
+    }
+  }
+  *(uint32_t *)out = sim_sum((const uint8_t *)in, in_len, job->index);
+  return (int)job->index;
+}
+
+static void sim_error(const char *what, uint32_t index) {
+  if (sim_errors++ < 10) {
+    fprintf(stderr, "  error: job %u: %s\n", index, what);
+  }
+}
+
+static void sim_job_done(void *ctx, int result, uint32_t flags) {
+  struct sim_job *job = (struct sim_job *)ctx;
+
+  if (job->index != sim_next_done) {
+    sim_error("callback out of order", job->index);
+  }
+  sim_next_done = job->index + 1;
+  if (result != (int)job->index) {
+    sim_error("wrong result", job->index);
+  }
+  if (job->runs != 1 &&
+      !(sim_mode == SIM_CP_CRASH && job->index == sim_crash_at &&
+        job->runs == 2)) {
+    sim_error("ran more or less than once", job->index);
+  }
+  if (!!(flags & CP_JOB_FLAG_MCU) == job->last_on_cp) {
+    sim_error("wrong core flag", job->index);
+  }
+  if (job->out != sim_sum(job->in, sizeof(job->in), job->index)) {
+    sim_error("wrong output", job->index);
+  }
+}
+
+static void sim_notify(void) { __sync_fetch_and_add(&sim_notified, 1); }
+
+static int sim_run(enum sim_cp_mode mode, uint32_t jobs) {
+  struct CP_JOB_STATS_T stats;
+  struct CP_JOB_T job;
+  uint32_t deadline_us = (mode == SIM_CP_SLOW) ? 500 : 2000;
+  uint32_t i, k;
+  int id, result;
+
+  sim_mode = mode;
+  sim_errors = 0;
+  sim_next_done = 0;
+  sim_notified = 0;
+  sim_crash_at = jobs / 2;
+  sim_jobs = calloc(jobs, sizeof(*sim_jobs));
+  for (i = 0; i < jobs; i++) {
+    sim_jobs[i].index = i;
+    for (k = 0; k < SIM_IN_LEN; k++) {
+      sim_jobs[i].in[k] = (uint8_t)rand();
+    }
+  }
+
+  cp_job_open(sim_notify);
+  for (i = 0; i < jobs; i++) {
+    job.func = sim_job_func;
+    job.done = sim_job_done;
+    job.ctx = &sim_jobs[i];
+    job.in = sim_jobs[i].in;
+    job.in_len = SIM_IN_LEN;
+    job.out = &sim_jobs[i].out;
+    job.out_len = sizeof(sim_jobs[i].out);
+    job.deadline = cp_job_port_now() + deadline_us;
+    id = cp_job_submit(&job);
+
+    switch (rand() % 4) {
+    case 0:
+      result = cp_job_wait(id);
+      if (result != (int)i) {
+        sim_error("wrong wait result", i);
+      }
+      break;
+    case 1:
+      cp_job_poll();
+      break;
+    default:
+      break;
+    }
+  }
+  cp_job_close();
+
+  if (sim_next_done != jobs) {
+    sim_error("callbacks missing", sim_next_done);
+  }
+  for (i = 0; i < jobs; i++) {
+    if (sim_jobs[i].runs == 0) {
+      sim_error("never ran", i);
+    }
+  }
+  cp_job_stats_get(&stats, true);
+  if (stats.submitted != jobs ||
+      stats.cp_done + stats.mcu_missed + stats.mcu_closed != jobs) {
+    sim_error("stats do not add up", jobs);
+  }
+
+  printf("%-6s jobs=%u cp=%u missed=%u closed=%u full=%u late=%u "
+         "notified=%u : %s\n",
+         sim_cp_mode_name[mode], stats.submitted, stats.cp_done,
+         stats.mcu_missed, stats.mcu_closed, stats.ring_full, stats.late,
+         sim_notified, sim_errors ? "FAIL" : "ok");
+  free(sim_jobs);
+  return sim_errors ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  uint32_t jobs = 20000;
+  unsigned seed = 1;
+  int fail = 0;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+      jobs = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoul(argv[++i], NULL, 0);
+    } else {
+      fprintf(stderr, "usage: cp_job_sim [--jobs N] [--seed N]\n");
+      return 2;
+    }
+  }
+  if (jobs < 2) {
+    jobs = 2;
+  }
+  srand(seed);
+  sim_mcu_thread = pthread_self();
+
+  fail |= sim_run(SIM_CP_FAST, jobs);
+  fail |= sim_run(SIM_CP_SLOW, jobs / 10);
+  fail |= sim_run(SIM_CP_STALL, jobs / 10);
+  fail |= sim_run(SIM_CP_NONE, jobs);
+  fail |= sim_run(SIM_CP_CRASH, jobs / 10);
+  return fail;
+}
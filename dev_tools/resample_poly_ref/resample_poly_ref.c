@@ -0,0 +1,464 @@
+/*
+ * Host check of the polyphase resampler
+ * (services/multimedia/audio/process/resample/poly/audio_resample_poly.c)
+ * on the resample_coef_any_* tables, and generator of those tables.
+ */
+#include "audio_resample_poly.h"
+#include "resample_coef.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define REF_CH 2
+#define REF_IN_RATE 48000
+#define REF_AMP (32767 * 0.891) // -1 dBFS
+// Ratio changes of the drift runs, as done by a2dp_clock_calib_process()
+#define REF_DRIFT_PPM 100
+#define REF_DRIFT_MAX_PPM 400
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#define REF_DSP_MODEL
+uint64_t shim_dual_mac_count;
+#endif
+
+struct ref_table {
+  const char *name;
+  const struct RESAMPLE_COEF_T *coef;
+  // Largest THD+N allowed for the tones below REF_TREBLE_HZ, and above
+  double max_thdn_db;
+  double max_thdn_treble_db;
+};
+
+// The up256 and up512 tables have a gain spread of about 0.013 dB between
+// their phases, which limits them to about -66 dB when the ratio visits few
+// phases, as for 16k to 48k. up256 lets 18 kHz images through at -44 dB.
+static const struct ref_table ref_tables[] = {
+    {"any_up128_16", &resample_coef_any_up128_16, -85, -83},
+    {"any_up256", &resample_coef_any_up256, -63, -40},
+    {"any_up64", &resample_coef_any_up64, -83, -80},
+    {"any_up512_32", &resample_coef_any_up512_32, -63, -63},
+    {"any_up512_36", &resample_coef_any_up512_36, -63, -63},
+};
+
+struct ref_case {
+  const char *name;
+  double ratio;
+};
+
+// The ratio_step values the app_bt_stream.cpp call sites open with
+static const struct ref_case ref_cases[] = {
+    {"force48k 44.1k", 44100.0 / 48000},
+    {"a2dp 48k", 24.576 / 26},
+    {"sco capture", 26 / 24.576},
+    {"prompt 16k", 16000.0 / 48000},
+};
+
+#define REF_TREBLE_HZ 10000
+static const double ref_tones[][REF_CH] = {
+    {1000, 3000},
+    {15000, 18000},
+};
+
+static uint32_t ref_seconds = 2;
+static uint32_t ref_fnv = 2166136261u;
+static int ref_failed;
+
+static uint32_t ref_rand(void) {
+  static uint32_t s = 12345;
+
+  s = s * 1103515245 + 12345;
+  return s >> 8;
+}
+
+static void ref_hash(const int16_t *p, uint32_t n) {
+  const uint8_t *b = (const uint8_t *)p;
+  uint32_t i;
+
+  for (i = 0; i < n * sizeof(*p); i++) {
+    ref_fnv = (ref_fnv ^ b[i]) * 16777619u;
+  }
+}
+
+static double ref_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Same quantization as the resampler
+static double ref_step(double ratio) {
+  return (double)(uint64_t)(ratio * 4294967296.0 + 0.5) / 4294967296.0;
+}
+
+struct ref_run {
+  const struct RESAMPLE_COEF_T *coef;
+  double ratio;
+  // Input and output frames per audio_resample_poly_run() call. A chunk of
+  // 0 is random.
+  uint32_t in_chunk;
+  uint32_t out_chunk;
+  bool drift;
+
+  const int16_t *in;
+  uint32_t in_frames;
+  int16_t *out;
+  uint32_t out_frames;
+  // Input position of each output frame
+  double *pos;
+  double secs;
+};
+
+static uint32_t ref_chunk(uint32_t chunk) {
+  return chunk ? chunk : 1 + ref_rand() % 300;
+}
+
+// Feeds the resampler the way app_playback_resample_run() does: the input
+// comes in chunks, and each call fills at most one output chunk.
+static uint32_t ref_resample(struct ref_run *r) {
+  struct RESAMPLE_CFG_T cfg;
+  struct RESAMPLE_IO_BUF_T io;
+  enum RESAMPLE_STATUS_T ret;
+  RESAMPLE_ID id;
+  uint32_t in_off = 0, in_end = 0, out_done = 0, want, n, i;
+  uint32_t in_size, out_size, calls = 0;
+  bool last = false;
+  double pos = 0, step, ratio = r->ratio, t0;
+  int ppm = 0;
+  void *buf;
+
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.chans = REF_CH;
+  cfg.bits = AUD_BITS_16;
+  cfg.ratio_step = (float)ratio;
+  cfg.coef = r->coef;
+  cfg.size = audio_resample_poly_get_buffer_size(cfg.chans, cfg.bits,
+                                                 r->coef->phase_coef_num);
+  buf = malloc(cfg.size);
+  cfg.buf = buf;
+  ret = audio_resample_poly_open(&cfg, &id);
+  if (ret != RESAMPLE_STATUS_OK) {
+    fprintf(stderr, "open failed: %d\n", ret);
+    exit(1);
+  }
+  step = ref_step(cfg.ratio_step);
+
+  t0 = ref_now();
+  while (out_done < r->out_frames) {
+    if (r->drift && ++calls % 8 == 0) {
+      // Random walk, as the calibration moves by fixed ppm steps
+      ppm += (ref_rand() & 1) ? REF_DRIFT_PPM : -REF_DRIFT_PPM;
+      if (ppm > REF_DRIFT_MAX_PPM || ppm < -REF_DRIFT_MAX_PPM) {
+        ppm = 0;
+      }
+      ratio = r->ratio * (1 + ppm * 1e-6);
+      audio_resample_poly_set_ratio_step(id, (float)ratio);
+      step = ref_step((float)ratio);
+    }
+
+    want = ref_chunk(r->out_chunk);
+    if (want > r->out_frames - out_done) {
+      want = r->out_frames - out_done;
+    }
+    while (want) {
+      if (in_off == in_end) {
+        if (in_end == r->in_frames) {
+          // Whatever the history still gives
+          if (last) {
+            goto _done;
+          }
+          last = true;
+        }
+        n = ref_chunk(r->in_chunk);
+        in_end = in_off + n < r->in_frames ? in_off + n : r->in_frames;
+      }
+      io.in = r->in + in_off * REF_CH;
+      io.in_size = (in_end - in_off) * REF_CH * sizeof(int16_t);
+      io.out = r->out + out_done * REF_CH;
+      io.out_size = want * REF_CH * sizeof(int16_t);
+      io.out_cyclic_start = NULL;
+      io.out_cyclic_end = NULL;
+      ret = audio_resample_poly_run(id, &io, &in_size, &out_size);
+      if (ret != RESAMPLE_STATUS_OUT_FULL &&
+          ret != RESAMPLE_STATUS_IN_EMPTY) {
+        fprintf(stderr, "run failed: %d\n", ret);
+        exit(1);
+      }
+      in_off += in_size / (REF_CH * sizeof(int16_t));
+      n = out_size / (REF_CH * sizeof(int16_t));
+      for (i = 0; i < n; i++) {
+        r->pos[out_done + i] = pos;
+        pos += step;
+      }
+      out_done += n;
+      want -= n;
+    }
+  }
+_done:
+  r->secs = ref_now() - t0;
+
+  audio_resample_poly_close(id);
+  free(buf);
+  return out_done;
+}
+
+// Least squares fit of a tone at the known input positions, plus DC. Returns
+// the THD+N in dB, i.e. the residual power against the tone power, and the
+// gain of the tone in dB.
+static double ref_thdn(const int16_t *out, const double *pos, uint32_t from,
+                       uint32_t to, uint32_t ch, double freq, double *gain) {
+  double m[3][4] = {{0}};
+  double v[3], x[3], y, e, sig = 0, res = 0, f;
+  uint32_t n, i, j, k;
+
+  for (n = from; n < to; n++) {
+    v[0] = sin(2 * M_PI * freq * pos[n] / REF_IN_RATE);
+    v[1] = cos(2 * M_PI * freq * pos[n] / REF_IN_RATE);
+    v[2] = 1;
+    y = out[n * REF_CH + ch];
+    for (i = 0; i < 3; i++) {
+      for (j = 0; j < 3; j++) {
+        m[i][j] += v[i] * v[j];
+      }
+      m[i][3] += v[i] * y;
+    }
+  }
+  // Gauss-Jordan, the matrix is well conditioned
+  for (i = 0; i < 3; i++) {
+    for (k = 0; k < 3; k++) {
+      if (k != i) {
+        f = m[k][i] / m[i][i];
+        for (j = 0; j < 4; j++) {
+          m[k][j] -= f * m[i][j];
+        }
+      }
+    }
+  }
+  for (i = 0; i < 3; i++) {
+    x[i] = m[i][3] / m[i][i];
+  }
+
+  for (n = from; n < to; n++) {
+    y = x[0] * sin(2 * M_PI * freq * pos[n] / REF_IN_RATE) +
+        x[1] * cos(2 * M_PI * freq * pos[n] / REF_IN_RATE);
+    e = out[n * REF_CH + ch] - y - x[2];
+    sig += y * y;
+    res += e * e;
+  }
+  *gain = 20 * log10(sqrt(x[0] * x[0] + x[1] * x[1]) / REF_AMP);
+  return 10 * log10(res / sig);
+}
+
+static void ref_gen_input(int16_t *in, uint32_t frames, const double *tone) {
+  uint32_t n, ch;
+
+  for (n = 0; n < frames; n++) {
+    for (ch = 0; ch < REF_CH; ch++) {
+      in[n * REF_CH + ch] =
+          (int16_t)lrint(REF_AMP * sin(2 * M_PI * tone[ch] * n / REF_IN_RATE));
+    }
+  }
+}
+
+// Spread of the DC gain between the phases, in dB
+static double ref_row_spread(const struct RESAMPLE_COEF_T *c) {
+  int32_t sum, min = INT32_MAX, max = INT32_MIN;
+  uint32_t k, j;
+
+  for (k = 0; k < c->upsample_factor; k++) {
+    sum = 0;
+    for (j = 0; j < c->phase_coef_num; j++) {
+      sum += c->coef_group[k * c->phase_coef_num + j];
+    }
+    min = sum < min ? sum : min;
+    max = sum > max ? sum : max;
+  }
+  return 20 * log10((double)max / min);
+}
+
+static void ref_run_table(const struct ref_table *t) {
+  const struct RESAMPLE_COEF_T *c = t->coef;
+  uint32_t in_frames = ref_seconds * REF_IN_RATE;
+  uint32_t out_cap, got, got2, settle, tone, i, ch;
+  struct ref_run r, r2;
+  int16_t *in, *out2;
+  double thdn, worst, worst_treble, limit, ns, gain, gain_15k;
+  uint64_t macs = 0;
+  int drift;
+
+  printf("%s: %u taps, %u phases, gain spread %.4f dB\n", t->name,
+         c->phase_coef_num, c->upsample_factor, ref_row_spread(c));
+
+  in = malloc(in_frames * REF_CH * sizeof(int16_t));
+  out_cap = (uint32_t)(in_frames / (16000.0 / 48000)) + 16;
+
+  for (i = 0; i < sizeof(ref_cases) / sizeof(ref_cases[0]); i++) {
+    for (drift = 0; drift < 2; drift++) {
+      worst = -1000;
+      worst_treble = -1000;
+      gain_15k = 0;
+      ns = 0;
+      for (tone = 0; tone < sizeof(ref_tones) / sizeof(ref_tones[0]);
+           tone++) {
+        ref_gen_input(in, in_frames, ref_tones[tone]);
+
+        memset(&r, 0, sizeof(r));
+        r.coef = c;
+        r.ratio = ref_cases[i].ratio;
+        r.in_chunk = 256;
+        r.out_chunk = 256;
+        r.drift = drift;
+        r.in = in;
+        r.in_frames = in_frames;
+        r.out_frames = out_cap;
+        r.out = malloc(out_cap * REF_CH * sizeof(int16_t));
+        r.pos = malloc(out_cap * sizeof(double));
+#ifdef REF_DSP_MODEL
+        shim_dual_mac_count = 0;
+#endif
+        got = ref_resample(&r);
+#ifdef REF_DSP_MODEL
+        macs = shim_dual_mac_count;
+#endif
+        ns = r.secs * 1e9 / (got * REF_CH);
+        ref_hash(r.out, got * REF_CH);
+
+        // Skip the start-up and the end of the input
+        settle = (uint32_t)(4 * c->phase_coef_num / r.ratio) + 64;
+        for (ch = 0; ch < REF_CH; ch++) {
+          thdn = ref_thdn(r.out, r.pos, settle, got - settle, ch,
+                          ref_tones[tone][ch], &gain);
+          if (ref_tones[tone][ch] == 15000) {
+            gain_15k = gain;
+          }
+          limit = ref_tones[tone][ch] < REF_TREBLE_HZ ? t->max_thdn_db
+                                                      : t->max_thdn_treble_db;
+          if (ref_tones[tone][ch] * r.ratio >= 0.5 * REF_IN_RATE * 0.92) {
+            // The tone is too close to the output Nyquist frequency
+            continue;
+          }
+          if (thdn > limit) {
+            printf("  FAIL %.0f Hz: THD+N %.1f dB > %.1f dB\n",
+                   ref_tones[tone][ch], thdn, limit);
+            ref_failed = 1;
+          }
+          if (ref_tones[tone][ch] < REF_TREBLE_HZ) {
+            worst = thdn > worst ? thdn : worst;
+          } else {
+            worst_treble = thdn > worst_treble ? thdn : worst_treble;
+          }
+        }
+
+        if (!drift && tone == 0) {
+          // Any split of the input and output gives the same output
+          r2 = r;
+          r2.in_chunk = 0;
+          r2.out_chunk = 0;
+          r2.out = malloc(out_cap * REF_CH * sizeof(int16_t));
+          got2 = ref_resample(&r2);
+          if (got2 != got ||
+              memcmp(r.out, r2.out, got * REF_CH * sizeof(int16_t))) {
+            printf("  FAIL: output depends on the chunk sizes\n");
+            ref_failed = 1;
+          }
+          free(r2.out);
+          r2.out = NULL;
+        }
+        free(r.out);
+        free(r.pos);
+      }
+
+      printf("%-13s %-15s %-5s THD+N %6.1f dB, treble %6.1f dB, 15 kHz "
+             "%+5.2f dB",
+             t->name, ref_cases[i].name, drift ? "drift" : "", worst,
+             worst_treble, gain_15k);
+#ifdef REF_DSP_MODEL
+      printf("  %5.1f dual MACs/sample\n", (double)macs / (got * REF_CH));
+#else
+      printf("  %5.1f ns/sample\n", ns);
+#endif
+    }
+  }
+
+  free(in);
+}
+
+// Kaiser windowed sinc, cut off at cutoff times the input Nyquist
+// frequency. Row k, tap j is the response at j - (taps / 2 - 1) - (k + 0.5)
+// / phases input frames, with the taps of a row in time order, as in the
+// other any_* tables. The window is centred on the whole prototype, so that
+// row k mirrors row phases - 1 - k.
+static double ref_bessel_i0(double x) {
+  double s = 1, t = 1;
+  int k;
+
+  for (k = 1; k < 50; k++) {
+    t *= (x / (2 * k)) * (x / (2 * k));
+    s += t;
+  }
+  return s;
+}
+
+static void ref_gen_coef(uint32_t taps, uint32_t phases, double beta,
+                         double cutoff) {
+  double h, t, w, sum;
+  uint32_t k, j;
+  int v;
+
+  printf("//single phase coef Number:=%u,    upsample factor:=%u,\n", taps,
+         phases);
+  for (k = 0; k < phases; k++) {
+    double row[64];
+
+    sum = 0;
+    for (j = 0; j < taps; j++) {
+      t = (double)j - (taps / 2 - 1) - (k + 0.5) / phases;
+      h = t == 0 ? 1 : sin(M_PI * cutoff * t) / (M_PI * cutoff * t);
+      w = 2 * t / taps;
+      w = w * w < 1 ? ref_bessel_i0(beta * sqrt(1 - w * w)) / ref_bessel_i0(beta)
+                    : 0;
+      row[j] = h * w;
+      sum += row[j];
+    }
+    for (j = 0; j < taps; j++) {
+      // Unity gain at DC
+      v = (int)lrint(row[j] / sum * 32767);
+      printf("%5d,", v);
+    }
+    printf("\n");
+  }
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t i;
+
+  for (i = 1; i < (uint32_t)argc; i++) {
+    if (!strcmp(argv[i], "--seconds") && i + 1 < (uint32_t)argc) {
+      ref_seconds = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--gen-coef") && i + 4 < (uint32_t)argc) {
+      ref_gen_coef(atoi(argv[i + 1]), atoi(argv[i + 2]), atof(argv[i + 3]),
+                   atof(argv[i + 4]));
+      return 0;
+    } else {
+      fprintf(stderr,
+              "usage: %s [--seconds N] | --gen-coef TAPS PHASES BETA CUTOFF\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  for (i = 0; i < sizeof(ref_tables) / sizeof(ref_tables[0]); i++) {
+    ref_run_table(&ref_tables[i]);
+  }
+  printf("output hash %08x\n", ref_fnv);
+
+  if (ref_failed) {
+    printf("FAILED\n");
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * Host shim for platform/cmsis/inc/cmsis.h. The tool is single threaded.
+ *
+ * When the tool is built with __ARM_FEATURE_DSP, the DSP intrinsics the
+ * resampler uses are C models, and the dual MACs are counted.
+ */
+#ifndef __CMSIS_H__
+#define __CMSIS_H__
+
+#include <stdint.h>
+
+static inline uint32_t int_lock(void) { return 0; }
+static inline void int_unlock(uint32_t pri) { (void)pri; }
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+extern uint64_t shim_dual_mac_count;
+
+static inline int64_t __SMLALD(uint32_t op1, uint32_t op2, int64_t acc) {
+  shim_dual_mac_count++;
+  return acc + (int64_t)(int16_t)op1 * (int16_t)op2 +
+         (int64_t)(int16_t)(op1 >> 16) * (int16_t)(op2 >> 16);
+}
+
+static inline int32_t shim_ssat(int32_t v, uint32_t bits) {
+  int32_t max = (1 << (bits - 1)) - 1;
+
+  if (v > max) {
+    return max;
+  } else if (v < -max - 1) {
+    return -max - 1;
+  }
+  return v;
+}
+
+#define __SSAT(v, bits) shim_ssat((v), (bits))
+#endif
+
+#endif
@@ -0,0 +1,10 @@
+/*
+ * Host shim for platform/hal/hal_location.h.
+ */
+#ifndef __HAL_LOCATION_H__
+#define __HAL_LOCATION_H__
+
+#define SRAM_TEXT_LOC
+#define FLASH_RODATA_DEF(n) n
+
+#endif
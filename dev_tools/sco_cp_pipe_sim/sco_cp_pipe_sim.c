@@ -0,0 +1,280 @@
+/*
+ * SCO RX pipeline host simulation.
+ *
+ * Runs the SCO_CP_PIPELINE part of apps/audioplayers/bt_sco_chain_cp.c on
+ * services/cp_accel/cp_job.c, with the main thread as the MCU and a second
+ * thread as the CP. A stateful stand-in for _speech_rx_process_() makes
+ * the output depend on every frame before it, so the pipeline output must
+ * be the serial chain shifted by one frame, whichever core ran each frame.
+ * The stand-in also checks that it never runs on both cores at once, and
+ * not after sco_cp_rx_pipe_deinit() has returned.
+ *
+ *   sco_cp_pipe_sim [--frames N] [--seed N]
+ */
+#include "bt_sco_chain_cp.h"
+#include "cp_job.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SIM_SAMPLE_RATE 16000
+#define SIM_FRAME_LEN 16 // 1 ms, so the deadline is 500 us
+
+enum sim_cp_mode {
+  SIM_CP_FAST,  // CP well within the deadlines
+  SIM_CP_SLOW,  // CP often runs past the deadline of the frame
+  SIM_CP_STALL, // CP stops for a while now and then, the MCU takes over
+  SIM_CP_NONE,  // CP never opened
+};
+
+static const char *const sim_cp_mode_name[] = {"fast", "slow", "stall",
+                                               "none"};
+
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t sim_kick_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_kick_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t sim_cp_thread;
+static pthread_t sim_mcu_thread;
+static volatile int sim_kicked;
+static volatile int sim_cp_exit;
+
+static enum sim_cp_mode sim_mode;
+static uint32_t sim_errors;
+
+// RX state of the stand-in handler
+static uint32_t sim_rx_state;
+static volatile int sim_rx_busy;
+static volatile int sim_rx_gone;
+static volatile uint32_t sim_rx_runs;
+static volatile uint32_t sim_rx_cp_runs;
+
+// Port
+
+uint32_t cp_job_port_lock(void) {
+  pthread_mutex_lock(&sim_lock);
+  return 0;
+}
+
+void cp_job_port_unlock(uint32_t lock) { pthread_mutex_unlock(&sim_lock); }
+
+void cp_job_port_kick_cp(void) {
+  pthread_mutex_lock(&sim_kick_lock);
+  sim_kicked = 1;
+  pthread_cond_signal(&sim_kick_cond);
+  pthread_mutex_unlock(&sim_kick_lock);
+}
+
+void cp_job_port_notify_mcu(void) { cp_job_notify(); }
+
+uint32_t cp_job_port_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+void cp_job_port_relax(void) { sched_yield(); }
+
+static void sim_busy_us(uint32_t us) {
+  uint32_t start = cp_job_port_now();
+
+  while (cp_job_port_now() - start < us)
+    ;
+}
+
+static void *sim_cp_main(void *arg) {
+  int exit;
+
+  while (1) {
+    pthread_mutex_lock(&sim_kick_lock);
+    while (!sim_kicked && !sim_cp_exit) {
+      pthread_cond_wait(&sim_kick_cond, &sim_kick_lock);
+    }
+    sim_kicked = 0;
+    exit = sim_cp_exit;
+    pthread_mutex_unlock(&sim_kick_lock);
+    if (exit) {
+      break;
+    }
+    if (sim_mode == SIM_CP_STALL && (rand() % 8) == 0) {
+      usleep(1000);
+    }
+    cp_job_cp_run();
+  }
+  return NULL;
+}
+
+int cp_job_open(CP_JOB_NOTIFY_T notify) {
+  cp_job_start(notify);
+  if (sim_mode == SIM_CP_NONE) {
+    cp_job_stop();
+    return -1;
+  }
+  sim_cp_exit = 0;
+  sim_kicked = 0;
+  pthread_create(&sim_cp_thread, NULL, sim_cp_main, NULL);
+  return 0;
+}
+
+void cp_job_close(void) {
+  cp_job_stop();
+  if (sim_mode == SIM_CP_NONE) {
+    return;
+  }
+  pthread_mutex_lock(&sim_kick_lock);
+  sim_cp_exit = 1;
+  pthread_cond_signal(&sim_kick_cond);
+  pthread_mutex_unlock(&sim_kick_lock);
+  pthread_join(sim_cp_thread, NULL);
+}
+
+// RX chain
+
+static void sim_error(const char *what, uint32_t frame) {
+  if (sim_errors++ < 10) {
+    fprintf(stderr, "  error: frame %u: %s\n", frame, what);
+  }
+}
+
+// Each output byte depends on all the bytes before it
+static void sim_rx_apply(uint32_t *state, uint8_t *buf, uint32_t bytes) {
+  uint32_t s = *state;
+  uint32_t i;
+
+  for (i = 0; i < bytes; i++) {
+    s = s * 1664525 + buf[i] + 1013904223;
+    buf[i] ^= (uint8_t)(s >> 24);
+  }
+  *state = s;
+}
+
+static int sim_sample_size;
+
+static int32_t sim_rx_handler(void *pcm_buf, int32_t *pcm_len) {
+  int on_cp = !pthread_equal(pthread_self(), sim_mcu_thread);
+
+  if (__sync_lock_test_and_set(&sim_rx_busy, 1)) {
+    sim_error("RX ran on both cores at once", sim_rx_runs);
+  }
+  if (sim_rx_gone) {
+    sim_error("RX ran after deinit", sim_rx_runs);
+  }
+  if (on_cp) {
+    sim_rx_cp_runs++;
+  }
+  // The chain takes as long on either core, except on a slow CP
+  if (on_cp && sim_mode == SIM_CP_SLOW) {
+    sim_busy_us(300 + rand() % 600);
+  } else {
+    sim_busy_us(50);
+  }
+  sim_rx_apply(&sim_rx_state, (uint8_t *)pcm_buf,
+               *pcm_len * sim_sample_size);
+  sim_rx_runs++;
+  __sync_lock_release(&sim_rx_busy);
+  return 0;
+}
+
+static int sim_run(enum sim_cp_mode mode, int sample_size, uint32_t frames) {
+  uint32_t frame_bytes = SIM_FRAME_LEN * sample_size;
+  uint8_t *in, *ref;
+  uint8_t buf[SIM_FRAME_LEN * sizeof(int32_t)];
+  uint32_t ref_state = 0;
+  uint32_t i, k;
+  int32_t len;
+  int open;
+
+  sim_mode = mode;
+  sim_errors = 0;
+  sim_sample_size = sample_size;
+  sim_rx_state = 0;
+  sim_rx_gone = 0;
+  sim_rx_runs = 0;
+  sim_rx_cp_runs = 0;
+
+  // The serial chain
+  in = malloc(frames * frame_bytes);
+  ref = malloc(frames * frame_bytes);
+  for (i = 0; i < frames * frame_bytes; i++) {
+    in[i] = (uint8_t)rand();
+  }
+  memcpy(ref, in, frames * frame_bytes);
+  for (i = 0; i < frames; i++) {
+    sim_rx_apply(&ref_state, ref + i * frame_bytes, frame_bytes);
+  }
+
+  open = sco_cp_rx_pipe_init(SIM_SAMPLE_RATE, SIM_FRAME_LEN, sample_size,
+                             sim_rx_handler);
+  if ((open == 0) != (mode != SIM_CP_NONE)) {
+    sim_error("wrong init result", 0);
+  }
+  for (i = 0; i < frames; i++) {
+    memcpy(buf, in + i * frame_bytes, frame_bytes);
+    len = SIM_FRAME_LEN;
+    sco_cp_rx_pipe_process(buf, &len);
+
+    if (len != SIM_FRAME_LEN) {
+      sim_error("wrong length", i);
+    } else if (i == 0) {
+      for (k = 0; k < frame_bytes && buf[k] == 0; k++)
+        ;
+      if (k != frame_bytes) {
+        sim_error("first frame not silent", i);
+      }
+    } else if (memcmp(buf, ref + (i - 1) * frame_bytes, frame_bytes)) {
+      sim_error("output differs from the serial chain", i);
+    }
+
+    // TX on the MCU
+    sim_busy_us(rand() % 300);
+  }
+  sco_cp_rx_pipe_deinit();
+  // The RX state goes away here in speech_deinit()
+  sim_rx_gone = 1;
+
+  if (sim_rx_runs != frames) {
+    sim_error("RX did not run once per frame", sim_rx_runs);
+  }
+
+  printf("%-5s sample_size=%d frames=%u cp=%u mcu=%u : %s\n",
+         sim_cp_mode_name[mode], sample_size, frames, sim_rx_cp_runs,
+         sim_rx_runs - sim_rx_cp_runs, sim_errors ? "FAIL" : "ok");
+  free(in);
+  free(ref);
+  return sim_errors ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  uint32_t frames = 4000;
+  unsigned seed = 1;
+  int fail = 0;
+  int i, size;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoul(argv[++i], NULL, 0);
+    } else {
+      fprintf(stderr, "usage: sco_cp_pipe_sim [--frames N] [--seed N]\n");
+      return 2;
+    }
+  }
+  if (frames < 2) {
+    frames = 2;
+  }
+  srand(seed);
+  sim_mcu_thread = pthread_self();
+
+  for (size = 2; size <= 4; size += 2) {
+    fail |= sim_run(SIM_CP_FAST, size, frames);
+    fail |= sim_run(SIM_CP_SLOW, size, frames / 4);
+    fail |= sim_run(SIM_CP_STALL, size, frames / 4);
+    fail |= sim_run(SIM_CP_NONE, size, frames);
+  }
+  return fail;
+}
@@ -0,0 +1,11 @@
+/*
+ * Host shim for platform/hal/hal_location.h.
+ */
+#ifndef __HAL_LOCATION_H__
+#define __HAL_LOCATION_H__
+
+#define CP_TEXT_SRAM_LOC
+#define CP_DATA_LOC
+#define CP_BSS_LOC
+
+#endif
@@ -0,0 +1,9 @@
+/*
+ * Host shim for platform/hal/hal_timer.h. The port counts in microseconds.
+ */
+#ifndef __HAL_TIMER_H__
+#define __HAL_TIMER_H__
+
+#define US_TO_FAST_TICKS(us) (us)
+
+#endif
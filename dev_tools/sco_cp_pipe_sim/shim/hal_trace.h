@@ -0,0 +1,21 @@
+/*
+ * Host shim for platform/hal/hal_trace.h.
+ */
+#ifndef __HAL_TRACE_H__
+#define __HAL_TRACE_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TRACE(n, ...) ((void)0)
+
+#define ASSERT(c, ...)                                                         \
+  do {                                                                         \
+    if (!(c)) {                                                                \
+      fprintf(stderr, __VA_ARGS__);                                            \
+      fprintf(stderr, "\n");                                                   \
+      abort();                                                                 \
+    }                                                                          \
+  } while (0)
+
+#endif
@@ -0,0 +1,10 @@
+/*
+ * Host shim for platform/cmsis/inc/cmsis.h. __DMB() is a full fence, which
+ * is at least as strong as the Cortex-M barrier.
+ */
+#ifndef __CMSIS_H__
+#define __CMSIS_H__
+
+#define __DMB() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#endif
@@ -0,0 +1,254 @@
+/*
+ * spsc_cqueue host stress test.
+ *
+ * Runs utils/cqueue/spsc_cqueue.c with one producer and one consumer
+ * thread. The producer pushes a numbered byte stream in random sizes; the
+ * consumer takes it back with random-size Peek/Dequeue/Pull calls and
+ * checks every byte. Each queue size also runs with the read and write
+ * indexes started just below UINT_MAX, so that they wrap during the run.
+ *
+ *   spsc_cqueue_stress [--bytes N] [--seed N]
+ */
+#include "spsc_cqueue.h"
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct stress_run {
+  SpscCQueue q;
+  unsigned int bytes;
+  unsigned int seed;
+  unsigned int errors;
+  unsigned int peeks;
+  unsigned int wrapped_peeks;
+  unsigned int full;
+  unsigned int empty;
+};
+
+static unsigned int stress_bytes = 4000000;
+static unsigned int stress_seed = 1;
+
+// Byte at position pos of the stream
+static uint8_t stress_byte(unsigned int pos) {
+  return (uint8_t)(pos * 7 + (pos >> 9) + (pos >> 17));
+}
+
+static void stress_error(struct stress_run *r, const char *what,
+                         unsigned int pos) {
+  if (r->errors++ < 10) {
+    fprintf(stderr, "size %u: %s at byte %u\n", r->q.size, what, pos);
+  }
+}
+
+static void *stress_producer(void *arg) {
+  struct stress_run *r = (struct stress_run *)arg;
+  unsigned int seed = r->seed * 2 + 1;
+  uint8_t buf[4096];
+  unsigned int pos = 0, len, i;
+
+  while (pos < r->bytes) {
+    len = rand_r(&seed) % r->q.size + 1;
+    if (len > r->bytes - pos) {
+      len = r->bytes - pos;
+    }
+    for (i = 0; i < len; i++) {
+      buf[i] = stress_byte(pos + i);
+    }
+    while (EnSpscCQueue(&r->q, buf, len) != CQ_OK) {
+      r->full++;
+      sched_yield();
+    }
+    pos += len;
+  }
+  return NULL;
+}
+
+static void stress_check(struct stress_run *r, const uint8_t *p,
+                         unsigned int len, unsigned int pos) {
+  unsigned int i;
+
+  for (i = 0; i < len; i++) {
+    if (p[i] != stress_byte(pos + i)) {
+      stress_error(r, "bad byte", pos + i);
+      return;
+    }
+  }
+}
+
+static void *stress_consumer(void *arg) {
+  struct stress_run *r = (struct stress_run *)arg;
+  unsigned int seed = r->seed * 2 + 2;
+  uint8_t buf[4096];
+  CQItemType *e1, *e2;
+  unsigned int len1, len2;
+  unsigned int pos = 0, len, filled;
+  int ret;
+
+  while (pos < r->bytes) {
+    len = rand_r(&seed) % r->q.size + 1;
+    if (len > r->bytes - pos) {
+      len = r->bytes - pos;
+    }
+    filled = LengthOfSpscCQueue(&r->q);
+    if (filled > r->q.size) {
+      stress_error(r, "length over size", pos);
+    }
+
+    switch (rand_r(&seed) % 3) {
+    case 0:
+      ret = DeSpscCQueue(&r->q, buf, len);
+      if (ret == CQ_OK) {
+        stress_check(r, buf, len, pos);
+      }
+      break;
+    case 1:
+      ret = PullSpscCQueue(&r->q, buf, len);
+      if (ret == CQ_OK) {
+        stress_check(r, buf, len, pos);
+      }
+      break;
+    default:
+      ret = PeekSpscCQueue(&r->q, len, &e1, &len1, &e2, &len2);
+      if (ret == CQ_OK) {
+        r->peeks++;
+        if ((len1 + len2 != len) || (e1 < r->q.base) ||
+            (e1 + len1 > r->q.base + r->q.size) ||
+            (len2 && (e2 != r->q.base)) || (!len2 && e2)) {
+          stress_error(r, "bad peek segments", pos);
+        } else {
+          if (len2) {
+            r->wrapped_peeks++;
+          }
+          stress_check(r, e1, len1, pos);
+          stress_check(r, e2, len2, pos + len1);
+        }
+        ret = DeSpscCQueue(&r->q, NULL, len);
+        if (ret != CQ_OK) {
+          stress_error(r, "dequeue after peek failed", pos);
+        }
+      }
+      break;
+    }
+
+    if (ret == CQ_OK) {
+      pos += len;
+    } else {
+      // Only fails when there was less than len
+      if (filled >= len && LengthOfSpscCQueue(&r->q) >= len) {
+        stress_error(r, "failed with enough data", pos);
+      }
+      r->empty++;
+      sched_yield();
+    }
+  }
+  if (LengthOfSpscCQueue(&r->q) != 0) {
+    stress_error(r, "not empty at the end", pos);
+  }
+  return NULL;
+}
+
+// Single threaded edge cases: size rounding, full and empty, split peek
+static unsigned int stress_edges(void) {
+  static uint8_t buf[1000];
+  uint8_t in[64], out[64];
+  SpscCQueue q;
+  CQItemType *e1, *e2;
+  unsigned int len1, len2, i, errors = 0;
+
+#define STRESS_EXPECT(c)                                                       \
+  do {                                                                         \
+    if (!(c)) {                                                                \
+      fprintf(stderr, "edge case failed: %s\n", #c);                           \
+      errors++;                                                                \
+    }                                                                          \
+  } while (0)
+
+  STRESS_EXPECT(InitSpscCQueue(&q, 0, buf) == CQ_ERR);
+  STRESS_EXPECT(InitSpscCQueue(&q, 1000, buf) == CQ_OK);
+  STRESS_EXPECT(q.size == 512);
+  STRESS_EXPECT(AvailableOfSpscCQueue(&q) == 512);
+
+  for (i = 0; i < sizeof(in); i++) {
+    in[i] = (uint8_t)(i + 1);
+  }
+
+  // 4 bytes before the end of the buffer and of the index range
+  q.read = q.write = UINT_MAX - 3;
+  STRESS_EXPECT(EnSpscCQueue(&q, in, 8) == CQ_OK);
+  STRESS_EXPECT(LengthOfSpscCQueue(&q) == 8);
+  STRESS_EXPECT(PeekSpscCQueue(&q, 8, &e1, &len1, &e2, &len2) == CQ_OK);
+  STRESS_EXPECT(len1 == 4 && len2 == 4 && e1 == buf + 508 && e2 == buf);
+  STRESS_EXPECT(PeekSpscCQueue(&q, 9, &e1, &len1, &e2, &len2) == CQ_ERR);
+
+  STRESS_EXPECT(EnSpscCQueue(&q, buf, 512 - 8) == CQ_OK);
+  STRESS_EXPECT(AvailableOfSpscCQueue(&q) == 0);
+  STRESS_EXPECT(EnSpscCQueue(&q, in, 1) == CQ_ERR);
+
+  STRESS_EXPECT(PullSpscCQueue(&q, out, 8) == CQ_OK);
+  STRESS_EXPECT(memcmp(in, out, 8) == 0);
+  STRESS_EXPECT(DeSpscCQueue(&q, NULL, 512 - 8) == CQ_OK);
+  STRESS_EXPECT(LengthOfSpscCQueue(&q) == 0);
+  STRESS_EXPECT(DeSpscCQueue(&q, out, 1) == CQ_ERR);
+
+  ResetSpscCQueue(&q);
+  STRESS_EXPECT(q.read == 0 && q.write == 0);
+
+#undef STRESS_EXPECT
+  return errors;
+}
+
+static unsigned int stress_run(unsigned int size, unsigned int start) {
+  static uint8_t buf[4096];
+  struct stress_run r;
+  pthread_t producer, consumer;
+
+  memset(&r, 0, sizeof(r));
+  r.bytes = stress_bytes;
+  r.seed = stress_seed + size + start;
+  InitSpscCQueue(&r.q, size, buf);
+  r.q.read = r.q.write = start;
+
+  pthread_create(&consumer, NULL, stress_consumer, &r);
+  pthread_create(&producer, NULL, stress_producer, &r);
+  pthread_join(producer, NULL);
+  pthread_join(consumer, NULL);
+
+  printf("size %4u start %08x: %u bytes, %u peeks (%u split), "
+         "%u full, %u empty, %u errors\n",
+         r.q.size, start, r.bytes, r.peeks, r.wrapped_peeks, r.full, r.empty,
+         r.errors);
+  return r.errors;
+}
+
+int main(int argc, char *argv[]) {
+  static const unsigned int sizes[] = {61, 1000, 4096};
+  unsigned int errors, i;
+
+  for (i = 1; i < (unsigned int)argc; i++) {
+    if (!strcmp(argv[i], "--bytes") && i + 1 < (unsigned int)argc) {
+      stress_bytes = strtoul(argv[++i], NULL, 0);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < (unsigned int)argc) {
+      stress_seed = strtoul(argv[++i], NULL, 0);
+    } else {
+      fprintf(stderr, "usage: %s [--bytes N] [--seed N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  errors = stress_edges();
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    errors += stress_run(sizes[i], 0);
+    errors += stress_run(sizes[i], UINT_MAX - sizes[i] / 2);
+  }
+
+  if (errors) {
+    printf("FAILED\n");
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,12 @@
+/*
+ * Host shim for platform/cmsis/inc/cmsis.h. The tool is single threaded.
+ */
+#ifndef __CMSIS_H__
+#define __CMSIS_H__
+
+#include <stdint.h>
+
+static inline uint32_t int_lock(void) { return 0; }
+static inline void int_unlock(uint32_t pri) { (void)pri; }
+
+#endif
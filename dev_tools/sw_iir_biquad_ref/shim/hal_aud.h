@@ -0,0 +1,26 @@
+/*
+ * Host shim for platform/hal/hal_aud.h.
+ */
+#ifndef __HAL_AUD_H__
+#define __HAL_AUD_H__
+
+enum AUD_SAMPRATE_T {
+  AUD_SAMPRATE_NULL = 0,
+  AUD_SAMPRATE_44100 = 44100,
+  AUD_SAMPRATE_48000 = 48000,
+  AUD_SAMPRATE_96000 = 96000,
+};
+
+enum AUD_CHANNEL_NUM_T {
+  AUD_CHANNEL_NUM_NULL = 0,
+  AUD_CHANNEL_NUM_1 = 1,
+  AUD_CHANNEL_NUM_2 = 2,
+};
+
+enum AUD_BITS_T {
+  AUD_BITS_NULL = 0,
+  AUD_BITS_16 = 16,
+  AUD_BITS_24 = 24,
+};
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * Host shim for platform/hal/hal_trace.h.
+ */
+#ifndef __HAL_TRACE_H__
+#define __HAL_TRACE_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TRACE(n, fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
+#define ASSERT(c, fmt, ...)                                                    \
+  do {                                                                         \
+    if (!(c)) {                                                                \
+      fprintf(stderr, fmt "\n", ##__VA_ARGS__);                                \
+      abort();                                                                 \
+    }                                                                          \
+  } while (0)
+
+#endif
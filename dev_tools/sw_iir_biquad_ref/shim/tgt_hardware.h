@@ -0,0 +1,7 @@
+/*
+ * Host shim for the target tgt_hardware.h, eq_cfg.c uses nothing from it.
+ */
+#ifndef __TGT_HARDWARE_H__
+#define __TGT_HARDWARE_H__
+
+#endif
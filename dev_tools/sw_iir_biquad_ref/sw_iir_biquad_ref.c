@@ -0,0 +1,298 @@
+/*
+ * sw_iir_biquad host check.
+ *
+ * Runs services/audio_process/sw_iir_biquad.c against a double precision
+ * cascade built from the same coefficients, for 16-bit and 24-bit stereo,
+ * and reports the error in PCM LSBs. Both take their coefficients from
+ * iir_coefs_generate() in the real
+ * services/multimedia/audio/process/filters/cfg/eq_cfg.c. It also switches between two
+ * configurations half way through a run and checks that the output never
+ * strays outside the outputs of the two configurations.
+ *
+ *   sw_iir_biquad_ref [--seconds N]
+ */
+#include "eq_cfg.h"
+#include "sw_iir_biquad.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define REF_CH 2
+#define REF_DMA_FRAMES 256
+
+// Reference
+
+struct ref_biquad {
+  double c[6];
+  double x1, x2, y1, y2;
+};
+
+struct ref_eq {
+  int num;
+  double gain[REF_CH];
+  struct ref_biquad bq[REF_CH][IIR_PARAM_NUM];
+};
+
+static void ref_eq_init(struct ref_eq *eq, const IIR_CFG_T *cfg,
+                        uint32_t rate) {
+  float coefs[6];
+  int i, ch, k;
+
+  memset(eq, 0, sizeof(*eq));
+  eq->num = cfg->num;
+  eq->gain[0] = iir_convert_db_to_multiple(cfg->gain0);
+  eq->gain[1] = iir_convert_db_to_multiple(cfg->gain1);
+  for (i = 0; i < cfg->num; i++) {
+    iir_coefs_generate(cfg->param[i].type, cfg->param[i].gain,
+                       cfg->param[i].fc / rate, cfg->param[i].Q, coefs);
+    for (ch = 0; ch < REF_CH; ch++) {
+      for (k = 0; k < 6; k++) {
+        eq->bq[ch][i].c[k] = coefs[k];
+      }
+    }
+  }
+}
+
+static double ref_eq_run(struct ref_eq *eq, int ch, double x) {
+  struct ref_biquad *b;
+  double y;
+  int i;
+
+  x *= eq->gain[ch];
+  for (i = 0; i < eq->num; i++) {
+    b = &eq->bq[ch][i];
+    y = b->c[3] * x + b->c[4] * b->x1 + b->c[5] * b->x2 - b->c[1] * b->y1 -
+        b->c[2] * b->y2;
+    b->x2 = b->x1;
+    b->x1 = x;
+    b->y2 = b->y1;
+    b->y1 = y;
+    x = y;
+  }
+  return x;
+}
+
+// Test signals and configurations
+
+static const IIR_CFG_T ref_cfg_10band = {
+    .gain0 = -6,
+    .gain1 = -7,
+    .num = 10,
+    .param =
+        {
+            {IIR_TYPE_LOW_SHELF, 5.0, 25.0, 0.7},
+            {IIR_TYPE_PEAK, -3.0, 60.0, 1.2},
+            {IIR_TYPE_PEAK, 4.0, 125.0, 0.9},
+            {IIR_TYPE_PEAK, -2.0, 250.0, 1.0},
+            {IIR_TYPE_PEAK, 3.0, 500.0, 1.4},
+            {IIR_TYPE_PEAK, -4.0, 1000.0, 2.0},
+            {IIR_TYPE_PEAK, 2.5, 2000.0, 1.0},
+            {IIR_TYPE_PEAK, -1.5, 4000.0, 3.0},
+            {IIR_TYPE_PEAK, 6.0, 8000.0, 1.5},
+            {IIR_TYPE_HIGH_SHELF, -3.0, 16000.0, 0.7},
+        },
+};
+
+static const IIR_CFG_T ref_cfg_bass = {
+    .gain0 = -9,
+    .gain1 = -9,
+    .num = 4,
+    .param =
+        {
+            {IIR_TYPE_HIGH_PASS, 0, 20.0, 0.7},
+            {IIR_TYPE_LOW_SHELF, 9.0, 100.0, 0.7},
+            {IIR_TYPE_PEAK, -3.0, 3000.0, 1.0},
+            // At or above fs/2 at 44.1 and 48 kHz, so left out there
+            {IIR_TYPE_PEAK, 4.0, 30000.0, 1.0},
+        },
+};
+
+static uint32_t ref_rand_state = 1;
+
+static double ref_noise(void) {
+  ref_rand_state = ref_rand_state * 1664525 + 1013904223;
+  return (double)(int32_t)ref_rand_state / 2147483648.0;
+}
+
+// Tones from 30 Hz to 12 kHz and some noise, peaking near -3 dBFS
+static double ref_signal(uint32_t n, int ch, uint32_t rate) {
+  static const double freq[] = {30, 110, 440, 1700, 5200, 12000};
+  double t = (double)n / rate;
+  double v = 0;
+  unsigned i;
+
+  for (i = 0; i < sizeof(freq) / sizeof(freq[0]); i++) {
+    v += 0.1 * sin(2 * M_PI * freq[i] * t + ch * 0.3 + i);
+  }
+  return v + 0.05 * ref_noise();
+}
+
+static int32_t ref_quantize(double v, int bits) {
+  double fs = (double)(1 << (bits - 1));
+  double q = floor(v * fs + 0.5);
+
+  if (q > fs - 1) {
+    q = fs - 1;
+  } else if (q < -fs) {
+    q = -fs;
+  }
+  return (int32_t)q;
+}
+
+static void ref_put(uint8_t *buf, uint32_t i, int bits, int32_t v) {
+  if (bits == 16) {
+    ((int16_t *)buf)[i] = (int16_t)v;
+  } else {
+    ((int32_t *)buf)[i] = v;
+  }
+}
+
+static int32_t ref_get(const uint8_t *buf, uint32_t i, int bits) {
+  return (bits == 16) ? ((const int16_t *)buf)[i] : ((const int32_t *)buf)[i];
+}
+
+static uint32_t ref_errors;
+
+// Compares against the reference sample by sample
+static void ref_accuracy(uint32_t rate, int bits, const IIR_CFG_T *cfg,
+                         uint32_t frames) {
+  static struct ref_eq ref;
+  uint8_t buf[REF_DMA_FRAMES * REF_CH * sizeof(int32_t)];
+  int32_t pcm_in[REF_DMA_FRAMES * REF_CH];
+  double fs = (double)(1 << (bits - 1));
+  double err, max_err = 0, err_pow = 0, sig_pow = 0, ns = 0;
+  struct timespec t0, t1;
+  uint32_t pos, n, i;
+  int32_t in, out, want;
+  double ideal;
+  bool fail;
+  int ch;
+
+  ref_eq_init(&ref, cfg, rate);
+  sw_iir_biquad_open((enum AUD_SAMPRATE_T)rate, (enum AUD_BITS_T)bits,
+                     AUD_CHANNEL_NUM_2);
+  // Taken at once, as no samples have run yet
+  sw_iir_biquad_set_cfg(cfg);
+
+  for (pos = 0; pos < frames; pos += n) {
+    n = frames - pos < REF_DMA_FRAMES ? frames - pos : REF_DMA_FRAMES;
+    for (i = 0; i < n; i++) {
+      for (ch = 0; ch < REF_CH; ch++) {
+        pcm_in[i * REF_CH + ch] =
+            ref_quantize(ref_signal(pos + i, ch, rate), bits);
+        ref_put(buf, i * REF_CH + ch, bits, pcm_in[i * REF_CH + ch]);
+      }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    sw_iir_biquad_run(buf, n * REF_CH);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ns += (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    for (i = 0; i < n; i++) {
+      for (ch = 0; ch < REF_CH; ch++) {
+        in = pcm_in[i * REF_CH + ch];
+        ideal = ref_eq_run(&ref, ch, (double)in / fs) * fs;
+        out = ref_get(buf, i * REF_CH + ch, bits);
+        want = ref_quantize(ideal / fs, bits);
+        err = out - ideal;
+        err_pow += err * err;
+        sig_pow += ideal * ideal;
+        if (fabs(out - (double)want) > max_err) {
+          max_err = fabs(out - (double)want);
+        }
+      }
+    }
+  }
+  sw_iir_biquad_close();
+
+  // Past the final rounding, the error has to stay 2 LSB or 120 dB below
+  // full scale, whichever is larger
+  fail = max_err > fmax(2, fs / (1 << 20));
+  if (fail) {
+    ref_errors++;
+  }
+  printf("%6u Hz %d-bit %2d bands: max err %.0f LSB, SNR %.1f dB, "
+         "%.1f ns/frame : %s\n",
+         rate, bits, cfg->num, max_err,
+         10 * log10(sig_pow / (err_pow ? err_pow : 1e-30)),
+         ns / frames, fail ? "FAIL" : "ok");
+}
+
+// Switches configuration in the middle. During the fade each output sample
+// has to lie between the outputs of the two configurations, up to the
+// transient of the new bands starting from the history of the old ones.
+static void ref_switch(uint32_t rate, int bits) {
+  static struct ref_eq ref_a, ref_b;
+  uint8_t buf[REF_DMA_FRAMES * REF_CH * sizeof(int32_t)];
+  int32_t pcm_in[REF_DMA_FRAMES * REF_CH];
+  double fs = (double)(1 << (bits - 1));
+  double outside = 0, ya, yb;
+  uint32_t frames = rate / 5;
+  uint32_t pos, n, i;
+  int32_t in, out;
+  int ch;
+  bool fail;
+
+  ref_eq_init(&ref_a, &ref_cfg_10band, rate);
+  ref_eq_init(&ref_b, &ref_cfg_bass, rate);
+  sw_iir_biquad_open((enum AUD_SAMPRATE_T)rate, (enum AUD_BITS_T)bits,
+                     AUD_CHANNEL_NUM_2);
+  sw_iir_biquad_set_cfg(&ref_cfg_10band);
+
+  for (pos = 0; pos < frames; pos += n) {
+    n = frames - pos < REF_DMA_FRAMES ? frames - pos : REF_DMA_FRAMES;
+    if (pos == frames / 2 / REF_DMA_FRAMES * REF_DMA_FRAMES) {
+      sw_iir_biquad_set_cfg(&ref_cfg_bass);
+    }
+    for (i = 0; i < n; i++) {
+      for (ch = 0; ch < REF_CH; ch++) {
+        pcm_in[i * REF_CH + ch] =
+            ref_quantize(ref_signal(pos + i, ch, rate), bits);
+        ref_put(buf, i * REF_CH + ch, bits, pcm_in[i * REF_CH + ch]);
+      }
+    }
+    sw_iir_biquad_run(buf, n * REF_CH);
+    for (i = 0; i < n; i++) {
+      for (ch = 0; ch < REF_CH; ch++) {
+        in = pcm_in[i * REF_CH + ch];
+        ya = ref_eq_run(&ref_a, ch, (double)in / fs) * fs;
+        yb = ref_eq_run(&ref_b, ch, (double)in / fs) * fs;
+        out = ref_get(buf, i * REF_CH + ch, bits);
+        outside = fmax(outside, fmin(ya, yb) - out);
+        outside = fmax(outside, out - fmax(ya, yb));
+      }
+    }
+  }
+  sw_iir_biquad_close();
+
+  // -60 dBFS
+  fail = outside > fs / 1000;
+  if (fail) {
+    ref_errors++;
+  }
+  printf("%6u Hz %d-bit switch: max excursion %.1f dBFS : %s\n", rate, bits,
+         20 * log10(fmax(outside, 1) / fs), fail ? "FAIL" : "ok");
+}
+
+int main(int argc, char **argv) {
+  uint32_t seconds = 2;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = strtoul(argv[++i], NULL, 0);
+    } else {
+      fprintf(stderr, "usage: sw_iir_biquad_ref [--seconds N]\n");
+      return 2;
+    }
+  }
+
+  ref_accuracy(44100, 16, &ref_cfg_10band, 44100 * seconds);
+  ref_accuracy(96000, 24, &ref_cfg_10band, 96000 * seconds);
+  ref_accuracy(48000, 24, &ref_cfg_bass, 48000 * seconds);
+  ref_switch(44100, 16);
+  ref_switch(96000, 24);
+  return ref_errors ? 1 : 0;
+}
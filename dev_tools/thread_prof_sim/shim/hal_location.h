@@ -0,0 +1,9 @@
+/*
+ * Host shim for platform/hal/hal_location.h.
+ */
+#ifndef __HAL_LOCATION_H__
+#define __HAL_LOCATION_H__
+
+#define SRAM_TEXT_LOC
+
+#endif
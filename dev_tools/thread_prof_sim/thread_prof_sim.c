@@ -0,0 +1,436 @@
+/*
+ * Host check of the thread_prof accounting core
+ * (utils/thread_prof/thread_prof.c).
+ *
+ * A simulated scheduler drives the switch, IRQ and stack hooks and keeps its
+ * own account of the ticks, switches and stack high-water marks of every
+ * thread. Each sample of the profiler must match it. A few scripted
+ * schedules are checked against hand computed numbers first, then a random
+ * schedule runs with nested IRQs, more threads than the table holds, thread
+ * ids reused under new names and a tick counter that wraps.
+ *
+ *   thread_prof_sim [--events N] [--seed N]
+ */
+#include "thread_prof.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Two names per id, so that ids get reused by new threads
+#define SIM_IDS (THREAD_PROF_MAX_THREADS + 4)
+#define SIM_THREADS (SIM_IDS * 2)
+
+struct sim_thread {
+  const void *id;
+  const char *name;
+  uint64_t run;
+  uint32_t switches;
+  uint32_t stack_size;
+  uint32_t stack_used;
+  bool listed; // has an entry in the profiler table
+};
+
+static struct sim_thread sim_th[SIM_THREADS];
+static char sim_names[SIM_THREADS][8];
+static int sim_ids[SIM_IDS];
+
+static uint32_t sim_now;
+static int sim_curr = -1;
+static bool sim_curr_other;
+static uint32_t sim_depth;
+static uint32_t sim_pend; // thread ticks since the profiler last charged
+static uint64_t sim_total;
+static uint64_t sim_isr;
+static uint32_t sim_irq_cnt;
+static uint64_t sim_other_run;
+static uint32_t sim_other_switches;
+
+static struct THREAD_PROF_SAMPLE_T sim_s;
+static unsigned int sim_samples;
+static unsigned int sim_errors;
+
+static uint32_t sim_events = 1000000;
+static unsigned int sim_seed = 1;
+
+static void sim_error(const char *fmt, ...) {
+  va_list ap;
+
+  if (sim_errors++ < 10) {
+    fprintf(stderr, "sample %u: ", sim_samples);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fprintf(stderr, "\n");
+  }
+}
+
+static unsigned int sim_listed(void) {
+  unsigned int k, n = 0;
+
+  for (k = 0; k < SIM_THREADS; k++) {
+    n += sim_th[k].listed;
+  }
+  return n;
+}
+
+// Mirrors the table lookup: returns false if the thread ends up in "other"
+static bool sim_list(int k) {
+  struct sim_thread *t = &sim_th[k];
+  uint32_t run = 0;
+  int j;
+
+  if (t->listed) {
+    return true;
+  }
+  for (j = 0; j < SIM_THREADS; j++) {
+    if (j != k && sim_th[j].listed && sim_th[j].id == t->id) {
+      // A new thread with the id of an old one takes over its entry. If
+      // that was the running entry, the ticks not charged yet go with it.
+      sim_th[j].listed = false;
+      if (sim_curr == j && !sim_curr_other) {
+        sim_curr = k;
+        run = sim_pend;
+      }
+      break;
+    }
+  }
+  if (j == SIM_THREADS && sim_listed() >= THREAD_PROF_MAX_THREADS) {
+    return false;
+  }
+  t->listed = true;
+  t->run = run;
+  t->switches = 0;
+  t->stack_size = 0;
+  t->stack_used = 0;
+  return true;
+}
+
+static void sim_start(uint32_t now) {
+  int k;
+
+  thread_prof_reset(now);
+  sim_now = now;
+  sim_pend = 0;
+  sim_total = 0;
+  sim_isr = 0;
+  sim_irq_cnt = 0;
+  sim_other_run = 0;
+  sim_other_switches = 0;
+  for (k = 0; k < SIM_THREADS; k++) {
+    sim_th[k].run = 0;
+    sim_th[k].switches = 0;
+  }
+}
+
+static void sim_run(uint32_t ticks) {
+  sim_now += ticks;
+  sim_total += ticks;
+  if (sim_depth) {
+    sim_isr += ticks;
+  } else if (sim_curr_other) {
+    sim_other_run += ticks;
+  } else if (sim_curr >= 0) {
+    sim_th[sim_curr].run += ticks;
+    sim_pend += ticks;
+  }
+}
+
+static void sim_switch(int k) {
+  thread_prof_switch(sim_th[k].id, sim_th[k].name, sim_now);
+  sim_pend = 0;
+  if (sim_curr == k && !sim_curr_other) {
+    return;
+  }
+  sim_curr = k;
+  sim_curr_other = !sim_list(k);
+  if (sim_curr_other) {
+    sim_other_switches++;
+  } else {
+    sim_th[k].switches++;
+  }
+}
+
+static void sim_irq_enter(void) {
+  thread_prof_irq_enter(sim_now);
+  sim_pend = 0;
+  if (sim_depth++ == 0) {
+    sim_irq_cnt++;
+  }
+}
+
+static void sim_irq_exit(void) {
+  thread_prof_irq_exit(sim_now);
+  if (sim_depth) {
+    sim_depth--;
+  }
+}
+
+static void sim_stack(int k, uint32_t size, uint32_t used) {
+  struct sim_thread *t = &sim_th[k];
+
+  thread_prof_set_stack(t->id, t->name, size, used);
+  if (!sim_list(k)) {
+    return;
+  }
+  t->stack_size = size;
+  if (t->stack_used < used) {
+    t->stack_used = used;
+  }
+}
+
+static const struct THREAD_PROF_ENTRY_T *sim_entry(int k) {
+  uint32_t i;
+
+  for (i = 0; i < sim_s.num; i++) {
+    if (sim_s.entry[i].id == sim_th[k].id &&
+        sim_s.entry[i].name == sim_th[k].name) {
+      return &sim_s.entry[i];
+    }
+  }
+  return NULL;
+}
+
+// Samples the profiler and checks it against the simulated account
+static void sim_sample(bool restart) {
+  const struct THREAD_PROF_ENTRY_T *e;
+  uint32_t num = 0;
+  bool other;
+  int k;
+
+  sim_samples++;
+  thread_prof_sample(&sim_s, sim_now, restart);
+  sim_pend = 0;
+
+  if (sim_s.total != sim_total || sim_s.isr != sim_isr ||
+      sim_s.irq_cnt != sim_irq_cnt) {
+    sim_error("total %llu isr %llu irq_cnt %u, expected %llu %llu %u",
+              (unsigned long long)sim_s.total, (unsigned long long)sim_s.isr,
+              sim_s.irq_cnt, (unsigned long long)sim_total,
+              (unsigned long long)sim_isr, sim_irq_cnt);
+  }
+
+  for (k = 0; k < SIM_THREADS; k++) {
+    struct sim_thread *t = &sim_th[k];
+
+    if (!t->listed) {
+      continue;
+    }
+    num++;
+    e = sim_entry(k);
+    if (e == NULL) {
+      sim_error("%s missing", t->name);
+    } else if (e->run != t->run || e->switches != t->switches ||
+               e->stack_size != t->stack_size ||
+               e->stack_used != t->stack_used) {
+      sim_error("%s run %llu switches %u stack %u/%u, expected %llu %u %u/%u",
+                t->name, (unsigned long long)e->run, e->switches,
+                e->stack_used, e->stack_size, (unsigned long long)t->run,
+                t->switches, t->stack_used, t->stack_size);
+    }
+  }
+
+  other = sim_other_run || sim_other_switches;
+  if (sim_s.num != num + other) {
+    sim_error("%u entries, expected %u", sim_s.num, num + other);
+  } else if (other) {
+    e = &sim_s.entry[num];
+    if (e->id != NULL || strcmp(e->name, "other") ||
+        e->run != sim_other_run || e->switches != sim_other_switches) {
+      sim_error("other run %llu switches %u, expected %llu %u",
+                (unsigned long long)e->run, e->switches,
+                (unsigned long long)sim_other_run, sim_other_switches);
+    }
+  }
+
+  if (!restart) {
+    return;
+  }
+  for (k = 0; k < SIM_THREADS; k++) {
+    struct sim_thread *t = &sim_th[k];
+
+    if (t->listed && t->run == 0 && t->switches == 0 &&
+        (k != sim_curr || sim_curr_other)) {
+      t->listed = false;
+    }
+  }
+  sim_start(sim_now);
+}
+
+#define SIM_EXPECT(c)                                                          \
+  do {                                                                         \
+    if (!(c)) {                                                                \
+      sim_error("%s", #c);                                                     \
+    }                                                                          \
+  } while (0)
+
+static void sim_expect(int k, uint64_t run, uint32_t switches) {
+  const struct THREAD_PROF_ENTRY_T *e = sim_entry(k);
+
+  if (e == NULL) {
+    sim_error("%s missing", sim_th[k].name);
+  } else if (e->run != run || e->switches != switches) {
+    sim_error("%s run %llu switches %u, expected %llu %u", sim_th[k].name,
+              (unsigned long long)e->run, e->switches,
+              (unsigned long long)run, switches);
+  }
+}
+
+// Switches to k and restarts twice, so that only k is left
+static void sim_flush(int k) {
+  sim_switch(k);
+  sim_sample(true);
+  sim_sample(true);
+  sim_sample(false);
+  SIM_EXPECT(sim_s.num == 1 && sim_entry(k));
+}
+
+// Scripted schedules with hand computed results
+static void sim_scripted(void) {
+  const int a = 0, b = 2, b2 = 3;
+  int k, n;
+
+  // Two threads and a nested IRQ, across the tick wrap
+  sim_start(0xFFFFFF00);
+  sim_run(20);
+  sim_switch(a);
+  sim_run(100);
+  sim_switch(b);
+  sim_run(50);
+  sim_irq_enter();
+  sim_run(10);
+  sim_irq_enter();
+  sim_run(10);
+  sim_irq_exit();
+  sim_run(30);
+  sim_irq_exit();
+  sim_run(100);
+  sim_switch(a);
+  sim_run(90);
+  sim_switch(a);
+  sim_run(10);
+  sim_sample(false);
+  SIM_EXPECT(sim_s.total == 420 && sim_s.isr == 50 && sim_s.irq_cnt == 1);
+  sim_expect(a, 200, 2);
+  sim_expect(b, 150, 1);
+
+  // The window goes on without restart
+  sim_run(25);
+  sim_sample(true);
+  SIM_EXPECT(sim_s.total == 445);
+  sim_expect(a, 225, 2);
+
+  // Stack high-water marks are kept across windows
+  sim_stack(a, 1024, 300);
+  sim_stack(a, 1024, 200);
+  sim_stack(b, 2048, 512);
+  sim_run(40);
+  sim_sample(true);
+  SIM_EXPECT(sim_s.total == 40 && sim_s.num == 2);
+  sim_expect(a, 40, 0);
+  sim_expect(b, 0, 0);
+  SIM_EXPECT(sim_entry(a) && sim_entry(a)->stack_used == 300 &&
+             sim_entry(a)->stack_size == 1024);
+  SIM_EXPECT(sim_entry(b) && sim_entry(b)->stack_used == 512);
+
+  // b did not run in that window, so it is gone with its stack mark
+  sim_run(10);
+  sim_sample(false);
+  SIM_EXPECT(sim_s.num == 1 && sim_entry(b) == NULL);
+  SIM_EXPECT(sim_entry(a) && sim_entry(a)->stack_used == 300);
+  sim_stack(b, 2048, 100);
+  sim_sample(false);
+  SIM_EXPECT(sim_entry(b) && sim_entry(b)->stack_used == 100);
+
+  // A new thread with the id of b starts a fresh entry
+  sim_switch(b);
+  sim_run(60);
+  sim_switch(b2);
+  sim_run(70);
+  sim_switch(a);
+  sim_sample(true);
+  SIM_EXPECT(sim_s.num == 2 && sim_entry(b) == NULL);
+  sim_expect(b2, 70, 1);
+  SIM_EXPECT(sim_entry(b2) && sim_entry(b2)->stack_used == 0);
+
+  // Threads that do not fit the table run as "other"
+  sim_flush(a);
+  n = THREAD_PROF_MAX_THREADS + 1;
+  for (k = 1; k <= n; k++) {
+    sim_switch(k * 2);
+    sim_run(10);
+  }
+  sim_switch(a);
+  sim_sample(false);
+  SIM_EXPECT(sim_s.num == THREAD_PROF_MAX_THREADS + 1);
+  SIM_EXPECT(sim_s.entry[THREAD_PROF_MAX_THREADS].id == NULL);
+  SIM_EXPECT(sim_s.entry[THREAD_PROF_MAX_THREADS].run == 20);
+  SIM_EXPECT(sim_s.entry[THREAD_PROF_MAX_THREADS].switches == 2);
+  sim_flush(a);
+
+  printf("scripted: %u samples, %u errors\n", sim_samples, sim_errors);
+}
+
+// Random schedule checked against the simulated account
+static void sim_random(void) {
+  unsigned int seed = sim_seed;
+  unsigned int samples = sim_samples, errors = sim_errors;
+  uint32_t i, r;
+
+  sim_start(rand_r(&seed) | 0xFFF00000u);
+  for (i = 0; i < sim_events; i++) {
+    r = rand_r(&seed) % 100;
+    if (r < 40) {
+      sim_run(rand_r(&seed) % 2000);
+    } else if (r < 60) {
+      // Mostly a small set of threads, sometimes any of them
+      sim_switch(rand_r(&seed) % ((r & 1) ? SIM_THREADS : 8));
+    } else if (r < 70) {
+      if (sim_depth < 4) {
+        sim_irq_enter();
+      }
+    } else if (r < 82) {
+      sim_irq_exit();
+    } else if (r < 92) {
+      sim_stack(rand_r(&seed) % SIM_THREADS, 4096, rand_r(&seed) % 4096);
+    } else if (r < 96) {
+      sim_sample(false);
+    } else {
+      sim_sample(true);
+    }
+  }
+
+  printf("random: %u events, %u samples, %u errors\n", sim_events,
+         sim_samples - samples, sim_errors - errors);
+}
+
+int main(int argc, char *argv[]) {
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--events") && i + 1 < argc) {
+      sim_events = strtoul(argv[++i], NULL, 0);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      sim_seed = strtoul(argv[++i], NULL, 0);
+    } else {
+      fprintf(stderr, "usage: %s [--events N] [--seed N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  for (i = 0; i < SIM_THREADS; i++) {
+    snprintf(sim_names[i], sizeof(sim_names[i]), "t%02d.%d", i / 2, i % 2);
+    sim_th[i].id = &sim_ids[i / 2];
+    sim_th[i].name = sim_names[i];
+  }
+
+  sim_scripted();
+  sim_random();
+
+  if (sim_errors) {
+    printf("FAILED\n");
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,148 @@
+// Minimal ELF32 little-endian reader: just enough to find the trace format
+// strings and the strings passed to %s.
+
+use std::fs;
+
+const SHT_PROGBITS: u32 = 1;
+
+pub struct Section {
+    pub name: String,
+    pub addr: u32,
+    pub data: Vec<u8>,
+}
+
+pub struct Elf {
+    pub sections: Vec<Section>,
+}
+
+fn rd16(b: &[u8], off: usize) -> Option<u16> {
+    Some(u16::from_le_bytes(b.get(off..off + 2)?.try_into().ok()?))
+}
+
+fn rd32(b: &[u8], off: usize) -> Option<u32> {
+    Some(u32::from_le_bytes(b.get(off..off + 4)?.try_into().ok()?))
+}
+
+fn cstr(b: &[u8]) -> &[u8] {
+    match b.iter().position(|&c| c == 0) {
+        Some(n) => &b[..n],
+        None => b,
+    }
+}
+
+impl Elf {
+    pub fn load(path: &str) -> Result<Elf, String> {
+        let b = fs::read(path).map_err(|e| format!("{}: {}", path, e))?;
+        Elf::parse(&b).ok_or_else(|| format!("{}: not a 32-bit little-endian ELF file", path))
+    }
+
+    fn parse(b: &[u8]) -> Option<Elf> {
+        if b.get(0..6)? != b"\x7fELF\x01\x01" {
+            return None;
+        }
+        let shoff = rd32(b, 0x20)? as usize;
+        let shentsize = rd16(b, 0x2e)? as usize;
+        let shnum = rd16(b, 0x30)? as usize;
+        let shstrndx = rd16(b, 0x32)? as usize;
+
+        let hdr = |i: usize| -> Option<(u32, u32, u32, usize, usize)> {
+            let h = shoff + i * shentsize;
+            Some((
+                rd32(b, h)?,
+                rd32(b, h + 4)?,
+                rd32(b, h + 12)?,
+                rd32(b, h + 16)? as usize,
+                rd32(b, h + 20)? as usize,
+            ))
+        };
+        let (_, _, _, stroff, strsize) = hdr(shstrndx)?;
+        let names = b.get(stroff..stroff + strsize)?;
+
+        let mut sections = Vec::new();
+        for i in 0..shnum {
+            let (name, kind, addr, off, size) = hdr(i)?;
+            if kind != SHT_PROGBITS || size == 0 {
+                continue;
+            }
+            let name = String::from_utf8_lossy(cstr(names.get(name as usize..)?)).into_owned();
+            sections.push(Section {
+                name,
+                addr,
+                data: b.get(off..off + size)?.to_vec(),
+            });
+        }
+        Some(Elf { sections })
+    }
+
+    pub fn section(&self, name: &str) -> Option<&Section> {
+        self.sections.iter().find(|s| s.name == name)
+    }
+
+    // NUL-terminated string at a target address, if it is in the image.
+    pub fn string_at(&self, addr: u32) -> Option<&[u8]> {
+        self.sections.iter().find_map(|s| {
+            let off = addr.checked_sub(s.addr)? as usize;
+            if off < s.data.len() {
+                Some(cstr(&s.data[off..]))
+            } else {
+                None
+            }
+        })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // ELF32 header, the section data, then the section headers: null,
+    // .trc_str, a NOBITS .bss and .shstrtab
+    fn build() -> Vec<u8> {
+        let names = b"\0.trc_str\0.bss\0.shstrtab\0";
+        let data = b"fmt %d\0";
+        let mut b = vec![0u8; 0x34];
+        b[0..6].copy_from_slice(b"\x7fELF\x01\x01");
+        let data_off = b.len();
+        b.extend_from_slice(data);
+        let names_off = b.len();
+        b.extend_from_slice(names);
+        let shoff = b.len();
+        b[0x20..0x24].copy_from_slice(&(shoff as u32).to_le_bytes());
+        b[0x2e..0x30].copy_from_slice(&40u16.to_le_bytes());
+        b[0x30..0x32].copy_from_slice(&4u16.to_le_bytes());
+        b[0x32..0x34].copy_from_slice(&3u16.to_le_bytes());
+        let mut sh = |name: u32, kind: u32, addr: u32, off: usize, size: usize| {
+            let mut h = [0u8; 40];
+            h[0..4].copy_from_slice(&name.to_le_bytes());
+            h[4..8].copy_from_slice(&kind.to_le_bytes());
+            h[12..16].copy_from_slice(&addr.to_le_bytes());
+            h[16..20].copy_from_slice(&(off as u32).to_le_bytes());
+            h[20..24].copy_from_slice(&(size as u32).to_le_bytes());
+            b.extend_from_slice(&h);
+        };
+        sh(0, 0, 0, 0, 0);
+        sh(1, SHT_PROGBITS, 0xFFFC_0000, data_off, data.len());
+        sh(10, 8, 0x2000_0000, 0, 0x100);
+        sh(15, 3, 0, names_off, names.len());
+        b
+    }
+
+    #[test]
+    fn finds_progbits_sections_and_strings() {
+        let elf = Elf::parse(&build()).unwrap();
+        assert_eq!(elf.sections.len(), 1);
+        let s = elf.section(".trc_str").unwrap();
+        assert_eq!((s.addr, s.data.len()), (0xFFFC_0000, 7));
+        assert_eq!(elf.string_at(0xFFFC_0004), Some(&b"%d"[..]));
+        assert_eq!(elf.string_at(0xFFFC_0007), None);
+        assert!(elf.section(".bss").is_none());
+    }
+
+    #[test]
+    fn rejects_other_files() {
+        let mut b = build();
+        b[4] = 2; // ELF64
+        assert!(Elf::parse(&b).is_none());
+        assert!(Elf::parse(b"\x7fELF").is_none());
+    }
+}
@@ -0,0 +1,268 @@
+// printf() of the target C library, run on the raw argument words of a
+// trace record.
+//
+// The arguments follow attr and fmt in hal_trace_printf(), so the first
+// one is passed in r2. AAPCS passes 64-bit values (long long, double) in
+// an even register pair or at an 8-byte aligned stack slot, so they start
+// at an even word counted from r0, i.e. an even argument index.
+
+use crate::elf::Elf;
+
+struct Args<'a> {
+    words: &'a [u32],
+    next: usize,
+}
+
+impl<'a> Args<'a> {
+    fn word(&mut self) -> Option<u32> {
+        let w = self.words.get(self.next).copied();
+        self.next += 1;
+        w
+    }
+
+    fn dword(&mut self) -> Option<u64> {
+        self.next += self.next & 1;
+        let lo = self.word()? as u64;
+        let hi = self.word()? as u64;
+        Some(lo | (hi << 32))
+    }
+}
+
+#[derive(Default)]
+struct Spec {
+    left: bool,
+    plus: bool,
+    space: bool,
+    alt: bool,
+    zero: bool,
+    width: usize,
+    prec: Option<usize>,
+    long64: bool,
+    short: u8, // 1: h, 2: hh
+}
+
+fn pad(out: &mut String, s: &str, sp: &Spec, zero_ok: bool) {
+    let len = s.chars().count();
+    if len >= sp.width {
+        out.push_str(s);
+    } else if sp.left {
+        out.push_str(s);
+        out.extend(std::iter::repeat(' ').take(sp.width - len));
+    } else if sp.zero && zero_ok {
+        // zeros go after the sign or the 0x prefix
+        let skip = if s.starts_with("0x") || s.starts_with("0X") {
+            2
+        } else if s.starts_with(['-', '+', ' ']) {
+            1
+        } else {
+            0
+        };
+        out.push_str(&s[..skip]);
+        out.extend(std::iter::repeat('0').take(sp.width - len));
+        out.push_str(&s[skip..]);
+    } else {
+        out.extend(std::iter::repeat(' ').take(sp.width - len));
+        out.push_str(s);
+    }
+}
+
+fn integer(sp: &Spec, conv: u8, args: &mut Args) -> Option<String> {
+    let raw = if sp.long64 {
+        args.dword()?
+    } else {
+        args.word()? as u64
+    };
+    let (neg, mag) = match conv {
+        b'd' | b'i' => {
+            let v: i64 = if sp.long64 {
+                raw as i64
+            } else if sp.short == 2 {
+                raw as u8 as i8 as i64
+            } else if sp.short == 1 {
+                raw as u16 as i16 as i64
+            } else {
+                raw as u32 as i32 as i64
+            };
+            (v < 0, v.unsigned_abs())
+        }
+        _ => {
+            let v = if sp.short == 2 {
+                raw & 0xff
+            } else if sp.short == 1 {
+                raw & 0xffff
+            } else {
+                raw
+            };
+            (false, v)
+        }
+    };
+    let mut digits = match conv {
+        b'x' => format!("{:x}", mag),
+        b'X' => format!("{:X}", mag),
+        b'o' => format!("{:o}", mag),
+        _ => format!("{}", mag),
+    };
+    if let Some(p) = sp.prec {
+        if p == 0 && mag == 0 {
+            digits.clear();
+        }
+        while digits.len() < p {
+            digits.insert(0, '0');
+        }
+    }
+    let mut s = String::new();
+    if neg {
+        s.push('-');
+    } else if matches!(conv, b'd' | b'i') && sp.plus {
+        s.push('+');
+    } else if matches!(conv, b'd' | b'i') && sp.space {
+        s.push(' ');
+    }
+    if sp.alt && mag != 0 {
+        match conv {
+            b'x' => s.push_str("0x"),
+            b'X' => s.push_str("0X"),
+            b'o' if !digits.starts_with('0') => s.push('0'),
+            _ => {}
+        }
+    }
+    s.push_str(&digits);
+    Some(s)
+}
+
+fn float(sp: &Spec, conv: u8, args: &mut Args) -> Option<String> {
+    let v = f64::from_bits(args.dword()?);
+    let p = sp.prec.unwrap_or(6);
+    let mut s = match conv {
+        b'e' => format!("{:.*e}", p, v),
+        b'E' => format!("{:.*E}", p, v),
+        b'g' | b'G' => format!("{}", v),
+        _ => format!("{:.*}", p, v),
+    };
+    if sp.plus && v >= 0.0 {
+        s.insert(0, '+');
+    }
+    Some(s)
+}
+
+fn string(sp: &Spec, args: &mut Args, elf: &Elf) -> Option<String> {
+    let addr = args.word()?;
+    let mut s = match elf.string_at(addr) {
+        Some(b) => String::from_utf8_lossy(b).into_owned(),
+        None if addr == 0 => "(null)".to_string(),
+        // a string in RAM; only its address was logged
+        None => format!("<str@0x{:08x}>", addr),
+    };
+    if let Some(p) = sp.prec {
+        if let Some((i, _)) = s.char_indices().nth(p) {
+            s.truncate(i);
+        }
+    }
+    Some(s)
+}
+
+// Returns the text and whether the arguments ran out.
+pub fn format(fmt: &[u8], words: &[u32], elf: &Elf) -> (String, bool) {
+    let mut args = Args { words, next: 0 };
+    let mut out = String::new();
+    let mut i = 0;
+    let mut short = false;
+
+    while i < fmt.len() {
+        let start = i;
+        while i < fmt.len() && fmt[i] != b'%' {
+            i += 1;
+        }
+        out.push_str(&String::from_utf8_lossy(&fmt[start..i]));
+        if i >= fmt.len() {
+            break;
+        }
+        let spec_start = i;
+        i += 1;
+
+        let mut sp = Spec::default();
+        while i < fmt.len() {
+            match fmt[i] {
+                b'-' => sp.left = true,
+                b'+' => sp.plus = true,
+                b' ' => sp.space = true,
+                b'#' => sp.alt = true,
+                b'0' => sp.zero = true,
+                _ => break,
+            }
+            i += 1;
+        }
+        if i < fmt.len() && fmt[i] == b'*' {
+            let w = args.word().unwrap_or(0) as i32;
+            sp.left |= w < 0;
+            sp.width = w.unsigned_abs() as usize;
+            i += 1;
+        } else {
+            while i < fmt.len() && fmt[i].is_ascii_digit() {
+                sp.width = sp.width * 10 + (fmt[i] - b'0') as usize;
+                i += 1;
+            }
+        }
+        if i < fmt.len() && fmt[i] == b'.' {
+            i += 1;
+            let mut p = 0;
+            if i < fmt.len() && fmt[i] == b'*' {
+                p = (args.word().unwrap_or(0) as i32).max(0) as usize;
+                i += 1;
+            } else {
+                while i < fmt.len() && fmt[i].is_ascii_digit() {
+                    p = p * 10 + (fmt[i] - b'0') as usize;
+                    i += 1;
+                }
+            }
+            sp.prec = Some(p);
+        }
+        while i < fmt.len() {
+            match fmt[i] {
+                b'h' => sp.short += 1,
+                b'l' if fmt.get(i + 1) == Some(&b'l') => {
+                    sp.long64 = true;
+                    i += 1;
+                }
+                b'j' | b'q' => sp.long64 = true,
+                b'l' | b'z' | b't' | b'L' => {}
+                _ => break,
+            }
+            i += 1;
+        }
+        let Some(&conv) = fmt.get(i) else {
+            out.push_str(&String::from_utf8_lossy(&fmt[spec_start..]));
+            break;
+        };
+        i += 1;
+
+        let s = match conv {
+            b'%' => Some("%".to_string()),
+            b'd' | b'i' | b'u' | b'x' | b'X' | b'o' => integer(&sp, conv, &mut args),
+            b'p' => args.word().map(|w| format!("0x{:x}", w)),
+            b'c' => args.word().map(|w| (w as u8 as char).to_string()),
+            b's' => string(&sp, &mut args, elf),
+            b'f' | b'F' | b'e' | b'E' | b'g' | b'G' => float(&sp, conv, &mut args),
+            _ => {
+                out.push_str(&String::from_utf8_lossy(&fmt[spec_start..i]));
+                continue;
+            }
+        };
+        match s {
+            Some(s) => {
+                // as in C, a precision turns off zero padding of integers
+                let zero_ok = match conv {
+                    b's' | b'c' | b'%' => false,
+                    b'f' | b'F' | b'e' | b'E' | b'g' | b'G' => true,
+                    _ => sp.prec.is_none(),
+                };
+                pad(&mut out, &s, &sp, zero_ok)
+            }
+            None => {
+                short = true;
+                out.push_str("<?>");
+            }
+        }
+    }
+    (out, short)
+}
@@ -0,0 +1,334 @@
+// Decoder for the binary trace records of USE_TRACE_ID=1 builds
+// (platform/hal/hal_trace.c). Reads the trace output (a capture file or
+// stdin, e.g. piped from the UART), replaces each record with the text
+// the firmware would have printed, and passes any other output through.
+
+mod elf;
+mod format;
+
+use std::env;
+use std::fs::File;
+use std::io::{self, BufWriter, Read, Write};
+use std::process;
+
+const HEAD_MARK: u8 = 0xBE;
+const INFO_MARK: u32 = 0x2A;
+const RECORD_LEN: usize = 8;
+const MAX_ARGS: usize = 10;
+const TS_BITS: u32 = 24;
+
+struct Decoder {
+    elf: elf::Elf,
+    str_addr: u32,
+    str_len: usize,
+    crc: bool,
+    ts_base: u64,
+    ts_last: u32,
+    records: u64,
+    bad: u64,
+}
+
+// LOG_DATA_T fields
+struct Record {
+    ts: u32,
+    count: usize,
+    task: u32,
+    offset: usize,
+}
+
+fn crc8(data: &[u8]) -> u8 {
+    let mut crc = 0u8;
+    for &b in data {
+        crc ^= b;
+        for _ in 0..8 {
+            crc = if crc & 0x80 != 0 { (crc << 1) ^ 0x07 } else { crc << 1 };
+        }
+    }
+    crc
+}
+
+impl Decoder {
+    fn header(&self, b: &[u8]) -> Option<Record> {
+        if self.crc {
+            if crc8(&b[1..RECORD_LEN]) != b[0] {
+                return None;
+            }
+        } else if b[0] != HEAD_MARK {
+            return None;
+        }
+        let head = u32::from_le_bytes(b[0..4].try_into().unwrap());
+        let info = u32::from_le_bytes(b[4..8].try_into().unwrap());
+        let r = Record {
+            ts: head >> 8,
+            count: ((info >> 6) & 0xf) as usize,
+            task: (info >> 10) & 0x1f,
+            offset: (info >> 15) as usize,
+        };
+        if info & 0x3f != INFO_MARK || r.count > MAX_ARGS || r.offset >= self.str_len {
+            return None;
+        }
+        Some(r)
+    }
+
+    // Milliseconds since boot; the record only keeps 24 bits (4.6 hours).
+    fn timestamp(&mut self, ts: u32) -> u64 {
+        if ts < self.ts_last && self.ts_last - ts > 1 << (TS_BITS - 1) {
+            self.ts_base += 1 << TS_BITS;
+        }
+        self.ts_last = ts;
+        self.ts_base + ts as u64
+    }
+
+    // Decodes what it can from buf and returns the number of bytes used.
+    // Without eof, a record cut off at the end of buf is left for later.
+    fn decode(&mut self, buf: &[u8], eof: bool, out: &mut impl Write) -> io::Result<usize> {
+        let mut pos = 0;
+        let mut text = 0;
+
+        while pos < buf.len() {
+            let rest = &buf[pos..];
+            let candidate = if self.crc { true } else { rest[0] == HEAD_MARK };
+            if candidate {
+                if rest.len() < RECORD_LEN && !eof {
+                    break;
+                }
+                if let Some(r) = rest.get(..RECORD_LEN).and_then(|b| self.header(b)) {
+                    let len = RECORD_LEN + 4 * r.count;
+                    if rest.len() < len && !eof {
+                        break;
+                    }
+                    out.write_all(&buf[text..pos])?;
+                    if rest.len() < len {
+                        // cut off by the end of the capture
+                        self.bad += rest.len() as u64;
+                        return Ok(buf.len());
+                    }
+                    self.record(&r, &rest[RECORD_LEN..len], out)?;
+                    pos += len;
+                    text = pos;
+                    continue;
+                }
+                if !self.crc {
+                    // not a record and not text either
+                    self.bad += 1;
+                    out.write_all(&buf[text..pos])?;
+                    pos += 1;
+                    text = pos;
+                    continue;
+                }
+            }
+            pos += 1;
+        }
+        out.write_all(&buf[text..pos])?;
+        Ok(pos)
+    }
+
+    fn record(&mut self, r: &Record, args: &[u8], out: &mut impl Write) -> io::Result<()> {
+        let words: Vec<u32> = args
+            .chunks_exact(4)
+            .map(|w| u32::from_le_bytes(w.try_into().unwrap()))
+            .collect();
+        let addr = self.str_addr + r.offset as u32;
+        let fmt = self.elf.string_at(addr).unwrap_or(b"");
+        let (text, short) = format::format(fmt, &words, &self.elf);
+        let ts = self.timestamp(r.ts);
+
+        self.records += 1;
+        write!(out, "{:9}/T{:<2}| {}", ts, r.task, text.trim_end_matches(['\r', '\n']))?;
+        if short {
+            write!(out, " [{} args]", words.len())?;
+        }
+        writeln!(out)
+    }
+}
+
+fn usage() -> ! {
+    eprintln!("usage: trace_decoder [--crc] <elf> [<trace capture>]");
+    eprintln!("  --crc  the firmware was built with USE_CRC_CHECK");
+    process::exit(2);
+}
+
+fn main() {
+    let mut crc = false;
+    let mut paths = Vec::new();
+    for a in env::args().skip(1) {
+        match a.as_str() {
+            "--crc" => crc = true,
+            "-h" | "--help" => usage(),
+            _ if a.starts_with('-') && a.len() > 1 => usage(),
+            _ => paths.push(a),
+        }
+    }
+    if paths.is_empty() || paths.len() > 2 {
+        usage();
+    }
+
+    let elf = elf::Elf::load(&paths[0]).unwrap_or_else(|e| {
+        eprintln!("{}", e);
+        process::exit(1);
+    });
+    let (str_addr, str_len) = match elf.section(".trc_str") {
+        Some(s) => (s.addr, s.data.len()),
+        None => {
+            eprintln!("{}: no .trc_str section; build with USE_TRACE_ID=1", paths[0]);
+            process::exit(1);
+        }
+    };
+    let mut input: Box<dyn Read> = match paths.get(1).map(|s| s.as_str()) {
+        None | Some("-") => Box::new(io::stdin()),
+        Some(p) => Box::new(File::open(p).unwrap_or_else(|e| {
+            eprintln!("{}: {}", p, e);
+            process::exit(1);
+        })),
+    };
+
+    let mut dec = Decoder {
+        elf,
+        str_addr,
+        str_len,
+        crc,
+        ts_base: 0,
+        ts_last: 0,
+        records: 0,
+        bad: 0,
+    };
+    let stdout = io::stdout();
+    let mut out = BufWriter::new(stdout.lock());
+    let mut buf = Vec::new();
+    let mut chunk = [0u8; 4096];
+
+    let result = (|| -> io::Result<()> {
+        loop {
+            let n = input.read(&mut chunk)?;
+            if n > 0 {
+                buf.extend_from_slice(&chunk[..n]);
+            }
+            let used = dec.decode(&buf, n == 0, &mut out)?;
+            buf.drain(..used);
+            out.flush()?;
+            if n == 0 {
+                return Ok(());
+            }
+        }
+    })();
+    if let Err(e) = result {
+        if e.kind() != io::ErrorKind::BrokenPipe {
+            eprintln!("{}", e);
+            process::exit(1);
+        }
+    }
+    eprintln!("{} records, {} bytes skipped", dec.records, dec.bad);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const STR_ADDR: u32 = 0xFFFC_0000;
+    const RODATA_ADDR: u32 = 0x3C00_0000;
+    const FMTS: &[u8] = b"boot\0%s: %d/%u 0x%08x\0";
+    const FMT_ARGS: usize = 5;
+
+    fn test_elf() -> elf::Elf {
+        elf::Elf {
+            sections: vec![
+                elf::Section { name: ".trc_str".into(), addr: STR_ADDR, data: FMTS.to_vec() },
+                elf::Section { name: ".rodata".into(), addr: RODATA_ADDR, data: b"a2dp\0".to_vec() },
+            ],
+        }
+    }
+
+    fn decoder(crc: bool) -> Decoder {
+        Decoder {
+            elf: test_elf(),
+            str_addr: STR_ADDR,
+            str_len: FMTS.len(),
+            crc,
+            ts_base: 0,
+            ts_last: 0,
+            records: 0,
+            bad: 0,
+        }
+    }
+
+    // A record as hal_trace_format_id() writes it
+    fn encode(crc: bool, ts: u32, task: u32, offset: usize, args: &[u32]) -> Vec<u8> {
+        let head = (ts & 0xff_ffff) << 8 | HEAD_MARK as u32;
+        let info = INFO_MARK | (args.len() as u32) << 6 | task << 10 | (offset as u32) << 15;
+        let mut b = head.to_le_bytes().to_vec();
+        b.extend_from_slice(&info.to_le_bytes());
+        if crc {
+            b[0] = crc8(&b[1..RECORD_LEN]);
+        }
+        for a in args {
+            b.extend_from_slice(&a.to_le_bytes());
+        }
+        b
+    }
+
+    fn run(dec: &mut Decoder, input: &[u8], chunk: usize) -> String {
+        let mut out = Vec::new();
+        let mut buf = Vec::new();
+        for (i, c) in input.chunks(chunk).enumerate() {
+            buf.extend_from_slice(c);
+            let eof = (i + 1) * chunk >= input.len();
+            let used = dec.decode(&buf, eof, &mut out).unwrap();
+            buf.drain(..used);
+        }
+        String::from_utf8(out).unwrap()
+    }
+
+    fn sample(crc: bool) -> Vec<u8> {
+        let mut input = b"text before\n".to_vec();
+        input.extend(encode(crc, 1234, 3, 0, &[]));
+        input.extend(encode(crc, 1240, 7, FMT_ARGS, &[RODATA_ADDR, -5i32 as u32, 42, 0xbeef]));
+        input.extend_from_slice(b"text after\n");
+        input
+    }
+
+    const SAMPLE_OUT: &str = "text before\n\
+         \x20    1234/T3 | boot\n\
+         \x20    1240/T7 | a2dp: -5/42 0x0000beef\n\
+         text after\n";
+
+    #[test]
+    fn decodes_records_between_text() {
+        let mut dec = decoder(false);
+        assert_eq!(run(&mut dec, &sample(false), 4096), SAMPLE_OUT);
+        assert_eq!((dec.records, dec.bad), (2, 0));
+    }
+
+    #[test]
+    fn decodes_records_split_across_reads() {
+        for chunk in 1..12 {
+            let mut dec = decoder(false);
+            assert_eq!(run(&mut dec, &sample(false), chunk), SAMPLE_OUT, "chunk {}", chunk);
+        }
+    }
+
+    #[test]
+    fn decodes_crc_records() {
+        let mut dec = decoder(true);
+        assert_eq!(run(&mut dec, &sample(true), 4096), SAMPLE_OUT);
+        assert_eq!(dec.records, 2);
+    }
+
+    #[test]
+    fn skips_stray_and_truncated_records() {
+        let mut input = vec![HEAD_MARK, b'x', b'\n'];
+        let rec = encode(false, 5, 1, FMT_ARGS, &[RODATA_ADDR, 1, 2, 3]);
+        input.extend_from_slice(&rec[..rec.len() - 2]);
+        let mut dec = decoder(false);
+        assert_eq!(run(&mut dec, &input, 4096), "x\n");
+        assert_eq!((dec.records, dec.bad), (0, 1 + rec.len() as u64 - 2));
+    }
+
+    #[test]
+    fn extends_wrapped_timestamps() {
+        let mut input = encode(false, 0xff_fff0, 0, 0, &[]);
+        input.extend(encode(false, 0x10, 0, 0, &[]));
+        let mut dec = decoder(false);
+        let out = run(&mut dec, &input, 4096);
+        assert_eq!(out, format!("{:9}/T0 | boot\n{:9}/T0 | boot\n", 0xff_fff0, 0x100_0010));
+    }
+}
@@ -127,6 +127,55 @@ IRQn_Type NVIC_GetCurrentActiveIRQ(void) {
   return irq;
 }
 
+#ifdef CMSIS_VECTAB_VIRTUAL
+
+static uint32_t vector_shadow[NVIC_NUM_VECTORS - NVIC_USER_IRQ_OFFSET];
+static NVIC_IRQ_HOOK_T irq_hook_enter;
+static NVIC_IRQ_HOOK_T irq_hook_exit;
+
+static void SRAM_TEXT_LOC NVIC_VirtualHandler(void) {
+  uint32_t irq = (__get_IPSR() & IPSR_ISR_Msk) - NVIC_USER_IRQ_OFFSET;
+  NVIC_IRQ_HOOK_T enter = irq_hook_enter;
+  NVIC_IRQ_HOOK_T exit = irq_hook_exit;
+
+  if (enter) {
+    enter();
+  }
+  ((void (*)(void))vector_shadow[irq])();
+  if (exit) {
+    exit();
+  }
+}
+
+void NVIC_SetVirtualVector(IRQn_Type IRQn, uint32_t vector) {
+  if ((int32_t)IRQn < 0) {
+    __NVIC_SetVector(IRQn, vector);
+    return;
+  }
+  vector_shadow[IRQn] = vector;
+  __NVIC_SetVector(IRQn, (uint32_t)NVIC_VirtualHandler);
+}
+
+uint32_t NVIC_GetVirtualVector(IRQn_Type IRQn) {
+  uint32_t vector = __NVIC_GetVector(IRQn);
+
+  if ((int32_t)IRQn >= 0 && vector == (uint32_t)NVIC_VirtualHandler) {
+    vector = vector_shadow[IRQn];
+  }
+  return vector;
+}
+
+void NVIC_SetIrqHooks(NVIC_IRQ_HOOK_T enter, NVIC_IRQ_HOOK_T exit) {
+  uint32_t lock;
+
+  lock = int_lock_global();
+  irq_hook_enter = enter;
+  irq_hook_exit = exit;
+  int_unlock_global(lock);
+}
+
+#endif
+
 #ifdef CORE_SLEEP_POWER_DOWN
 
 void SRAM_TEXT_LOC NVIC_PowerDownSleep(uint32_t *buf, uint32_t cnt) {
@@ -0,0 +1,38 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#ifndef __CMSIS_VECTAB_VIRTUAL_H__
+#define __CMSIS_VECTAB_VIRTUAL_H__
+
+// Included by the CMSIS core header when CMSIS_VECTAB_VIRTUAL is defined.
+//
+// User IRQ handlers set with NVIC_SetVector() are kept in a shadow table,
+// and the vector table points to a common handler in SRAM that calls the
+// hooks set with NVIC_SetIrqHooks() around the real handler. System
+// exception vectors are not wrapped.
+
+typedef void (*NVIC_IRQ_HOOK_T)(void);
+
+#define NVIC_SetVector NVIC_SetVirtualVector
+#define NVIC_GetVector NVIC_GetVirtualVector
+
+void NVIC_SetVirtualVector(IRQn_Type IRQn, uint32_t vector);
+
+uint32_t NVIC_GetVirtualVector(IRQn_Type IRQn);
+
+// Both hooks run in the IRQ context, before and after the handler.
+void NVIC_SetIrqHooks(NVIC_IRQ_HOOK_T enter, NVIC_IRQ_HOOK_T exit);
+
+#endif
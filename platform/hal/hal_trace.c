@@ -926,9 +926,24 @@ int hal_trace_output(const unsigned char *buf, unsigned int buf_len) {
   return ret ? 0 : buf_len;
 }
 #ifdef USE_TRACE_ID
+// Binary trace records. Instead of the text, a trace only writes the
+// offset of its format string in .trc_str and its raw 32-bit arguments to
+// the trace buffer; dev_tools/trace_decoder rebuilds the text from the ELF
+// file. Format strings outside .trc_str (e.g. built at run time) and
+// traces with LOG_ATTR_NO_ID are still formatted on the device, and the
+// decoder passes such text through.
+//
+// Record: LOG_DATA_T, then count argument words. The first byte (0xBE)
+// can not occur in text output, so the decoder uses it to find the
+// records; with USE_CRC_CHECK it is a CRC of the other 7 bytes instead.
+// The decoder does not support LITE_VERSION.
+
 // define USE_CRC_CHECK
 //#define LITE_VERSION
 
+// 17-bit string offset
+#define TRACE_ID_STR_SPACE (1 << 17)
+
 typedef struct {
   uint32_t crc : 6;
   uint32_t count : 4;
@@ -982,6 +997,47 @@ uint8_t crc6(uint8_t *data, uint32_t length) {
   return crc;
 }
 
+#if defined(RTOS) && defined(KERNEL_RTX5)
+// RTX5 thread ids are control block pointers. They are numbered from 1 in
+// the order the threads first trace; 0 is an ISR or no thread, and the
+// last index is shared by the threads beyond the table.
+#define TRACE_ID_TSK_NUM ((1 << 5) - 1)
+
+static osThreadId_t trace_id_threads[TRACE_ID_TSK_NUM - 1];
+
+static uint32_t hal_trace_id_task_index(void) {
+  osThreadId_t id;
+  uint32_t lock;
+  uint32_t i;
+
+  if (in_isr()) {
+    return 0;
+  }
+  id = osThreadGetId();
+  if (id == NULL) {
+    return 0;
+  }
+  for (i = 0; i < ARRAY_SIZE(trace_id_threads) && trace_id_threads[i]; i++) {
+    if (trace_id_threads[i] == id) {
+      return i + 1;
+    }
+  }
+
+  lock = int_lock();
+  for (i = 0; i < ARRAY_SIZE(trace_id_threads); i++) {
+    if (trace_id_threads[i] == id) {
+      break;
+    } else if (trace_id_threads[i] == NULL) {
+      trace_id_threads[i] = id;
+      break;
+    }
+  }
+  int_unlock(lock);
+
+  return i + 1;
+}
+#endif
+
 static int hal_trace_format_id(uint32_t attr, char *buf, uint32_t size,
                                const char *fmt, va_list ap) {
   uint8_t num;
@@ -991,6 +1047,11 @@ static int hal_trace_format_id(uint32_t attr, char *buf, uint32_t size,
   if (size < sizeof(trace) + sizeof(value)) {
     return -1;
   }
+  if ((uint32_t)fmt < (uint32_t)__trc_str_start__ ||
+      (uint32_t)fmt >= (uint32_t)__trc_str_end__ ||
+      (uint32_t)fmt - (uint32_t)__trc_str_start__ >= TRACE_ID_STR_SPACE) {
+    return -1;
+  }
 
   num = GET_BITFIELD(attr, LOG_ATTR_ARG_NUM);
   if (num > 10) {
@@ -1003,10 +1064,14 @@ static int hal_trace_format_id(uint32_t attr, char *buf, uint32_t size,
   // memset(buf, 0, size);
 
   trace.trace_info.count = num;
-  trace.trace_info.addr =
-      (uint32_t)fmt -
-      (uint32_t)0xFFFC0000; //(uint32_t)fmt-(uint32_t)__trc_str_start__;
+  trace.trace_info.addr = (uint32_t)fmt - (uint32_t)__trc_str_start__;
+#if defined(RTOS) && defined(KERNEL_RTX5)
+  trace.trace_info.tskid = hal_trace_id_task_index();
+#elif defined(RTOS)
   trace.trace_info.tskid = osGetThreadIntId();
+#else
+  trace.trace_info.tskid = 0;
+#endif
   trace.trace_info.crc = 0x2A;
 #ifndef LITE_VERSION
   trace.trace_head.timestamp = TICKS_TO_MS(hal_sys_timer_get());
@@ -188,6 +188,9 @@ extern void         osRtxThreadSwitch     (os_thread_t *thread);
 #if __RTX_CPU_STATISTICS__
 uint32_t rtx_get_hwticks(void);
 #endif
+#ifdef THREAD_PROF_ENABLED
+void rtx_thread_prof_switch(const os_thread_t *thread);
+#endif
 extern void         osRtxThreadDispatch   (os_thread_t *thread);
 extern void         osRtxThreadWaitExit   (os_thread_t *thread, uint32_t ret_val, bool_t dispatch);
 extern bool_t       osRtxThreadWaitEnter  (uint8_t state, uint32_t timeout);
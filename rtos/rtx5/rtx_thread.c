@@ -447,6 +447,9 @@ void osRtxThreadSwitch(os_thread_t *thread) {
           HWTICKS_TO_MS(rtx_get_hwticks());
     thread->swap_in_time = HWTICKS_TO_MS(rtx_get_hwticks());
   }
+#endif
+#ifdef THREAD_PROF_ENABLED
+  rtx_thread_prof_switch(thread);
 #endif
   osRtxThreadStackCheck();
   EvrRtxThreadSwitched(thread);
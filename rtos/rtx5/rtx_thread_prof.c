@@ -0,0 +1,279 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#ifdef THREAD_PROF_ENABLED
+
+#include "cmsis.h"
+#include "cmsis_nvic.h"
+#include "hal_location.h"
+#include "hal_sysfreq.h"
+#include "hal_timer.h"
+#include "hal_trace.h"
+#include "rtx_lib.h"
+#include "string.h"
+#include "thread_prof.h"
+
+// Thread time is read from the fast system timer at every switch made by
+// osRtxThreadSwitch() and at every user IRQ entry and exit, which the
+// virtual vector table wraps. Kernel exceptions (SVC, PendSV, SysTick) are
+// charged to the thread they interrupt. The window length is taken from
+// the slow system timer, which also runs while the idle thread sleeps.
+
+#define THREAD_PROF_TOP_NUM 3
+
+struct THREAD_PROF_STACK_T {
+  const void *id;
+  const char *name;
+  uint32_t size;
+  uint32_t used;
+};
+
+static bool prof_started;
+static uint32_t prof_window_start;
+
+static struct THREAD_PROF_SAMPLE_T prof_sample;
+static THREAD_PROF_STATS_T prof_stats;
+
+static void SRAM_TEXT_LOC rtx_thread_prof_irq_enter(void) {
+  uint32_t lock;
+
+  lock = int_lock_global();
+  thread_prof_irq_enter(hal_fast_sys_timer_get());
+  int_unlock_global(lock);
+}
+
+static void SRAM_TEXT_LOC rtx_thread_prof_irq_exit(void) {
+  uint32_t lock;
+
+  lock = int_lock_global();
+  thread_prof_irq_exit(hal_fast_sys_timer_get());
+  int_unlock_global(lock);
+}
+
+void SRAM_TEXT_LOC rtx_thread_prof_switch(const os_thread_t *thread) {
+  uint32_t lock;
+
+  if (!prof_started) {
+    return;
+  }
+  lock = int_lock_global();
+  thread_prof_switch(thread, thread->name, hal_fast_sys_timer_get());
+  int_unlock_global(lock);
+}
+
+void thread_prof_start(void) {
+  const os_thread_t *thread;
+  uint32_t lock;
+
+  if (prof_started) {
+    return;
+  }
+
+  lock = int_lock_global();
+  thread = osRtxInfo.thread.run.curr;
+  thread_prof_reset(hal_fast_sys_timer_get());
+  if (thread) {
+    thread_prof_switch(thread, thread->name, hal_fast_sys_timer_get());
+  }
+  prof_window_start = hal_sys_timer_get();
+  prof_started = true;
+  int_unlock_global(lock);
+
+  NVIC_SetIrqHooks(rtx_thread_prof_irq_enter, rtx_thread_prof_irq_exit);
+}
+
+static uint32_t rtx_thread_prof_stack_used(const os_thread_t *thread) {
+  const uint32_t *stack;
+  uint32_t space;
+
+  if ((osRtxConfig.flags & osRtxConfigStackWatermark) == 0U ||
+      thread->stack_mem == NULL) {
+    return 0;
+  }
+
+  stack = thread->stack_mem;
+  if (*stack++ != osRtxStackMagicWord) {
+    return thread->stack_size;
+  }
+  for (space = 4U; space < thread->stack_size; space += 4U) {
+    if (*stack++ != osRtxStackFillPattern) {
+      break;
+    }
+  }
+  return thread->stack_size - space;
+}
+
+static uint32_t rtx_thread_prof_add_stack(struct THREAD_PROF_STACK_T *list,
+                                          uint32_t num,
+                                          const os_thread_t *thread) {
+  if (thread == NULL || num >= THREAD_PROF_MAX_THREADS) {
+    return num;
+  }
+  list[num].id = thread;
+  list[num].name = thread->name;
+  list[num].size = thread->stack_size;
+  list[num].used = rtx_thread_prof_stack_used(thread);
+  return num + 1;
+}
+
+static void rtx_thread_prof_update_stacks(void) {
+  struct THREAD_PROF_STACK_T list[THREAD_PROF_MAX_THREADS];
+  const os_thread_t *thread;
+  uint32_t num = 0;
+  uint32_t lock;
+  uint32_t i;
+
+  // The thread lists only change in the kernel, which int_lock() holds off
+  lock = int_lock();
+  num = rtx_thread_prof_add_stack(list, num, osRtxInfo.thread.run.curr);
+  for (thread = osRtxInfo.thread.ready.thread_list; thread != NULL;
+       thread = thread->thread_next) {
+    num = rtx_thread_prof_add_stack(list, num, thread);
+  }
+  for (thread = osRtxInfo.thread.delay_list; thread != NULL;
+       thread = thread->delay_next) {
+    num = rtx_thread_prof_add_stack(list, num, thread);
+  }
+  for (thread = osRtxInfo.thread.wait_list; thread != NULL;
+       thread = thread->delay_next) {
+    num = rtx_thread_prof_add_stack(list, num, thread);
+  }
+  int_unlock(lock);
+
+  lock = int_lock_global();
+  for (i = 0; i < num; i++) {
+    thread_prof_set_stack(list[i].id, list[i].name, list[i].size,
+                          list[i].used);
+  }
+  int_unlock_global(lock);
+}
+
+static uint16_t rtx_thread_prof_permille(uint64_t val, uint64_t total) {
+  if (total == 0) {
+    return 0;
+  }
+  return (uint16_t)(val * 1000 / total);
+}
+
+uint32_t thread_prof_stats_get(THREAD_PROF_STATS_T *stats, bool restart) {
+  struct THREAD_PROF_SAMPLE_T *s = &prof_sample;
+  const struct THREAD_PROF_ENTRY_T *e;
+  THREAD_PROF_STATS_ENTRY_T *out;
+  uint32_t window_start, now;
+  uint64_t window, busy;
+  uint32_t lock;
+  uint32_t i, len;
+
+  memset(stats, 0, sizeof(*stats));
+  stats->version = THREAD_PROF_STATS_VERSION;
+  if (!prof_started) {
+    return offsetof(THREAD_PROF_STATS_T, entry);
+  }
+
+  rtx_thread_prof_update_stacks();
+
+  lock = int_lock_global();
+  now = hal_sys_timer_get();
+  window_start = prof_window_start;
+  if (restart) {
+    prof_window_start = now;
+  }
+  thread_prof_sample(s, hal_fast_sys_timer_get(), restart);
+  int_unlock_global(lock);
+
+  window = (uint64_t)(now - window_start) * CONFIG_FAST_SYSTICK_HZ /
+           CONFIG_SYSTICK_HZ;
+  if (window < s->total) {
+    window = s->total;
+  }
+
+  busy = s->isr;
+  for (i = 0; i < s->num; i++) {
+    e = &s->entry[i];
+    out = &stats->entry[i];
+    if (e->name) {
+      strncpy(out->name, e->name, sizeof(out->name) - 1);
+    }
+    out->cpu = rtx_thread_prof_permille(e->run, window);
+    out->stack_size = (uint16_t)e->stack_size;
+    out->stack_used = (uint16_t)e->stack_used;
+    out->switches = e->switches;
+    if (e->id == NULL) {
+      out->flags |= THREAD_PROF_FLAG_OTHER;
+    } else if (e->id == osRtxInfo.thread.idle) {
+      out->flags |= THREAD_PROF_FLAG_IDLE;
+      continue;
+    }
+    busy += e->run;
+  }
+
+  stats->num = (uint8_t)s->num;
+  stats->load = rtx_thread_prof_permille(busy, window);
+  stats->isr = rtx_thread_prof_permille(s->isr, window);
+  stats->sysfreq = (uint16_t)hal_sysfreq_get();
+  stats->window = TICKS_TO_MS(now - window_start);
+  stats->irq_cnt = s->irq_cnt;
+
+  len = offsetof(THREAD_PROF_STATS_T, entry) +
+        s->num * sizeof(THREAD_PROF_STATS_ENTRY_T);
+  return len;
+}
+
+void thread_prof_print(bool verbose, bool restart) {
+  THREAD_PROF_STATS_T *stats = &prof_stats;
+  const THREAD_PROF_STATS_ENTRY_T *e;
+  const THREAD_PROF_STATS_ENTRY_T *top[THREAD_PROF_TOP_NUM];
+  static const THREAD_PROF_STATS_ENTRY_T none;
+  uint32_t i, j, k;
+
+  thread_prof_stats_get(stats, restart);
+
+  for (i = 0; i < ARRAY_SIZE(top); i++) {
+    top[i] = &none;
+  }
+  for (i = 0; i < stats->num; i++) {
+    e = &stats->entry[i];
+    if (e->flags & THREAD_PROF_FLAG_IDLE) {
+      continue;
+    }
+    for (j = 0; j < ARRAY_SIZE(top); j++) {
+      if (e->cpu > top[j]->cpu) {
+        for (k = ARRAY_SIZE(top) - 1; k > j; k--) {
+          top[k] = top[k - 1];
+        }
+        top[j] = e;
+        break;
+      }
+    }
+  }
+
+  TRACE(11,
+        "[PROF] %ums load=%u isr=%u irq=%u freq=%u | %s=%u %s=%u %s=%u",
+        stats->window, stats->load, stats->isr, stats->irq_cnt,
+        stats->sysfreq, top[0]->name, top[0]->cpu, top[1]->name,
+        top[1]->cpu, top[2]->name, top[2]->cpu);
+
+  if (!verbose) {
+    return;
+  }
+  for (i = 0; i < stats->num; i++) {
+    e = &stats->entry[i];
+    TRACE(6, "[PROF]   %-11s cpu=%4u sw=%6u stack=%u/%u%s", e->name,
+          e->cpu, e->switches, e->stack_used, e->stack_size,
+          (e->flags & THREAD_PROF_FLAG_IDLE) ? " idle" : "");
+  }
+}
+
+#endif
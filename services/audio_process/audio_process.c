@@ -59,6 +59,7 @@ Audio Flow:
 #include "hw_codec_iir_process.h"
 #include "hw_iir_process.h"
 #include "limiter.h"
+#include "perf_probe.h"
 #include "stdbool.h"
 #include "string.h"
 #include "tgt_hardware.h"
@@ -101,6 +102,15 @@ Audio Flow:
 
 #if defined(__SW_IIR_EQ_PROCESS__)
 extern const IIR_CFG_T *const audio_eq_sw_iir_cfg_list[EQ_SW_IIR_LIST_NUM];
+
+#ifdef SW_IIR_BIQUAD
+// Run the SW EQ on the in-tree biquad engine instead of the filters library
+#include "sw_iir_biquad.h"
+#define iir_open sw_iir_biquad_open
+#define iir_set_cfg sw_iir_biquad_set_cfg
+#define iir_run sw_iir_biquad_run
+#define iir_close sw_iir_biquad_close
+#endif
 #endif
 
 #if defined(__HW_DAC_IIR_EQ_PROCESS__)
@@ -155,6 +165,15 @@ extern const LimiterConfig audio_drc2_cfg;
 #define CODEC_OUTPUT_DEV CFG_HW_AUD_OUTPUT_PATH_SPEAKER_DEV
 #endif
 
+#ifndef AUDIO_PROCESS_BLOCK
+#define AUDIO_PROCESS_BLOCK (32)
+#endif
+
+#ifdef AUDIO_PROCESS_DUMP
+#include "audio_dump.h"
+static short dump_buf[1024];
+#endif
+
 typedef signed int pcm_24bits_t;
 typedef signed short int pcm_16bits_t;
 
@@ -400,64 +419,86 @@ int audio_eq_set_cfg(const FIR_CFG_T *fir_cfg, const IIR_CFG_T *iir_cfg,
   return 0;
 }
 
-int SRAM_TEXT_LOC audio_process_run(uint8_t *buf, uint32_t len) {
-  int POSSIBLY_UNUSED pcm_len = 0;
-
-  if (audio_process.sample_bits == AUD_BITS_16) {
-    pcm_len = len / sizeof(pcm_16bits_t);
-  } else if (audio_process.sample_bits == AUD_BITS_24) {
-    pcm_len = len / sizeof(pcm_24bits_t);
-  } else {
-    ASSERT(0, "[%s] bits(%d) is invalid", __func__, audio_process.sample_bits);
-  }
-
-  if (audio_process.sw_ch_num == audio_process.hw_ch_num) {
-    // do nothing
-  } else if (audio_process.sw_ch_num == AUD_CHANNEL_NUM_1 &&
-             audio_process.hw_ch_num == AUD_CHANNEL_NUM_2) {
-    if (audio_process.sample_bits == AUD_BITS_16) {
-      int16_t *pcm_buf = (int16_t *)buf;
-      for (uint32_t i = 0, j = 0; i < pcm_len; i += 2, j++) {
-        pcm_buf[j] = pcm_buf[i];
-      }
-    } else {
-      int32_t *pcm_buf = (int32_t *)buf;
-      for (uint32_t i = 0, j = 0; i < pcm_len; i += 2, j++) {
-        pcm_buf[j] = pcm_buf[i];
-      }
-    }
-
-    pcm_len /= 2;
-  } else {
-    ASSERT(0, "[%s] sw_ch_num(%d) or hw_ch_num(%d) is invalid", __FUNCTION__,
-           audio_process.sw_ch_num, audio_process.hw_ch_num);
-  }
-
-#ifdef AUDIO_PROCESS_DUMP
-  int *buf32 = (int *)buf;
-  for (int i = 0; i < 1024; i++)
-    dump_buf[i] = buf32[2 * i] >> 8;
-  audio_dump_clear_up();
-  audio_dump_add_channel_data(0, dump_buf, 1024);
-
-#endif
+// Stages of audio_process_run(), in order, between the mono downmix and the
+// upmix. Only the enabled ones are compiled in, and each gets the whole
+// buffer. With AUDIO_PROCESS_FUSED the SW IIR EQ, which keeps its state from
+// one call to the next, is the only stage: it runs with the downmix and the
+// upmix one block of AUDIO_PROCESS_BLOCK frames at a time, while the block is
+// still in cache. The HW EQs are started once per buffer, and DRC and the
+// limiter are created for a frame_size of one whole buffer, so they are not
+// fused.
 
-  // int32_t s_time,e_time;
-  // s_time = hal_fast_sys_timer_get();
+typedef void (*AUDIO_PROCESS_STAGE_RUN_T)(uint8_t *buf, uint32_t pcm_len);
 
 #ifdef __SW_IIR_EQ_PROCESS__
+static void SRAM_TEXT_LOC audio_process_sw_iir_stage(uint8_t *buf,
+                                                     uint32_t pcm_len) {
   if (audio_process.sw_iir_enable) {
     iir_run(buf, pcm_len);
   }
+}
 #endif
 
 #ifdef __HW_FIR_EQ_PROCESS__
+static void SRAM_TEXT_LOC audio_process_hw_fir_stage(uint8_t *buf,
+                                                     uint32_t pcm_len) {
   if (audio_process.hw_fir_enable) {
     fir_run(buf, pcm_len);
   }
+}
 #endif
 
 #ifdef __AUDIO_DRC__
+static void SRAM_TEXT_LOC audio_process_drc_stage(uint8_t *buf,
+                                                  uint32_t pcm_len) {
+  drc_process(audio_process.drc_st, buf, pcm_len);
+}
+#endif
+
+#ifdef __AUDIO_DRC2__
+static void SRAM_TEXT_LOC audio_process_drc2_stage(uint8_t *buf,
+                                                   uint32_t pcm_len) {
+  limiter_process(audio_process.drc2_st, buf, pcm_len);
+}
+#endif
+
+#ifdef __HW_IIR_EQ_PROCESS__
+static void SRAM_TEXT_LOC audio_process_hw_iir_stage(uint8_t *buf,
+                                                     uint32_t pcm_len) {
+  if (audio_process.hw_iir_enable) {
+    hw_iir_run(buf, pcm_len);
+  }
+}
+#endif
+
+static const AUDIO_PROCESS_STAGE_RUN_T audio_process_stage_list[] = {
+#ifdef __SW_IIR_EQ_PROCESS__
+    audio_process_sw_iir_stage,
+#endif
+#ifdef __HW_FIR_EQ_PROCESS__
+    audio_process_hw_fir_stage,
+#endif
+#ifdef __AUDIO_DRC__
+    audio_process_drc_stage,
+#endif
+#ifdef __AUDIO_DRC2__
+    audio_process_drc2_stage,
+#endif
+#ifdef __HW_IIR_EQ_PROCESS__
+    audio_process_hw_iir_stage,
+#endif
+};
+
+#define AUDIO_PROCESS_STAGE_NUM ARRAY_SIZE(audio_process_stage_list)
+
+#if defined(AUDIO_PROCESS_FUSED) &&                                           \
+    (!defined(__SW_IIR_EQ_PROCESS__) || defined(__HW_FIR_EQ_PROCESS__) ||    \
+     defined(__HW_IIR_EQ_PROCESS__) || defined(__AUDIO_DRC__) ||             \
+     defined(__AUDIO_DRC2__))
+#error "AUDIO_PROCESS_FUSED only fuses SW_IIR_EQ_PROCESS, without other stages"
+#endif
+
+static void SRAM_TEXT_LOC audio_process_update_cfg(void) {
 #ifdef AUDIO_DRC_UPDATE_CFG
   if (audio_process.drc_update) {
     drc_set_config(audio_process.drc_st, &audio_process.drc_cfg);
@@ -465,32 +506,136 @@ int SRAM_TEXT_LOC audio_process_run(uint8_t *buf, uint32_t len) {
   }
 #endif
 
-  drc_process(audio_process.drc_st, buf, pcm_len);
-#endif
-
-  // int32_t m_time = hal_fast_sys_timer_get();
-
-#ifdef __AUDIO_DRC2__
 #ifdef AUDIO_DRC2_UPDATE_CFG
   if (audio_process.drc2_update) {
     limiter_set_config(audio_process.drc2_st, &audio_process.drc2_cfg);
     audio_process.drc2_update = false;
   }
 #endif
+}
 
-  limiter_process(audio_process.drc2_st, buf, pcm_len);
+static void SRAM_TEXT_LOC audio_process_run_stages(uint8_t *buf,
+                                                   uint32_t pcm_len) {
+  uint32_t i;
+
+  for (i = 0; i < AUDIO_PROCESS_STAGE_NUM; i++) {
+    audio_process_stage_list[i](buf, pcm_len);
+  }
+}
+
+#ifdef AUDIO_PROCESS_DUMP
+static void audio_process_dump_input(uint8_t *buf) {
+  int *buf32 = (int *)buf;
+  for (int i = 0; i < 1024; i++)
+    dump_buf[i] = buf32[2 * i] >> 8;
+  audio_dump_clear_up();
+  audio_dump_add_channel_data(0, dump_buf, 1024);
+}
 #endif
 
-#ifdef __HW_IIR_EQ_PROCESS__
-  if (audio_process.hw_iir_enable) {
-    hw_iir_run(buf, pcm_len);
+#ifdef AUDIO_PROCESS_FUSED
+static uint32_t audio_process_sample_size(void) {
+  return (audio_process.sample_bits == AUD_BITS_16) ? sizeof(pcm_16bits_t)
+                                                    : sizeof(pcm_24bits_t);
+}
+
+// Single pass over the buffer. With a mono EQ on a stereo stream, each block
+// is downmixed into work, processed there and upmixed back in place.
+static void SRAM_TEXT_LOC audio_process_run_fused(uint8_t *buf,
+                                                  uint32_t frames) {
+  pcm_24bits_t work[AUDIO_PROCESS_BLOCK];
+  uint32_t hw_ch_num = audio_process.hw_ch_num;
+  uint32_t sw_ch_num = audio_process.sw_ch_num;
+  uint32_t n, i;
+
+  while (frames) {
+    n = (frames < AUDIO_PROCESS_BLOCK) ? frames : AUDIO_PROCESS_BLOCK;
+    if (sw_ch_num == hw_ch_num) {
+      audio_process_run_stages(buf, n * sw_ch_num);
+    } else if (audio_process.sample_bits == AUD_BITS_16) {
+      int16_t *pcm_buf = (int16_t *)buf;
+      int16_t *mono = (int16_t *)work;
+      for (i = 0; i < n; i++) {
+        mono[i] = pcm_buf[i * 2];
+      }
+      audio_process_run_stages((uint8_t *)mono, n);
+      for (i = 0; i < n; i++) {
+        pcm_buf[i * 2 + 1] = mono[i];
+        pcm_buf[i * 2 + 0] = mono[i];
+      }
+    } else {
+      int32_t *pcm_buf = (int32_t *)buf;
+      int32_t *mono = (int32_t *)work;
+      for (i = 0; i < n; i++) {
+        mono[i] = pcm_buf[i * 2];
+      }
+      audio_process_run_stages((uint8_t *)mono, n);
+      for (i = 0; i < n; i++) {
+        pcm_buf[i * 2 + 1] = mono[i];
+        pcm_buf[i * 2 + 0] = mono[i];
+      }
+    }
+    buf += n * hw_ch_num * audio_process_sample_size();
+    frames -= n;
+  }
+}
+#endif
+
+int SRAM_TEXT_LOC audio_process_run(uint8_t *buf, uint32_t len) {
+  int POSSIBLY_UNUSED pcm_len = 0;
+  PERF_PROBE_BEGIN(PERF_PROBE_AUDIO_PROCESS);
+
+  if (audio_process.sample_bits == AUD_BITS_16) {
+    pcm_len = len / sizeof(pcm_16bits_t);
+  } else if (audio_process.sample_bits == AUD_BITS_24) {
+    pcm_len = len / sizeof(pcm_24bits_t);
+  } else {
+    ASSERT(0, "[%s] bits(%d) is invalid", __func__, audio_process.sample_bits);
+  }
+
+  if (!(audio_process.sw_ch_num == audio_process.hw_ch_num ||
+        (audio_process.sw_ch_num == AUD_CHANNEL_NUM_1 &&
+         audio_process.hw_ch_num == AUD_CHANNEL_NUM_2))) {
+    ASSERT(0, "[%s] sw_ch_num(%d) or hw_ch_num(%d) is invalid", __FUNCTION__,
+           audio_process.sw_ch_num, audio_process.hw_ch_num);
   }
+
+  audio_process_update_cfg();
+
+#ifdef AUDIO_PROCESS_FUSED
+#ifdef AUDIO_PROCESS_DUMP
+  audio_process_dump_input(buf);
 #endif
+  audio_process_run_fused(buf, pcm_len / audio_process.hw_ch_num);
+#ifdef AUDIO_PROCESS_DUMP
+  audio_dump_run();
+#endif
+  PERF_PROBE_END(PERF_PROBE_AUDIO_PROCESS);
+  return 0;
+#else
+  if (audio_process.sw_ch_num != audio_process.hw_ch_num) {
+    if (audio_process.sample_bits == AUD_BITS_16) {
+      int16_t *pcm_buf = (int16_t *)buf;
+      for (uint32_t i = 0, j = 0; i < pcm_len; i += 2, j++) {
+        pcm_buf[j] = pcm_buf[i];
+      }
+    } else {
+      int32_t *pcm_buf = (int32_t *)buf;
+      for (uint32_t i = 0, j = 0; i < pcm_len; i += 2, j++) {
+        pcm_buf[j] = pcm_buf[i];
+      }
+    }
+
+    pcm_len /= 2;
+  }
 
-  if (audio_process.sw_ch_num == audio_process.hw_ch_num) {
-    // do nothing
-  } else if (audio_process.sw_ch_num == AUD_CHANNEL_NUM_1 &&
-             audio_process.hw_ch_num == AUD_CHANNEL_NUM_2) {
+#ifdef AUDIO_PROCESS_DUMP
+  audio_process_dump_input(buf);
+#endif
+
+  audio_process_run_stages(buf, pcm_len);
+
+  if (audio_process.sw_ch_num != audio_process.hw_ch_num) {
     if (audio_process.sample_bits == AUD_BITS_16) {
       int16_t *pcm_buf = (int16_t *)buf;
       for (int32_t i = pcm_len - 1, j = 2 * pcm_len - 1; i >= 0; i--, j -= 2) {
@@ -506,9 +651,6 @@ int SRAM_TEXT_LOC audio_process_run(uint8_t *buf, uint32_t len) {
     }
 
     pcm_len *= 2;
-  } else {
-    ASSERT(0, "[%s] sw_ch_num(%d) or hw_ch_num(%d) is invalid", __FUNCTION__,
-           audio_process.sw_ch_num, audio_process.hw_ch_num);
   }
 
 #ifdef AUDIO_PROCESS_DUMP
@@ -518,12 +660,9 @@ int SRAM_TEXT_LOC audio_process_run(uint8_t *buf, uint32_t len) {
   audio_dump_run();
 #endif
 
-  // e_time = hal_fast_sys_timer_get();
-  // TRACE(4,"[%s] Sample len = %d, drc1 %d us, drc2 %d us",
-  //    __func__, pcm_len, FAST_TICKS_TO_US(m_time - s_time),
-  //    FAST_TICKS_TO_US(e_time - m_time));
-
+  PERF_PROBE_END(PERF_PROBE_AUDIO_PROCESS);
   return 0;
+#endif
 }
 
 /*
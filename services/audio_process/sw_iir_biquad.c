@@ -0,0 +1,452 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#if defined(__SW_IIR_EQ_PROCESS__) && defined(SW_IIR_BIQUAD)
+
+#include "sw_iir_biquad.h"
+#include "cmsis.h"
+#include "hal_location.h"
+#include "hal_trace.h"
+#include "stdbool.h"
+#include "string.h"
+
+// eq_cfg.h shares its include guard with fir_process.h
+void iir_coefs_generate(IIR_TYPE_T type, float gain, float fn, float Q,
+                        float *coefs);
+float iir_convert_db_to_multiple(float db);
+
+// Samples are processed as Q(WORK_BITS - 1) in int32, which leaves 12 dB of
+// headroom between the bands and 14 (16-bit) or 6 (24-bit) bits below the
+// PCM LSB.
+#define SW_IIR_BIQUAD_WORK_BITS 30
+#define SW_IIR_BIQUAD_COEF_Q 30
+#define SW_IIR_BIQUAD_GAIN_Q 28
+#define SW_IIR_BIQUAD_MAX_SHIFT 3
+#define SW_IIR_BIQUAD_MAX_CH 2
+#define SW_IIR_BIQUAD_BANK_NUM 3
+#define SW_IIR_BIQUAD_NONE (-1)
+
+// y = b0*x + b1*x1 + b2*x2 + na1*y1 + na2*y2, coefficients in
+// Q(COEF_Q - shift) so that boosts above 6 dB fit
+struct SW_IIR_BIQUAD_STAGE_T {
+  int32_t b0;
+  int32_t b1;
+  int32_t b2;
+  int32_t na1;
+  int32_t na2;
+  uint32_t shift;
+};
+
+struct SW_IIR_BIQUAD_BANK_T {
+  int num;
+  int32_t gain[SW_IIR_BIQUAD_MAX_CH];
+  struct SW_IIR_BIQUAD_STAGE_T stage[IIR_PARAM_NUM];
+};
+
+struct SW_IIR_BIQUAD_STATE_T {
+  int32_t x1;
+  int32_t x2;
+  int32_t y1;
+  int32_t y2;
+  uint32_t err;
+};
+
+// The three banks are the one in use, the one being faded out and the one
+// set_cfg() fills. The indexes only change under int_lock().
+struct SW_IIR_BIQUAD_T {
+  enum AUD_SAMPRATE_T sample_rate;
+  enum AUD_BITS_T sample_bits;
+  uint32_t ch_num;
+  uint32_t warmup_len;
+  uint32_t fade_len;
+  uint32_t fade_step;
+  uint32_t fade_pos;
+  bool started;
+  volatile int8_t active;
+  volatile int8_t pending;
+  volatile int8_t fading;
+  struct SW_IIR_BIQUAD_BANK_T bank[SW_IIR_BIQUAD_BANK_NUM];
+  struct SW_IIR_BIQUAD_STATE_T state[SW_IIR_BIQUAD_MAX_CH][IIR_PARAM_NUM];
+  struct SW_IIR_BIQUAD_STATE_T fade_state[SW_IIR_BIQUAD_MAX_CH]
+                                         [IIR_PARAM_NUM];
+};
+
+static struct SW_IIR_BIQUAD_T sw_iir_biquad;
+
+static inline int32_t sw_iir_biquad_sat(int64_t v, int32_t max) {
+  if (v > max) {
+    return max;
+  } else if (v < -max - 1) {
+    return -max - 1;
+  }
+  return (int32_t)v;
+}
+
+static int32_t sw_iir_biquad_to_fixed(float v, uint32_t q) {
+  return sw_iir_biquad_sat((int64_t)((double)v * (double)(1LL << q)),
+                           INT32_MAX);
+}
+
+static void sw_iir_biquad_bank_reset(struct SW_IIR_BIQUAD_BANK_T *bank) {
+  uint32_t ch;
+
+  bank->num = 0;
+  for (ch = 0; ch < SW_IIR_BIQUAD_MAX_CH; ch++) {
+    bank->gain[ch] = 1 << SW_IIR_BIQUAD_GAIN_Q;
+  }
+}
+
+static void sw_iir_biquad_stage_set(struct SW_IIR_BIQUAD_STAGE_T *stage,
+                                    const float *coefs) {
+  float max = 0;
+  uint32_t shift, q;
+  int i;
+
+  // coefs: 1, a1, a2, b0, b1, b2
+  for (i = 1; i < 6; i++) {
+    if (coefs[i] > max) {
+      max = coefs[i];
+    } else if (-coefs[i] > max) {
+      max = -coefs[i];
+    }
+  }
+  for (shift = 0; shift < SW_IIR_BIQUAD_MAX_SHIFT; shift++) {
+    if (max < (float)(2 << shift) * 0.999f) {
+      break;
+    }
+  }
+
+  q = SW_IIR_BIQUAD_COEF_Q - shift;
+  stage->b0 = sw_iir_biquad_to_fixed(coefs[3], q);
+  stage->b1 = sw_iir_biquad_to_fixed(coefs[4], q);
+  stage->b2 = sw_iir_biquad_to_fixed(coefs[5], q);
+  stage->na1 = sw_iir_biquad_to_fixed(-coefs[1], q);
+  stage->na2 = sw_iir_biquad_to_fixed(-coefs[2], q);
+  stage->shift = shift;
+}
+
+// Runs one band over a block. Each output is rounded down and the dropped
+// bits are added to the next one, which pushes the rounding noise away from
+// DC where low-frequency poles would amplify it.
+static void SRAM_TEXT_LOC
+sw_iir_biquad_stage_run(const struct SW_IIR_BIQUAD_STAGE_T *stage,
+                        struct SW_IIR_BIQUAD_STATE_T *st, int32_t *x,
+                        uint32_t n) {
+  const int32_t b0 = stage->b0;
+  const int32_t b1 = stage->b1;
+  const int32_t b2 = stage->b2;
+  const int32_t na1 = stage->na1;
+  const int32_t na2 = stage->na2;
+  const uint32_t q = SW_IIR_BIQUAD_COEF_Q - stage->shift;
+  const uint32_t mask = (1u << q) - 1;
+  int32_t x1 = st->x1;
+  int32_t x2 = st->x2;
+  int32_t y1 = st->y1;
+  int32_t y2 = st->y2;
+  uint32_t err = st->err;
+  int32_t x0, y0;
+  int64_t acc;
+  uint32_t i;
+
+  for (i = 0; i < n; i++) {
+    x0 = x[i];
+    // Each of these is a single SMLAL
+    acc = (int64_t)err;
+    acc += (int64_t)b0 * x0;
+    acc += (int64_t)b1 * x1;
+    acc += (int64_t)b2 * x2;
+    acc += (int64_t)na1 * y1;
+    acc += (int64_t)na2 * y2;
+    err = (uint32_t)acc & mask;
+    y0 = sw_iir_biquad_sat(acc >> q, INT32_MAX);
+    x2 = x1;
+    x1 = x0;
+    y2 = y1;
+    y1 = y0;
+    x[i] = y0;
+  }
+
+  st->x1 = x1;
+  st->x2 = x2;
+  st->y1 = y1;
+  st->y2 = y2;
+  st->err = err;
+}
+
+// Deinterleaves channel ch of the PCM into work, applying the gain
+static void SRAM_TEXT_LOC sw_iir_biquad_load(int32_t *work, const uint8_t *buf,
+                                             uint32_t ch, uint32_t n,
+                                             int32_t gain) {
+  const struct SW_IIR_BIQUAD_T *ctx = &sw_iir_biquad;
+  const uint32_t stride = ctx->ch_num;
+  uint32_t i;
+
+  if (ctx->sample_bits == AUD_BITS_16) {
+    const int16_t *pcm = (const int16_t *)buf + ch;
+    const uint32_t shift =
+        SW_IIR_BIQUAD_GAIN_Q - (SW_IIR_BIQUAD_WORK_BITS - 16);
+    for (i = 0; i < n; i++) {
+      work[i] = sw_iir_biquad_sat(((int64_t)pcm[i * stride] * gain) >> shift,
+                                  INT32_MAX);
+    }
+  } else {
+    const int32_t *pcm = (const int32_t *)buf + ch;
+    const uint32_t shift =
+        SW_IIR_BIQUAD_GAIN_Q - (SW_IIR_BIQUAD_WORK_BITS - 24);
+    for (i = 0; i < n; i++) {
+      work[i] = sw_iir_biquad_sat(((int64_t)pcm[i * stride] * gain) >> shift,
+                                  INT32_MAX);
+    }
+  }
+}
+
+static void SRAM_TEXT_LOC sw_iir_biquad_store(uint8_t *buf, uint32_t ch,
+                                              const int32_t *work,
+                                              uint32_t n) {
+  const struct SW_IIR_BIQUAD_T *ctx = &sw_iir_biquad;
+  const uint32_t stride = ctx->ch_num;
+  uint32_t i;
+
+  if (ctx->sample_bits == AUD_BITS_16) {
+    int16_t *pcm = (int16_t *)buf + ch;
+    const uint32_t shift = SW_IIR_BIQUAD_WORK_BITS - 16;
+    for (i = 0; i < n; i++) {
+      pcm[i * stride] = (int16_t)sw_iir_biquad_sat(
+          ((int64_t)work[i] + (1 << (shift - 1))) >> shift, INT16_MAX);
+    }
+  } else {
+    int32_t *pcm = (int32_t *)buf + ch;
+    const uint32_t shift = SW_IIR_BIQUAD_WORK_BITS - 24;
+    for (i = 0; i < n; i++) {
+      pcm[i * stride] = sw_iir_biquad_sat(
+          ((int64_t)work[i] + (1 << (shift - 1))) >> shift, (1 << 23) - 1);
+    }
+  }
+}
+
+static void SRAM_TEXT_LOC
+sw_iir_biquad_cascade(const struct SW_IIR_BIQUAD_BANK_T *bank,
+                      struct SW_IIR_BIQUAD_STATE_T *st, int32_t *work,
+                      uint32_t n) {
+  int i;
+
+  for (i = 0; i < bank->num; i++) {
+    sw_iir_biquad_stage_run(&bank->stage[i], &st[i], work, n);
+  }
+}
+
+// work += (old - work) * weight of old, which stays 1 during the warm-up and
+// then goes down to 0 over the fade
+static void SRAM_TEXT_LOC sw_iir_biquad_fade(int32_t *work, const int32_t *old,
+                                             uint32_t n, uint32_t pos) {
+  const struct SW_IIR_BIQUAD_T *ctx = &sw_iir_biquad;
+  uint32_t i, t;
+  int32_t w;
+
+  for (i = 0; i < n; i++, pos++) {
+    if (pos < ctx->warmup_len) {
+      w = 32768;
+    } else if ((t = pos - ctx->warmup_len) < ctx->fade_len) {
+      w = 32768 - (int32_t)((t * ctx->fade_step) >> 16);
+    } else {
+      w = 0;
+    }
+    work[i] += (int32_t)((((int64_t)old[i] - work[i]) * w) >> 15);
+  }
+}
+
+static bool sw_iir_biquad_is_bypass(const struct SW_IIR_BIQUAD_BANK_T *bank) {
+  uint32_t ch;
+
+  if (bank->num) {
+    return false;
+  }
+  for (ch = 0; ch < SW_IIR_BIQUAD_MAX_CH; ch++) {
+    if (bank->gain[ch] != (1 << SW_IIR_BIQUAD_GAIN_Q)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int sw_iir_biquad_open(enum AUD_SAMPRATE_T sample_rate,
+                       enum AUD_BITS_T sample_bits,
+                       enum AUD_CHANNEL_NUM_T ch_num) {
+  struct SW_IIR_BIQUAD_T *ctx = &sw_iir_biquad;
+  uint32_t lock;
+
+  ASSERT(sample_bits == AUD_BITS_16 || sample_bits == AUD_BITS_24,
+         "[%s] bits(%d) is invalid", __func__, sample_bits);
+  ASSERT(ch_num >= AUD_CHANNEL_NUM_1 && ch_num <= SW_IIR_BIQUAD_MAX_CH,
+         "[%s] ch_num(%d) is invalid", __func__, ch_num);
+
+  lock = int_lock();
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->sample_rate = sample_rate;
+  ctx->sample_bits = sample_bits;
+  ctx->ch_num = ch_num;
+  ctx->warmup_len = (uint32_t)sample_rate * SW_IIR_BIQUAD_WARMUP_MS / 1000;
+  ctx->fade_len = (uint32_t)sample_rate * SW_IIR_BIQUAD_FADE_MS / 1000;
+  if (ctx->fade_len == 0) {
+    ctx->fade_len = 1;
+  }
+  ctx->fade_step = (32768u << 16) / ctx->fade_len;
+  ctx->active = 0;
+  ctx->pending = SW_IIR_BIQUAD_NONE;
+  ctx->fading = SW_IIR_BIQUAD_NONE;
+  sw_iir_biquad_bank_reset(&ctx->bank[0]);
+  int_unlock(lock);
+
+  return 0;
+}
+
+int sw_iir_biquad_set_cfg(const IIR_CFG_T *cfg) {
+  struct SW_IIR_BIQUAD_T *ctx = &sw_iir_biquad;
+  struct SW_IIR_BIQUAD_BANK_T *bank;
+  float coefs[6];
+  uint32_t lock;
+  int idx, i;
+
+  if (ctx->sample_rate == 0) {
+    TRACE(1, "[%s] not opened", __func__);
+    return -1;
+  }
+  ASSERT(cfg->num >= 0 && cfg->num <= IIR_PARAM_NUM,
+         "[%s] num(%d) is too large", __func__, cfg->num);
+
+  // Take a bank run() does not use. A configuration that is still pending
+  // is replaced.
+  lock = int_lock();
+  for (idx = 0; idx < SW_IIR_BIQUAD_BANK_NUM; idx++) {
+    if (idx != ctx->active && idx != ctx->fading) {
+      break;
+    }
+  }
+  if (ctx->pending != SW_IIR_BIQUAD_NONE) {
+    idx = ctx->pending;
+    ctx->pending = SW_IIR_BIQUAD_NONE;
+  }
+  int_unlock(lock);
+
+  bank = &ctx->bank[idx];
+  bank->num = cfg->num;
+  bank->gain[0] = sw_iir_biquad_to_fixed(
+      iir_convert_db_to_multiple(cfg->gain0), SW_IIR_BIQUAD_GAIN_Q);
+  bank->gain[1] = sw_iir_biquad_to_fixed(
+      iir_convert_db_to_multiple(cfg->gain1), SW_IIR_BIQUAD_GAIN_Q);
+  for (i = 0; i < cfg->num; i++) {
+    iir_coefs_generate(cfg->param[i].type, cfg->param[i].gain,
+                       cfg->param[i].fc / ctx->sample_rate, cfg->param[i].Q,
+                       coefs);
+    sw_iir_biquad_stage_set(&bank->stage[i], coefs);
+  }
+
+  lock = int_lock();
+  ctx->pending = idx;
+  int_unlock(lock);
+
+  return 0;
+}
+
+int SRAM_TEXT_LOC sw_iir_biquad_run(uint8_t *buf, uint32_t len) {
+  struct SW_IIR_BIQUAD_T *ctx = &sw_iir_biquad;
+  const struct SW_IIR_BIQUAD_BANK_T *bank;
+  const struct SW_IIR_BIQUAD_BANK_T *old = NULL;
+  int32_t work[SW_IIR_BIQUAD_BLOCK];
+  int32_t work_old[SW_IIR_BIQUAD_BLOCK];
+  uint32_t frames, n, ch;
+  uint32_t lock;
+  bool start_fade = false;
+
+  if (ctx->ch_num == 0) {
+    return -1;
+  }
+
+  // A new configuration waits for the previous fade to end. Before the
+  // first samples there is nothing to fade from.
+  lock = int_lock();
+  if (ctx->pending != SW_IIR_BIQUAD_NONE &&
+      ctx->fading == SW_IIR_BIQUAD_NONE) {
+    if (ctx->started) {
+      ctx->fading = ctx->active;
+      start_fade = true;
+    }
+    ctx->active = ctx->pending;
+    ctx->pending = SW_IIR_BIQUAD_NONE;
+  }
+  int_unlock(lock);
+  ctx->started = true;
+
+  bank = &ctx->bank[ctx->active];
+  if (ctx->fading != SW_IIR_BIQUAD_NONE) {
+    old = &ctx->bank[ctx->fading];
+  }
+  if (start_fade) {
+    // The old bands go on with their history, the new ones start from
+    // silence and settle during the warm-up
+    memcpy(ctx->fade_state, ctx->state, sizeof(ctx->state));
+    memset(ctx->state, 0, sizeof(ctx->state));
+    ctx->fade_pos = 0;
+  }
+
+  if (old == NULL && sw_iir_biquad_is_bypass(bank)) {
+    return 0;
+  }
+
+  frames = len / ctx->ch_num;
+  while (frames) {
+    n = (frames < SW_IIR_BIQUAD_BLOCK) ? frames : SW_IIR_BIQUAD_BLOCK;
+    for (ch = 0; ch < ctx->ch_num; ch++) {
+      sw_iir_biquad_load(work, buf, ch, n, bank->gain[ch]);
+      sw_iir_biquad_cascade(bank, ctx->state[ch], work, n);
+      if (old) {
+        sw_iir_biquad_load(work_old, buf, ch, n, old->gain[ch]);
+        sw_iir_biquad_cascade(old, ctx->fade_state[ch], work_old, n);
+        sw_iir_biquad_fade(work, work_old, n, ctx->fade_pos);
+      }
+      sw_iir_biquad_store(buf, ch, work, n);
+    }
+    buf += n * ctx->ch_num *
+           (ctx->sample_bits == AUD_BITS_16 ? sizeof(int16_t)
+                                            : sizeof(int32_t));
+    frames -= n;
+
+    if (old) {
+      ctx->fade_pos += n;
+      if (ctx->fade_pos >= ctx->warmup_len + ctx->fade_len) {
+        old = NULL;
+        lock = int_lock();
+        ctx->fading = SW_IIR_BIQUAD_NONE;
+        int_unlock(lock);
+      }
+    }
+  }
+
+  return 0;
+}
+
+int sw_iir_biquad_close(void) {
+  struct SW_IIR_BIQUAD_T *ctx = &sw_iir_biquad;
+  uint32_t lock;
+
+  lock = int_lock();
+  ctx->sample_rate = 0;
+  ctx->ch_num = 0;
+  int_unlock(lock);
+
+  return 0;
+}
+
+#endif
@@ -0,0 +1,61 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#ifndef __SW_IIR_BIQUAD_H__
+#define __SW_IIR_BIQUAD_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "iir_process.h"
+#include "stdint.h"
+
+// In-tree replacement for the iir_* SW EQ of the filters library, with the
+// same calls and IIR_CFG_T. The PCM is processed in blocks of
+// SW_IIR_BIQUAD_BLOCK frames: each band runs over the whole block with its
+// coefficients and history in registers, 32x32->64 bit MACs and first order
+// error feedback. A new configuration first runs alongside the old one for
+// SW_IIR_BIQUAD_WARMUP_MS, so that its bands settle, and is then
+// cross-faded in over SW_IIR_BIQUAD_FADE_MS.
+//
+// sw_iir_biquad_set_cfg() may be called from another thread than
+// sw_iir_biquad_run().
+
+#ifndef SW_IIR_BIQUAD_BLOCK
+#define SW_IIR_BIQUAD_BLOCK (32)
+#endif
+
+#ifndef SW_IIR_BIQUAD_WARMUP_MS
+#define SW_IIR_BIQUAD_WARMUP_MS (50)
+#endif
+
+#ifndef SW_IIR_BIQUAD_FADE_MS
+#define SW_IIR_BIQUAD_FADE_MS (5)
+#endif
+
+int sw_iir_biquad_open(enum AUD_SAMPRATE_T sample_rate,
+                       enum AUD_BITS_T sample_bits,
+                       enum AUD_CHANNEL_NUM_T ch_num);
+int sw_iir_biquad_set_cfg(const IIR_CFG_T *cfg);
+// len is the number of samples of all channels, as for iir_run()
+int sw_iir_biquad_run(uint8_t *buf, uint32_t len);
+int sw_iir_biquad_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
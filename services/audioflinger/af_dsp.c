@@ -0,0 +1,206 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#include "af_dsp.h"
+#include "string.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "cmsis.h"
+#define AF_DSP_SIMD
+#endif
+
+#define AF_DSP_GAIN_SHIFT (14)
+#define AF_DSP_GAIN_ROUND (1 << (AF_DSP_GAIN_SHIFT - 1))
+
+#ifdef AF_DSP_SIMD
+#define af_dsp_sat16(v) __SSAT((v), 16)
+#define af_dsp_sat24(v) __SSAT((v), 24)
+#else
+static inline int32_t af_dsp_sat16(int32_t v) {
+  if (v > 32767) {
+    return 32767;
+  } else if (v < -32768) {
+    return -32768;
+  }
+  return v;
+}
+
+static inline int32_t af_dsp_sat24(int32_t v) {
+  if (v > 0x7FFFFF) {
+    return 0x7FFFFF;
+  } else if (v < -0x800000) {
+    return -0x800000;
+  }
+  return v;
+}
+#endif
+
+static inline int16_t af_dsp_scale16(int16_t x, int32_t g) {
+  return (int16_t)af_dsp_sat16(((int32_t)x * g + AF_DSP_GAIN_ROUND) >>
+                               AF_DSP_GAIN_SHIFT);
+}
+
+static inline int32_t af_dsp_scale24(int32_t x, int32_t g) {
+  return af_dsp_sat24(
+      (int32_t)(((int64_t)x * g + AF_DSP_GAIN_ROUND) >> AF_DSP_GAIN_SHIFT));
+}
+
+#ifdef AF_DSP_SIMD
+static inline uint32_t af_dsp_read_pair(const int16_t *p) {
+  uint32_t v;
+
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void af_dsp_write_pair(int16_t *p, uint32_t v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+// Scales the low lane by the low half of g_lo and the high lane by the low
+// half of g_hi. The upper halves of both gains must be 0.
+static inline uint32_t af_dsp_scale_pair(uint32_t x, uint32_t g_lo,
+                                         uint32_t g_hi) {
+  int32_t lo = __SMLAD(x, g_lo, AF_DSP_GAIN_ROUND) >> AF_DSP_GAIN_SHIFT;
+  int32_t hi = __SMLADX(x, g_hi, AF_DSP_GAIN_ROUND) >> AF_DSP_GAIN_SHIFT;
+
+  return __PKHBT(__SSAT(lo, 16), __SSAT(hi, 16), 16);
+}
+#endif
+
+int32_t af_dsp_gain_ramp_16(int16_t *buf, uint32_t frames, uint32_t chans,
+                            int32_t gain, int32_t step) {
+  uint32_t i, c;
+  int32_t g;
+
+#ifdef AF_DSP_SIMD
+  if (chans == 1) {
+    uint32_t g0, g1;
+
+    for (i = 0; i + 2 <= frames; i += 2) {
+      g0 = (uint32_t)(gain >> 16);
+      gain += step;
+      g1 = (uint32_t)(gain >> 16);
+      gain += step;
+      af_dsp_write_pair(buf, af_dsp_scale_pair(af_dsp_read_pair(buf), g0, g1));
+      buf += 2;
+    }
+    if (i < frames) {
+      *buf = af_dsp_scale16(*buf, gain >> 16);
+      gain += step;
+    }
+    return gain;
+  }
+
+  if ((chans & 1) == 0) {
+    uint32_t gp;
+
+    for (i = 0; i < frames; i++) {
+      gp = (uint32_t)(gain >> 16);
+      for (c = 0; c < chans; c += 2) {
+        af_dsp_write_pair(buf, af_dsp_scale_pair(af_dsp_read_pair(buf), gp, gp));
+        buf += 2;
+      }
+      gain += step;
+    }
+    return gain;
+  }
+#endif
+
+  for (i = 0; i < frames; i++) {
+    g = gain >> 16;
+    for (c = 0; c < chans; c++) {
+      *buf = af_dsp_scale16(*buf, g);
+      buf++;
+    }
+    gain += step;
+  }
+  return gain;
+}
+
+int32_t af_dsp_gain_ramp_24(int32_t *buf, uint32_t frames, uint32_t chans,
+                            int32_t gain, int32_t step) {
+  uint32_t i, c;
+  int32_t g;
+
+  if (chans == 2) {
+    for (i = 0; i < frames; i++) {
+      g = gain >> 16;
+      buf[0] = af_dsp_scale24(buf[0], g);
+      buf[1] = af_dsp_scale24(buf[1], g);
+      buf += 2;
+      gain += step;
+    }
+    return gain;
+  }
+
+  for (i = 0; i < frames; i++) {
+    g = gain >> 16;
+    for (c = 0; c < chans; c++) {
+      *buf = af_dsp_scale24(*buf, g);
+      buf++;
+    }
+    gain += step;
+  }
+  return gain;
+}
+
+void af_dsp_dc_offset_16(int16_t *buf, uint32_t frames, uint32_t chans,
+                         int16_t dc_l, int16_t dc_r) {
+  uint32_t samples = frames * chans;
+  uint32_t i = 0;
+
+  if (chans == 1) {
+    dc_r = dc_l;
+  }
+
+#ifdef AF_DSP_SIMD
+  uint32_t dc = __PKHBT(dc_l, dc_r, 16);
+
+  for (; i + 4 <= samples; i += 4) {
+    af_dsp_write_pair(buf, __QADD16(af_dsp_read_pair(buf), dc));
+    af_dsp_write_pair(buf + 2, __QADD16(af_dsp_read_pair(buf + 2), dc));
+    buf += 4;
+  }
+#endif
+
+  for (; i + 2 <= samples; i += 2) {
+    buf[0] = (int16_t)af_dsp_sat16(buf[0] + dc_l);
+    buf[1] = (int16_t)af_dsp_sat16(buf[1] + dc_r);
+    buf += 2;
+  }
+  if (i < samples) {
+    buf[0] = (int16_t)af_dsp_sat16(buf[0] + dc_l);
+  }
+}
+
+void af_dsp_dc_offset_24(int32_t *buf, uint32_t frames, uint32_t chans,
+                         int32_t dc_l, int32_t dc_r, uint32_t shift) {
+  uint32_t samples = frames * chans;
+  uint32_t i = 0;
+
+  if (chans == 1) {
+    dc_r = dc_l;
+  }
+
+  for (; i + 2 <= samples; i += 2) {
+    buf[0] = af_dsp_sat24(buf[0] + dc_l) >> shift;
+    buf[1] = af_dsp_sat24(buf[1] + dc_r) >> shift;
+    buf += 2;
+  }
+  if (i < samples) {
+    buf[0] = af_dsp_sat24(buf[0] + dc_l) >> shift;
+  }
+}
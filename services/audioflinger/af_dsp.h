@@ -0,0 +1,55 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#ifndef __AF_DSP_H__
+#define __AF_DSP_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sample kernels for the audioflinger playback post handler.
+//
+// 16-bit samples are handled as dual 16-bit lanes with the Cortex-M4 DSP
+// instructions when the compiler targets them (__ARM_FEATURE_DSP), and by
+// plain C otherwise. Both builds produce bit-exact results.
+//
+// 24-bit samples are right aligned in 32-bit words.
+//
+// Gains are Q30 and must be >= 0. Frame n is scaled by
+// (gain + n * step) >> 16, i.e. a Q14 factor, with round-to-nearest and
+// saturation to the sample width.
+
+#define AF_DSP_GAIN_Q30_ONE (1 << 30)
+
+int32_t af_dsp_gain_ramp_16(int16_t *buf, uint32_t frames, uint32_t chans,
+                            int32_t gain, int32_t step);
+int32_t af_dsp_gain_ramp_24(int32_t *buf, uint32_t frames, uint32_t chans,
+                            int32_t gain, int32_t step);
+
+// Saturating DC offset. Even channels get dc_l and odd channels dc_r.
+// The 24-bit version shifts the saturated result right by shift.
+void af_dsp_dc_offset_16(int16_t *buf, uint32_t frames, uint32_t chans,
+                         int16_t dc_l, int16_t dc_r);
+void af_dsp_dc_offset_24(int32_t *buf, uint32_t frames, uint32_t chans,
+                         int32_t dc_l, int32_t dc_r, uint32_t shift);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -14,6 +14,7 @@
  *
  ****************************************************************************/
 #include "audioflinger.h"
+#include "af_dsp.h"
 #include "codec_int.h"
 #include "codec_tlv32aic32.h"
 #include "hal_btpcm.h"
@@ -27,6 +28,7 @@
 #include "hal_cmu.h"
 #include "hal_timer.h"
 #include "hal_trace.h"
+#include "perf_probe.h"
 #include "pmu.h"
 #include "string.h"
 #include "tgt_hardware.h"
@@ -316,10 +318,10 @@ int af_stream_fadeout_stop(void) {
 
 uint32_t af_stream_fadeout(int16_t *buf, uint32_t len,
                            enum AUD_CHANNEL_NUM_T num) {
-  uint32_t i;
-  uint32_t j = 0;
   uint32_t start;
   uint32_t end;
+  uint32_t frames;
+  uint32_t recip;
 
   start = af_stream_fade_out.need_fadeout_len_processed;
   end = af_stream_fade_out.need_fadeout_len_processed > len
@@ -332,58 +334,13 @@ uint32_t af_stream_fadeout(int16_t *buf, uint32_t len,
     return len;
   }
   //    TRACE(3,"fadeout l:%d start:%d end:%d", len, start, end);
-  //    DUMP16("%05d ", buf, 10);
-  //    DUMP16("%05d ", buf+len-10, 10);
-
-  if (num == AUD_CHANNEL_NUM_1) {
-    for (i = start; i > end; i--) {
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-    }
-  } else if (num == AUD_CHANNEL_NUM_2) {
-    for (i = start; i > end; i -= 2) {
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-    }
-  } else if (num == AUD_CHANNEL_NUM_4) {
-    for (i = start; i > end; i -= 4) {
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-    }
-  } else if (num == AUD_CHANNEL_NUM_8) {
-    for (i = start; i > end; i -= 8) {
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-      *(buf + j) = *(buf + j) * i / af_stream_fade_out.need_fadeout_len;
-      j++;
-    }
-  }
-  af_stream_fade_out.need_fadeout_len_processed -= j;
-
-  //    TRACE(3,"out i:%d process:%d x:%d", i,
-  //    af_stream_fade_out.need_fadeout_len_processed,
-  //    end+((start-end)/AUD_CHANNEL_NUM_2)); DUMP16("%05d ", buf, 10);
-  //    DUMP16("%05d ", buf+len-10, 10);
+
+  // Frame k is scaled by (start - k * num) / need_fadeout_len
+  recip = AF_DSP_GAIN_Q30_ONE / af_stream_fade_out.need_fadeout_len;
+  frames = (start - end + num - 1) / num;
+  af_dsp_gain_ramp_16(buf, frames, num, (int32_t)(start * recip),
+                      -(int32_t)(num * recip));
+  af_stream_fade_out.need_fadeout_len_processed -= frames * num;
 
   return len;
 }
@@ -499,8 +456,19 @@ static void af_codec_output_gain_changed(float coef) {
   saved_output_coef = coef;
 }
 #ifndef AUDIO_OUTPUT_SW_LIMITER
+// The gain IIR is stepped once per AF_SW_GAIN_BLOCK_FRAMES frames. The input
+// is constant across a block, so 16 steps of the recurrence collapse into
+// y[0..1] = sw_gain_block_coef * (y0, y1, x0, x1, input), computed once from
+// the per-frame coefficients. The applied gain ramps linearly between the
+// block end points.
+#define AF_SW_GAIN_BLOCK_FRAMES (16)
+
+static float sw_gain_block_coef[2][5];
+static bool sw_gain_block_coef_valid;
+static int32_t sw_gain_q30;
+
 static float af_codec_sw_gain_filter(float gain_in) {
-  float gain_out = saved_output_coef * sw_gain_iir.coefs_b[0] +
+  float gain_out = gain_in * sw_gain_iir.coefs_b[0] +
                    sw_gain_iir.history_x[0] * sw_gain_iir.coefs_b[1] +
                    sw_gain_iir.history_x[1] * sw_gain_iir.coefs_b[2] -
                    sw_gain_iir.history_y[0] * sw_gain_iir.coefs_a[1] -
@@ -509,63 +477,106 @@ static float af_codec_sw_gain_filter(float gain_in) {
   sw_gain_iir.history_y[1] = sw_gain_iir.history_y[0];
   sw_gain_iir.history_y[0] = gain_out;
   sw_gain_iir.history_x[1] = sw_gain_iir.history_x[0];
-  sw_gain_iir.history_x[0] = saved_output_coef;
+  sw_gain_iir.history_x[0] = gain_in;
 
   return gain_out;
 }
+
+static void af_codec_sw_gain_block_coef_init(void) {
+  SW_GAIN_IIR_T saved = sw_gain_iir;
+  float *state[4] = {
+      &sw_gain_iir.history_y[0],
+      &sw_gain_iir.history_y[1],
+      &sw_gain_iir.history_x[0],
+      &sw_gain_iir.history_x[1],
+  };
+  uint32_t k, n;
+
+  for (k = 0; k < 5; k++) {
+    sw_gain_iir.history_x[0] = sw_gain_iir.history_x[1] = 0.0f;
+    sw_gain_iir.history_y[0] = sw_gain_iir.history_y[1] = 0.0f;
+    if (k < 4) {
+      *state[k] = 1.0f;
+    }
+    for (n = 0; n < AF_SW_GAIN_BLOCK_FRAMES; n++) {
+      af_codec_sw_gain_filter(k == 4 ? 1.0f : 0.0f);
+    }
+    sw_gain_block_coef[0][k] = sw_gain_iir.history_y[0];
+    sw_gain_block_coef[1][k] = sw_gain_iir.history_y[1];
+  }
+  sw_gain_iir = saved;
+  sw_gain_block_coef_valid = true;
+}
+
+static float af_codec_sw_gain_filter_block(float gain_in) {
+  float in[5] = {sw_gain_iir.history_y[0], sw_gain_iir.history_y[1],
+                 sw_gain_iir.history_x[0], sw_gain_iir.history_x[1], gain_in};
+  float y0 = 0.0f, y1 = 0.0f;
+  uint32_t k;
+
+  for (k = 0; k < 5; k++) {
+    y0 += sw_gain_block_coef[0][k] * in[k];
+    y1 += sw_gain_block_coef[1][k] * in[k];
+  }
+  sw_gain_iir.history_y[0] = y0;
+  sw_gain_iir.history_y[1] = y1;
+  sw_gain_iir.history_x[0] = gain_in;
+  sw_gain_iir.history_x[1] = gain_in;
+
+  return y0;
+}
+
+static int32_t af_codec_sw_gain_to_q30(float gain) {
+  if (gain <= 0.0f) {
+    return 0;
+  } else if (gain >= 1.99f) {
+    return (int32_t)(1.99f * AF_DSP_GAIN_Q30_ONE);
+  }
+  return (int32_t)(gain * AF_DSP_GAIN_Q30_ONE);
+}
+
+static void af_codec_sw_gain_reset(void) {
+  sw_gain_iir.history_x[0] = 0.0f;
+  sw_gain_iir.history_x[1] = 0.0f;
+  sw_gain_iir.history_y[0] = 0.0f;
+  sw_gain_iir.history_y[1] = 0.0f;
+  sw_gain_q30 = 0;
+}
+
 static void af_codec_sw_gain_process(uint8_t *buf, uint32_t size,
                                      enum AUD_BITS_T bits,
                                      enum AUD_CHANNEL_NUM_T chans) {
-  uint32_t i, pcm_len;
-  int32_t pcm_out;
-  float output_gain = 1.0f;
+  uint32_t frames, n, i;
+  float coef = saved_output_coef;
+  float gain = 0.0f;
+  int32_t target, step;
 
-  // TRACE(1,"af_codec_sw_gain_process:%d",(int32_t)(saved_output_coef*1000));
-
-  if (chans == AUD_CHANNEL_NUM_1) {
-    if (bits <= AUD_BITS_16) {
-      pcm_len = size / sizeof(int16_t);
-      int16_t *pcm_buf = (int16_t *)buf;
-      for (i = 0; i < pcm_len; i++) {
-        output_gain = af_codec_sw_gain_filter(saved_output_coef);
+  if (!sw_gain_block_coef_valid) {
+    af_codec_sw_gain_block_coef_init();
+  }
 
-        pcm_out = (int32_t)(pcm_buf[i] * output_gain);
-        pcm_buf[i] = __SSAT(pcm_out, 16);
-      }
+  frames = size / (bits <= AUD_BITS_16 ? sizeof(int16_t) : sizeof(int32_t)) /
+           chans;
+  while (frames) {
+    n = MIN(frames, AF_SW_GAIN_BLOCK_FRAMES);
+    if (n == AF_SW_GAIN_BLOCK_FRAMES) {
+      gain = af_codec_sw_gain_filter_block(coef);
     } else {
-      pcm_len = size / sizeof(int32_t);
-      int32_t *pcm_buf = (int32_t *)buf;
-      for (i = 0; i < pcm_len; i++) {
-        output_gain = af_codec_sw_gain_filter(saved_output_coef);
-
-        pcm_out = (int32_t)(pcm_buf[i] * output_gain);
-        pcm_buf[i] = __SSAT(pcm_out, 24);
+      for (i = 0; i < n; i++) {
+        gain = af_codec_sw_gain_filter(coef);
       }
     }
-  } else if (chans == AUD_CHANNEL_NUM_2) {
+    target = af_codec_sw_gain_to_q30(gain);
+    step = (target - sw_gain_q30) / (int32_t)n;
     if (bits <= AUD_BITS_16) {
-      pcm_len = size / sizeof(int16_t);
-      int16_t *pcm_buf = (int16_t *)buf;
-      for (i = 0; i < pcm_len; i = i + 2) {
-        output_gain = af_codec_sw_gain_filter(saved_output_coef);
-
-        pcm_out = (int32_t)(pcm_buf[i] * output_gain);
-        pcm_buf[i] = __SSAT(pcm_out, 16);
-        pcm_out = (int32_t)(pcm_buf[i + 1] * output_gain);
-        pcm_buf[i + 1] = __SSAT(pcm_out, 16);
-      }
+      af_dsp_gain_ramp_16((int16_t *)buf, n, chans, sw_gain_q30, step);
+      buf += n * chans * sizeof(int16_t);
     } else {
-      pcm_len = size / sizeof(int32_t);
-      int32_t *pcm_buf = (int32_t *)buf;
-      for (i = 0; i < pcm_len; i = i + 2) {
-        output_gain = af_codec_sw_gain_filter(saved_output_coef);
-
-        pcm_out = (int32_t)(pcm_buf[i] * output_gain);
-        pcm_buf[i] = __SSAT(pcm_out, 24);
-        pcm_out = (int32_t)(pcm_buf[i + 1] * output_gain);
-        pcm_buf[i + 1] = __SSAT(pcm_out, 24);
-      }
+      af_dsp_gain_ramp_24((int32_t *)buf, n, chans, sw_gain_q30, step);
+      buf += n * chans * sizeof(int32_t);
     }
+    sw_gain_q30 = target;
+    frames -= n;
   }
 }
 #endif
@@ -640,41 +651,17 @@ static bool af_codec_playback_pre_handler(uint8_t *buf, uint32_t len,
 static void af_codec_playback_sw_dc_calib(uint8_t *buf, uint32_t len,
                                           enum AUD_BITS_T bits,
                                           enum AUD_CHANNEL_NUM_T chans) {
-  uint32_t cnt;
-
   if (bits <= AUD_BITS_16) {
-    int16_t *ptr16 = (int16_t *)buf;
-#ifdef AUDIO_OUTPUT_DC_CALIB_SW
-    int16_t dc_l = dac_dc[0];
-    int16_t dc_r = dac_dc[1];
-#endif
-    if (chans == AUD_CHANNEL_NUM_1) {
-      cnt = len / sizeof(int16_t);
-      while (cnt-- > 0) {
-#ifdef AUDIO_OUTPUT_DC_CALIB_SW
-        *ptr16 = __SSAT(*ptr16 + dc_l, 16);
-#endif
-        ptr16++;
-      }
-    } else {
-      cnt = len / sizeof(int16_t) / 2;
-      while (cnt-- > 0) {
-#ifdef AUDIO_OUTPUT_DC_CALIB_SW
-        *ptr16 = __SSAT(*ptr16 + dc_l, 16);
-        *(ptr16 + 1) = __SSAT(*(ptr16 + 1) + dc_r, 16);
-#endif
-        ptr16 += 2;
-      }
-    }
+    af_dsp_dc_offset_16((int16_t *)buf, len / sizeof(int16_t) / chans, chans,
+                        dac_dc[0], dac_dc[1]);
   } else {
-    int32_t *ptr32 = (int32_t *)buf;
     int32_t dac_bits =
 #ifdef CHIP_BEST1000
         CODEC_PLAYBACK_BIT_DEPTH;
 #else
         24;
 #endif
-    int32_t val_shift;
+    uint32_t val_shift;
 
     if (dac_bits < 24) {
       val_shift = 24 - dac_bits;
@@ -682,45 +669,19 @@ static void af_codec_playback_sw_dc_calib(uint8_t *buf, uint32_t len,
       val_shift = 0;
     }
 
-#ifdef AUDIO_OUTPUT_DC_CALIB_SW
-    int32_t dc_l = dac_dc[0] << 8;
-    int32_t dc_r = dac_dc[1] << 8;
-#endif
-    if (chans == AUD_CHANNEL_NUM_1) {
-      cnt = len / sizeof(int32_t);
-      while (cnt-- > 0) {
-#ifdef CORRECT_SAMPLE_VALUE
-        *ptr32 = ((*ptr32) << (32 - dac_bits)) >> (32 - dac_bits);
-#endif
-#ifdef AUDIO_OUTPUT_DC_CALIB_SW
-        *ptr32 = __SSAT((*ptr32 + dc_l) >> val_shift, dac_bits);
-#elif defined(CORRECT_SAMPLE_VALUE)
-        *ptr32 = __SSAT(*ptr32 >> val_shift, dac_bits);
-#else
-        *ptr32 = *ptr32 >> val_shift;
-#endif
-        ptr32++;
-      }
-    } else {
-      cnt = len / sizeof(int32_t) / 2;
-      while (cnt-- > 0) {
 #ifdef CORRECT_SAMPLE_VALUE
-        *ptr32 = ((*ptr32) << (32 - dac_bits)) >> (32 - dac_bits);
-        *(ptr32 + 1) = ((*(ptr32 + 1)) << (32 - dac_bits)) >> (32 - dac_bits);
-#endif
-#ifdef AUDIO_OUTPUT_DC_CALIB_SW
-        *ptr32 = __SSAT((*ptr32 + dc_l) >> val_shift, dac_bits);
-        *(ptr32 + 1) = __SSAT((*(ptr32 + 1) + dc_r) >> val_shift, dac_bits);
-#elif defined(CORRECT_SAMPLE_VALUE)
-        *ptr32 = __SSAT(*ptr32 >> val_shift, dac_bits);
-        *(ptr32 + 1) = __SSAT(*(ptr32 + 1) >> val_shift, dac_bits);
-#else
-        *ptr32 = *ptr32 >> val_shift;
-        *(ptr32 + 1) = *(ptr32 + 1) >> val_shift;
-#endif
-        ptr32 += 2;
-      }
+    int32_t *ptr32 = (int32_t *)buf;
+    uint32_t cnt = len / sizeof(int32_t);
+
+    while (cnt-- > 0) {
+      *ptr32 = ((*ptr32) << (32 - dac_bits)) >> (32 - dac_bits);
+      ptr32++;
     }
+#endif
+    // saturating to 24 bits before the shift is the same as saturating to
+    // dac_bits after it
+    af_dsp_dc_offset_24((int32_t *)buf, len / sizeof(int32_t) / chans, chans,
+                        dac_dc[0] << 8, dac_dc[1] << 8, val_shift);
   }
 }
 #endif // AUDIO_OUTPUT_DC_CALIB_SW
@@ -911,11 +872,15 @@ static inline void af_thread_stream_handler(enum AUD_STREAM_ID_T id,
                             role->cfg.channel_num);
       }
 #endif
+      PERF_PROBE_BEGIN(PERF_PROBE_AF_HANDLER);
       role->handler(buf, len);
+      PERF_PROBE_END(PERF_PROBE_AF_HANDLER);
     }
 
     if (codec_playback) {
+      PERF_PROBE_BEGIN(PERF_PROBE_AF_POST);
       af_codec_playback_post_handler(buf, len, role);
+      PERF_PROBE_END(PERF_PROBE_AF_POST);
     }
 
 #if defined(RTOS) && defined(AF_STREAM_ID_0_PLAYBACK_FADEOUT)
@@ -1497,10 +1462,7 @@ uint32_t af_stream_open(enum AUD_STREAM_ID_T id, enum AUD_STREAM_T stream,
         goto _exit;
       }
 #else
-      sw_gain_iir.history_x[0] = 0.0f;
-      sw_gain_iir.history_x[1] = 0.0f;
-      sw_gain_iir.history_y[0] = 0.0f;
-      sw_gain_iir.history_y[1] = 0.0f;
+      af_codec_sw_gain_reset();
 #endif
 #endif
 
@@ -86,6 +86,7 @@
 #include "cqueue.h"
 #include "hal_chipid.h"
 #include "math.h"
+#include "norflash_api.h"
 #include "os_api.h"
 
 #ifdef WL_DET
@@ -2927,6 +2928,7 @@ void app_bt_stream_playback_irq_notification(enum AUD_STREAM_ID_T id,
   if (id != AUD_STREAM_ID_0 || stream != AUD_STREAM_PLAYBACK) {
     return;
   }
+  norflash_api_flush_window_mark();
   app_bt_stream_trigger_result();
 #if defined(IBRT)
   app_tws_ibrt_audio_analysis_interrupt_tick();
@@ -6381,7 +6383,7 @@ int bt_sco_player(bool on, enum APP_SYSFREQ_FREQ_T freq) {
       stream_cfg.sample_rate = AUD_SAMPRATE_16927;
     }
 #ifdef RESAMPLE_ANY_SAMPLE_RATE
-    sco_playback_resample = app_playback_resample_any_open(
+    sco_playback_resample = app_sco_playback_resample_any_open(
         AUD_CHANNEL_NUM_1, bt_sco_playback_resample_iter,
         stream_cfg.data_size / stream_cfg.channel_num / 2,
         (float)CODEC_FREQ_24P576M / CODEC_FREQ_26M);
@@ -7792,6 +7794,59 @@ app_force48k_resample_any_open(enum AUD_CHANNEL_NUM_T chans,
 static APP_RESAMPLE_BUF_ALLOC_CALLBACK resamp_buf_alloc =
     app_audio_mempool_get_buff;
 
+#ifdef RESAMPLE_POLY
+#include "audio_resample_poly.h"
+
+// Taps of the polyphase resampler for A2DP (and prompts) and for SCO. More
+// taps cost more cycles, and the longer tables are not better: the 16-tap
+// one is the cleanest, see audio_resample_poly.h.
+#ifndef RESAMPLE_POLY_A2DP_TAPS
+#define RESAMPLE_POLY_A2DP_TAPS 16
+#endif
+#ifndef RESAMPLE_POLY_SCO_TAPS
+#define RESAMPLE_POLY_SCO_TAPS 16
+#endif
+
+static const struct RESAMPLE_COEF_T *app_resample_any_coef(uint32_t taps) {
+  if (taps <= 16) {
+    return &resample_coef_any_up128_16;
+  } else if (taps <= 24) {
+    return &resample_coef_any_up256;
+  } else if (taps <= 32) {
+    return &resample_coef_any_up64;
+  }
+  return &resample_coef_any_up512_36;
+}
+
+#define APP_RESAMPLE_A2DP_ANY_COEF                                            \
+  app_resample_any_coef(RESAMPLE_POLY_A2DP_TAPS)
+#define APP_RESAMPLE_SCO_ANY_COEF app_resample_any_coef(RESAMPLE_POLY_SCO_TAPS)
+
+// The any rate tables run on the polyphase resampler, the fixed ratio ones
+// stay on the resample library
+#define APP_RESAMPLE_USE_POLY(coef) ((coef)->downsample_factor == 0)
+#define APP_RESAMPLE_CALL(resamp, fn, ...)                                    \
+  ((resamp)->poly ? audio_resample_poly_##fn(__VA_ARGS__)                    \
+                  : audio_resample_ex_##fn(__VA_ARGS__))
+#else
+#define APP_RESAMPLE_A2DP_ANY_COEF (&resample_coef_any_up256)
+#define APP_RESAMPLE_SCO_ANY_COEF (&resample_coef_any_up256)
+#define APP_RESAMPLE_USE_POLY(coef) false
+#define APP_RESAMPLE_CALL(resamp, fn, ...) audio_resample_ex_##fn(__VA_ARGS__)
+#endif
+
+static uint32_t app_resample_get_buffer_size(const struct RESAMPLE_COEF_T *coef,
+                                             enum AUD_CHANNEL_NUM_T chans) {
+#ifdef RESAMPLE_POLY
+  if (APP_RESAMPLE_USE_POLY(coef)) {
+    return audio_resample_poly_get_buffer_size(chans, AUD_BITS_16,
+                                               coef->phase_coef_num);
+  }
+#endif
+  return audio_resample_ex_get_buffer_size(chans, AUD_BITS_16,
+                                           coef->phase_coef_num);
+}
+
 static void memzero_int16(void *dst, uint32_t len) {
   if (dst) {
     int16_t *dst16 = (int16_t *)dst;
@@ -7815,8 +7870,7 @@ struct APP_RESAMPLE_T *app_resample_open_with_preallocated_buf(
   enum RESAMPLE_STATUS_T status;
   uint32_t size, resamp_size;
 
-  resamp_size = audio_resample_ex_get_buffer_size(chans, AUD_BITS_16,
-                                                  coef->phase_coef_num);
+  resamp_size = app_resample_get_buffer_size(coef, chans);
 
   size = sizeof(struct APP_RESAMPLE_T);
   size += ALIGN(iter_len, 4);
@@ -7835,6 +7889,7 @@ struct APP_RESAMPLE_T *app_resample_open_with_preallocated_buf(
   resamp->iter_len = iter_len;
   resamp->offset = iter_len;
   resamp->ratio_step = ratio_step;
+  resamp->poly = APP_RESAMPLE_USE_POLY(coef);
 
   memset(&cfg, 0, sizeof(cfg));
   cfg.chans = chans;
@@ -7844,7 +7899,7 @@ struct APP_RESAMPLE_T *app_resample_open_with_preallocated_buf(
   cfg.buf = buf;
   cfg.size = resamp_size;
 
-  status = audio_resample_ex_open(&cfg, (RESAMPLE_ID *)&resamp->id);
+  status = APP_RESAMPLE_CALL(resamp, open, &cfg, (RESAMPLE_ID *)&resamp->id);
   ASSERT(status == RESAMPLE_STATUS_OK, "%s: Failed to open resample: %d",
          __func__, status);
 
@@ -7867,8 +7922,7 @@ app_resample_open(enum AUD_STREAM_T stream, const struct RESAMPLE_COEF_T *coef,
   uint32_t size, resamp_size;
   uint8_t *buf;
 
-  resamp_size = audio_resample_ex_get_buffer_size(chans, AUD_BITS_16,
-                                                  coef->phase_coef_num);
+  resamp_size = app_resample_get_buffer_size(coef, chans);
 
   size = sizeof(struct APP_RESAMPLE_T);
   size += ALIGN(iter_len, 4);
@@ -7885,6 +7939,7 @@ app_resample_open(enum AUD_STREAM_T stream, const struct RESAMPLE_COEF_T *coef,
   resamp->iter_len = iter_len;
   resamp->offset = iter_len;
   resamp->ratio_step = ratio_step;
+  resamp->poly = APP_RESAMPLE_USE_POLY(coef);
 
   memset(&cfg, 0, sizeof(cfg));
   cfg.chans = chans;
@@ -7894,7 +7949,7 @@ app_resample_open(enum AUD_STREAM_T stream, const struct RESAMPLE_COEF_T *coef,
   cfg.buf = buf;
   cfg.size = resamp_size;
 
-  status = audio_resample_ex_open(&cfg, (RESAMPLE_ID *)&resamp->id);
+  status = APP_RESAMPLE_CALL(resamp, open, &cfg, (RESAMPLE_ID *)&resamp->id);
   ASSERT(status == RESAMPLE_STATUS_OK, "%s: Failed to open resample: %d",
          __func__, status);
 
@@ -7911,7 +7966,7 @@ static int app_resample_close(struct APP_RESAMPLE_T *resamp) {
 #endif
 
   if (resamp) {
-    audio_resample_ex_close((RESAMPLE_ID *)resamp->id);
+    APP_RESAMPLE_CALL(resamp, close, (RESAMPLE_ID *)resamp->id);
   }
 
   return 0;
@@ -7945,7 +8000,17 @@ struct APP_RESAMPLE_T *
 app_playback_resample_any_open(enum AUD_CHANNEL_NUM_T chans,
                                APP_RESAMPLE_ITER_CALLBACK cb, uint32_t iter_len,
                                float ratio_step) {
-  const struct RESAMPLE_COEF_T *coef = &resample_coef_any_up256;
+  const struct RESAMPLE_COEF_T *coef = APP_RESAMPLE_A2DP_ANY_COEF;
+
+  return app_resample_open(AUD_STREAM_PLAYBACK, coef, chans, cb, iter_len,
+                           ratio_step);
+}
+
+struct APP_RESAMPLE_T *
+app_sco_playback_resample_any_open(enum AUD_CHANNEL_NUM_T chans,
+                                   APP_RESAMPLE_ITER_CALLBACK cb,
+                                   uint32_t iter_len, float ratio_step) {
+  const struct RESAMPLE_COEF_T *coef = APP_RESAMPLE_SCO_ANY_COEF;
 
   return app_resample_open(AUD_STREAM_PLAYBACK, coef, chans, cb, iter_len,
                            ratio_step);
@@ -7954,7 +8019,7 @@ app_playback_resample_any_open(enum AUD_CHANNEL_NUM_T chans,
 struct APP_RESAMPLE_T *app_playback_resample_any_open_with_pre_allocated_buffer(
     enum AUD_CHANNEL_NUM_T chans, APP_RESAMPLE_ITER_CALLBACK cb,
     uint32_t iter_len, float ratio_step, uint8_t *ptrBuf, uint32_t bufSize) {
-  const struct RESAMPLE_COEF_T *coef = &resample_coef_any_up256;
+  const struct RESAMPLE_COEF_T *coef = APP_RESAMPLE_A2DP_ANY_COEF;
 
   return app_resample_open_with_preallocated_buf(AUD_STREAM_PLAYBACK, coef,
                                                  chans, cb, iter_len,
@@ -7999,8 +8064,8 @@ int app_playback_resample_run(struct APP_RESAMPLE_T *resamp, uint8_t *buf,
     io.out_size = len;
 
     // lock = int_lock();
-    status = audio_resample_ex_run((RESAMPLE_ID *)resamp->id, &io, &in_size,
-                                   &out_size);
+    status = APP_RESAMPLE_CALL(resamp, run, (RESAMPLE_ID *)resamp->id, &io,
+                               &in_size, &out_size);
     // int_unlock(lock);
     if (status != RESAMPLE_STATUS_OUT_FULL &&
         status != RESAMPLE_STATUS_IN_EMPTY && status != RESAMPLE_STATUS_DONE) {
@@ -8028,8 +8093,8 @@ int app_playback_resample_run(struct APP_RESAMPLE_T *resamp, uint8_t *buf,
     io.out_size = len;
 
     // lock = int_lock();
-    status = audio_resample_ex_run((RESAMPLE_ID *)resamp->id, &io, &in_size,
-                                   &out_size);
+    status = APP_RESAMPLE_CALL(resamp, run, (RESAMPLE_ID *)resamp->id, &io,
+                               &in_size, &out_size);
     // int_unlock(lock);
     if (status != RESAMPLE_STATUS_OUT_FULL &&
         status != RESAMPLE_STATUS_IN_EMPTY && status != RESAMPLE_STATUS_DONE) {
@@ -8087,7 +8152,7 @@ struct APP_RESAMPLE_T *
 app_capture_resample_any_open(enum AUD_CHANNEL_NUM_T chans,
                               APP_RESAMPLE_ITER_CALLBACK cb, uint32_t iter_len,
                               float ratio_step) {
-  const struct RESAMPLE_COEF_T *coef = &resample_coef_any_up256;
+  const struct RESAMPLE_COEF_T *coef = APP_RESAMPLE_SCO_ANY_COEF;
   return app_resample_open(AUD_STREAM_CAPTURE, coef, chans, cb, iter_len,
                            ratio_step);
 }
@@ -8117,8 +8182,8 @@ int app_capture_resample_run(struct APP_RESAMPLE_T *resamp, uint8_t *buf,
     io.out = resamp->iter_buf + resamp->offset;
     io.out_size = resamp->iter_len - resamp->offset;
 
-    status = audio_resample_ex_run((RESAMPLE_ID *)resamp->id, &io, &in_size,
-                                   &out_size);
+    status = APP_RESAMPLE_CALL(resamp, run, (RESAMPLE_ID *)resamp->id, &io,
+                               &in_size, &out_size);
     if (status != RESAMPLE_STATUS_OUT_FULL &&
         status != RESAMPLE_STATUS_IN_EMPTY && status != RESAMPLE_STATUS_DONE) {
       goto _err_exit;
@@ -8146,8 +8211,8 @@ int app_capture_resample_run(struct APP_RESAMPLE_T *resamp, uint8_t *buf,
     io.out = resamp->iter_buf;
     io.out_size = resamp->iter_len;
 
-    status = audio_resample_ex_run((RESAMPLE_ID *)resamp->id, &io, &in_size,
-                                   &out_size);
+    status = APP_RESAMPLE_CALL(resamp, run, (RESAMPLE_ID *)resamp->id, &io,
+                               &in_size, &out_size);
     if (status != RESAMPLE_STATUS_OUT_FULL &&
         status != RESAMPLE_STATUS_IN_EMPTY && status != RESAMPLE_STATUS_DONE) {
       goto _err_exit;
@@ -8187,7 +8252,7 @@ _err_exit:
 }
 
 void app_resample_reset(struct APP_RESAMPLE_T *resamp) {
-  audio_resample_ex_flush((RESAMPLE_ID *)resamp->id);
+  APP_RESAMPLE_CALL(resamp, flush, (RESAMPLE_ID *)resamp->id);
   resamp->offset = resamp->iter_len;
 }
 
@@ -8206,7 +8271,7 @@ void app_resample_tune(struct APP_RESAMPLE_T *resamp, float ratio) {
   } else {
     new_step = resamp->ratio_step - resamp->ratio_step * ratio;
   }
-  audio_resample_ex_set_ratio_step(resamp->id, new_step);
+  APP_RESAMPLE_CALL(resamp, set_ratio_step, resamp->id, new_step);
 }
 
 APP_RESAMPLE_BUF_ALLOC_CALLBACK
@@ -192,6 +192,7 @@ struct APP_RESAMPLE_T {
     uint32_t iter_len;
     uint32_t offset;
     float ratio_step;
+    bool poly;
 };
 
 struct APP_RESAMPLE_T *app_playback_resample_open(enum AUD_SAMPRATE_T sample_rate, enum AUD_CHANNEL_NUM_T chans,
@@ -199,6 +200,9 @@ struct APP_RESAMPLE_T *app_playback_resample_open(enum AUD_SAMPRATE_T sample_rat
 struct APP_RESAMPLE_T *app_playback_resample_any_open(enum AUD_CHANNEL_NUM_T chans,
                                                       APP_RESAMPLE_ITER_CALLBACK cb, uint32_t iter_len,
                                                       float ratio_step);
+struct APP_RESAMPLE_T *app_sco_playback_resample_any_open(enum AUD_CHANNEL_NUM_T chans,
+                                                          APP_RESAMPLE_ITER_CALLBACK cb, uint32_t iter_len,
+                                                          float ratio_step);
 struct APP_RESAMPLE_T *app_playback_resample_any_open_with_pre_allocated_buffer(enum AUD_CHANNEL_NUM_T chans,
         APP_RESAMPLE_ITER_CALLBACK cb, uint32_t iter_len,
         float ratio_step, uint8_t* ptrBuf, uint32_t bufSize);    
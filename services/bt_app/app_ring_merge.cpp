@@ -14,6 +14,7 @@
  *
  ****************************************************************************/
 #include "app_ring_merge.h"
+#include "audio_mix.h"
 #include "audioflinger.h"
 #include "cmsis_os.h"
 #include "hal_trace.h"
@@ -56,35 +57,17 @@ struct APP_RING_MERGE_CONFIG_T app_ring_merge_config = {
     .play = APP_RING_MERGE_PLAY_QTY,
     .handler = NULL};
 
-template <typename DataType> static DataType convertTo(int16_t x) {
-  return (x);
+// The stream and the ring at half gain each, mixed in place into the stream
+static void app_ring_merge_track_2_in_1(int16_t *buf, int16_t *ring,
+                                        uint32_t len) {
+  audio_mix_avg_16(buf, ring, len);
 }
 
-template <> int32_t convertTo<int32_t>(int16_t x) { return (x << 8); }
-
-template <typename DataType>
-static void app_ring_merge_track_2_in_1(DataType *src_buf0, int16_t *src_buf1,
-                                        DataType *dst_buf, uint32_t src_len) {
-  uint32_t i = 0;
-  for (i = 0; i < src_len; i++) {
-    dst_buf[i] = (src_buf0[i] >> 1) + ((convertTo<DataType>(src_buf1[i])) >> 1);
-  }
+static void app_ring_merge_track_2_in_1(int32_t *buf, int16_t *ring,
+                                        uint32_t len) {
+  audio_mix_avg_24(buf, ring, len);
 }
 
-/*
-static void app_ring_merge_track_2_in_1_16bits(int16_t *src_buf0, int16_t
-*src_buf1, int16_t *dst_buf,  uint32_t src_len)
-{
-    app_ring_merge_track_2_in_1<int16_t>(src_buf0, src_buf1, dst_buf, src_len);
-}
-
-static void app_ring_merge_track_2_in_1_24bits(int32_t *src_buf0, int16_t
-*src_buf1, int32_t *dst_buf,  uint32_t src_len)
-{
-    app_ring_merge_track_2_in_1<int32_t>(src_buf0, src_buf1, dst_buf, src_len);
-}
-*/
-
 template <typename DataType>
 static uint32_t app_ring_merge_oneshot_more_data_impl(uint8_t *buf,
                                                       uint32_t len) {
@@ -98,20 +81,20 @@ static uint32_t app_ring_merge_oneshot_more_data_impl(uint8_t *buf,
   }
 
   if (need_len > app_ring_merge_config.len) {
-    app_ring_merge_track_2_in_1(pBuf, app_ring_merge_config.pbuf, pBuf,
+    app_ring_merge_track_2_in_1(pBuf, app_ring_merge_config.pbuf,
                                 app_ring_merge_config.len);
     app_ring_merge_config.next = app_ring_merge_config.len;
     app_ring_merge_finished_callback();
   } else {
     if ((app_ring_merge_config.len - app_ring_merge_config.next) >= need_len) {
       app_ring_merge_track_2_in_1(
-          pBuf, app_ring_merge_config.pbuf + app_ring_merge_config.next, pBuf,
+          pBuf, app_ring_merge_config.pbuf + app_ring_merge_config.next,
           need_len);
       app_ring_merge_config.next += need_len;
     } else {
       curr_size = app_ring_merge_config.len - app_ring_merge_config.next;
       app_ring_merge_track_2_in_1(
-          pBuf, app_ring_merge_config.pbuf + app_ring_merge_config.next, pBuf,
+          pBuf, app_ring_merge_config.pbuf + app_ring_merge_config.next,
           curr_size);
       app_ring_merge_config.next = app_ring_merge_config.len;
       app_ring_merge_finished_callback();
@@ -145,20 +128,19 @@ static uint32_t app_ring_merge_periodic_more_data_impl(uint8_t *buf,
       if (app_ring_merge_config.next) {
         curr_size = app_ring_merge_config.len - app_ring_merge_config.next;
         app_ring_merge_track_2_in_1(
-            pBuf, app_ring_merge_config.pbuf + app_ring_merge_config.next, pBuf,
+            pBuf, app_ring_merge_config.pbuf + app_ring_merge_config.next,
             curr_size);
         remain_size -= curr_size;
         app_ring_merge_config.next = 0;
       } else if (remain_size > app_ring_merge_config.len) {
-        app_ring_merge_track_2_in_1(
-            pBuf + curr_size, app_ring_merge_config.pbuf, pBuf + curr_size,
-            app_ring_merge_config.len);
+        app_ring_merge_track_2_in_1(pBuf + curr_size,
+                                    app_ring_merge_config.pbuf,
+                                    app_ring_merge_config.len);
         curr_size += app_ring_merge_config.len;
         remain_size -= app_ring_merge_config.len;
       } else {
         app_ring_merge_track_2_in_1(pBuf + curr_size,
-                                    app_ring_merge_config.pbuf,
-                                    pBuf + curr_size, remain_size);
+                                    app_ring_merge_config.pbuf, remain_size);
         app_ring_merge_config.next = remain_size;
         remain_size = 0;
       }
@@ -166,17 +148,17 @@ static uint32_t app_ring_merge_periodic_more_data_impl(uint8_t *buf,
   } else {
     if ((app_ring_merge_config.len - app_ring_merge_config.next) >= need_len) {
       app_ring_merge_track_2_in_1(
-          pBuf, app_ring_merge_config.pbuf + app_ring_merge_config.next, pBuf,
+          pBuf, app_ring_merge_config.pbuf + app_ring_merge_config.next,
           need_len);
       app_ring_merge_config.next += need_len;
     } else {
       curr_size = app_ring_merge_config.len - app_ring_merge_config.next;
       app_ring_merge_track_2_in_1(
-          pBuf, app_ring_merge_config.pbuf + app_ring_merge_config.next, pBuf,
+          pBuf, app_ring_merge_config.pbuf + app_ring_merge_config.next,
           curr_size);
       app_ring_merge_config.next = need_len - curr_size;
       app_ring_merge_track_2_in_1(pBuf + curr_size, app_ring_merge_config.pbuf,
-                                  pBuf + curr_size, app_ring_merge_config.next);
+                                  app_ring_merge_config.next);
     }
   }
   return len;
@@ -17,6 +17,7 @@
 #endif
 #include "app_audio.h"
 #include "apps.h"
+#include "audio_mix.h"
 #ifdef MIX_AUDIO_PROMPT_WITH_A2DP_MEDIA_ENABLED
 
 #define AUDIO_PROMPT_RESAMPLE_ITER_NUM 256
@@ -29,9 +30,6 @@ extern void tws_enable_mix_prompt(bool isEnable);
 
 extern void app_stop_a2dp_media_stream(uint8_t devId);
 extern void app_stop_sco_media_stream(uint8_t devId);
-extern void app_bt_stream_copy_track_one_to_two_16bits(int16_t *dst_buf,
-                                                       int16_t *src_buf,
-                                                       uint32_t src_len);
 
 static uint32_t audio_prompt_sbc_decode(uint8_t *pcm_buffer,
                                         uint32_t expectedOutputSize,
@@ -54,6 +52,20 @@ static float audio_prompt_sbc_eq_band_gain[8] = {1, 1, 1, 1, 1, 1, 1, 1};
 
 #define DEFAULT_OVERLAP_LENGTH 128
 
+#ifdef AUDIO_PROMPT_PCM_CACHE
+// Bytes of mono 16-bit PCM kept for the prompts already played, at the
+// sample rate of the stream they were mixed into. The default holds about
+// 1/3 s at 48 kHz, enough for the tones; boards with RAM to spare can raise
+// it for the voice prompts.
+#ifndef AUDIO_PROMPT_PCM_CACHE_SIZE
+#define AUDIO_PROMPT_PCM_CACHE_SIZE (32 * 1024)
+#endif
+
+#ifndef AUDIO_PROMPT_PCM_CACHE_ENTRY_NUM
+#define AUDIO_PROMPT_PCM_CACHE_ENTRY_NUM 4
+#endif
+#endif
+
 static int audio_prompt_sbc_init_decoder(void) {
   btif_sbc_init_decoder(&audio_prompt_sbc_decoder);
   return 0;
@@ -95,10 +107,53 @@ typedef struct {
   float mergeInWeight;
   float mergeOutWeight;
   float mergeStep;
+#ifdef AUDIO_PROMPT_PCM_CACHE
+  // set when the whole prompt is in the pcm cache
+  const uint8_t *cachedPcmData;
+  uint32_t cachedPcmDataLen;
+  uint32_t cachedPcmDataOutIndex;
+#endif
 } AUDIO_PROMPT_ENV_T;
 
 static AUDIO_PROMPT_ENV_T audio_prompt_env;
 
+#ifdef AUDIO_PROMPT_PCM_CACHE
+typedef struct {
+  uint16_t promptId;
+  uint32_t sampleRate;
+  // the prompt data changes with the prompt language
+  const uint8_t *encodedData;
+  uint32_t offset;
+  uint32_t len;
+  uint32_t lastUsed;
+} AUDIO_PROMPT_PCM_CACHE_ENTRY_T;
+
+// The entries are packed from the start of the buffer, in offset order,
+// followed by the prompt being filled while it plays. Room for that prompt
+// is made when it starts, so the playback callback only copies into it.
+typedef struct {
+  AUDIO_PROMPT_PCM_CACHE_ENTRY_T entry[AUDIO_PROMPT_PCM_CACHE_ENTRY_NUM];
+  uint8_t entryCnt;
+  uint32_t usedLen;
+  uint32_t useCnt;
+  uint8_t isFilling;
+  uint16_t fillPromptId;
+  uint32_t fillSampleRate;
+  const uint8_t *fillEncodedData;
+  uint32_t fillLen;
+  // last prompt that did not fit in the room made for it, and that room:
+  // the whole buffer when it can never fit
+  uint16_t tooLongPromptId;
+  uint32_t tooLongSampleRate;
+  const uint8_t *tooLongEncodedData;
+  uint32_t tooLongRoom;
+} AUDIO_PROMPT_PCM_CACHE_T;
+
+static AUDIO_PROMPT_PCM_CACHE_T audio_prompt_pcm_cache;
+static uint8_t audio_prompt_pcm_cache_buf[AUDIO_PROMPT_PCM_CACHE_SIZE]
+    __attribute__((aligned(4)));
+#endif
+
 static void audio_prompt_set_pending_stop_op(uint8_t op) {
   audio_prompt_env.pendingStopOp = op;
   TRACE(1, "pendingStopOp is set to %d", op);
@@ -403,6 +458,234 @@ uint32_t audio_prompt_get_sample_rate(void) {
   return audio_prompt_env.targetSampleRate;
 }
 
+static void audio_prompt_set_prompt_data(uint8_t *promptDataPtr,
+                                         uint32_t promptDataLen) {
+  audio_prompt_env.promptDataBuf = promptDataPtr;
+  audio_prompt_env.isResetDecoder = true;
+  audio_prompt_env.isAudioPromptDecodingDone = false;
+  audio_prompt_env.wholeEncodedDataLen = promptDataLen;
+  audio_prompt_env.leftEncodedDataLen = audio_prompt_env.wholeEncodedDataLen;
+}
+
+static void audio_prompt_set_target_sample_rate(uint32_t targetSampleRate) {
+  audio_prompt_env.targetSampleRate = targetSampleRate;
+
+  audio_prompt_env.resampleRatio = ((float)AUDIO_PROMPT_SBC_SAMPLE_RATE_VALUE) /
+                                   audio_prompt_env.targetSampleRate;
+  audio_prompt_env.targetPcmChunkSize =
+      (uint32_t)(AUDIO_PROMPT_SBC_PCM_DATA_SIZE_PER_FRAME /
+                 audio_prompt_env.resampleRatio);
+}
+
+static struct APP_RESAMPLE_T *audio_prompt_open_resampler(void) {
+  return app_playback_resample_any_open_with_pre_allocated_buffer(
+      (enum AUD_CHANNEL_NUM_T)AUDIO_PROMPT_SBC_CHANNEL_COUNT,
+      audio_prompt_resample_iter, AUDIO_PROMPT_RESAMPLE_ITER_NUM,
+      audio_prompt_env.resampleRatio, audio_prompt_env.bufForResampler,
+      audio_prompt_env.resampleBufLen);
+}
+
+// size of the resampled pcm data of one decoded chunk
+static uint32_t audio_prompt_get_target_pcm_size(uint32_t sourcePcmDataLen) {
+  uint32_t targetPcmSize;
+
+  if (AUDIO_PROMPT_SBC_PCM_DATA_SIZE_PER_FRAME == sourcePcmDataLen) {
+    targetPcmSize = audio_prompt_env.targetPcmChunkSize;
+  } else {
+    targetPcmSize =
+        (uint32_t)(sourcePcmDataLen / audio_prompt_env.resampleRatio);
+  }
+
+  return (targetPcmSize / 4) * 4;
+}
+
+#ifdef AUDIO_PROMPT_PCM_CACHE
+static int audio_prompt_pcm_cache_get_lru(void) {
+  AUDIO_PROMPT_PCM_CACHE_T *cache = &audio_prompt_pcm_cache;
+  int lru = -1;
+
+  for (uint8_t i = 0; i < cache->entryCnt; i++) {
+    if ((lru < 0) || (cache->entry[i].lastUsed < cache->entry[lru].lastUsed)) {
+      lru = i;
+    }
+  }
+
+  return lru;
+}
+
+// Moves the entries after it down, only when no prompt is being filled
+static void audio_prompt_pcm_cache_evict(uint8_t index) {
+  AUDIO_PROMPT_PCM_CACHE_T *cache = &audio_prompt_pcm_cache;
+  uint32_t offset = cache->entry[index].offset;
+  uint32_t len = cache->entry[index].len;
+
+  TRACE(3, "prompt cache: evict id 0x%x rate %d len %d",
+        cache->entry[index].promptId, cache->entry[index].sampleRate, len);
+
+  memmove(audio_prompt_pcm_cache_buf + offset,
+          audio_prompt_pcm_cache_buf + offset + len,
+          cache->usedLen - offset - len);
+
+  for (uint8_t i = index + 1; i < cache->entryCnt; i++) {
+    cache->entry[i].offset -= len;
+    cache->entry[i - 1] = cache->entry[i];
+  }
+  cache->entryCnt--;
+  cache->usedLen -= len;
+}
+
+static AUDIO_PROMPT_PCM_CACHE_ENTRY_T *
+audio_prompt_pcm_cache_find(uint16_t promptId, uint32_t sampleRate,
+                            const uint8_t *encodedData) {
+  AUDIO_PROMPT_PCM_CACHE_T *cache = &audio_prompt_pcm_cache;
+
+  for (uint8_t i = 0; i < cache->entryCnt; i++) {
+    if ((cache->entry[i].promptId == promptId) &&
+        (cache->entry[i].sampleRate == sampleRate) &&
+        (cache->entry[i].encodedData == encodedData)) {
+      return &cache->entry[i];
+    }
+  }
+
+  return NULL;
+}
+
+static void audio_prompt_pcm_cache_set_too_long(uint16_t promptId,
+                                                uint32_t sampleRate,
+                                                const uint8_t *encodedData,
+                                                uint32_t room) {
+  AUDIO_PROMPT_PCM_CACHE_T *cache = &audio_prompt_pcm_cache;
+
+  TRACE(3, "prompt cache: id 0x%x at %d does not fit in %d", promptId,
+        sampleRate, room);
+  cache->tooLongPromptId = promptId;
+  cache->tooLongSampleRate = sampleRate;
+  cache->tooLongEncodedData = encodedData;
+  cache->tooLongRoom = room;
+}
+
+// Resampled size of a prompt, taking every AUDIO_PROMPT_SBC_BLOCK_SIZE
+// encoded bytes as one frame of AUDIO_PROMPT_SBC_PCM_DATA_SIZE_PER_FRAME
+static uint32_t audio_prompt_pcm_cache_estimate(uint32_t sampleRate,
+                                                uint32_t encodedDataLen) {
+  uint32_t frameCnt = (encodedDataLen + AUDIO_PROMPT_SBC_BLOCK_SIZE - 1) /
+                      AUDIO_PROMPT_SBC_BLOCK_SIZE;
+  uint32_t frameLen =
+      (uint32_t)((uint64_t)AUDIO_PROMPT_SBC_PCM_DATA_SIZE_PER_FRAME *
+                 sampleRate / AUDIO_PROMPT_SBC_SAMPLE_RATE_VALUE);
+
+  // the resampled chunks are rounded down to 4 bytes, allow for a float
+  // ratio rounding the other way
+  return frameCnt * ((frameLen / 4) * 4 + 4);
+}
+
+// Appends a resampled chunk of the prompt being played. Runs in the
+// playback callback, so it only copies into the room made at the start.
+static void audio_prompt_pcm_cache_fill(const uint8_t *pcmData, uint32_t len) {
+  AUDIO_PROMPT_PCM_CACHE_T *cache = &audio_prompt_pcm_cache;
+
+  if (!cache->isFilling || (0 == len)) {
+    return;
+  }
+
+  if (cache->usedLen + cache->fillLen + len > AUDIO_PROMPT_PCM_CACHE_SIZE) {
+    audio_prompt_pcm_cache_set_too_long(
+        cache->fillPromptId, cache->fillSampleRate, cache->fillEncodedData,
+        AUDIO_PROMPT_PCM_CACHE_SIZE - cache->usedLen);
+    cache->isFilling = false;
+    return;
+  }
+
+  memcpy(audio_prompt_pcm_cache_buf + cache->usedLen + cache->fillLen, pcmData,
+         len);
+  cache->fillLen += len;
+}
+
+// The whole prompt has been decoded
+static void audio_prompt_pcm_cache_fill_done(void) {
+  AUDIO_PROMPT_PCM_CACHE_T *cache = &audio_prompt_pcm_cache;
+  AUDIO_PROMPT_PCM_CACHE_ENTRY_T *entry;
+
+  if (!cache->isFilling) {
+    return;
+  }
+  cache->isFilling = false;
+
+  if (0 == cache->fillLen) {
+    return;
+  }
+
+  entry = &cache->entry[cache->entryCnt++];
+  entry->promptId = cache->fillPromptId;
+  entry->sampleRate = cache->fillSampleRate;
+  entry->encodedData = cache->fillEncodedData;
+  entry->offset = cache->usedLen;
+  entry->len = cache->fillLen;
+  entry->lastUsed = ++cache->useCnt;
+  cache->usedLen += cache->fillLen;
+
+  TRACE(4, "prompt cache: add id 0x%x rate %d len %d, %d bytes used",
+        entry->promptId, entry->sampleRate, entry->len, cache->usedLen);
+}
+
+// The prompt stopped before it was decoded to the end
+static void audio_prompt_pcm_cache_fill_abort(void) {
+  audio_prompt_pcm_cache.isFilling = false;
+}
+
+// Returns the cached prompt, or NULL when it has to be decoded while it
+// plays, in which case the playback callback adds it to the cache as it
+// decodes it. The least recently used prompts are evicted here to make
+// room for it, before the callback can run.
+static AUDIO_PROMPT_PCM_CACHE_ENTRY_T *
+audio_prompt_pcm_cache_get(uint16_t promptId, uint32_t sampleRate,
+                           uint8_t *encodedData, uint32_t encodedDataLen) {
+  AUDIO_PROMPT_PCM_CACHE_T *cache = &audio_prompt_pcm_cache;
+  AUDIO_PROMPT_PCM_CACHE_ENTRY_T *entry;
+  uint32_t room;
+
+  cache->isFilling = false;
+
+  if ((NULL == encodedData) || (0 == encodedDataLen)) {
+    return NULL;
+  }
+
+  entry = audio_prompt_pcm_cache_find(promptId, sampleRate, encodedData);
+  if (entry) {
+    entry->lastUsed = ++cache->useCnt;
+    return entry;
+  }
+
+  room = audio_prompt_pcm_cache_estimate(sampleRate, encodedDataLen);
+  if ((cache->tooLongPromptId == promptId) &&
+      (cache->tooLongSampleRate == sampleRate) &&
+      (cache->tooLongEncodedData == encodedData)) {
+    if (cache->tooLongRoom >= AUDIO_PROMPT_PCM_CACHE_SIZE) {
+      return NULL;
+    }
+    // it was longer than estimated, try again with the whole buffer
+    room = AUDIO_PROMPT_PCM_CACHE_SIZE;
+  } else if (room > AUDIO_PROMPT_PCM_CACHE_SIZE) {
+    audio_prompt_pcm_cache_set_too_long(promptId, sampleRate, encodedData,
+                                        AUDIO_PROMPT_PCM_CACHE_SIZE);
+    return NULL;
+  }
+
+  while ((AUDIO_PROMPT_PCM_CACHE_ENTRY_NUM == cache->entryCnt) ||
+         (cache->usedLen + room > AUDIO_PROMPT_PCM_CACHE_SIZE)) {
+    audio_prompt_pcm_cache_evict(audio_prompt_pcm_cache_get_lru());
+  }
+
+  cache->isFilling = true;
+  cache->fillPromptId = promptId;
+  cache->fillSampleRate = sampleRate;
+  cache->fillEncodedData = encodedData;
+  cache->fillLen = 0;
+
+  return NULL;
+}
+#endif
+
 bool audio_prompt_start_playing(uint16_t promptPram,
                                 uint32_t targetSampleRate) {
   uint16_t promptId = PROMPT_ID_FROM_ID_VALUE(promptPram);
@@ -424,15 +707,24 @@ bool audio_prompt_start_playing(uint16_t promptPram,
 
   promptId = PROMPT_ID_FROM_ID_VALUE(promptId);
 
+  uint8_t *promptDataPtr = NULL;
+  uint32_t promptDataLen = 0;
+
+#ifdef MEDIA_PLAYER_SUPPORT
+  media_runtime_audio_prompt_update(promptId, &promptDataPtr, &promptDataLen);
+#endif
+
+#ifdef AUDIO_PROMPT_PCM_CACHE
+  AUDIO_PROMPT_PCM_CACHE_ENTRY_T *cachedPrompt = audio_prompt_pcm_cache_get(
+      promptId, targetSampleRate, promptDataPtr, promptDataLen);
+#endif
+
   uint32_t lock = int_lock_global();
   audio_prompt_env.isMixPromptOn = true;
 
-  uint8_t *promptDataPtr = NULL;
-  uint32_t promptDataLen = 0;
   PROMPT_MIX_PROPERTY_T *pPromptProperty = NULL;
 
 #ifdef MEDIA_PLAYER_SUPPORT
-  media_runtime_audio_prompt_update(promptId, &promptDataPtr, &promptDataLen);
   pPromptProperty = get_prompt_mix_property(promptId);
 #endif
 
@@ -477,25 +769,23 @@ bool audio_prompt_start_playing(uint16_t promptPram,
 
   audio_prompt_env.promptId = promptId;
   audio_prompt_env.promptPram = PROMPT_PRAM_FROM_ID_VALUE(promptPram);
-  audio_prompt_env.promptDataBuf = promptDataPtr;
-  audio_prompt_env.isResetDecoder = true;
-  audio_prompt_env.isAudioPromptDecodingDone = false;
-  audio_prompt_env.wholeEncodedDataLen = promptDataLen;
-  audio_prompt_env.leftEncodedDataLen = audio_prompt_env.wholeEncodedDataLen;
-  audio_prompt_env.targetSampleRate = targetSampleRate;
-
-  audio_prompt_env.resampleRatio = ((float)AUDIO_PROMPT_SBC_SAMPLE_RATE_VALUE) /
-                                   audio_prompt_env.targetSampleRate;
-  audio_prompt_env.targetPcmChunkSize =
-      (uint32_t)(AUDIO_PROMPT_SBC_PCM_DATA_SIZE_PER_FRAME /
-                 audio_prompt_env.resampleRatio);
-
-  audio_prompt_env.resampler =
-      app_playback_resample_any_open_with_pre_allocated_buffer(
-          (enum AUD_CHANNEL_NUM_T)AUDIO_PROMPT_SBC_CHANNEL_COUNT,
-          audio_prompt_resample_iter, AUDIO_PROMPT_RESAMPLE_ITER_NUM,
-          audio_prompt_env.resampleRatio, audio_prompt_env.bufForResampler,
-          audio_prompt_env.resampleBufLen);
+  audio_prompt_set_prompt_data(promptDataPtr, promptDataLen);
+  audio_prompt_set_target_sample_rate(targetSampleRate);
+
+#ifdef AUDIO_PROMPT_PCM_CACHE
+  audio_prompt_env.cachedPcmData = NULL;
+  audio_prompt_env.resampler = NULL;
+  if (cachedPrompt) {
+    audio_prompt_env.cachedPcmData =
+        audio_prompt_pcm_cache_buf + cachedPrompt->offset;
+    audio_prompt_env.cachedPcmDataLen = cachedPrompt->len;
+    audio_prompt_env.cachedPcmDataOutIndex = 0;
+    audio_prompt_env.isAudioPromptDecodingDone = true;
+  } else
+#endif
+  {
+    audio_prompt_env.resampler = audio_prompt_open_resampler();
+  }
 
   // audio resample out size should be even
   uint16_t targetOverlapLength =
@@ -515,7 +805,15 @@ bool audio_prompt_start_playing(uint16_t promptPram,
 
   TRACE(1, "start audio prompt. target sample rate %d", targetSampleRate);
 
-  app_sysfreq_req(APP_SYSFREQ_USER_PROMPT_MIXER, APP_SYSFREQ_104M);
+#ifdef AUDIO_PROMPT_PCM_CACHE
+  if (cachedPrompt) {
+    // nothing left to decode or resample while mixing
+    app_sysfreq_req(APP_SYSFREQ_USER_PROMPT_MIXER, APP_SYSFREQ_32K);
+  } else
+#endif
+  {
+    app_sysfreq_req(APP_SYSFREQ_USER_PROMPT_MIXER, APP_SYSFREQ_104M);
+  }
 
 #ifdef TWS_PROMPT_SYNC
   if (!isPlayingLocally) {
@@ -533,6 +831,10 @@ void audio_prompt_forcefully_stop(void) {
   audio_prompt_set_saved_stopped_stream_id(-1);
   audio_prompt_env.isAudioPromptDecodingDone = true;
   audio_prompt_env.leftEncodedDataLen = 0;
+#ifdef AUDIO_PROMPT_PCM_CACHE
+  audio_prompt_env.cachedPcmData = NULL;
+  audio_prompt_pcm_cache_fill_abort();
+#endif
   app_sysfreq_req(APP_SYSFREQ_USER_PROMPT_MIXER, APP_SYSFREQ_32K);
 #if defined(IBRT) && defined(MEDIA_PLAYER_SUPPORT)
   app_tws_sync_prompt_check();
@@ -601,6 +903,10 @@ void audio_prompt_stop_playing(void) {
 
   audio_prompt_env.leftEncodedDataLen = 0;
   audio_prompt_env.isMixPromptOn = false;
+#ifdef AUDIO_PROMPT_PCM_CACHE
+  audio_prompt_env.cachedPcmData = NULL;
+  audio_prompt_pcm_cache_fill_abort();
+#endif
 
 #ifdef TWS_PROMPT_SYNC
   tws_reset_mix_prompt_trigger_ticks();
@@ -655,115 +961,76 @@ void audio_prompt_stop_playing(void) {
   }
 }
 
-template <typename DstType> static inline DstType prompt_data_ssat(int32_t in) {
-  DstType out;
-
-  if (sizeof(DstType) == 2) {
-    out = __SSAT(in, 16);
-  } else {
-    out = __SSAT(in, 24);
-  }
-
-  return out;
+// Gains of the stream and of the prompt at merge weight w, stepping w by
+// step per frame
+static void audio_prompt_set_mix_gain(struct AUDIO_MIX_GAIN_T *source_gain,
+                                      struct AUDIO_MIX_GAIN_T *prompt_gain,
+                                      float weight, float step,
+                                      float coeff_for_source,
+                                      float coeff_for_prompt) {
+  source_gain->gain =
+      audio_mix_gain_q30(1 - weight + weight * coeff_for_source);
+  source_gain->step =
+      (int32_t)(-step * (1 - coeff_for_source) * AUDIO_MIX_GAIN_Q30_ONE);
+  prompt_gain->gain = audio_mix_gain_q30(weight * coeff_for_prompt);
+  prompt_gain->step =
+      (int32_t)(step * coeff_for_prompt * AUDIO_MIX_GAIN_Q30_ONE);
 }
 
-template <typename DstType>
-static inline DstType prompt_data_extend(int16_t in) {
-  DstType out;
+// Mixes the mono prompt into the samples [start, end) of the stream
+static void audio_prompt_mix(uint8_t *pcmDataToMerge, const int16_t *prompt,
+                             uint32_t start, uint32_t end,
+                             struct AUDIO_MIX_GAIN_T *source_gain,
+                             struct AUDIO_MIX_GAIN_T *prompt_gain) {
+  uint32_t chans = audio_prompt_env.targetChannelCnt;
 
-  if (sizeof(DstType) == 2) {
-    out = in;
-  } else {
-    out = (in << 8);
+  if (end <= start) {
+    return;
   }
 
-  return out;
+  if (2 == audio_prompt_env.targetBytesCntPerSample) {
+    audio_mix_mono_16((int16_t *)pcmDataToMerge + start, prompt + start / chans,
+                      (end - start) / chans, chans, source_gain, prompt_gain);
+  } else if (4 == audio_prompt_env.targetBytesCntPerSample) {
+    audio_mix_mono_24((int32_t *)pcmDataToMerge + start, prompt + start / chans,
+                      (end - start) / chans, chans, source_gain, prompt_gain);
+  }
 }
 
-template <typename DstType>
-static void audio_prompt_crossfade(DstType *dst_buf, DstType *src_buf1,
-                                   int16_t *src_buf0, float coeff_for_source,
+static void audio_prompt_crossfade(uint8_t *pcmDataToMerge,
+                                   const int16_t *prompt,
+                                   float coeff_for_source,
                                    float coeff_for_prompt,
                                    uint32_t merge_in_end,
                                    uint32_t merge_out_start, uint32_t src_len) {
-  uint32_t i = 0;
-  if (audio_prompt_env.targetChannelCnt == 2) {
-    float weight = audio_prompt_env.mergeInWeight;
-    for (; i < merge_in_end; i += 2) {
-      /* TODO: increase coeff by step instead of calcualted every step */
-      float coeff0 = 1 - weight + weight * coeff_for_source;
-      float coeff1 = weight * coeff_for_prompt;
-
-      float tmp0 = coeff0 * src_buf1[i] +
-                   coeff1 * prompt_data_extend<DstType>(src_buf0[i]);
-      float tmp1 = coeff0 * src_buf1[i + 1] +
-                   coeff1 * prompt_data_extend<DstType>(src_buf0[i + 1]);
-      dst_buf[i] = prompt_data_ssat<DstType>((int32_t)tmp0);
-      dst_buf[i + 1] = prompt_data_ssat<DstType>((int32_t)tmp1);
-
-      weight += audio_prompt_env.mergeStep;
-    }
-    audio_prompt_env.mergeInOverlapLength -= merge_in_end;
-    audio_prompt_env.mergeInWeight = weight;
-  } else if (audio_prompt_env.targetChannelCnt == 1) {
-    float weight = audio_prompt_env.mergeInWeight;
-    for (; i < merge_in_end; i++) {
-      float coeff0 = 1 - weight + weight * coeff_for_source;
-      float coeff1 = weight * coeff_for_prompt;
-
-      float tmp0 = coeff0 * src_buf1[i] +
-                   coeff1 * prompt_data_extend<DstType>(src_buf0[i]);
-      dst_buf[i] = prompt_data_ssat<DstType>((int32_t)tmp0);
-
-      weight += audio_prompt_env.mergeStep;
-    }
-    audio_prompt_env.mergeInOverlapLength -= merge_in_end;
-    audio_prompt_env.mergeInWeight = weight;
-  } else {
-    ASSERT(0, "[%s] channel number %d not supported", __FUNCTION__,
-           audio_prompt_env.targetChannelCnt);
-  }
-  for (; i < merge_out_start; i++) {
-    float mix_value =
-        coeff_for_prompt * prompt_data_extend<DstType>(src_buf0[i]) +
-        coeff_for_source * src_buf1[i];
-    dst_buf[i] = prompt_data_ssat<DstType>((int32_t)mix_value);
-  }
-  if (audio_prompt_env.targetChannelCnt == 2) {
-    float weight = audio_prompt_env.mergeOutWeight;
-    for (; i < src_len; i += 2) {
-      float coeff0 = (1 - weight + weight * coeff_for_source);
-      float coeff1 = weight * coeff_for_prompt;
-
-      float tmp0 = coeff0 * src_buf1[i] +
-                   coeff1 * prompt_data_extend<DstType>(src_buf0[i]);
-      float tmp1 = coeff0 * src_buf1[i + 1] +
-                   coeff1 * prompt_data_extend<DstType>(src_buf0[i + 1]);
-      dst_buf[i] = prompt_data_ssat<DstType>((int32_t)tmp0);
-      dst_buf[i + 1] = prompt_data_ssat<DstType>((int32_t)tmp1);
-
-      weight -= audio_prompt_env.mergeStep;
-    }
-    audio_prompt_env.mergeOutOverlapLength -= src_len - merge_out_start;
-    audio_prompt_env.mergeOutWeight = weight;
-  } else if (audio_prompt_env.targetChannelCnt == 1) {
-    float weight = audio_prompt_env.mergeOutWeight;
-    for (; i < src_len; i++) {
-      float coeff0 = (1 - weight + weight * coeff_for_source);
-      float coeff1 = weight * coeff_for_prompt;
-
-      float tmp0 = coeff0 * src_buf1[i] +
-                   coeff1 * prompt_data_extend<DstType>(src_buf0[i]);
-      dst_buf[i] = prompt_data_ssat<DstType>((int32_t)tmp0);
-
-      weight -= audio_prompt_env.mergeStep;
-    }
-    audio_prompt_env.mergeOutOverlapLength -= src_len - merge_out_start;
-    audio_prompt_env.mergeOutWeight = weight;
-  } else {
-    ASSERT(0, "[%s] channel number %d not supported", __FUNCTION__,
-           audio_prompt_env.targetChannelCnt);
-  }
+  uint32_t chans = audio_prompt_env.targetChannelCnt;
+  struct AUDIO_MIX_GAIN_T source_gain;
+  struct AUDIO_MIX_GAIN_T prompt_gain;
+
+  audio_prompt_set_mix_gain(&source_gain, &prompt_gain,
+                            audio_prompt_env.mergeInWeight,
+                            audio_prompt_env.mergeStep, coeff_for_source,
+                            coeff_for_prompt);
+  audio_prompt_mix(pcmDataToMerge, prompt, 0, merge_in_end, &source_gain,
+                   &prompt_gain);
+  audio_prompt_env.mergeInOverlapLength -= merge_in_end;
+  audio_prompt_env.mergeInWeight +=
+      audio_prompt_env.mergeStep * (merge_in_end / chans);
+
+  audio_prompt_set_mix_gain(&source_gain, &prompt_gain, 1.f, 0.f,
+                            coeff_for_source, coeff_for_prompt);
+  audio_prompt_mix(pcmDataToMerge, prompt, merge_in_end, merge_out_start,
+                   &source_gain, &prompt_gain);
+
+  audio_prompt_set_mix_gain(&source_gain, &prompt_gain,
+                            audio_prompt_env.mergeOutWeight,
+                            -audio_prompt_env.mergeStep, coeff_for_source,
+                            coeff_for_prompt);
+  audio_prompt_mix(pcmDataToMerge, prompt, merge_out_start, src_len,
+                   &source_gain, &prompt_gain);
+  audio_prompt_env.mergeOutOverlapLength -= src_len - merge_out_start;
+  audio_prompt_env.mergeOutWeight -=
+      audio_prompt_env.mergeStep * ((src_len - merge_out_start) / chans);
 }
 
 static void audio_prompt_processing_handler_func(uint32_t acquiredPcmDataLen,
@@ -776,6 +1043,33 @@ static void audio_prompt_processing_handler_func(uint32_t acquiredPcmDataLen,
   uint32_t pcmDataToGetFromPrompt =
       acquiredPcmDataLen / (audio_prompt_env.targetChannelCnt *
                             audio_prompt_env.targetBytesCntPerSample / 2);
+  uint32_t pcmDataLenToMerge = pcmDataToGetFromPrompt;
+  uint32_t pcmDataLenLeft;
+  const int16_t *promptPcmData = NULL;
+
+#ifdef AUDIO_PROMPT_PCM_CACHE
+  if (audio_prompt_env.cachedPcmData) {
+    promptPcmData =
+        (const int16_t *)(audio_prompt_env.cachedPcmData +
+                          audio_prompt_env.cachedPcmDataOutIndex);
+    pcmDataLenLeft = audio_prompt_env.cachedPcmDataLen -
+                     audio_prompt_env.cachedPcmDataOutIndex;
+    if (pcmDataLenLeft < pcmDataLenToMerge) {
+      pcmDataLenToMerge = pcmDataLenLeft;
+    }
+    audio_prompt_env.cachedPcmDataOutIndex += pcmDataLenToMerge;
+    pcmDataLenLeft -= pcmDataLenToMerge;
+
+    // the whole prompt was decoded before the mixing started
+    audio_prompt_env.leftEncodedDataLen = 0;
+
+    if (pcmDataLenToMerge == 0) {
+      // shorter than the overlap, nothing left to fade out
+      audio_prompt_env.mergeOutOverlapLength = 0;
+      goto exit;
+    }
+  }
+#endif
 
   while ((uint32_t)LengthOfCQueue(&(audio_prompt_env.pcmDataQueue)) <
          pcmDataToGetFromPrompt) {
@@ -797,53 +1091,45 @@ static void audio_prompt_processing_handler_func(uint32_t acquiredPcmDataLen,
     audio_prompt_env.tmpSourcePcmDataLen = returnedPcmDataLen;
     audio_prompt_env.tmpSourcePcmDataOutIndex = 0;
 
+    uint8_t *pcmData = audio_prompt_env.tmpSourcePcmDataBuf;
+    uint32_t pcmDataLen = returnedPcmDataLen;
+
     // do resmpling
     if (audio_prompt_env.targetSampleRate !=
         AUDIO_PROMPT_SBC_SAMPLE_RATE_VALUE) {
-      uint32_t targetPcmSize = returnedPcmDataLen;
-      if (AUDIO_PROMPT_SBC_PCM_DATA_SIZE_PER_FRAME == returnedPcmDataLen) {
-        targetPcmSize = audio_prompt_env.targetPcmChunkSize;
-      } else {
-        targetPcmSize =
-            (uint32_t)(returnedPcmDataLen / audio_prompt_env.resampleRatio);
-      }
-
-      targetPcmSize = (targetPcmSize / 4) * 4;
+      pcmDataLen = audio_prompt_get_target_pcm_size(returnedPcmDataLen);
+      pcmData = audio_prompt_env.tmpTargetPcmDataBuf;
 
-      app_playback_resample_run(audio_prompt_env.resampler,
-                                audio_prompt_env.tmpTargetPcmDataBuf,
-                                targetPcmSize);
+      app_playback_resample_run(audio_prompt_env.resampler, pcmData,
+                                pcmDataLen);
+    }
 
-      // fill into pcm data queue
-      EnCQueue(&(audio_prompt_env.pcmDataQueue),
-               audio_prompt_env.tmpTargetPcmDataBuf, targetPcmSize);
-    } else {
-      EnCQueue(&(audio_prompt_env.pcmDataQueue),
-               audio_prompt_env.tmpSourcePcmDataBuf, returnedPcmDataLen);
+#ifdef AUDIO_PROMPT_PCM_CACHE
+    audio_prompt_pcm_cache_fill(pcmData, pcmDataLen);
+    if (audio_prompt_env.isAudioPromptDecodingDone) {
+      audio_prompt_pcm_cache_fill_done();
     }
-  }
+#endif
 
-  uint32_t pcmDataLenToMerge = pcmDataToGetFromPrompt;
-  if ((uint32_t)LengthOfCQueue(&(audio_prompt_env.pcmDataQueue)) <
-      pcmDataToGetFromPrompt) {
-    pcmDataLenToMerge = LengthOfCQueue(&(audio_prompt_env.pcmDataQueue));
+    // fill into pcm data queue
+    EnCQueue(&(audio_prompt_env.pcmDataQueue), pcmData, pcmDataLen);
   }
 
-  if (pcmDataLenToMerge == 0)
-    goto exit;
+  if (NULL == promptPcmData) {
+    if ((uint32_t)LengthOfCQueue(&(audio_prompt_env.pcmDataQueue)) <
+        pcmDataToGetFromPrompt) {
+      pcmDataLenToMerge = LengthOfCQueue(&(audio_prompt_env.pcmDataQueue));
+    }
 
-  // copy to multiple channel if needed
-  if (audio_prompt_env.targetChannelCnt > 1) {
-    // get the data
-    DeCQueue(&(audio_prompt_env.pcmDataQueue),
-             audio_prompt_env.tmpSourcePcmDataBuf, pcmDataLenToMerge);
-    app_bt_stream_copy_track_one_to_two_16bits(
-        (int16_t *)audio_prompt_env.tmpTargetPcmDataBuf,
-        (int16_t *)audio_prompt_env.tmpSourcePcmDataBuf,
-        pcmDataLenToMerge / sizeof(uint16_t));
-  } else {
+    if (pcmDataLenToMerge == 0)
+      goto exit;
+
+    // get the data, the mono prompt is mixed into all the channels
     DeCQueue(&(audio_prompt_env.pcmDataQueue),
              audio_prompt_env.tmpTargetPcmDataBuf, pcmDataLenToMerge);
+    promptPcmData = (const int16_t *)audio_prompt_env.tmpTargetPcmDataBuf;
+
+    pcmDataLenLeft = LengthOfCQueue(&(audio_prompt_env.pcmDataQueue));
   }
 
 #ifdef TWS_PROMPT_SYNC
@@ -852,7 +1138,6 @@ static void audio_prompt_processing_handler_func(uint32_t acquiredPcmDataLen,
 #endif
   {
     // merge the data
-    int16_t *src_buf0 = (int16_t *)audio_prompt_env.tmpTargetPcmDataBuf;
     uint32_t src_len = pcmDataLenToMerge * audio_prompt_env.targetChannelCnt /
                        sizeof(uint16_t);
 
@@ -892,16 +1177,15 @@ static void audio_prompt_processing_handler_func(uint32_t acquiredPcmDataLen,
     uint32_t merge_out_start = src_len;
     /* TODO: calc remain decoded pcm samples for DEFAULT_OVERLAP_LENGTH > 128 */
     if (audio_prompt_env.leftEncodedDataLen == 0) {
-      if (LengthOfCQueue(&(audio_prompt_env.pcmDataQueue)) <
-          audio_prompt_env.mergeOutOverlapLength /
-              audio_prompt_env.targetChannelCnt * (int32_t)sizeof(uint16_t)) {
+      if (pcmDataLenLeft < audio_prompt_env.mergeOutOverlapLength /
+                               audio_prompt_env.targetChannelCnt *
+                               sizeof(uint16_t)) {
         TRACE(2, "[%s] merge end, remain %d", __FUNCTION__,
               audio_prompt_env.mergeOutOverlapLength);
         merge_out_start =
-            src_len -
-            (audio_prompt_env.mergeOutOverlapLength -
-             LengthOfCQueue(&(audio_prompt_env.pcmDataQueue)) /
-                 sizeof(uint16_t) * audio_prompt_env.targetChannelCnt);
+            src_len - (audio_prompt_env.mergeOutOverlapLength -
+                       pcmDataLenLeft / sizeof(uint16_t) *
+                           audio_prompt_env.targetChannelCnt);
       }
     }
 
@@ -910,21 +1194,9 @@ static void audio_prompt_processing_handler_func(uint32_t acquiredPcmDataLen,
     // src_len = %d", __FUNCTION__,
     // LengthOfCQueue(&(audio_prompt_env.pcmDataQueue)), src_len);
 
-    if (2 == audio_prompt_env.targetBytesCntPerSample) {
-      int16_t *src_buf1 = (int16_t *)pcmDataToMerge;
-      int16_t *dst_buf = (int16_t *)pcmDataToMerge;
-
-      audio_prompt_crossfade<int16_t>(dst_buf, src_buf1, src_buf0,
-                                      coeff_for_source, coeff_for_prompt,
-                                      merge_in_end, merge_out_start, src_len);
-    } else if (4 == audio_prompt_env.targetBytesCntPerSample) {
-      int32_t *src_buf1 = (int32_t *)pcmDataToMerge;
-      int32_t *dst_buf = (int32_t *)pcmDataToMerge;
-
-      audio_prompt_crossfade<int32_t>(dst_buf, src_buf1, src_buf0,
-                                      coeff_for_source, coeff_for_prompt,
-                                      merge_in_end, merge_out_start, src_len);
-    }
+    audio_prompt_crossfade(pcmDataToMerge, promptPcmData, coeff_for_source,
+                           coeff_for_prompt, merge_in_end, merge_out_start,
+                           src_len);
   }
 
 exit:
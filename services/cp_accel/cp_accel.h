@@ -26,6 +26,7 @@ extern "C" {
 #define MAX_CP_MSG_NUM                    5
 
 #define HAL_MEMSC_ID_CP                    HAL_MEMSC_ID_1
+#define HAL_MEMSC_ID_CP_JOB                HAL_MEMSC_ID_2
 
 #define LOCK_CP_PROCESS() \
      while (hal_memsc_lock(HAL_MEMSC_ID_CP) == 0){}
@@ -49,6 +50,8 @@ enum CP_TASK_EVENT
 
     CP_EVENT_HW_PROCESSING = 0x0,
 
+    CP_EVENT_JOB = 0x0,
+
     /// Maximum number of event
     CP_EVENT_MAX = 0x2,
 };
@@ -71,6 +74,7 @@ enum CP_TASK_TYPE
     CP_TASK_SCO = 0x01,
     CP_TASK_AEC = 0x02,
     CP_TASK_HW = 0x03,
+    CP_TASK_JOB = 0x04,
     /// Maximum number of tasks
     CP_TASK_MAX,
 };
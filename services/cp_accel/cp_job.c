@@ -0,0 +1,334 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#ifdef CHIP_HAS_CP
+
+#include "cp_job.h"
+#include "hal_location.h"
+#include "string.h"
+
+// Job ids are sequence numbers: slot = id % CP_JOB_RING_SIZE. head is
+// written by the MCU only, cp_next by the CP only. A slot moves through
+//
+//   FREE -> QUEUED -> CP_RUN or MCU_RUN -> DONE -> FREE
+//
+// and only the core that moves it out of QUEUED runs the job. The states
+// change under the port lock, which also orders the descriptor and buffer
+// accesses of the two cores.
+
+#define CP_JOB_ID_MASK 0x7FFFFFFF
+
+STATIC_ASSERT((CP_JOB_RING_SIZE & (CP_JOB_RING_SIZE - 1)) == 0,
+              "CP_JOB_RING_SIZE must be a power of 2");
+
+enum CP_JOB_STATE_T {
+  CP_JOB_STATE_FREE = 0,
+  CP_JOB_STATE_QUEUED,
+  CP_JOB_STATE_CP_RUN,
+  CP_JOB_STATE_MCU_RUN,
+  CP_JOB_STATE_DONE,
+};
+
+struct CP_JOB_SLOT_T {
+  struct CP_JOB_T job;
+  volatile uint8_t state;
+  uint8_t flags;
+  int result;
+};
+
+struct CP_JOB_RING_T {
+  struct CP_JOB_SLOT_T slot[CP_JOB_RING_SIZE];
+  volatile uint32_t head;    // next id to submit
+  volatile uint32_t cp_next; // next id the CP looks at
+  uint32_t tail;             // next id to reap
+  bool open;
+  CP_JOB_NOTIFY_T notify;
+  struct CP_JOB_STATS_T stats;
+};
+
+static CP_BSS_LOC struct CP_JOB_RING_T cp_job_ring;
+
+#define CP_JOB_SLOT(seq) (&cp_job_ring.slot[(seq) & (CP_JOB_RING_SIZE - 1)])
+
+static CP_TEXT_SRAM_LOC bool cp_job_expired(uint32_t deadline,
+                                            uint32_t now) {
+  return (int32_t)(now - deadline) > 0;
+}
+
+CP_TEXT_SRAM_LOC void cp_job_cp_run(void) {
+  struct CP_JOB_RING_T *r = &cp_job_ring;
+  struct CP_JOB_SLOT_T *slot;
+  struct CP_JOB_T *job;
+  uint32_t lock;
+  bool run;
+  int result;
+
+  while (1) {
+    lock = cp_job_port_lock();
+    if (r->cp_next == r->head) {
+      cp_job_port_unlock(lock);
+      break;
+    }
+    // Jobs the MCU took back may have been reaped and their slots reused
+    if (r->head - r->cp_next > CP_JOB_RING_SIZE) {
+      r->cp_next = r->head - CP_JOB_RING_SIZE;
+    }
+    slot = CP_JOB_SLOT(r->cp_next++);
+    run = (slot->state == CP_JOB_STATE_QUEUED);
+    if (run) {
+      slot->state = CP_JOB_STATE_CP_RUN;
+    }
+    cp_job_port_unlock(lock);
+    if (!run) {
+      continue;
+    }
+
+    // The MCU leaves the slot alone until it is DONE
+    job = &slot->job;
+    result =
+        job->func(job->ctx, job->in, job->in_len, job->out, job->out_len);
+
+    lock = cp_job_port_lock();
+    slot->result = result;
+    slot->flags = 0;
+    if (cp_job_expired(job->deadline, cp_job_port_now())) {
+      slot->flags |= CP_JOB_FLAG_LATE;
+      r->stats.late++;
+    }
+    slot->state = CP_JOB_STATE_DONE;
+    r->stats.cp_done++;
+    cp_job_port_unlock(lock);
+
+    cp_job_port_notify_mcu();
+  }
+}
+
+static uint8_t cp_job_state_get(const struct CP_JOB_SLOT_T *slot) {
+  uint32_t lock;
+  uint8_t state;
+
+  lock = cp_job_port_lock();
+  state = slot->state;
+  cp_job_port_unlock(lock);
+  return state;
+}
+
+// Runs the job of slot on the MCU unless the CP has started it
+static bool cp_job_take_back(struct CP_JOB_SLOT_T *slot, uint32_t *stat) {
+  struct CP_JOB_RING_T *r = &cp_job_ring;
+  struct CP_JOB_T *job = &slot->job;
+  uint32_t lock;
+  bool take;
+  int result;
+
+  lock = cp_job_port_lock();
+  take = (slot->state == CP_JOB_STATE_QUEUED);
+  if (take) {
+    slot->state = CP_JOB_STATE_MCU_RUN;
+  }
+  cp_job_port_unlock(lock);
+  if (!take) {
+    return false;
+  }
+
+  result = job->func(job->ctx, job->in, job->in_len, job->out, job->out_len);
+
+  lock = cp_job_port_lock();
+  slot->result = result;
+  slot->flags = CP_JOB_FLAG_MCU;
+  if (cp_job_expired(job->deadline, cp_job_port_now())) {
+    slot->flags |= CP_JOB_FLAG_LATE;
+    r->stats.late++;
+  }
+  slot->state = CP_JOB_STATE_DONE;
+  (*stat)++;
+  cp_job_port_unlock(lock);
+  return true;
+}
+
+static int cp_job_reap_one(void) {
+  struct CP_JOB_RING_T *r = &cp_job_ring;
+  struct CP_JOB_SLOT_T *slot = CP_JOB_SLOT(r->tail);
+  CP_JOB_DONE_T done = slot->job.done;
+  void *ctx = slot->job.ctx;
+  uint32_t flags;
+  uint32_t lock;
+  int result;
+
+  lock = cp_job_port_lock();
+  flags = slot->flags;
+  result = slot->result;
+  slot->state = CP_JOB_STATE_FREE;
+  cp_job_port_unlock(lock);
+  r->tail++;
+  if (done) {
+    done(ctx, result, flags);
+  }
+  return result;
+}
+
+// Waits for the oldest job, taking it back once its deadline passes, or at
+// once if force, and reaps it
+static int cp_job_finish_oldest(bool force) {
+  struct CP_JOB_RING_T *r = &cp_job_ring;
+  struct CP_JOB_SLOT_T *slot = CP_JOB_SLOT(r->tail);
+  uint8_t state;
+
+  while ((state = cp_job_state_get(slot)) != CP_JOB_STATE_DONE) {
+    if (state == CP_JOB_STATE_QUEUED &&
+        (force || cp_job_expired(slot->job.deadline, cp_job_port_now()))) {
+      cp_job_take_back(slot, &r->stats.mcu_missed);
+    } else {
+      cp_job_port_relax();
+    }
+  }
+  return cp_job_reap_one();
+}
+
+int cp_job_submit(const struct CP_JOB_T *job) {
+  struct CP_JOB_RING_T *r = &cp_job_ring;
+  struct CP_JOB_SLOT_T *slot;
+  uint32_t lock;
+  uint32_t seq;
+
+  if (r->head - r->tail >= CP_JOB_RING_SIZE) {
+    cp_job_poll();
+    if (r->head - r->tail >= CP_JOB_RING_SIZE) {
+      r->stats.ring_full++;
+      cp_job_finish_oldest(false);
+    }
+  }
+
+  seq = r->head;
+  slot = CP_JOB_SLOT(seq);
+  slot->job = *job;
+  slot->flags = 0;
+  slot->result = 0;
+  r->stats.submitted++;
+
+  lock = cp_job_port_lock();
+  slot->state = CP_JOB_STATE_QUEUED;
+  if (r->open) {
+    r->head = seq + 1;
+  }
+  cp_job_port_unlock(lock);
+
+  if (r->open) {
+    cp_job_port_kick_cp();
+  } else {
+    // head is only moved past the job once it is done, so the CP never
+    // sees it
+    cp_job_take_back(slot, &r->stats.mcu_closed);
+    r->head = seq + 1;
+    r->cp_next = r->head;
+  }
+  return (int)(seq & CP_JOB_ID_MASK);
+}
+
+int cp_job_poll(void) {
+  struct CP_JOB_RING_T *r = &cp_job_ring;
+  struct CP_JOB_SLOT_T *slot;
+  uint32_t now = cp_job_port_now();
+  uint32_t seq;
+  int cnt = 0;
+
+  for (seq = r->tail; seq != r->head; seq++) {
+    slot = CP_JOB_SLOT(seq);
+    if (cp_job_expired(slot->job.deadline, now)) {
+      cp_job_take_back(slot, &r->stats.mcu_missed);
+    }
+  }
+  while (r->tail != r->head &&
+         cp_job_state_get(CP_JOB_SLOT(r->tail)) == CP_JOB_STATE_DONE) {
+    cp_job_reap_one();
+    cnt++;
+  }
+  return cnt;
+}
+
+int cp_job_wait(int id) {
+  struct CP_JOB_RING_T *r = &cp_job_ring;
+  uint32_t ahead;
+  int result;
+
+  ahead = ((uint32_t)id - r->tail) & CP_JOB_ID_MASK;
+  if (ahead >= r->head - r->tail) {
+    // Already reaped, or never submitted
+    return -1;
+  }
+  do {
+    result = cp_job_finish_oldest(false);
+  } while (ahead--);
+  return result;
+}
+
+uint32_t cp_job_pending(void) { return cp_job_ring.head - cp_job_ring.tail; }
+
+void cp_job_stats_get(struct CP_JOB_STATS_T *stats, bool reset) {
+  uint32_t lock;
+
+  lock = cp_job_port_lock();
+  *stats = cp_job_ring.stats;
+  if (reset) {
+    memset(&cp_job_ring.stats, 0, sizeof(cp_job_ring.stats));
+  }
+  cp_job_port_unlock(lock);
+}
+
+void cp_job_start(CP_JOB_NOTIFY_T notify) {
+  struct CP_JOB_RING_T *r = &cp_job_ring;
+  uint32_t lock;
+
+  lock = cp_job_port_lock();
+  memset(r, 0, sizeof(*r));
+  r->notify = notify;
+  r->open = true;
+  cp_job_port_unlock(lock);
+}
+
+void cp_job_stop(void) {
+  struct CP_JOB_RING_T *r = &cp_job_ring;
+
+  while (r->tail != r->head) {
+    cp_job_finish_oldest(true);
+  }
+  r->open = false;
+}
+
+void cp_job_cp_lost(void) {
+  struct CP_JOB_RING_T *r = &cp_job_ring;
+  uint32_t lock;
+  uint32_t seq;
+
+  lock = cp_job_port_lock();
+  r->open = false;
+  for (seq = r->tail; seq != r->head; seq++) {
+    if (CP_JOB_SLOT(seq)->state == CP_JOB_STATE_CP_RUN) {
+      CP_JOB_SLOT(seq)->state = CP_JOB_STATE_QUEUED;
+    }
+  }
+  r->cp_next = r->head;
+  cp_job_port_unlock(lock);
+}
+
+void cp_job_notify(void) {
+  CP_JOB_NOTIFY_T notify = cp_job_ring.notify;
+
+  if (notify) {
+    notify();
+  }
+}
+
+#endif
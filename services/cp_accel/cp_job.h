@@ -0,0 +1,138 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#ifndef __CP_JOB_H__
+#define __CP_JOB_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Job queue for offloading work from the MCU to the CP.
+//
+// The MCU submits jobs to a ring of CP_JOB_RING_SIZE descriptors. The CP
+// runs them in order and tells the MCU when each is done. A job whose
+// deadline passes before the CP has started it is taken back and run on
+// the MCU instead, so a busy or stalled CP costs time but never a result.
+// A job the CP has started is always finished by the CP.
+//
+// Completion callbacks run on the MCU, in submission order, from
+// cp_job_poll() or cp_job_wait(). The notify callback given to
+// cp_job_open() runs in IRQ context whenever the CP finishes a job and can
+// be used to wake the thread that polls.
+//
+// Job functions run on either core. Like all CP code, they and the data
+// they touch must be in RAM (CP_TEXT_SRAM_LOC, CP_DATA_LOC, CP_BSS_LOC):
+// the CP cannot read flash.
+//
+// All the functions below except cp_job_cp_run() are for the MCU, from one
+// thread at a time.
+
+#ifndef CP_JOB_RING_SIZE
+#define CP_JOB_RING_SIZE 8 // power of 2
+#endif
+
+// Completion flags
+#define CP_JOB_FLAG_MCU (1 << 0)  // run on the MCU
+#define CP_JOB_FLAG_LATE (1 << 1) // finished after its deadline
+
+typedef int (*CP_JOB_FUNC_T)(void *ctx, const void *in, uint32_t in_len,
+                             void *out, uint32_t out_len);
+
+typedef void (*CP_JOB_DONE_T)(void *ctx, int result, uint32_t flags);
+
+typedef void (*CP_JOB_NOTIFY_T)(void);
+
+struct CP_JOB_T {
+  CP_JOB_FUNC_T func;
+  CP_JOB_DONE_T done; // may be NULL
+  void *ctx;
+  const void *in;
+  uint32_t in_len;
+  void *out;
+  uint32_t out_len;
+  uint32_t deadline; // cp_job_port_now() ticks
+};
+
+struct CP_JOB_STATS_T {
+  uint32_t submitted;
+  uint32_t cp_done;
+  uint32_t mcu_missed; // run on the MCU, the CP had not started in time
+  uint32_t mcu_closed; // run on the MCU, the CP was not open
+  uint32_t ring_full;  // submissions that had to wait for a free slot
+  uint32_t late;
+};
+
+int cp_job_open(CP_JOB_NOTIFY_T notify);
+
+// Jobs still queued are run on the MCU first.
+void cp_job_close(void);
+
+// Queues job and returns its id. If the ring is full, the oldest job is
+// waited for first as in cp_job_wait(). If the CP is not open, the job
+// runs on the MCU before this returns. Its callback is called from the
+// next cp_job_poll() either way.
+int cp_job_submit(const struct CP_JOB_T *job);
+
+// Runs on the MCU the queued jobs whose deadline has passed, then calls
+// the callbacks of finished jobs. Returns the number of callbacks called.
+int cp_job_poll(void);
+
+// Waits for job id, taking it back from the CP once its deadline passes,
+// and calls its callback and those of the jobs before it. Returns the
+// result of the job function.
+int cp_job_wait(int id);
+
+// Jobs submitted and not yet reaped by cp_job_poll() or cp_job_wait()
+uint32_t cp_job_pending(void);
+
+void cp_job_stats_get(struct CP_JOB_STATS_T *stats, bool reset);
+
+// CP side: runs the queued jobs. Called by the CP task.
+void cp_job_cp_run(void);
+
+// Called by the port once the CP runs cp_job_cp_run() on kicks, and
+// before it stops. cp_job_start() clears the ring and the stats;
+// cp_job_stop() finishes every job, on the MCU if the CP has not started
+// it, and calls the callbacks.
+void cp_job_start(CP_JOB_NOTIFY_T notify);
+void cp_job_stop(void);
+
+// Port. The target port is cp_job_port.c; the host sim in
+// dev_tools/cp_job_sim provides its own with two threads as the cores.
+
+// Lock shared by both cores. The job states only change under it.
+uint32_t cp_job_port_lock(void);
+void cp_job_port_unlock(uint32_t lock);
+// MCU: jobs were queued
+void cp_job_port_kick_cp(void);
+// CP: a job is done
+void cp_job_port_notify_mcu(void);
+uint32_t cp_job_port_now(void);
+// MCU: waiting for the CP, called in a spin loop
+void cp_job_port_relax(void);
+// Called by the port in MCU IRQ context when the CP reports a finished job
+void cp_job_notify(void);
+// Called by the port when the CP crashed: the jobs it was running are
+// queued again, and from now on all jobs run on the MCU
+void cp_job_cp_lost(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,122 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#ifdef CHIP_HAS_CP
+
+#include "cmsis.h"
+#include "cp_accel.h"
+#include "cp_job.h"
+#include "hal_location.h"
+#include "hal_memsc.h"
+#include "hal_timer.h"
+#include "hal_trace.h"
+#include "norflash_api.h"
+
+// cp_job on the CP_TASK_JOB task of cp_accel. The port lock is a hardware
+// memory semaphore, taken with the local interrupts masked so that an IRQ
+// on the same core cannot spin on it forever.
+
+CP_TEXT_SRAM_LOC
+uint32_t cp_job_port_lock(void) {
+  uint32_t lock;
+
+  lock = int_lock();
+  while (hal_memsc_lock(HAL_MEMSC_ID_CP_JOB) == 0) {
+  }
+  return lock;
+}
+
+CP_TEXT_SRAM_LOC
+void cp_job_port_unlock(uint32_t lock) {
+  hal_memsc_unlock(HAL_MEMSC_ID_CP_JOB);
+  int_unlock(lock);
+}
+
+void cp_job_port_kick_cp(void) {
+  cp_accel_send_event_mcu2cp(CP_BUILD_ID(CP_TASK_JOB, CP_EVENT_JOB));
+}
+
+CP_TEXT_SRAM_LOC
+void cp_job_port_notify_mcu(void) {
+  cp_accel_send_event_cp2mcu(CP_BUILD_ID(CP_TASK_JOB, CP_EVENT_JOB));
+}
+
+CP_TEXT_SRAM_LOC
+uint32_t cp_job_port_now(void) { return hal_fast_sys_timer_get(); }
+
+void cp_job_port_relax(void) { hal_sys_timer_delay_us(10); }
+
+CP_TEXT_SRAM_LOC
+static unsigned int cp_job_cp_main(uint8_t event) {
+  cp_job_cp_run();
+  return 0;
+}
+
+static unsigned int cp_job_mcu_evt(uint8_t event) {
+  cp_job_notify();
+  return 0;
+}
+
+static unsigned int cp_job_mcu_sys_ctrl(uint8_t event) {
+  TRACE(0, "[CP_JOB] CP lost, jobs fall back to MCU");
+  cp_job_cp_lost();
+  return 0;
+}
+
+static struct cp_task_desc TASK_DESC_JOB = {
+    CP_ACCEL_STATE_CLOSED, cp_job_cp_main, NULL, cp_job_mcu_evt,
+    cp_job_mcu_sys_ctrl};
+
+int cp_job_open(CP_JOB_NOTIFY_T notify) {
+  uint32_t cnt = 0;
+  int ret;
+
+  norflash_api_flush_disable(NORFLASH_API_USER_CP,
+                             (uint32_t)cp_accel_init_done);
+  ret = cp_accel_open(CP_TASK_JOB, &TASK_DESC_JOB);
+  while (ret == 0 && cp_accel_init_done() == false) {
+    hal_sys_timer_delay_us(100);
+    if (++cnt == 10 * 200) { // 200ms
+      TRACE(0, "[CP_JOB] CP init timeout");
+      cp_accel_close(CP_TASK_JOB);
+      ret = -1;
+    }
+  }
+  norflash_api_flush_enable(NORFLASH_API_USER_CP);
+
+  cp_job_start(notify);
+  if (ret) {
+    // Jobs still work, on the MCU
+    cp_job_stop();
+    return ret;
+  }
+  TRACE(0, "[CP_JOB] open");
+  return 0;
+}
+
+void cp_job_close(void) {
+  struct CP_JOB_STATS_T stats;
+
+  cp_job_stop();
+  cp_accel_close(CP_TASK_JOB);
+
+  cp_job_stats_get(&stats, true);
+  TRACE(6,
+        "[CP_JOB] close: jobs=%u cp=%u missed=%u closed=%u full=%u late=%u",
+        stats.submitted, stats.cp_done, stats.mcu_missed, stats.mcu_closed,
+        stats.ring_full, stats.late);
+}
+
+#endif
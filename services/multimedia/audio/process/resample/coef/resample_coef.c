@@ -130,6 +130,17 @@ const struct RESAMPLE_COEF_T COEF_DEF(resample_coef_16k_to_48k) = {
 };
 
 #ifdef RESAMPLE_ANY_SAMPLE_RATE
+static const int16_t COEF_DEF(filter_any_up128_16)[] = {
+#include "resample_any_up128_16_filter.txt"
+};
+const struct RESAMPLE_COEF_T COEF_DEF(resample_coef_any_up128_16) = {
+    .upsample_factor = 128,
+    .downsample_factor = 0,
+    .phase_coef_num = 16,
+    .total_coef_num = ARRAY_SIZE(filter_any_up128_16),
+    .coef_group = filter_any_up128_16,
+};
+
 static const int16_t COEF_DEF(filter_any_up64)[] = {
 #include "resample_any_up64_filter.txt"
 };
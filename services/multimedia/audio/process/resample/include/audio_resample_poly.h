@@ -0,0 +1,80 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#ifndef __AUDIO_RESAMPLE_POLY_H__
+#define __AUDIO_RESAMPLE_POLY_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "audio_resample_ex.h"
+
+// In-tree polyphase resampler for the "any" coefficient tables
+// (resample_coef_any_*, downsample_factor == 0), with the same calls, config
+// and io structs as audio_resample_ex_*. 16-bit interleaved PCM only.
+//
+// ratio_step is the number of input frames per output frame. The output
+// frame at input position n + f (0 <= f < 1) is the average of the two
+// table phases around f, weighted linearly, so the ratio can be any value
+// and may change between two runs without a click.
+//
+// The filter length is that of the table, i.e. phase_coef_num taps, which
+// must be even: each output sample costs phase_coef_num dual 16-bit MACs
+// per channel. More taps do not mean better quality. The tables, with the
+// worst THD+N of the 1-3 kHz and 15-18 kHz tones that
+// dev_tools/resample_poly_ref measures over the app_bt_stream ratios:
+//   resample_coef_any_up128_16, 16 taps, -86 dB
+//   resample_coef_any_up256,    24 taps, -43 dB (15-18 kHz)
+//   resample_coef_any_up64,     32 taps, -83 dB
+//   resample_coef_any_up512_32, 32 taps, -68 dB (16 kHz prompts)
+//   resample_coef_any_up512_36, 36 taps, -68 dB (16 kHz prompts)
+//
+// audio_resample_poly_set_ratio_step() may be called from another thread
+// than audio_resample_poly_run().
+
+// Input frames kept per channel beyond the filter length. The history is
+// shifted down once per this many input frames.
+#ifndef RESAMPLE_POLY_HIST_BLOCK
+#define RESAMPLE_POLY_HIST_BLOCK (64)
+#endif
+
+// Largest ratio_step accepted
+#ifndef RESAMPLE_POLY_MAX_STEP
+#define RESAMPLE_POLY_MAX_STEP (8)
+#endif
+
+uint32_t audio_resample_poly_get_buffer_size(enum AUD_CHANNEL_NUM_T chans,
+                                             enum AUD_BITS_T bits,
+                                             uint8_t phase_coef_num);
+enum RESAMPLE_STATUS_T
+audio_resample_poly_open(const struct RESAMPLE_CFG_T *cfg,
+                         RESAMPLE_ID *id_ptr);
+enum RESAMPLE_STATUS_T
+audio_resample_poly_run(RESAMPLE_ID id, const struct RESAMPLE_IO_BUF_T *io,
+                        uint32_t *in_size_ptr, uint32_t *out_size_ptr);
+void audio_resample_poly_close(RESAMPLE_ID id);
+void audio_resample_poly_flush(RESAMPLE_ID id);
+
+enum RESAMPLE_STATUS_T audio_resample_poly_set_ratio_step(RESAMPLE_ID id,
+                                                          float ratio_step);
+enum RESAMPLE_STATUS_T audio_resample_poly_get_ratio_step(RESAMPLE_ID id,
+                                                          float *ratio_step);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -35,6 +35,7 @@ extern const struct RESAMPLE_COEF_T resample_coef_8p4k_to_8k;
 
 extern const struct RESAMPLE_COEF_T resample_coef_16k_to_48k;
 
+extern const struct RESAMPLE_COEF_T resample_coef_any_up128_16;
 extern const struct RESAMPLE_COEF_T resample_coef_any_up64;
 extern const struct RESAMPLE_COEF_T resample_coef_any_up256;
 extern const struct RESAMPLE_COEF_T resample_coef_any_up512_32;
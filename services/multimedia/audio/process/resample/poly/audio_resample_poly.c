@@ -0,0 +1,402 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#include "audio_resample_poly.h"
+#include "cmsis.h"
+#include "hal_location.h"
+#include "string.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#define RESAMPLE_POLY_SIMD
+#endif
+
+// The position in the input is kept as a frame index into the history and
+// a Q32 fraction. The top bits of the fraction pick the table phase and
+// the next RESAMPLE_POLY_WEIGHT_Q bits weight it against the next phase.
+#define RESAMPLE_POLY_WEIGHT_Q 15
+#define RESAMPLE_POLY_COEF_Q 15
+#define RESAMPLE_POLY_OUT_SHIFT (RESAMPLE_POLY_COEF_Q + RESAMPLE_POLY_WEIGHT_Q)
+
+#define RESAMPLE_POLY_ALIGN4(n) (((n) + 3) & ~3)
+
+struct RESAMPLE_POLY_T {
+  const int16_t *coef;
+  uint16_t phase_num;
+  uint8_t phase_shift;
+  uint8_t taps;
+  uint8_t chans;
+  // Frames per channel the history can hold, and its stride in samples
+  uint16_t hist_cap;
+  uint16_t hist_stride;
+  // Valid frames in the history, and index of the oldest frame of the
+  // next filter window
+  uint16_t hist_cnt;
+  uint16_t hist_idx;
+  uint32_t frac;
+  // Q32 input frames per output frame, written under int_lock
+  uint32_t step_int;
+  uint32_t step_frac;
+  float ratio_step;
+  int16_t *hist;
+};
+
+static uint32_t resample_poly_hist_cap(uint8_t taps) {
+  // One frame more than the window, for the last phase
+  return taps + 1 + RESAMPLE_POLY_HIST_BLOCK;
+}
+
+uint32_t audio_resample_poly_get_buffer_size(enum AUD_CHANNEL_NUM_T chans,
+                                             enum AUD_BITS_T bits,
+                                             uint8_t phase_coef_num) {
+  uint32_t stride;
+
+  stride = RESAMPLE_POLY_ALIGN4(resample_poly_hist_cap(phase_coef_num) *
+                                sizeof(int16_t));
+  return RESAMPLE_POLY_ALIGN4(sizeof(struct RESAMPLE_POLY_T)) +
+         chans * stride;
+}
+
+#ifdef RESAMPLE_POLY_SIMD
+static inline uint32_t resample_poly_read_pair(const int16_t *p) {
+  uint32_t v;
+
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Two phases over the same window: two dual MACs per word of input
+static inline void resample_poly_dot2(const int16_t *x, const int16_t *c0,
+                                      const int16_t *c1, uint32_t taps,
+                                      int64_t *acc0, int64_t *acc1) {
+  int64_t a0 = 0, a1 = 0;
+  uint32_t xv, i;
+
+  for (i = 0; i < taps; i += 2) {
+    xv = resample_poly_read_pair(x + i);
+    a0 = __SMLALD(xv, resample_poly_read_pair(c0 + i), a0);
+    a1 = __SMLALD(xv, resample_poly_read_pair(c1 + i), a1);
+  }
+  *acc0 = a0;
+  *acc1 = a1;
+}
+
+static inline int64_t resample_poly_dot(const int16_t *x, const int16_t *c,
+                                        uint32_t taps) {
+  int64_t a = 0;
+  uint32_t i;
+
+  for (i = 0; i < taps; i += 2) {
+    a = __SMLALD(resample_poly_read_pair(x + i),
+                 resample_poly_read_pair(c + i), a);
+  }
+  return a;
+}
+
+#define resample_poly_sat16(v) __SSAT((v), 16)
+#else
+static inline void resample_poly_dot2(const int16_t *x, const int16_t *c0,
+                                      const int16_t *c1, uint32_t taps,
+                                      int64_t *acc0, int64_t *acc1) {
+  int64_t a0 = 0, a1 = 0;
+  uint32_t i;
+
+  for (i = 0; i < taps; i++) {
+    a0 += (int32_t)x[i] * c0[i];
+    a1 += (int32_t)x[i] * c1[i];
+  }
+  *acc0 = a0;
+  *acc1 = a1;
+}
+
+static inline int64_t resample_poly_dot(const int16_t *x, const int16_t *c,
+                                        uint32_t taps) {
+  int64_t a = 0;
+  uint32_t i;
+
+  for (i = 0; i < taps; i++) {
+    a += (int32_t)x[i] * c[i];
+  }
+  return a;
+}
+
+static inline int32_t resample_poly_sat16(int32_t v) {
+  if (v > 32767) {
+    return 32767;
+  } else if (v < -32768) {
+    return -32768;
+  }
+  return v;
+}
+#endif
+
+static void resample_poly_reset(struct RESAMPLE_POLY_T *rs) {
+  // Half a window of silence, so that the first output frame is centred
+  // on the first input frame
+  memset(rs->hist, 0, rs->chans * rs->hist_stride * sizeof(int16_t));
+  rs->hist_cnt = rs->taps / 2;
+  rs->hist_idx = 0;
+  rs->frac = 0;
+}
+
+static enum RESAMPLE_STATUS_T
+resample_poly_check_step(float ratio_step, uint32_t *step_int,
+                         uint32_t *step_frac) {
+  uint64_t step;
+
+  if (!(ratio_step > 0 && ratio_step <= RESAMPLE_POLY_MAX_STEP)) {
+    return RESAMPLE_STATUS_BAD_FACTOR;
+  }
+  step = (uint64_t)((double)ratio_step * 4294967296.0 + 0.5);
+  if (step == 0) {
+    return RESAMPLE_STATUS_BAD_FACTOR;
+  }
+  *step_int = (uint32_t)(step >> 32);
+  *step_frac = (uint32_t)step;
+  return RESAMPLE_STATUS_OK;
+}
+
+enum RESAMPLE_STATUS_T
+audio_resample_poly_open(const struct RESAMPLE_CFG_T *cfg,
+                         RESAMPLE_ID *id_ptr) {
+  const struct RESAMPLE_COEF_T *coef = cfg->coef;
+  struct RESAMPLE_POLY_T *rs;
+  enum RESAMPLE_STATUS_T ret;
+  uint32_t step_int, step_frac;
+  uint8_t shift;
+
+  if (coef == NULL) {
+    return RESAMPLE_STATUS_NO_COEF;
+  }
+  if (coef->coef_group == NULL) {
+    return RESAMPLE_STATUS_NO_COEF_GROUP;
+  }
+  // Only the arbitrary ratio tables, whose phase count is a power of 2
+  if (coef->downsample_factor != 0 || coef->upsample_factor < 2 ||
+      (coef->upsample_factor & (coef->upsample_factor - 1))) {
+    return RESAMPLE_STATUS_BAD_FACTOR;
+  }
+  if (coef->phase_coef_num == 0 || (coef->phase_coef_num & 1) ||
+      coef->total_coef_num !=
+          (uint32_t)coef->upsample_factor * coef->phase_coef_num) {
+    return RESAMPLE_STATUS_BAD_COEF_NUM;
+  }
+  if (cfg->bits != AUD_BITS_16 || cfg->chans == 0) {
+    return RESAMPLE_STATUS_ERROR;
+  }
+  if (cfg->buf == NULL) {
+    return RESAMPLE_STATUS_NO_BUF;
+  }
+  if ((uintptr_t)cfg->buf & 3) {
+    return RESAMPLE_STATUS_BUF_MISALIGN;
+  }
+  if (cfg->size < audio_resample_poly_get_buffer_size(
+                      cfg->chans, cfg->bits, coef->phase_coef_num)) {
+    return RESAMPLE_STATUS_BUF_TOO_SMALL;
+  }
+  ret = resample_poly_check_step(cfg->ratio_step, &step_int, &step_frac);
+  if (ret != RESAMPLE_STATUS_OK) {
+    return ret;
+  }
+
+  for (shift = 0; (1U << shift) < coef->upsample_factor; shift++)
+    ;
+
+  rs = (struct RESAMPLE_POLY_T *)cfg->buf;
+  memset(rs, 0, sizeof(*rs));
+  rs->coef = coef->coef_group;
+  rs->phase_num = coef->upsample_factor;
+  rs->phase_shift = 32 - shift;
+  rs->taps = coef->phase_coef_num;
+  rs->chans = cfg->chans;
+  rs->hist_cap = resample_poly_hist_cap(rs->taps);
+  rs->hist_stride =
+      RESAMPLE_POLY_ALIGN4(rs->hist_cap * sizeof(int16_t)) / sizeof(int16_t);
+  rs->step_int = step_int;
+  rs->step_frac = step_frac;
+  rs->ratio_step = cfg->ratio_step;
+  rs->hist = (int16_t *)((uint8_t *)cfg->buf +
+                         RESAMPLE_POLY_ALIGN4(sizeof(struct RESAMPLE_POLY_T)));
+  resample_poly_reset(rs);
+
+  *id_ptr = (RESAMPLE_ID)rs;
+  return RESAMPLE_STATUS_OK;
+}
+
+void audio_resample_poly_close(RESAMPLE_ID id) {}
+
+void audio_resample_poly_flush(RESAMPLE_ID id) {
+  struct RESAMPLE_POLY_T *rs = (struct RESAMPLE_POLY_T *)id;
+
+  if (rs) {
+    resample_poly_reset(rs);
+  }
+}
+
+enum RESAMPLE_STATUS_T audio_resample_poly_set_ratio_step(RESAMPLE_ID id,
+                                                          float ratio_step) {
+  struct RESAMPLE_POLY_T *rs = (struct RESAMPLE_POLY_T *)id;
+  enum RESAMPLE_STATUS_T ret;
+  uint32_t step_int, step_frac;
+  uint32_t lock;
+
+  if (rs == NULL) {
+    return RESAMPLE_STATUS_BAD_ID;
+  }
+  ret = resample_poly_check_step(ratio_step, &step_int, &step_frac);
+  if (ret != RESAMPLE_STATUS_OK) {
+    return ret;
+  }
+
+  lock = int_lock();
+  rs->step_int = step_int;
+  rs->step_frac = step_frac;
+  rs->ratio_step = ratio_step;
+  int_unlock(lock);
+
+  return RESAMPLE_STATUS_OK;
+}
+
+enum RESAMPLE_STATUS_T audio_resample_poly_get_ratio_step(RESAMPLE_ID id,
+                                                          float *ratio_step) {
+  struct RESAMPLE_POLY_T *rs = (struct RESAMPLE_POLY_T *)id;
+
+  if (rs == NULL) {
+    return RESAMPLE_STATUS_BAD_ID;
+  }
+  *ratio_step = rs->ratio_step;
+  return RESAMPLE_STATUS_OK;
+}
+
+// Drops the frames before the window and appends up to in_frames frames.
+// Returns the number of frames taken.
+static uint32_t resample_poly_fill(struct RESAMPLE_POLY_T *rs,
+                                   const int16_t *in, uint32_t in_frames) {
+  uint32_t drop, keep, n, i, ch;
+  int16_t *h;
+
+  drop = rs->hist_idx < rs->hist_cnt ? rs->hist_idx : rs->hist_cnt;
+  keep = rs->hist_cnt - drop;
+  if (drop) {
+    for (ch = 0; ch < rs->chans; ch++) {
+      h = rs->hist + ch * rs->hist_stride;
+      memmove(h, h + drop, keep * sizeof(int16_t));
+    }
+    rs->hist_cnt = keep;
+    rs->hist_idx -= drop;
+  }
+
+  n = rs->hist_cap - keep;
+  if (n > in_frames) {
+    n = in_frames;
+  }
+  if (rs->chans == 1) {
+    memcpy(rs->hist + keep, in, n * sizeof(int16_t));
+  } else {
+    for (ch = 0; ch < rs->chans; ch++) {
+      h = rs->hist + ch * rs->hist_stride + keep;
+      for (i = 0; i < n; i++) {
+        h[i] = in[i * rs->chans + ch];
+      }
+    }
+  }
+  rs->hist_cnt += n;
+  return n;
+}
+
+enum RESAMPLE_STATUS_T SRAM_TEXT_LOC
+audio_resample_poly_run(RESAMPLE_ID id, const struct RESAMPLE_IO_BUF_T *io,
+                        uint32_t *in_size_ptr, uint32_t *out_size_ptr) {
+  struct RESAMPLE_POLY_T *rs = (struct RESAMPLE_POLY_T *)id;
+  const int16_t *in;
+  const int16_t *c0, *c1;
+  int16_t *out, *h;
+  uint32_t frame_size, in_frames, out_frames, in_done, out_done;
+  uint32_t step_int, step_frac, frac, idx, need, phase, w, ch;
+  uint32_t taps, lock;
+  int64_t acc0, acc1;
+
+  if (rs == NULL) {
+    return RESAMPLE_STATUS_BAD_ID;
+  }
+
+  frame_size = rs->chans * sizeof(int16_t);
+  in = (const int16_t *)io->in;
+  in_frames = io->in_size / frame_size;
+  out = (int16_t *)io->out;
+  out_frames = io->out_size / frame_size;
+  in_done = 0;
+  out_done = 0;
+  taps = rs->taps;
+
+  lock = int_lock();
+  step_int = rs->step_int;
+  step_frac = rs->step_frac;
+  int_unlock(lock);
+
+  frac = rs->frac;
+  idx = rs->hist_idx;
+  // The last phase is interpolated against phase 0 one frame later
+  need = taps + 1;
+
+  while (out_done < out_frames) {
+    if (idx + need > rs->hist_cnt) {
+      if (in_done >= in_frames) {
+        break;
+      }
+      rs->hist_idx = idx;
+      in_done += resample_poly_fill(rs, in + in_done * rs->chans,
+                                    in_frames - in_done);
+      idx = rs->hist_idx;
+      continue;
+    }
+
+    phase = frac >> rs->phase_shift;
+    w = (frac << (32 - rs->phase_shift)) >> (32 - RESAMPLE_POLY_WEIGHT_Q);
+    c0 = rs->coef + phase * taps;
+
+    for (ch = 0; ch < rs->chans; ch++) {
+      h = rs->hist + ch * rs->hist_stride + idx;
+      if (phase + 1 < rs->phase_num) {
+        c1 = c0 + taps;
+        resample_poly_dot2(h, c0, c1, taps, &acc0, &acc1);
+      } else {
+        acc0 = resample_poly_dot(h, c0, taps);
+        acc1 = resample_poly_dot(h + 1, rs->coef, taps);
+      }
+      acc0 = acc0 * ((1 << RESAMPLE_POLY_WEIGHT_Q) - w) + acc1 * w;
+      *out++ = (int16_t)resample_poly_sat16((int32_t)(
+          (acc0 + (1LL << (RESAMPLE_POLY_OUT_SHIFT - 1))) >>
+          RESAMPLE_POLY_OUT_SHIFT));
+    }
+    if (io->out_cyclic_end && (void *)out >= io->out_cyclic_end) {
+      out = (int16_t *)io->out_cyclic_start;
+    }
+    out_done++;
+
+    frac += step_frac;
+    idx += step_int + (frac < step_frac);
+  }
+
+  rs->frac = frac;
+  rs->hist_idx = idx;
+
+  *in_size_ptr = in_done * frame_size;
+  *out_size_ptr = out_done * frame_size;
+
+  if (out_done == out_frames) {
+    return RESAMPLE_STATUS_OUT_FULL;
+  }
+  return RESAMPLE_STATUS_IN_EMPTY;
+}
@@ -3,9 +3,8 @@
 #include "string.h"
 #ifdef RTOS
 #include "cmsis_os.h"
-#else
-#include "hal_timer.h"
 #endif
+#include "hal_timer.h"
 #include "hal_norflash.h"
 #include "hal_sleep.h"
 #include "hal_trace.h"
@@ -20,12 +19,34 @@
 
 #define API_IS_ALIGN(v, size) (((v / size) * size) == v)
 
+// time kept free before the next audio DMA interrupt
+#define NORFLASH_API_WINDOW_GUARD_US 500
+// marks further apart than this mean that the audio stream has stopped
+#define NORFLASH_API_WINDOW_MAX_PERIOD_US 100000
+// initial costs, refined by operations that ran without being suspended
+#define NORFLASH_API_SECTOR_ERASE_US 50000
+#define NORFLASH_API_PAGE_PROGRAM_US 1000
+#define NORFLASH_API_PAGE_LEN 256
+
+// sector -> newest pending operation, open addressing; must stay sparse
+#define NORFLASH_API_OVERLAY_LEN 32
+#if NORFLASH_API_OPRA_LIST_LEN * 2 > NORFLASH_API_OVERLAY_LEN
+#error "NORFLASH_API_OVERLAY_LEN is too small"
+#endif
+#define NORFLASH_API_OVERLAY_HASH(addr)                                        \
+  (((addr) / NORFLASH_API_SECTOR_SIZE) & (NORFLASH_API_OVERLAY_LEN - 1))
+
 static NORFLASH_API_INFO norflash_api_info = {
     false,
 };
 static OPERA_INFO_LIST opera_info_list[NORFLASH_API_OPRA_LIST_LEN];
 static DATA_LIST data_list[NORFLASH_API_WRITE_BUFF_LEN];
 static int suspend_number = 0;
+static uint32_t window_mark;
+static uint32_t window_period;
+static uint32_t sector_erase_us = NORFLASH_API_SECTOR_ERASE_US;
+static uint32_t page_program_us = NORFLASH_API_PAGE_PROGRAM_US;
+static OPRA_INFO *overlay_index[NORFLASH_API_OVERLAY_LEN];
 
 static void *_norflash_api_malloc(uint32_t size) {
   uint32_t i;
@@ -100,6 +121,125 @@ static OPRA_INFO *_get_tail(MODULE_INFO *mod_info, bool is_remove) {
   return opera_node;
 }
 
+static OPRA_INFO *_get_oldest(MODULE_INFO *mod_info) {
+  OPRA_INFO *opera_node = mod_info->opera_info;
+
+  while (opera_node && opera_node->next) {
+    opera_node = opera_node->next;
+  }
+  return opera_node;
+}
+
+// Overlay index: pending operations by sector address, so that a read only
+// looks at the newest operation of the sectors it covers. Each operation
+// keeps a bitmap of the overlay units (pages, at most 32 per sector) it
+// changes; the rest of the sector reads from flash.
+
+static uint32_t _overlay_mask(MODULE_INFO *mod_info, uint32_t offs,
+                              uint32_t len) {
+  uint32_t first;
+  uint32_t num;
+
+  if (len == 0) {
+    return 0;
+  }
+  first = offs / mod_info->overlay_unit;
+  num = (offs + len - 1) / mod_info->overlay_unit - first + 1;
+  if (num >= 32) {
+    return 0xFFFFFFFF;
+  }
+  return ((1U << num) - 1) << first;
+}
+
+static uint32_t _overlay_slot(uint32_t addr) {
+  uint32_t i = NORFLASH_API_OVERLAY_HASH(addr);
+
+  while (overlay_index[i] && overlay_index[i]->addr != addr) {
+    i = (i + 1) & (NORFLASH_API_OVERLAY_LEN - 1);
+  }
+  return i;
+}
+
+static void _overlay_set(uint32_t addr, OPRA_INFO *node) {
+  uint32_t i = _overlay_slot(addr);
+  uint32_t j = i;
+  uint32_t home;
+
+  overlay_index[i] = node;
+  if (node) {
+    return;
+  }
+  // move back the entries probed past the freed slot
+  while (true) {
+    j = (j + 1) & (NORFLASH_API_OVERLAY_LEN - 1);
+    if (!overlay_index[j]) {
+      break;
+    }
+    home = NORFLASH_API_OVERLAY_HASH(overlay_index[j]->addr);
+    if (((j - home) & (NORFLASH_API_OVERLAY_LEN - 1)) >=
+        ((j - i) & (NORFLASH_API_OVERLAY_LEN - 1))) {
+      overlay_index[i] = overlay_index[j];
+      overlay_index[j] = NULL;
+      i = j;
+    }
+  }
+}
+
+static bool _overlay_is_wide(MODULE_INFO *mod_info, OPRA_INFO *node) {
+  return node->type == NORFLASH_API_ERASING &&
+         node->len > mod_info->mod_sector_len;
+}
+
+// node has just been added to the head of the list.
+static void _overlay_add(MODULE_INFO *mod_info, OPRA_INFO *node) {
+  _overlay_set(node->addr, node);
+  if (_overlay_is_wide(mod_info, node)) {
+    mod_info->wide_erase_count++;
+  }
+}
+
+// node has just been removed from the list.
+static void _overlay_del(MODULE_INFO *mod_info, OPRA_INFO *node) {
+  OPRA_INFO *tmp;
+
+  if (_overlay_is_wide(mod_info, node)) {
+    mod_info->wide_erase_count--;
+  }
+  if (overlay_index[_overlay_slot(node->addr)] != node) {
+    return;
+  }
+  tmp = mod_info->opera_info;
+  while (tmp && tmp->addr != node->addr) {
+    tmp = tmp->next;
+  }
+  _overlay_set(node->addr, tmp);
+}
+
+// Returns the newest pending operation on the sector at sec_start.
+static OPRA_INFO *_overlay_find(MODULE_INFO *mod_info, uint32_t sec_start) {
+  OPRA_INFO *tmp;
+
+  if (!mod_info->opera_info) {
+    return NULL;
+  }
+  if (mod_info->wide_erase_count == 0) {
+    return overlay_index[_overlay_slot(sec_start)];
+  }
+  // block erases cover sectors other than their own address
+  tmp = mod_info->opera_info;
+  while (tmp) {
+    if (tmp->type == NORFLASH_API_WRITTING) {
+      if (tmp->addr == sec_start) {
+        break;
+      }
+    } else if (sec_start >= tmp->addr && sec_start < tmp->addr + tmp->len) {
+      break;
+    }
+    tmp = tmp->next;
+  }
+  return tmp;
+}
+
 static void _opera_del(MODULE_INFO *mod_info, OPRA_INFO *node) {
   OPRA_INFO *opera_node = NULL;
   OPRA_INFO *pre_node = NULL;
@@ -115,6 +255,7 @@ static void _opera_del(MODULE_INFO *mod_info, OPRA_INFO *node) {
       } else {
         pre_node->next = NULL;
       }
+      _overlay_del(mod_info, node);
       if (node->buff) {
         _norflash_api_free(node->buff);
       }
@@ -174,10 +315,21 @@ static uint32_t _get_e_count(MODULE_INFO *mod_info) {
   return count;
 }
 
+static bool _opera_is_late(MODULE_INFO *mod_info, OPRA_INFO *opera_info) {
+  return hal_sys_timer_get() - opera_info->queued_ticks >=
+         MS_TO_TICKS(mod_info->budget_ms);
+}
+
+// An operation in progress is finished first. Otherwise pick the module
+// with the highest priority, late modules first, round robin on ties.
 static MODULE_INFO *_get_cur_mod(void) {
   uint32_t i;
   MODULE_INFO *mod_info = NULL;
+  MODULE_INFO *best_mod_info = NULL;
+  OPRA_INFO *opera_info;
   uint32_t tmp_mod_id = NORFLASH_API_MODULE_ID_COUNT;
+  uint32_t rank;
+  uint32_t best_rank = 0;
 
   if (norflash_api_info.cur_mod) {
     return norflash_api_info.cur_mod;
@@ -188,13 +340,121 @@ static MODULE_INFO *_get_cur_mod(void) {
     tmp_mod_id =
         tmp_mod_id + 1 >= NORFLASH_API_MODULE_ID_COUNT ? 0 : tmp_mod_id + 1;
     mod_info = _get_module_info((enum NORFLASH_API_MODULE_ID_T)tmp_mod_id);
-    if (mod_info->is_inited) {
-      if (_get_ew_count(mod_info) > 0) {
-        return mod_info;
-      }
+    if (!mod_info->is_inited) {
+      continue;
+    }
+    opera_info = _get_oldest(mod_info);
+    if (!opera_info) {
+      continue;
+    }
+    rank = mod_info->priority + 1;
+    if (_opera_is_late(mod_info, opera_info)) {
+      rank += NORFLASH_API_PRIORITY_COUNT;
+    }
+    if (rank > best_rank) {
+      best_rank = rank;
+      best_mod_info = mod_info;
+    }
+  }
+  return best_mod_info;
+}
+
+// Time left before the next audio DMA interrupt, or 0xFFFFFFFF without
+// audio.
+static uint32_t _window_left_us(void) {
+  uint32_t elapsed;
+
+  if (window_period == 0) {
+    return 0xFFFFFFFF;
+  }
+  elapsed = hal_fast_sys_timer_get() - window_mark;
+  if (elapsed >= window_period * 2) {
+    window_period = 0;
+    return 0xFFFFFFFF;
+  }
+  if (elapsed >= window_period) {
+    return 0;
+  }
+  return FAST_TICKS_TO_US(window_period - elapsed);
+}
+
+static uint32_t _opera_cost_us(MODULE_INFO *mod_info, OPRA_INFO *opera_info) {
+#if defined(FLASH_SUSPEND)
+  // the flash is suspended as soon as the DMA interrupt is pending
+  mod_info = mod_info;
+  opera_info = opera_info;
+  return NORFLASH_API_WINDOW_GUARD_US;
+#else
+  uint32_t n;
+
+  if (opera_info->type == NORFLASH_API_ERASING) {
+    n = opera_info->len / mod_info->mod_sector_len;
+    return (n ? n : 1) * sector_erase_us + NORFLASH_API_WINDOW_GUARD_US;
+  }
+  n = (opera_info->w_len + NORFLASH_API_PAGE_LEN - 1) / NORFLASH_API_PAGE_LEN;
+  return n * page_program_us + NORFLASH_API_WINDOW_GUARD_US;
+#endif
+}
+
+static void _opera_done(MODULE_INFO *mod_info, OPRA_INFO *opera_info) {
+  NORFLASH_API_STATS *stats = &mod_info->stats;
+  uint32_t lat_ms;
+  uint32_t busy_us;
+  uint32_t n;
+
+  lat_ms = TICKS_TO_MS(hal_sys_timer_get() - opera_info->queued_ticks);
+  busy_us =
+      FAST_TICKS_TO_US(hal_fast_sys_timer_get() - opera_info->start_ticks);
+
+  stats->op_count++;
+  stats->suspend_count += suspend_number;
+  stats->lat_sum_ms += lat_ms;
+  if (lat_ms > mod_info->budget_ms) {
+    stats->late_count++;
+  }
+  if (lat_ms > stats->lat_max_ms) {
+    stats->lat_max_ms = lat_ms;
+  }
+  if (busy_us > stats->busy_max_us) {
+    stats->busy_max_us = busy_us;
+  }
+
+  if (suspend_number) {
+    return;
+  }
+  // track the costs of this flash, 1/4 weight to the new sample
+  if (opera_info->type == NORFLASH_API_ERASING) {
+    n = opera_info->len / mod_info->mod_sector_len;
+    if (n) {
+      sector_erase_us = (sector_erase_us * 3 + busy_us / n) / 4;
     }
+  } else if (opera_info->w_len) {
+    n = (opera_info->w_len + NORFLASH_API_PAGE_LEN - 1) / NORFLASH_API_PAGE_LEN;
+    page_program_us = (page_program_us * 3 + busy_us / n) / 4;
+  }
+}
+
+static void _set_default_priority(MODULE_INFO *mod_info,
+                                  enum NORFLASH_API_MODULE_ID_T mod_id) {
+  switch (mod_id) {
+  case NORFLASH_API_MODULE_ID_USERDATA:
+  case NORFLASH_API_MODULE_ID_USERDATA_EXT:
+  case NORFLASH_API_MODULE_ID_FACTORY:
+    mod_info->priority = NORFLASH_API_PRIORITY_HIGH;
+    mod_info->budget_ms = 200;
+    break;
+  case NORFLASH_API_MODULE_ID_OTA:
+  case NORFLASH_API_MODULE_ID_INTERACTION_OTA:
+  case NORFLASH_API_MODULE_ID_GMA_OTA:
+  case NORFLASH_API_MODULE_ID_HOTWORD_MODEL:
+    mod_info->priority = NORFLASH_API_PRIORITY_NORMAL;
+    mod_info->budget_ms = 1000;
+    break;
+  default:
+    mod_info->priority = NORFLASH_API_PRIORITY_LOW;
+    mod_info->budget_ms = 5000;
+    break;
   }
-  return NULL;
 }
 
 static enum NORFLASH_API_MODULE_ID_T _get_mod_id(MODULE_INFO *mod_info) {
@@ -306,54 +566,73 @@ static void _flash_remap_done(enum HAL_NORFLASH_ID_T id, uint32_t addr,
 #define FLASH_REMAP_DONE(...)
 #endif
 
+static void _flash_read(MODULE_INFO *mod_info, uint32_t addr, uint8_t *buff,
+                        uint32_t len) {
+  FLASH_REMAP_START(mod_info->dev_id, addr, len);
+  memcpy(buff, (uint8_t *)addr, len);
+  FLASH_REMAP_DONE(mod_info->dev_id, addr, len);
+}
+
+// Reads [addr, addr + len) of the sector at sec_start as it will be once
+// node, the newest operation on it, is done.
+static void _overlay_read(MODULE_INFO *mod_info, OPRA_INFO *node,
+                          uint32_t sec_start, uint32_t addr, uint8_t *buff,
+                          uint32_t len) {
+  uint32_t unit = mod_info->overlay_unit;
+  uint32_t offs = addr - sec_start;
+  uint32_t end = offs + len;
+  uint32_t r_len;
+  bool dirty;
+
+  if (!node || !(node->dirty & _overlay_mask(mod_info, offs, len))) {
+    _flash_read(mod_info, addr, buff, len);
+    return;
+  }
+  while (offs < end) {
+    dirty = (node->dirty >> (offs / unit)) & 1;
+    r_len = (offs / unit + 1) * unit - offs;
+    while (offs + r_len < end &&
+           ((node->dirty >> ((offs + r_len) / unit)) & 1) == dirty) {
+      r_len += unit;
+    }
+    if (offs + r_len > end) {
+      r_len = end - offs;
+    }
+    if (!dirty) {
+      _flash_read(mod_info, sec_start + offs, buff, r_len);
+    } else if (node->buff) {
+      memcpy(buff, node->buff + offs, r_len);
+    } else {
+      memset(buff, 0xff, r_len);
+    }
+    offs += r_len;
+    buff += r_len;
+  }
+}
+
 static int32_t _opera_read(MODULE_INFO *mod_info, uint32_t addr, uint8_t *buff,
                            uint32_t len) {
-  OPRA_INFO *opera_node = NULL;
-  OPRA_INFO *e_node = NULL;
-  OPRA_INFO *w_node = NULL;
-  OPRA_INFO *tmp;
-  uint32_t r_offs;
   uint32_t sec_start;
   uint32_t sec_len;
+  uint32_t r_len;
 
-  sec_len = mod_info->mod_sector_len;
-  sec_start = (addr / sec_len) * sec_len;
-  tmp = mod_info->opera_info;
-  while (tmp) {
-    opera_node = tmp;
-    tmp = opera_node->next;
-    if (opera_node->addr == sec_start) {
-      if (opera_node->type == NORFLASH_API_WRITTING) {
-        w_node = opera_node;
-        break;
-      } else {
-        e_node = opera_node;
-        break;
-      }
-    }
+  if (!mod_info->opera_info) {
+    _flash_read(mod_info, addr, buff, len);
+    return 0;
   }
 
-  if (w_node) {
-    r_offs = addr - sec_start;
-    memcpy(buff, w_node->buff + r_offs, len);
-  } else {
-    if (e_node) {
-      memset(buff, 0xff, len);
-    } else {
-      FLASH_REMAP_START(mod_info->dev_id, addr, len);
-      memcpy(buff, (uint8_t *)addr, len);
-      FLASH_REMAP_DONE(mod_info->dev_id, addr, len);
-      /*
-      HAL_NORFLASH_RET_T result;
-      result = hal_norflash_read(mod_info->dev_id,addr,buff,len);
-      if(result != HAL_NORFLASH_OK)
-      {
-          NORFLASH_API_TRACE(2,"%s: hal_norflash_read failed,result = %d.",
-                  __func__,result);
-          return result;
-      }
-      */
+  sec_len = mod_info->mod_sector_len;
+  while (len > 0) {
+    sec_start = (addr / sec_len) * sec_len;
+    r_len = sec_start + sec_len - addr;
+    if (r_len > len) {
+      r_len = len;
     }
+    _overlay_read(mod_info, _overlay_find(mod_info, sec_start), sec_start,
+                  addr, buff, r_len);
+    addr += r_len;
+    buff += r_len;
+    len -= r_len;
   }
   return 0;
 }
@@ -365,28 +644,32 @@ static int32_t _e_opera_add(MODULE_INFO *mod_info, uint32_t addr,
   OPRA_INFO *tmp;
   int32_t ret = 0;
 
-  // delete opera nodes with the same address when add the erase opera node.
+  // delete opera nodes covered by the erase opera node when add it.
   pre_node = mod_info->opera_info;
   tmp = mod_info->opera_info;
   while (tmp) {
     opera_node = tmp;
     tmp = opera_node->next;
 
-    if (opera_node->addr == addr) {
+    if (opera_node->addr >= addr &&
+        opera_node->addr + opera_node->len <= addr + len) {
       if (opera_node->lock == false) {
         if (opera_node == mod_info->opera_info) {
           mod_info->opera_info = tmp;
         } else {
           pre_node->next = tmp;
         }
+        _overlay_del(mod_info, opera_node);
         if (opera_node->type == NORFLASH_API_WRITTING) {
           if (opera_node->buff) {
             _norflash_api_free(opera_node->buff);
           }
         }
         _norflash_api_free(opera_node);
+        continue;
       } else {
-        if (opera_node->type == NORFLASH_API_ERASING) {
+        if (opera_node->type == NORFLASH_API_ERASING &&
+            opera_node->addr == addr && opera_node->len == len) {
           NORFLASH_API_TRACE(3, "%s: erase is merged! addr = 0x%x,len = 0x%x.",
                              __func__, opera_node->addr, opera_node->len);
           ret = 0;
@@ -415,8 +698,13 @@ static int32_t _e_opera_add(MODULE_INFO *mod_info, uint32_t addr,
   opera_node->w_len = 0;
   opera_node->buff = NULL;
   opera_node->lock = false;
+  opera_node->dirty = _overlay_mask(
+      mod_info, 0,
+      len < mod_info->mod_sector_len ? len : mod_info->mod_sector_len);
+  opera_node->queued_ticks = hal_sys_timer_get();
   opera_node->next = mod_info->opera_info;
   mod_info->opera_info = opera_node;
+  _overlay_add(mod_info, opera_node);
   ret = 0;
 _func_end:
 
@@ -426,7 +714,7 @@ _func_end:
 static int32_t _w_opera_add(MODULE_INFO *mod_info, uint32_t addr, uint32_t len,
                             uint8_t *buff) {
   OPRA_INFO *opera_node = NULL;
-  OPRA_INFO *e_node = NULL;
+  OPRA_INFO *prev_node = NULL;
   OPRA_INFO *w_node = NULL;
   OPRA_INFO *tmp;
   uint32_t w_offs;
@@ -449,17 +737,16 @@ static int32_t _w_opera_add(MODULE_INFO *mod_info, uint32_t addr, uint32_t len,
     opera_node = tmp;
     tmp = opera_node->next;
 
-    if (opera_node->addr == sec_start) {
-      if (opera_node->type == NORFLASH_API_WRITTING) {
-        if (!opera_node->lock) {
-          // select the first w_node in the list.
-          w_node = opera_node;
-          break;
-        }
-      } else {
-        e_node = opera_node;
+    if (opera_node->type == NORFLASH_API_WRITTING) {
+      if (opera_node->addr == sec_start && !opera_node->lock) {
+        // select the first w_node in the list.
+        w_node = opera_node;
         break;
       }
+    } else if (sec_start >= opera_node->addr &&
+               sec_start < opera_node->addr + opera_node->len) {
+      // a later write must not be merged into a write before the erase.
+      break;
     }
   }
 
@@ -472,6 +759,7 @@ static int32_t _w_opera_add(MODULE_INFO *mod_info, uint32_t addr, uint32_t len,
     w_len_new = w_end - w_start;
     w_node->w_offs = w_start;
     w_node->w_len = w_len_new;
+    w_node->dirty |= _overlay_mask(mod_info, w_offs, w_len);
     opera_node = w_node;
     ret = 0;
   } else {
@@ -495,15 +783,19 @@ static int32_t _w_opera_add(MODULE_INFO *mod_info, uint32_t addr, uint32_t len,
       ret = 1;
       goto _func_end;
     }
-    if (e_node) {
-      memset(opera_node->buff, 0xff, opera_node->len);
-    } else {
-      memcpy(opera_node->buff, (uint8_t *)opera_node->addr, opera_node->len);
-    }
+    // start from the sector as the pending erase, or the write in progress,
+    // will leave it.
+    prev_node = _overlay_find(mod_info, sec_start);
+    _overlay_read(mod_info, prev_node, sec_start, sec_start, opera_node->buff,
+                  opera_node->len);
     memcpy(opera_node->buff + w_offs, buff, w_len);
     opera_node->lock = false;
+    opera_node->dirty = (prev_node ? prev_node->dirty : 0) |
+                        _overlay_mask(mod_info, w_offs, w_len);
+    opera_node->queued_ticks = hal_sys_timer_get();
     opera_node->next = mod_info->opera_info;
     mod_info->opera_info = opera_node;
+    _overlay_add(mod_info, opera_node);
     ret = 0;
   }
 
@@ -539,6 +831,7 @@ bool _opera_flush(MODULE_INFO *mod_info, bool nosuspend) {
   if (cur_opera_info->type == NORFLASH_API_WRITTING) {
     if (mod_info->state == NORFLASH_API_STATE_IDLE) {
       suspend_number = 0;
+      cur_opera_info->start_ticks = hal_fast_sys_timer_get();
       if (cur_opera_info->w_len > 0) {
         NORFLASH_API_TRACE(5,
                            "%s: %d,hal_norflash_write_suspend,addr = 0x%x,len "
@@ -599,6 +892,7 @@ bool _opera_flush(MODULE_INFO *mod_info, bool nosuspend) {
   } else {
     if (mod_info->state == NORFLASH_API_STATE_IDLE) {
       suspend_number = 0;
+      cur_opera_info->start_ticks = hal_fast_sys_timer_get();
       NORFLASH_API_TRACE(5,
                          "%s: %d,hal_norflash_erase_suspend,addr = 0x%x,len = "
                          "0x%x,suspend = %d.",
@@ -673,6 +967,7 @@ __opera_is_completed:
       opera_result.remain_num = _get_ew_count(mod_info) - 1;
       mod_info->cb_func(&opera_result);
     }
+    _opera_done(mod_info, cur_opera_info);
     _opera_del(mod_info, cur_opera_info);
     mod_info->cur_opera_info = NULL;
   }
@@ -781,10 +1076,17 @@ norflash_api_register(enum NORFLASH_API_MODULE_ID_T mod_id,
   mod_info->mod_sector_len = mod_sector_len;
   mod_info->mod_page_len = mod_page_len;
   mod_info->buff_len = buffer_len;
+  mod_info->overlay_unit = mod_page_len;
+  if (mod_info->overlay_unit < mod_sector_len / 32) {
+    mod_info->overlay_unit = mod_sector_len / 32;
+  }
+  mod_info->wide_erase_count = 0;
   mod_info->cb_func = cb_func;
   mod_info->opera_info = NULL;
   mod_info->cur_opera_info = NULL;
   mod_info->state = NORFLASH_API_STATE_IDLE;
+  _set_default_priority(mod_info, mod_id);
+  memset(&mod_info->stats, 0, sizeof(mod_info->stats));
   mod_info->is_inited = true;
   return NORFLASH_API_OK;
 }
@@ -1116,11 +1418,10 @@ enum NORFLASH_API_RET_T norflash_api_write(enum NORFLASH_API_MODULE_ID_T mod_id,
   return ret;
 }
 
-// -1: error, 0:all pending flash op flushed, 1:still pending flash op to be
-// flushed
-int norflash_api_flush(void) {
+static int _norflash_api_flush(bool force) {
   enum NORFLASH_API_MODULE_ID_T mod_id = NORFLASH_API_MODULE_ID_COUNT;
   MODULE_INFO *mod_info = NULL;
+  OPRA_INFO *opera_info = NULL;
   uint32_t lock;
   bool bret = false;
 
@@ -1147,10 +1448,20 @@ int norflash_api_flush(void) {
   }
   mod_id = _get_mod_id(mod_info);
 
+  opera_info = mod_info->cur_opera_info ? mod_info->cur_opera_info
+                                         : _get_oldest(mod_info);
+  if (!force && !_opera_is_late(mod_info, opera_info) &&
+      _opera_cost_us(mod_info, opera_info) > _window_left_us()) {
+    mod_info->stats.skip_count++;
+    int_unlock_global(lock);
+    return 0;
+  }
+
   norflash_api_info.cur_mod_id = mod_id;
   norflash_api_info.cur_mod = mod_info;
   bret = _opera_flush(mod_info, false);
-  if (!bret) {
+  // reschedule once the operation is done
+  if (!bret || !mod_info->cur_opera_info) {
     norflash_api_info.cur_mod = NULL;
   }
   int_unlock_global(lock);
@@ -1158,6 +1469,10 @@ int norflash_api_flush(void) {
   return 1;
 }
 
+// -1: error, 0:all pending flash op flushed, or deferred to the next audio
+// window, 1:still pending flash op to be flushed
+int norflash_api_flush(void) { return _norflash_api_flush(false); }
+
 bool norflash_api_buffer_is_free(enum NORFLASH_API_MODULE_ID_T mod_id) {
   MODULE_INFO *mod_info = NULL;
   uint32_t count;
@@ -1243,7 +1558,7 @@ void norflash_api_flush_all(void) {
 
   norflash_api_flush_enable_all();
   do {
-    ret = norflash_api_flush();
+    ret = _norflash_api_flush(true);
     if (ret == 1) {
       cnt++;
     }
@@ -1289,6 +1604,77 @@ norflash_api_get_state(enum NORFLASH_API_MODULE_ID_T mod_id) {
   return norflash_api_info.mod_info[mod_id].state;
 }
 
+void norflash_api_set_priority(enum NORFLASH_API_MODULE_ID_T mod_id,
+                               enum NORFLASH_API_PRIORITY priority,
+                               uint32_t budget_ms) {
+  MODULE_INFO *mod_info;
+  uint32_t lock;
+
+  ASSERT(mod_id < NORFLASH_API_MODULE_ID_COUNT &&
+             priority < NORFLASH_API_PRIORITY_COUNT,
+         "%s: mod_id(%d) or priority(%d) error!", __func__, mod_id, priority);
+  mod_info = _get_module_info(mod_id);
+  lock = int_lock_global();
+  mod_info->priority = priority;
+  mod_info->budget_ms = budget_ms;
+  int_unlock_global(lock);
+}
+
+void norflash_api_get_stats(enum NORFLASH_API_MODULE_ID_T mod_id,
+                            NORFLASH_API_STATS *stats) {
+  uint32_t lock;
+
+  ASSERT(mod_id < NORFLASH_API_MODULE_ID_COUNT,
+         "%s : mod_id error! mod_id = %d.", __func__, mod_id);
+  lock = int_lock_global();
+  *stats = norflash_api_info.mod_info[mod_id].stats;
+  int_unlock_global(lock);
+}
+
+void norflash_api_reset_stats(enum NORFLASH_API_MODULE_ID_T mod_id) {
+  uint32_t lock;
+
+  ASSERT(mod_id < NORFLASH_API_MODULE_ID_COUNT,
+         "%s : mod_id error! mod_id = %d.", __func__, mod_id);
+  lock = int_lock_global();
+  memset(&norflash_api_info.mod_info[mod_id].stats, 0,
+         sizeof(NORFLASH_API_STATS));
+  int_unlock_global(lock);
+}
+
+void norflash_api_dump_stats(void) {
+  NORFLASH_API_STATS stats;
+  uint32_t lat_avg_ms;
+  uint32_t i;
+
+  TRACE(2, "norflash_api: sector erase %d us, page program %d us",
+        sector_erase_us, page_program_us);
+  for (i = 0; i < NORFLASH_API_MODULE_ID_COUNT; i++) {
+    if (!norflash_api_info.mod_info[i].is_inited) {
+      continue;
+    }
+    norflash_api_get_stats((enum NORFLASH_API_MODULE_ID_T)i, &stats);
+    lat_avg_ms = stats.op_count ? stats.lat_sum_ms / stats.op_count : 0;
+    TRACE(8,
+          "mod %d: ops %d late %d suspends %d skips %d lat avg %d max %d ms "
+          "busy max %d us",
+          i, stats.op_count, stats.late_count, stats.suspend_count,
+          stats.skip_count, lat_avg_ms, stats.lat_max_ms, stats.busy_max_us);
+  }
+}
+
+void norflash_api_flush_window_mark(void) {
+  uint32_t now = hal_fast_sys_timer_get();
+  uint32_t interval = now - window_mark;
+
+  if (interval < US_TO_FAST_TICKS(NORFLASH_API_WINDOW_MAX_PERIOD_US)) {
+    window_period = interval;
+  } else {
+    window_period = 0;
+  }
+  window_mark = now;
+}
+
 void norflash_flush_all_pending_op(void) { norflash_api_flush_all(); }
 
 void app_flush_pending_flash_op(enum NORFLASH_API_MODULE_ID_T module,
@@ -75,6 +75,28 @@ enum NORFLASH_API_USER
     NORFLASH_API_USER_COUNTS,
 };
 
+// Modules with pending operations are flushed by priority, round robin
+// within a priority. A module whose oldest operation has waited longer
+// than its latency budget goes first and ignores the audio flush window.
+enum NORFLASH_API_PRIORITY
+{
+    NORFLASH_API_PRIORITY_LOW,
+    NORFLASH_API_PRIORITY_NORMAL,
+    NORFLASH_API_PRIORITY_HIGH,
+    NORFLASH_API_PRIORITY_COUNT,
+};
+
+typedef struct
+{
+    uint32_t op_count;      // completed erase/write operations
+    uint32_t late_count;    // completed after the latency budget
+    uint32_t suspend_count; // suspends of the operations
+    uint32_t skip_count;    // flushes deferred to the next audio window
+    uint32_t lat_max_ms;    // queued to completed
+    uint32_t lat_sum_ms;
+    uint32_t busy_max_us;   // started to completed, suspended time included
+}NORFLASH_API_STATS;
+
 typedef void (* NORFLASH_API_OPERA_CB)(void* opera_result);
 typedef bool (*NOFLASH_API_FLUSH_ALLOWED_CB)(void);
 
@@ -87,6 +109,9 @@ typedef struct _opera_info
     uint32_t w_len;
     uint8_t *buff;
     bool lock;
+    uint32_t dirty; // overlay units of the sector that differ from flash
+    uint32_t queued_ticks;
+    uint32_t start_ticks;
     struct _opera_info *next;
 }OPRA_INFO;
 
@@ -102,10 +127,15 @@ typedef struct
     uint32_t mod_sector_len;
     uint32_t mod_page_len;
     uint32_t buff_len;
+    uint32_t overlay_unit;
+    uint32_t wide_erase_count;
     NORFLASH_API_OPERA_CB cb_func;
     OPRA_INFO *opera_info;
     OPRA_INFO *cur_opera_info;
     enum NORFLASH_API_STATE state;
+    enum NORFLASH_API_PRIORITY priority;
+    uint32_t budget_ms;
+    NORFLASH_API_STATS stats;
 }MODULE_INFO;
 
 typedef struct
@@ -205,6 +235,26 @@ void norflash_api_flush_enable(enum NORFLASH_API_USER user_id);
 void norflash_api_flush_enable_all(void);
 enum NORFLASH_API_STATE norflash_api_get_state(enum NORFLASH_API_MODULE_ID_T mod_id);
 
+void norflash_api_set_priority(
+                enum NORFLASH_API_MODULE_ID_T mod_id,
+                enum NORFLASH_API_PRIORITY priority,
+                uint32_t budget_ms
+                );
+
+void norflash_api_get_stats(
+                enum NORFLASH_API_MODULE_ID_T mod_id,
+                NORFLASH_API_STATS *stats
+                );
+
+void norflash_api_reset_stats(enum NORFLASH_API_MODULE_ID_T mod_id);
+
+void norflash_api_dump_stats(void);
+
+// Called at each audio DMA interrupt. While the marks keep coming, a flush
+// only starts or resumes an operation that is expected to end (or, with
+// FLASH_SUSPEND, to be suspended) before the next mark.
+void norflash_api_flush_window_mark(void);
+
 void norflash_flush_all_pending_op(void);
 
 void app_flush_pending_flash_op(enum NORFLASH_API_MODULE_ID_T module,
@@ -31,6 +31,9 @@
 #include "nvrecord_dma_config.h"
 #include "nvrecord_env.h"
 #include "nvrecord_fp_account_key.h"
+#ifdef NV_RECORD_LOG_ENABLED
+#include "nvrecord_log.h"
+#endif
 #include <assert.h>
 #include <stdbool.h>
 #include <string.h>
@@ -73,7 +76,9 @@ static NV_FLUSH_STATE nv_flsh_state;
 static bool nvrec_init = false;
 static uint32_t _user_data_main_start;
 static uint32_t _user_data_bak_start;
+#ifndef NV_RECORD_LOG_ENABLED
 static uint8_t _nv_burn_buf[NV_EXTENSION_PAGE_SIZE];
+#endif
 
 NV_EXTENSION_RECORD_T *nvrecord_extension_p = NULL;
 
@@ -362,6 +367,22 @@ static void nv_record_extension_init(void) {
            nvrecord_extension_p->header.validLen);
   }
 
+#ifdef NV_RECORD_LOG_ENABLED
+  nv_record_log_init((uint32_t)__userdata_start,
+                     ((uint32_t)__userdata_end - (uint32_t)__userdata_start) /
+                         NV_EXTENSION_SIZE);
+  if (nv_record_log_load((uint8_t *)nvrecord_extension_p +
+                             NV_EXTENSION_HEADER_SIZE,
+                         NV_EXTENSION_VALID_LEN) == 0) {
+    TRACE(2, "%s,log is valid.", __func__);
+    nvrecord_extension_p->header.crc32 =
+        crc32(0, ((uint8_t *)nvrecord_extension_p + NV_EXTENSION_HEADER_SIZE),
+              nvrecord_extension_p->header.validLen);
+    nv_flsh_state.is_update = nv_record_log_is_busy();
+    goto _init_done;
+  }
+#endif
+
   // Check main sector.
   if (nv_record_data_is_valid((NV_EXTENSION_RECORD_T *)_user_data_main_start) &&
       nv_record_items_is_valid(
@@ -414,6 +435,12 @@ static void nv_record_extension_init(void) {
     nvrecord_extension_p->header.crc32 =
         crc32(0, ((uint8_t *)nvrecord_extension_p + NV_EXTENSION_HEADER_SIZE),
               nvrecord_extension_p->header.validLen);
+#ifdef NV_RECORD_LOG_ENABLED
+    // convert to the log, keeping the old copy until the log is written
+    nv_record_log_reset(main_is_valid ? 0 : 1);
+    nv_flsh_state.is_update = true;
+    nv_flsh_state.state = NV_STATE_IDLE;
+#endif
   } else {
     TRACE(1, "%s,data invalid, rebuild... ", __func__);
     nv_record_set_default(nvrecord_extension_p);
@@ -423,6 +450,9 @@ static void nv_record_extension_init(void) {
     nv_record_extension_update();
   }
 
+#ifdef NV_RECORD_LOG_ENABLED
+_init_done:
+#endif
   nvrec_init = true;
 
   nv_record_post_write_operation(lock);
@@ -439,6 +469,47 @@ NV_EXTENSION_RECORD_T *nv_record_get_extension_entry_ptr(void) {
 
 void nv_record_extension_update(void) { nv_flsh_state.is_update = true; }
 
+#ifdef NV_RECORD_LOG_ENABLED
+static int nv_record_extension_flush(bool is_async) {
+  uint32_t lock;
+  enum NORFLASH_API_RET_T ret;
+
+  if (NULL == nvrecord_extension_p) {
+    TRACE(1, "%s,nvrecord_extension_p is null.", __func__);
+    return 0;
+  }
+
+  do {
+    hal_trace_pause();
+    lock = int_lock_global();
+    nv_flsh_state.is_update = false;
+    ret = nv_record_log_flush((uint8_t *)nvrecord_extension_p +
+                                  NV_EXTENSION_HEADER_SIZE,
+                              NV_EXTENSION_VALID_LEN);
+    if (ret == NORFLASH_API_BUFFER_FULL) {
+      nv_flsh_state.is_update = true;
+    }
+    int_unlock_global(lock);
+    hal_trace_continue();
+
+    if (ret == NORFLASH_API_BUFFER_FULL) {
+      norflash_api_flush();
+    } else {
+      ASSERT(ret == NORFLASH_API_OK, "%s: nv_record_log_flush err,ret = %d.",
+             __func__, ret);
+    }
+  } while (!is_async && ret == NORFLASH_API_BUFFER_FULL);
+
+  if (!is_async) {
+    do {
+      norflash_api_flush();
+    } while (norflash_api_get_used_buffer_count(
+                 NORFLASH_API_MODULE_ID_USERDATA_EXT, NORFLASH_API_ALL) > 0);
+    TRACE(1, "%s: sync flush done.", __func__);
+  }
+  return (ret == NORFLASH_API_OK) ? 0 : 1;
+}
+#else
 static int nv_record_extension_flush_main(bool is_async) {
   uint32_t crc;
   uint32_t lock;
@@ -793,6 +864,7 @@ static int nv_record_extension_flush(bool is_async) {
   } while (!is_async);
   return ret;
 }
+#endif // NV_RECORD_LOG_ENABLED
 
 void nv_extension_callback(void *param) {
   NORFLASH_API_OPERA_RESULT *opera_result;
@@ -831,8 +903,24 @@ int nv_record_touch_cause_flush(void) {
 void nv_record_sector_clear(void) {
   uint32_t lock;
   enum NORFLASH_API_RET_T ret;
+#ifdef NV_RECORD_LOG_ENABLED
+  uint32_t addr;
+#endif
 
   lock = int_lock_global();
+#ifdef NV_RECORD_LOG_ENABLED
+  for (addr = (uint32_t)__userdata_start; addr < (uint32_t)__userdata_end;
+       addr += NV_EXTENSION_SIZE) {
+    ret = norflash_api_erase(NORFLASH_API_MODULE_ID_USERDATA_EXT, addr,
+                             NV_EXTENSION_SIZE, false);
+    ASSERT(ret == NORFLASH_API_OK,
+           "%s: norflash_api_erase(0x%x) failed! ret = %d.", __func__, addr,
+           (int32_t)ret);
+  }
+  if (nvrec_init) {
+    nv_record_log_reset(-1);
+  }
+#else
   ret =
       norflash_api_erase(NORFLASH_API_MODULE_ID_USERDATA_EXT,
                          (uint32_t)__userdata_start, NV_EXTENSION_SIZE, false);
@@ -846,6 +934,7 @@ void nv_record_sector_clear(void) {
   ASSERT(ret == NORFLASH_API_OK,
          "%s: norflash_api_erase(0x%x) failed! ret = %d.", __func__,
          (uint32_t)__userdata_start + NV_EXTENSION_SIZE, (int32_t)ret);
+#endif
   // pmu_reboot();
   int_unlock_global(lock);
 }
@@ -917,10 +1006,19 @@ void nv_record_execute_async_flush(void) {
 }
 
 int nv_record_flash_flush_in_sleep(void) {
+#ifdef NV_RECORD_LOG_ENABLED
+  // Appending to the log erases nothing, so write changes at the next sleep
+  // rather than waiting for the flush interval.
+  if (!nv_flsh_state.is_update && !nv_record_log_is_busy() &&
+      !nv_record_is_timer_expired_to_check()) {
+    return 0;
+  }
+#else
   if ((NV_STATE_IDLE == nv_flsh_state.state) &&
       !nv_record_is_timer_expired_to_check()) {
     return 0;
   }
+#endif
 
   nv_record_execute_async_flush();
   return 0;
@@ -0,0 +1,409 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#if defined(NEW_NV_RECORD_ENABLED) && defined(NV_RECORD_LOG_ENABLED)
+#include "nvrecord_log.h"
+#include "crc32.h"
+#include "hal_trace.h"
+#include "norflash_api.h"
+#include "nvrecord_extension.h"
+#include <stddef.h>
+#include <string.h>
+
+#define NV_LOG_SECTOR_MAGIC 0x4E564C47
+#define NV_LOG_RECORD_END 0xFFFF
+#define NV_LOG_CHUNK_NUM                                                       \
+  ((NV_EXTENSION_MIRROR_RAM_SIZE + NV_LOG_CHUNK_SIZE - 1) / NV_LOG_CHUNK_SIZE)
+
+typedef struct {
+  uint32_t magicNumber;
+  uint16_t majorVersion; // NV_EXTENSION_MAJOR_VERSION of the writer
+  uint16_t minorVersion;
+  uint32_t seq;        // incremented by each compaction
+  uint32_t eraseCount; // erases of this sector
+  uint32_t crc32;      // crc32 of the fields above
+} NV_LOG_SECTOR_HEADER_T;
+
+typedef struct {
+  uint16_t offset; // in the data following NVRECORD_HEADER_T
+  uint16_t len;
+  uint32_t crc32; // crc32 of offset, len and the payload
+} NV_LOG_RECORD_HEADER_T;
+
+#define NV_LOG_RECORD_SIZE(len)                                                \
+  (((uint32_t)sizeof(NV_LOG_RECORD_HEADER_T) + (len) + 3) & ~3)
+#define NV_LOG_DATA_START                                                      \
+  (sizeof(NV_LOG_SECTOR_HEADER_T) + sizeof(NV_LOG_RECORD_HEADER_T))
+
+STATIC_ASSERT(NV_LOG_DATA_START + NV_EXTENSION_MIRROR_RAM_SIZE <=
+                  NV_EXTENSION_SIZE,
+              "NV log sector cannot hold a snapshot");
+
+typedef enum {
+  NV_LOG_STATE_IDLE,
+  NV_LOG_STATE_APPENDING,
+  NV_LOG_STATE_ERASING,
+  NV_LOG_STATE_COMPACTING,
+  NV_LOG_STATE_COMMITTING,
+} NV_LOG_STATE;
+
+typedef struct {
+  uint32_t base;
+  uint32_t sector_num;
+  NV_LOG_STATE state;
+  int32_t active; // sector holding the newest snapshot, -1 if none
+  int32_t target; // sector being compacted into
+  uint32_t seq;
+  uint32_t erase_count; // of the target
+  uint32_t wr_offs;     // next free byte in the sector being written
+  bool compact;
+  // the payload of rec_hdr is queued but the header itself is not
+  bool rec_pending;
+  NV_LOG_RECORD_HEADER_T rec_hdr;
+  // crc32 of each chunk as last queued, to find the changed ones
+  uint32_t chunk_crc[NV_LOG_CHUNK_NUM];
+} NV_LOG_ENV_T;
+
+static NV_LOG_ENV_T nv_log;
+
+static uint32_t nv_log_sector_addr(int32_t sector) {
+  return nv_log.base + (uint32_t)sector * NV_EXTENSION_SIZE;
+}
+
+static bool nv_log_sector_header_is_valid(const NV_LOG_SECTOR_HEADER_T *hdr) {
+  return hdr->magicNumber == NV_LOG_SECTOR_MAGIC &&
+         hdr->crc32 == crc32(0, (const uint8_t *)hdr,
+                             offsetof(NV_LOG_SECTOR_HEADER_T, crc32));
+}
+
+static uint32_t nv_log_record_crc(const NV_LOG_RECORD_HEADER_T *hdr,
+                                  const uint8_t *payload) {
+  uint32_t crc;
+
+  crc = crc32(0, (const uint8_t *)hdr, offsetof(NV_LOG_RECORD_HEADER_T, crc32));
+  return crc32(crc, payload, hdr->len);
+}
+
+// Returns the record at offs of the sector, or NULL at the end of the log.
+// *torn is set if the log ends with a bad record rather than erased flash.
+static const NV_LOG_RECORD_HEADER_T *
+nv_log_record_at(uint32_t sector_addr, uint32_t offs, bool *torn) {
+  const NV_LOG_RECORD_HEADER_T *rec;
+
+  *torn = false;
+  if (offs + sizeof(*rec) > NV_EXTENSION_SIZE) {
+    return NULL;
+  }
+  rec = (const NV_LOG_RECORD_HEADER_T *)(sector_addr + offs);
+  if (rec->offset == NV_LOG_RECORD_END && rec->len == NV_LOG_RECORD_END) {
+    return NULL;
+  }
+  if (rec->len > NV_EXTENSION_SIZE - offs - sizeof(*rec) ||
+      rec->crc32 != nv_log_record_crc(rec, (const uint8_t *)(rec + 1))) {
+    *torn = true;
+    return NULL;
+  }
+  return rec;
+}
+
+static bool nv_log_sector_is_valid(int32_t sector) {
+  uint32_t addr = nv_log_sector_addr(sector);
+  const NV_LOG_SECTOR_HEADER_T *hdr = (const NV_LOG_SECTOR_HEADER_T *)addr;
+  const NV_LOG_RECORD_HEADER_T *rec;
+  bool torn;
+
+  if (!nv_log_sector_header_is_valid(hdr) ||
+      hdr->majorVersion != NV_EXTENSION_MAJOR_VERSION) {
+    return false;
+  }
+  // the snapshot must be complete
+  rec = nv_log_record_at(addr, sizeof(*hdr), &torn);
+  return rec && rec->offset == 0;
+}
+
+static bool nv_log_is_blank(uint32_t addr, uint32_t len) {
+  const uint32_t *p = (const uint32_t *)addr;
+  uint32_t i;
+
+  for (i = 0; i < len / 4; i++) {
+    if (p[i] != 0xFFFFFFFF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static uint32_t nv_log_chunk_crc(const uint8_t *data, uint32_t len,
+                                 uint32_t chunk) {
+  uint32_t offs = chunk * NV_LOG_CHUNK_SIZE;
+
+  return crc32(0, data + offs, MIN(NV_LOG_CHUNK_SIZE, len - offs));
+}
+
+static void nv_log_update_chunk_crc(const uint8_t *data, uint32_t len,
+                                    uint32_t offs, uint32_t run_len) {
+  uint32_t chunk;
+
+  for (chunk = offs / NV_LOG_CHUNK_SIZE;
+       chunk * NV_LOG_CHUNK_SIZE < offs + run_len; chunk++) {
+    nv_log.chunk_crc[chunk] = nv_log_chunk_crc(data, len, chunk);
+  }
+}
+
+// Finds the first run of chunks whose content differs from the last flush.
+static bool nv_log_dirty_run(const uint8_t *data, uint32_t len, uint32_t *offs,
+                             uint32_t *run_len) {
+  uint32_t chunk_num = (len + NV_LOG_CHUNK_SIZE - 1) / NV_LOG_CHUNK_SIZE;
+  uint32_t first, last;
+
+  for (first = 0; first < chunk_num; first++) {
+    if (nv_log.chunk_crc[first] != nv_log_chunk_crc(data, len, first)) {
+      break;
+    }
+  }
+  if (first == chunk_num) {
+    return false;
+  }
+  for (last = first + 1; last < chunk_num; last++) {
+    if (nv_log.chunk_crc[last] == nv_log_chunk_crc(data, len, last)) {
+      break;
+    }
+  }
+  *offs = first * NV_LOG_CHUNK_SIZE;
+  *run_len = MIN(last * NV_LOG_CHUNK_SIZE, len) - *offs;
+  return true;
+}
+
+static enum NORFLASH_API_RET_T nv_log_queue_payload(int32_t sector,
+                                                    const uint8_t *data,
+                                                    uint32_t len, uint32_t offs,
+                                                    uint32_t run_len) {
+  enum NORFLASH_API_RET_T ret;
+
+  ret = norflash_api_write(NORFLASH_API_MODULE_ID_USERDATA_EXT,
+                           nv_log_sector_addr(sector) + nv_log.wr_offs +
+                               sizeof(NV_LOG_RECORD_HEADER_T),
+                           data + offs, run_len, true);
+  if (ret == NORFLASH_API_OK) {
+    // The header must describe what was queued, even if the data changes
+    // before the header can be queued too.
+    nv_log.rec_hdr.offset = (uint16_t)offs;
+    nv_log.rec_hdr.len = (uint16_t)run_len;
+    nv_log.rec_hdr.crc32 = nv_log_record_crc(&nv_log.rec_hdr, data + offs);
+    nv_log.rec_pending = true;
+    nv_log_update_chunk_crc(data, len, offs, run_len);
+  }
+  return ret;
+}
+
+static enum NORFLASH_API_RET_T nv_log_queue_record_header(int32_t sector) {
+  enum NORFLASH_API_RET_T ret;
+
+  ret = norflash_api_write(NORFLASH_API_MODULE_ID_USERDATA_EXT,
+                           nv_log_sector_addr(sector) + nv_log.wr_offs,
+                           (const uint8_t *)&nv_log.rec_hdr,
+                           sizeof(nv_log.rec_hdr), true);
+  if (ret == NORFLASH_API_OK) {
+    nv_log.wr_offs += NV_LOG_RECORD_SIZE(nv_log.rec_hdr.len);
+    nv_log.rec_pending = false;
+  }
+  return ret;
+}
+
+static enum NORFLASH_API_RET_T nv_log_queue_sector_header(void) {
+  NV_LOG_SECTOR_HEADER_T hdr;
+
+  hdr.magicNumber = NV_LOG_SECTOR_MAGIC;
+  hdr.majorVersion = NV_EXTENSION_MAJOR_VERSION;
+  hdr.minorVersion = NV_EXTENSION_MINOR_VERSION;
+  hdr.seq = nv_log.seq + 1;
+  hdr.eraseCount = nv_log.erase_count;
+  hdr.crc32 = crc32(0, (const uint8_t *)&hdr,
+                    offsetof(NV_LOG_SECTOR_HEADER_T, crc32));
+  return norflash_api_write(NORFLASH_API_MODULE_ID_USERDATA_EXT,
+                            nv_log_sector_addr(nv_log.target),
+                            (const uint8_t *)&hdr, sizeof(hdr), true);
+}
+
+static void nv_log_start_compaction(void) {
+  const NV_LOG_SECTOR_HEADER_T *hdr;
+
+  nv_log.target = (nv_log.active + 1) % (int32_t)nv_log.sector_num;
+  hdr = (const NV_LOG_SECTOR_HEADER_T *)nv_log_sector_addr(nv_log.target);
+  nv_log.erase_count =
+      nv_log_sector_header_is_valid(hdr) ? hdr->eraseCount + 1 : 1;
+  nv_log.rec_pending = false;
+  nv_log.state = NV_LOG_STATE_ERASING;
+}
+
+void nv_record_log_init(uint32_t base, uint32_t sector_num) {
+  ASSERT(sector_num >= 2, "%s: %d sectors, at least 2 are needed", __func__,
+         sector_num);
+  memset(&nv_log, 0, sizeof(nv_log));
+  nv_log.base = base;
+  nv_log.sector_num = sector_num;
+  nv_record_log_reset(-1);
+}
+
+int nv_record_log_load(uint8_t *data, uint32_t len) {
+  const NV_LOG_SECTOR_HEADER_T *hdr;
+  const NV_LOG_RECORD_HEADER_T *rec;
+  uint32_t addr;
+  uint32_t offs;
+  uint32_t max_seq = 0;
+  uint32_t active_seq = 0;
+  int32_t sector;
+  int32_t active = -1;
+  bool torn;
+
+  ASSERT(len <= NV_LOG_CHUNK_NUM * NV_LOG_CHUNK_SIZE && len < NV_LOG_RECORD_END,
+         "%s: bad len %d", __func__, len);
+
+  for (sector = 0; sector < (int32_t)nv_log.sector_num; sector++) {
+    hdr = (const NV_LOG_SECTOR_HEADER_T *)nv_log_sector_addr(sector);
+    if (!nv_log_sector_header_is_valid(hdr)) {
+      continue;
+    }
+    if (hdr->seq > max_seq) {
+      max_seq = hdr->seq;
+    }
+    if (nv_log_sector_is_valid(sector) &&
+        (active < 0 || hdr->seq > active_seq)) {
+      active = sector;
+      active_seq = hdr->seq;
+    }
+  }
+
+  nv_record_log_reset(-1);
+  nv_log.seq = max_seq;
+  if (active < 0) {
+    TRACE(1, "%s: no valid log", __func__);
+    return -1;
+  }
+
+  addr = nv_log_sector_addr(active);
+  offs = sizeof(NV_LOG_SECTOR_HEADER_T);
+  while ((rec = nv_log_record_at(addr, offs, &torn)) != NULL) {
+    if (rec->offset < len) {
+      memcpy(data + rec->offset, rec + 1, MIN(rec->len, len - rec->offset));
+    }
+    offs += NV_LOG_RECORD_SIZE(rec->len);
+  }
+
+  nv_log.active = active;
+  nv_log.wr_offs = offs;
+  // A torn append leaves programmed bytes behind the last good record; the
+  // next flush moves the record to a clean sector.
+  nv_log.compact = torn || (offs < NV_EXTENSION_SIZE &&
+                            !nv_log_is_blank(addr + offs,
+                                             NV_EXTENSION_SIZE - offs));
+  nv_log_update_chunk_crc(data, len, 0, len);
+
+  hdr = (const NV_LOG_SECTOR_HEADER_T *)addr;
+  TRACE(5, "%s: sector %d seq %d erase count %d used %d compact %d", __func__,
+        active, hdr->seq, hdr->eraseCount, offs, nv_log.compact);
+  return 0;
+}
+
+void nv_record_log_reset(int32_t keep_sector) {
+  nv_log.state = NV_LOG_STATE_IDLE;
+  nv_log.active = keep_sector;
+  nv_log.wr_offs = NV_EXTENSION_SIZE;
+  nv_log.compact = true;
+  nv_log.rec_pending = false;
+}
+
+enum NORFLASH_API_RET_T nv_record_log_flush(const uint8_t *data, uint32_t len) {
+  enum NORFLASH_API_RET_T ret = NORFLASH_API_OK;
+  uint32_t offs;
+  uint32_t run_len;
+
+  while (ret == NORFLASH_API_OK) {
+    switch (nv_log.state) {
+    case NV_LOG_STATE_IDLE:
+      if (nv_log.compact) {
+        nv_log_start_compaction();
+      } else {
+        nv_log.state = NV_LOG_STATE_APPENDING;
+      }
+      break;
+
+    case NV_LOG_STATE_APPENDING:
+      if (!nv_log.rec_pending) {
+        if (!nv_log_dirty_run(data, len, &offs, &run_len)) {
+          nv_log.state = NV_LOG_STATE_IDLE;
+          return NORFLASH_API_OK;
+        }
+        if (nv_log.wr_offs + NV_LOG_RECORD_SIZE(run_len) > NV_EXTENSION_SIZE) {
+          nv_log_start_compaction();
+          break;
+        }
+        ret = nv_log_queue_payload(nv_log.active, data, len, offs, run_len);
+        if (ret != NORFLASH_API_OK) {
+          break;
+        }
+      }
+      ret = nv_log_queue_record_header(nv_log.active);
+      break;
+
+    case NV_LOG_STATE_ERASING:
+      ret = norflash_api_erase(NORFLASH_API_MODULE_ID_USERDATA_EXT,
+                               nv_log_sector_addr(nv_log.target),
+                               NV_EXTENSION_SIZE, true);
+      if (ret == NORFLASH_API_OK) {
+        nv_log.wr_offs = sizeof(NV_LOG_SECTOR_HEADER_T);
+        nv_log.state = NV_LOG_STATE_COMPACTING;
+      }
+      break;
+
+    case NV_LOG_STATE_COMPACTING:
+      if (!nv_log.rec_pending) {
+        ret = nv_log_queue_payload(nv_log.target, data, len, 0, len);
+        if (ret != NORFLASH_API_OK) {
+          break;
+        }
+      }
+      ret = nv_log_queue_record_header(nv_log.target);
+      if (ret == NORFLASH_API_OK) {
+        nv_log.state = NV_LOG_STATE_COMMITTING;
+      }
+      break;
+
+    case NV_LOG_STATE_COMMITTING:
+      ret = nv_log_queue_sector_header();
+      if (ret == NORFLASH_API_OK) {
+        TRACE(4, "%s: compacted into sector %d seq %d erase count %d",
+              __func__, nv_log.target, nv_log.seq + 1, nv_log.erase_count);
+        nv_log.active = nv_log.target;
+        nv_log.seq++;
+        nv_log.compact = false;
+        // changes made while compacting are appended next
+        nv_log.state = NV_LOG_STATE_IDLE;
+      }
+      break;
+
+    default:
+      ASSERT(0, "%s: bad state %d", __func__, nv_log.state);
+      break;
+    }
+  }
+  return ret;
+}
+
+bool nv_record_log_is_busy(void) {
+  return nv_log.compact || nv_log.state != NV_LOG_STATE_IDLE;
+}
+
+#endif // NEW_NV_RECORD_ENABLED && NV_RECORD_LOG_ENABLED
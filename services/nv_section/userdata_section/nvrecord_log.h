@@ -0,0 +1,70 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#ifndef __NVRECORD_LOG_H__
+#define __NVRECORD_LOG_H__
+
+#if defined(NEW_NV_RECORD_ENABLED) && defined(NV_RECORD_LOG_ENABLED)
+#include "norflash_api.h"
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Log-structured storage of the NV extension record.
+//
+// The userdata section is split into NV_EXTENSION_SIZE sectors. The sector
+// with the newest valid header holds a full snapshot of the record data,
+// followed by records that each replace a byte range of it:
+//
+//   sector header | snapshot record | record | record | ... | 0xFF ...
+//
+// A record is an 8-byte header (offset, length, crc32) and its payload.
+// A flush appends one record per run of changed NV_LOG_CHUNK_SIZE chunks,
+// so a small change programs a few dozen bytes and erases nothing. When
+// the active sector is full, the whole record is compacted into the next
+// sector, round robin, so all sectors wear evenly. The previous sector is
+// only erased by a later compaction, and a sector without a complete
+// snapshot is ignored, so a power loss never leaves the record without a
+// valid copy.
+
+#define NV_LOG_CHUNK_SIZE 32
+
+void nv_record_log_init(uint32_t base, uint32_t sector_num);
+
+// Replays the newest log onto data. Data not covered by the log keeps its
+// current content. Returns 0 on success, -1 if no sector holds a valid log.
+int nv_record_log_load(uint8_t *data, uint32_t len);
+
+// Forgets the log and makes the next flush compact. keep_sector (or -1)
+// holds data that must survive until the new snapshot is written, e.g. a
+// pre-log copy of the record; it is the last sector to be reused.
+void nv_record_log_reset(int32_t keep_sector);
+
+// Queues the changes of data since the last flush to norflash_api. Returns
+// NORFLASH_API_BUFFER_FULL if the queue is full; call it again after
+// norflash_api_flush().
+enum NORFLASH_API_RET_T nv_record_log_flush(const uint8_t *data, uint32_t len);
+
+// Whether a flush is needed to finish a compaction or an append.
+bool nv_record_log_is_busy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NEW_NV_RECORD_ENABLED && NV_RECORD_LOG_ENABLED
+#endif
@@ -48,6 +48,7 @@
 #define OTA_BOOT_INFO_FLASH_OFFSET 0x1000
 #define OTA_BREAKPOINT_STORE_GRANULARITY (256 * 1024) // must be 4KB aligned
 #define LEN_OF_IMAGE_TAIL_TO_FIND_SANITY_CRC 512
+#define OTA_IMAGE_CRC_FOLD_INVALID 0xFFFFFFFF
 #define INVALID_VERSION_STR "BESTECHNIC"
 
 #define NORFLASH_API_MODE_ASYNC true
@@ -395,6 +396,73 @@ __attribute__((unused)) static void _exit_ota_state(void) {
 
 #ifdef IBRT
 
+/**
+ * @brief End of the image part the running sanity crc32 covers.
+ *
+ * The sanity crc32 ends somewhere in the last
+ * LEN_OF_IMAGE_TAIL_TO_FIND_SANITY_CRC bytes, which is only known once the
+ * whole image is received, so the running value stops short of them.
+ */
+static uint32_t _sanity_crc_fold_end(void) {
+  if (otaEnv.totalImageSize < LEN_OF_IMAGE_TAIL_TO_FIND_SANITY_CRC) {
+    return 0;
+  }
+
+  return otaEnv.totalImageSize - LEN_OF_IMAGE_TAIL_TO_FIND_SANITY_CRC;
+}
+
+/**
+ * @brief Fold data about to be programmed into the running crc32 values.
+ *
+ * The finalisation then only has to read back what was not folded, instead
+ * of the whole image. The data must arrive in order from image offset 0,
+ * otherwise (e.g. after resuming from a break point) the running values are
+ * dropped and the finalisation reads the whole image back.
+ *
+ * @param ptrSource     Pointer of the data to program
+ * @param length        Length of the data
+ * @param imageOffset   Offset of the data in the new image
+ */
+static void _fold_image_crc(const uint8_t *ptrSource, uint32_t length,
+                            uint32_t imageOffset) {
+  static const uint32_t erasedBootWord = 0xFFFFFFFF;
+  uint32_t sanityEnd = _sanity_crc_fold_end();
+  uint32_t bytes;
+
+  if (OTA_IMAGE_CRC_FOLD_INVALID == otaEnv.crc32FoldedSize) {
+    return;
+  }
+
+  if (imageOffset != otaEnv.crc32FoldedSize) {
+    LOG_W("crc32 fold expects offset %d, got %d", otaEnv.crc32FoldedSize,
+          imageOffset);
+    otaEnv.crc32FoldedSize = OTA_IMAGE_CRC_FOLD_INVALID;
+    return;
+  }
+
+  otaEnv.crc32FoldedSize += length;
+
+  if (imageOffset < sanityEnd) {
+    bytes = MIN(length, sanityEnd - imageOffset);
+    otaEnv.sanityCrc32Running =
+        crc32(otaEnv.sanityCrc32Running, ptrSource, bytes);
+  }
+
+  /// the boot word is NORMAL_BOOT once programmed, the crc32 of the whole
+  /// image takes it as erased, @see _compute_whole_image_crc
+  if (imageOffset < sizeof(erasedBootWord)) {
+    bytes = MIN(length, sizeof(erasedBootWord) - imageOffset);
+    otaEnv.crc32OfImageRunning =
+        crc32(otaEnv.crc32OfImageRunning,
+              (const uint8_t *)&erasedBootWord + imageOffset, bytes);
+    ptrSource += bytes;
+    length -= bytes;
+  }
+
+  otaEnv.crc32OfImageRunning =
+      crc32(otaEnv.crc32OfImageRunning, ptrSource, length);
+}
+
 /**
  * @brief Do the sanity check for the upgrade file.
  *
@@ -451,10 +519,21 @@ static bool _image_sanity_check(void) {
 
   // generate the CRC from image data
   uint32_t calculatedCrc32 = 0;
-  calculatedCrc32 =
-      crc32(calculatedCrc32,
-            (uint8_t *)(OTA_FLASH_LOGIC_ADDR + NEW_IMAGE_FLASH_OFFSET),
-            crc32ImageOffset);
+  uint32_t sanityFoldEnd = _sanity_crc_fold_end();
+  if (otaEnv.crc32FoldedSize == otaEnv.totalImageSize &&
+      crc32ImageOffset >= sanityFoldEnd) {
+    // only the tail after the folded part is left to read back
+    calculatedCrc32 =
+        crc32(otaEnv.sanityCrc32Running,
+              (uint8_t *)(OTA_FLASH_LOGIC_ADDR + NEW_IMAGE_FLASH_OFFSET +
+                          sanityFoldEnd),
+              crc32ImageOffset - sanityFoldEnd);
+  } else {
+    calculatedCrc32 =
+        crc32(calculatedCrc32,
+              (uint8_t *)(OTA_FLASH_LOGIC_ADDR + NEW_IMAGE_FLASH_OFFSET),
+              crc32ImageOffset);
+  }
 
   LOG_D("calculatedCrc32 is 0x%x", calculatedCrc32);
 
@@ -485,12 +564,41 @@ _get_flash_module_from_ota_device(OTA_DEVICE_E device) {
   return mod;
 }
 
+/**
+ * @brief Queue the erase of the new image sectors before endOffset.
+ *
+ * Sectors are erased once, in order, and never after data has been queued
+ * to them, since an erase drops the pending writes of its sector.
+ *
+ * @param mod           Flash module of the OTA device
+ * @param endOffset     Offset in new image, the sector holding the byte
+ *                      before it is the last one erased
+ */
+static void _erase_image_sectors(enum NORFLASH_API_MODULE_ID_T mod,
+                                 uint32_t endOffset) {
+  uint32_t imageEnd =
+      (otaEnv.totalImageSize + FLASH_SECTOR_SIZE_IN_BYTES - 1) /
+      FLASH_SECTOR_SIZE_IN_BYTES * FLASH_SECTOR_SIZE_IN_BYTES;
+
+  if (endOffset > imageEnd) {
+    endOffset = imageEnd;
+  }
+
+  while (otaEnv.newImageEraseOffset < endOffset) {
+    app_flash_page_erase(mod, otaEnv.newImageFlashOffset +
+                                  otaEnv.newImageEraseOffset);
+    otaEnv.newImageEraseOffset += FLASH_SECTOR_SIZE_IN_BYTES;
+  }
+}
+
 static void _flush_data_to_flash(uint8_t *ptrSource, uint32_t lengthToBurn,
                                  uint32_t offsetInFlashToProgram,
                                  bool synWrite) {
 
   LOG_D("flush %d bytes to flash offset 0x%x", lengthToBurn,
         offsetInFlashToProgram);
+  _fold_image_crc(ptrSource, lengthToBurn,
+                  offsetInFlashToProgram - otaEnv.newImageFlashOffset);
   enum NORFLASH_API_MODULE_ID_T mod =
       _get_flash_module_from_ota_device(otaEnv.deviceId);
 
@@ -517,6 +625,13 @@ static void _flush_data_to_flash(uint8_t *ptrSource, uint32_t lengthToBurn,
   LOG_D("Prebytes is %d middlebytes is %d postbytes is %d", preBytes,
         middleBytes, postBytes);
 
+  /// the pre bytes go to a sector erased by an earlier flush; erase the
+  /// sectors of this chunk, if not done yet, and the next few ahead of it
+  _erase_image_sectors(mod, offsetInFlashToProgram + lengthToBurn -
+                                otaEnv.newImageFlashOffset +
+                                OTA_ERASE_AHEAD_SECTORS *
+                                    FLASH_SECTOR_SIZE_IN_BYTES);
+
   if (preBytes > 0) {
     app_flash_page_program(mod, offsetInFlashToProgram, ptrSource, preBytes,
                            synWrite);
@@ -531,8 +646,6 @@ static void _flush_data_to_flash(uint8_t *ptrSource, uint32_t lengthToBurn,
   if (middleBytes > 0) {
     uint32_t sectorCntToProgram = middleBytes / FLASH_SECTOR_SIZE_IN_BYTES;
     for (uint32_t sector = 0; sector < sectorCntToProgram; sector++) {
-      app_flash_page_erase(mod,
-                           sectorIndexInFlash * FLASH_SECTOR_SIZE_IN_BYTES);
       app_flash_page_program(mod,
                              sectorIndexInFlash * FLASH_SECTOR_SIZE_IN_BYTES,
                              ptrSource + sector * FLASH_SECTOR_SIZE_IN_BYTES,
@@ -545,12 +658,15 @@ static void _flush_data_to_flash(uint8_t *ptrSource, uint32_t lengthToBurn,
   }
 
   if (postBytes > 0) {
-    app_flash_page_erase(mod, sectorIndexInFlash * FLASH_SECTOR_SIZE_IN_BYTES);
     app_flash_page_program(mod, sectorIndexInFlash * FLASH_SECTOR_SIZE_IN_BYTES,
                            ptrSource, postBytes, synWrite);
   }
 
-  app_flush_pending_flash_op(mod, NORFLASH_API_ALL);
+  /// async chunks are left to the norflash_api flush while the next one is
+  /// received, a full queue makes app_flash_page_program() wait
+  if (synWrite) {
+    app_flush_pending_flash_op(mod, NORFLASH_API_ALL);
+  }
 }
 
 /**
@@ -564,6 +680,27 @@ static bool _compute_whole_image_crc(void) {
   uint32_t bytes_to_use = 0;
   uint32_t lock;
 
+  /// the whole image was folded while it was programmed, only the boot word
+  /// needs reading back
+  if (otaEnv.crc32FoldedSize == otaEnv.totalImageSize) {
+    uint32_t bootWord;
+
+    lock = int_lock_global();
+    norflash_sync_read(NORFLASH_API_MODULE_ID_OTA,
+                       (OTA_FLASH_LOGIC_ADDR + NEW_IMAGE_FLASH_OFFSET),
+                       (uint8_t *)&bootWord, sizeof(bootWord));
+    int_unlock_global(lock);
+
+    if (bootWord != NORMAL_BOOT) {
+      LOG_D("first 32bit value is not NORMAL_BOOT");
+      return false;
+    }
+
+    LOG_D("Folded CRC32 is 0x%x.", otaEnv.crc32OfImageRunning);
+    otaEnv.crc32OfImage = otaEnv.crc32OfImageRunning;
+    return true;
+  }
+
   while (processedDataSize < otaEnv.totalImageSize) {
     if (otaEnv.totalImageSize - processedDataSize >
         OTA_DATA_CACHE_BUFFER_SIZE) {
@@ -921,8 +1058,14 @@ OTA_STATUS_E ota_common_command_received_handler(OTA_COMMAND_E cmdType,
     LOG_I("programOffset&receivedDataSize is update:%d->%d",
           otaEnv.newImageProgramOffset, c->startOffset);
     otaEnv.newImageProgramOffset = c->startOffset;
+    otaEnv.newImageEraseOffset = c->startOffset;
     otaEnv.receivedDataSize = c->startOffset;
 
+    /// the running crc32 values can only cover an image received from 0
+    otaEnv.crc32FoldedSize = c->startOffset ? OTA_IMAGE_CRC_FOLD_INVALID : 0;
+    otaEnv.crc32OfImageRunning = 0;
+    otaEnv.sanityCrc32Running = 0;
+
     /// update the device index
     LOG_I("deviceId update:%d->%d", otaEnv.deviceId, c->device);
     otaEnv.deviceId = c->device;
@@ -1165,6 +1308,11 @@ OTA_STATUS_E ota_common_fw_data_write(const uint8_t *data, uint16_t len) {
           (otaEnv.newImageProgramOffset + otaEnv.newImageFlashOffset), true);
     }
 
+    /// the last full chunk may still be queued when the image size is a
+    /// multiple of the cache buffer, and the checks below read it via XIP
+    app_flush_pending_flash_op(
+        _get_flash_module_from_ota_device(otaEnv.deviceId), NORFLASH_API_ALL);
+
     if (OTA_DEVICE_APP == otaEnv.deviceId) {
       bool check = true;
 
@@ -1229,6 +1377,11 @@ OTA_STATUS_E ota_common_fw_data_write(const uint8_t *data, uint16_t len) {
           (otaEnv.receivedDataSize / OTA_BREAKPOINT_STORE_GRANULARITY) *
           OTA_BREAKPOINT_STORE_GRANULARITY;
 
+      /// the break point must not cover data still queued for programming
+      app_flush_pending_flash_op(
+          _get_flash_module_from_ota_device(otaEnv.deviceId),
+          NORFLASH_API_WRITTING);
+
       LOG_I("update record offset to %d", otaEnv.breakPoint);
       nv_record_ota_update_breakpoint(otaEnv.currentUser, otaEnv.deviceId,
                                       otaEnv.breakPoint);
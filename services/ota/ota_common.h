@@ -96,6 +96,18 @@ extern "C"{
 #define OTA_NORFLASH_BUFFER_LEN (OTA_DATA_CACHE_BUFFER_SIZE * 2)
 
 
+/**
+ * @brief count of sectors erased ahead of the OTA write pointer.
+ * 
+ * The erases and the programming of full cache buffers are queued to the
+ * norflash_api async list, which copies the data, so the cache buffer takes
+ * the next chunk while the previous one is still being programmed.
+ */
+#ifndef OTA_ERASE_AHEAD_SECTORS
+#define OTA_ERASE_AHEAD_SECTORS 2
+#endif
+
+
 /**
  * @brief this flag is used to mark if platform support automatic OTA.
  * 
@@ -431,6 +443,16 @@ typedef struct
     /// crc32 value of whole OTA image
     uint32_t crc32OfImage;
 
+    /// size of the new image folded into the running crc32 values below,
+    /// OTA_IMAGE_CRC_FOLD_INVALID if it was not programmed in order from 0
+    uint32_t crc32FoldedSize;
+
+    /// running crc32 of the new image, boot word taken as 0xFFFFFFFF
+    uint32_t crc32OfImageRunning;
+
+    /// running crc32 of the raw new image, up to the sanity crc search area
+    uint32_t sanityCrc32Running;
+
     /// string of version info
     char version[MAX_VERSION_LEN];
 
@@ -452,6 +474,9 @@ typedef struct
     /// offset of data programmed in new image flash section
     uint32_t newImageProgramOffset;
 
+    /// offset in new image up to which sector erases have been queued
+    uint32_t newImageEraseOffset;
+
     /// offset in flash of user data section
     uint32_t userDataNvFlashOffset;
 
@@ -104,6 +104,8 @@ typedef enum
     OP_TOTA_VOLUME_GET_CMD      = 0x6306,
     OP_TOTA_EQ_SET_CMD          = 0x6307,
     OP_TOTA_EQ_GET_CMD          = 0x6308,
+    OP_TOTA_A2DP_STATS_GET_CMD  = 0x6309, /**< param: [u8 reset], rsp: A2DP_AUDIO_STATS_T */
+    OP_TOTA_THREAD_PROF_GET_CMD = 0x630A, /**< param: [u8 restart], rsp: THREAD_PROF_STATS_T */
 
     /* audio dump and mic cmd */
     OP_TOTA_AUDIO_DUMP_START    = 0x6400,
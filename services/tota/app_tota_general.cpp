@@ -14,6 +14,7 @@
  *
  ****************************************************************************/
 #include "app_tota_general.h"
+#include "a2dp_decoder.h"
 #include "app_hfp.h"
 #include "app_key.h"
 #include "app_spp_tota.h"
@@ -25,6 +26,7 @@
 #include "crc32.h"
 #include "hal_cmu.h"
 #include "nvrecord_ble.h"
+#include "thread_prof.h"
 /*
 ** general info struct
 **  ->  bt  name
@@ -148,6 +150,28 @@ static void __tota_general_cmd_handle(APP_TOTA_CMD_CODE_E funcCode,
   case OP_TOTA_RAW_DATA_SET_CMD:
     app_ibrt_debug_parse(ptrParam, paramLen);
     break;
+  case OP_TOTA_A2DP_STATS_GET_CMD: {
+    A2DP_AUDIO_STATS_T stats;
+    a2dp_audio_stats_get(&stats);
+    if (paramLen >= 1 && ptrParam[0]) {
+      a2dp_audio_stats_reset();
+    }
+    app_tota_send_response_to_command(funcCode, TOTA_NO_ERROR,
+                                      (uint8_t *)&stats, sizeof(stats),
+                                      app_tota_get_datapath());
+    return;
+  }
+#ifdef THREAD_PROF_ENABLED
+  case OP_TOTA_THREAD_PROF_GET_CMD: {
+    static THREAD_PROF_STATS_T stats;
+    uint32_t len;
+    len = thread_prof_stats_get(&stats, paramLen >= 1 && ptrParam[0]);
+    app_tota_send_response_to_command(funcCode, TOTA_NO_ERROR,
+                                      (uint8_t *)&stats, len,
+                                      app_tota_get_datapath());
+    return;
+  }
+#endif
   default:
     TRACE(1, "wrong cmd 0x%x", funcCode);
     resData[0] = -1;
@@ -240,5 +264,11 @@ TOTA_COMMAND_TO_ADD(OP_TOTA_EQ_SET_CMD, __tota_general_cmd_handle, false, 0,
                     NULL);
 TOTA_COMMAND_TO_ADD(OP_TOTA_EQ_GET_CMD, __tota_general_cmd_handle, false, 0,
                     NULL);
+TOTA_COMMAND_TO_ADD(OP_TOTA_A2DP_STATS_GET_CMD, __tota_general_cmd_handle,
+                    false, 0, NULL);
+#ifdef THREAD_PROF_ENABLED
+TOTA_COMMAND_TO_ADD(OP_TOTA_THREAD_PROF_GET_CMD, __tota_general_cmd_handle,
+                    false, 0, NULL);
+#endif
 TOTA_COMMAND_TO_ADD(OP_TOTA_RAW_DATA_SET_CMD, __tota_general_cmd_handle, false,
                     0, NULL);
@@ -0,0 +1,329 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#include "audio_mix.h"
+#include "string.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "cmsis.h"
+#define AUDIO_MIX_SIMD
+#endif
+
+#define AUDIO_MIX_GAIN_SHIFT (14)
+#define AUDIO_MIX_GAIN_ONE (1 << AUDIO_MIX_GAIN_SHIFT)
+#define AUDIO_MIX_GAIN_ROUND (1 << (AUDIO_MIX_GAIN_SHIFT - 1))
+// Largest Q30 gain, whose Q14 factor is 32767
+#define AUDIO_MIX_GAIN_MAX (0x7FFF0000)
+
+#ifdef AUDIO_MIX_SIMD
+#define audio_mix_sat16(v) __SSAT((v), 16)
+#define audio_mix_sat24(v) __SSAT((v), 24)
+#else
+static inline int32_t audio_mix_sat16(int32_t v) {
+  if (v > 32767) {
+    return 32767;
+  } else if (v < -32768) {
+    return -32768;
+  }
+  return v;
+}
+
+static inline int32_t audio_mix_sat24(int32_t v) {
+  if (v > 0x7FFFFF) {
+    return 0x7FFFFF;
+  } else if (v < -0x800000) {
+    return -0x800000;
+  }
+  return v;
+}
+#endif
+
+// Q14 factor of a Q30 gain, rounded to nearest
+static inline int32_t audio_mix_factor(int32_t gain) {
+  return (gain + (1 << 15)) >> 16;
+}
+
+// Two products of 16-bit samples by factors within (-2, 2) add up without
+// overflowing 32 bits, so the 16-bit mix needs no 64-bit accumulator
+static inline int16_t audio_mix_sample16(int16_t x, int16_t y, int32_t gx,
+                                         int32_t gy) {
+  return (int16_t)audio_mix_sat16((x * gx + y * gy + AUDIO_MIX_GAIN_ROUND) >>
+                                  AUDIO_MIX_GAIN_SHIFT);
+}
+
+// The 24-bit products need 64 bits anyway, so they take the Q30 gains
+// rather than Q14 factors, which are 8 bits short of the samples
+static inline int32_t audio_mix_sample24(int32_t x, int32_t y, int32_t gx,
+                                         int32_t gy) {
+  return audio_mix_sat24(
+      (int32_t)(((int64_t)x * gx + (int64_t)y * gy + (1 << 29)) >> 30));
+}
+
+#ifdef AUDIO_MIX_SIMD
+static inline uint32_t audio_mix_read_pair(const int16_t *p) {
+  uint32_t v;
+
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void audio_mix_write_pair(int16_t *p, uint32_t v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+// Q14 factors of x in the low half and of y in the high half
+static inline uint32_t audio_mix_pack_gains(int32_t gx, int32_t gy) {
+  return __PKHBT((uint32_t)audio_mix_factor(gx), (uint32_t)audio_mix_factor(gy),
+                 16);
+}
+
+// Mixes each lane of x with the same lane of y, with the factors of g_lo
+// for the low lanes and of g_hi for the high lanes
+static inline uint32_t audio_mix_pair(uint32_t x, uint32_t y, uint32_t g_lo,
+                                      uint32_t g_hi) {
+  int32_t lo = __SMLAD(__PKHBT(x, y, 16), g_lo, AUDIO_MIX_GAIN_ROUND) >>
+               AUDIO_MIX_GAIN_SHIFT;
+  int32_t hi = __SMLAD(__PKHTB(y, x, 16), g_hi, AUDIO_MIX_GAIN_ROUND) >>
+               AUDIO_MIX_GAIN_SHIFT;
+
+  return __PKHBT(__SSAT(lo, 16), __SSAT(hi, 16), 16);
+}
+
+// The mono sample in both lanes
+static inline uint32_t audio_mix_dup(int16_t y) {
+  return __PKHBT((uint32_t)y, (uint32_t)y, 16);
+}
+#endif
+
+int32_t audio_mix_gain_q30(float factor) {
+  if (factor <= 0.f) {
+    return 0;
+  } else if (factor >= (float)AUDIO_MIX_GAIN_MAX / AUDIO_MIX_GAIN_Q30_ONE) {
+    return AUDIO_MIX_GAIN_MAX;
+  }
+  return (int32_t)(factor * AUDIO_MIX_GAIN_Q30_ONE + 0.5f);
+}
+
+void audio_mix_mono_16(int16_t *dst, const int16_t *mono, uint32_t frames,
+                       uint32_t chans, struct AUDIO_MIX_GAIN_T *dst_gain,
+                       struct AUDIO_MIX_GAIN_T *mono_gain) {
+  int32_t gx = dst_gain->gain;
+  int32_t gy = mono_gain->gain;
+  int32_t sx = dst_gain->step;
+  int32_t sy = mono_gain->step;
+  uint32_t i = 0, c;
+
+#ifdef AUDIO_MIX_SIMD
+  if ((sx == 0) && (sy == 0)) {
+    uint32_t g = audio_mix_pack_gains(gx, gy);
+    bool unity = (audio_mix_factor(gx) == AUDIO_MIX_GAIN_ONE) &&
+                 (audio_mix_factor(gy) == AUDIO_MIX_GAIN_ONE);
+
+    if (chans == 1) {
+      if (unity) {
+        for (; i + 2 <= frames; i += 2) {
+          audio_mix_write_pair(dst, __QADD16(audio_mix_read_pair(dst),
+                                             audio_mix_read_pair(mono + i)));
+          dst += 2;
+        }
+      } else {
+        for (; i + 2 <= frames; i += 2) {
+          audio_mix_write_pair(dst, audio_mix_pair(audio_mix_read_pair(dst),
+                                                   audio_mix_read_pair(mono + i),
+                                                   g, g));
+          dst += 2;
+        }
+      }
+    } else if ((chans & 1) == 0) {
+      for (; i < frames; i++) {
+        uint32_t y = audio_mix_dup(mono[i]);
+
+        for (c = 0; c < chans; c += 2) {
+          uint32_t x = audio_mix_read_pair(dst);
+
+          audio_mix_write_pair(dst, unity ? __QADD16(x, y)
+                                          : audio_mix_pair(x, y, g, g));
+          dst += 2;
+        }
+      }
+    }
+  } else if (chans == 1) {
+    uint32_t g0, g1;
+
+    for (; i + 2 <= frames; i += 2) {
+      g0 = audio_mix_pack_gains(gx, gy);
+      gx += sx;
+      gy += sy;
+      g1 = audio_mix_pack_gains(gx, gy);
+      gx += sx;
+      gy += sy;
+      audio_mix_write_pair(dst, audio_mix_pair(audio_mix_read_pair(dst),
+                                               audio_mix_read_pair(mono + i),
+                                               g0, g1));
+      dst += 2;
+    }
+  } else if ((chans & 1) == 0) {
+    for (; i < frames; i++) {
+      uint32_t g = audio_mix_pack_gains(gx, gy);
+      uint32_t y = audio_mix_dup(mono[i]);
+
+      for (c = 0; c < chans; c += 2) {
+        audio_mix_write_pair(dst,
+                             audio_mix_pair(audio_mix_read_pair(dst), y, g, g));
+        dst += 2;
+      }
+      gx += sx;
+      gy += sy;
+    }
+  }
+#endif
+
+  if ((sx == 0) && (sy == 0)) {
+    int32_t fx = audio_mix_factor(gx);
+    int32_t fy = audio_mix_factor(gy);
+
+    if (chans == 1) {
+      for (; i < frames; i++, dst++) {
+        *dst = audio_mix_sample16(*dst, mono[i], fx, fy);
+      }
+    } else {
+      for (; i < frames; i++) {
+        for (c = 0; c < chans; c++, dst++) {
+          *dst = audio_mix_sample16(*dst, mono[i], fx, fy);
+        }
+      }
+    }
+    return;
+  }
+
+  for (; i < frames; i++) {
+    for (c = 0; c < chans; c++) {
+      *dst = audio_mix_sample16(*dst, mono[i], audio_mix_factor(gx),
+                                audio_mix_factor(gy));
+      dst++;
+    }
+    gx += sx;
+    gy += sy;
+  }
+
+  dst_gain->gain = gx;
+  mono_gain->gain = gy;
+}
+
+void audio_mix_mono_24(int32_t *dst, const int16_t *mono, uint32_t frames,
+                       uint32_t chans, struct AUDIO_MIX_GAIN_T *dst_gain,
+                       struct AUDIO_MIX_GAIN_T *mono_gain) {
+  int32_t gx = dst_gain->gain;
+  int32_t gy = mono_gain->gain;
+  int32_t sx = dst_gain->step;
+  int32_t sy = mono_gain->step;
+  uint32_t i, c;
+
+  if ((sx == 0) && (sy == 0) && (gx == AUDIO_MIX_GAIN_Q30_ONE) &&
+      (gy == AUDIO_MIX_GAIN_Q30_ONE)) {
+    for (i = 0; i < frames; i++) {
+      int32_t y = mono[i] << 8;
+
+      for (c = 0; c < chans; c++) {
+        *dst = audio_mix_sat24(*dst + y);
+        dst++;
+      }
+    }
+    return;
+  }
+
+  for (i = 0; i < frames; i++) {
+    int32_t y = mono[i] << 8;
+
+    for (c = 0; c < chans; c++) {
+      *dst = audio_mix_sample24(*dst, y, gx, gy);
+      dst++;
+    }
+    gx += sx;
+    gy += sy;
+  }
+
+  dst_gain->gain = gx;
+  mono_gain->gain = gy;
+}
+
+void audio_mix_avg_16(int16_t *dst, const int16_t *src, uint32_t samples) {
+  uint32_t i = 0;
+
+#ifdef AUDIO_MIX_SIMD
+  for (; i + 2 <= samples; i += 2) {
+    audio_mix_write_pair(dst + i, __SHADD16(audio_mix_read_pair(dst + i),
+                                            audio_mix_read_pair(src + i)));
+  }
+#endif
+
+  for (; i < samples; i++) {
+    dst[i] = (int16_t)((dst[i] + src[i]) >> 1);
+  }
+}
+
+void audio_mix_avg_24(int32_t *dst, const int16_t *src, uint32_t samples) {
+  uint32_t i;
+
+  for (i = 0; i < samples; i++) {
+    dst[i] = (dst[i] + (src[i] << 8)) >> 1;
+  }
+}
+
+#ifndef AUDIO_MIX_SIMD
+// One channel of stereo frames. app_audio_lr_balance() leaves one channel at
+// 1 and attenuates the other, which cannot saturate.
+static void audio_mix_scale_channel_16(int16_t *buf, uint32_t frames,
+                                       int32_t factor) {
+  uint32_t i;
+
+  if (factor == AUDIO_MIX_GAIN_ONE) {
+    return;
+  } else if ((factor >= 0) && (factor < AUDIO_MIX_GAIN_ONE)) {
+    for (i = 0; i < frames; i++) {
+      buf[2 * i] = (int16_t)((buf[2 * i] * factor + AUDIO_MIX_GAIN_ROUND) >>
+                             AUDIO_MIX_GAIN_SHIFT);
+    }
+  } else {
+    for (i = 0; i < frames; i++) {
+      buf[2 * i] = audio_mix_sample16(buf[2 * i], 0, factor, 0);
+    }
+  }
+}
+#endif
+
+void audio_mix_scale_stereo_16(int16_t *buf, uint32_t frames, int32_t gain_l,
+                               int32_t gain_r) {
+#ifdef AUDIO_MIX_SIMD
+  uint32_t i;
+
+  // The upper halves are 0, so that __SMLAD and __SMLADX each take a
+  // single lane
+  uint32_t gl = (uint32_t)audio_mix_factor(gain_l) & 0xFFFF;
+  uint32_t gr = (uint32_t)audio_mix_factor(gain_r) & 0xFFFF;
+
+  for (i = 0; i < frames; i++) {
+    uint32_t x = audio_mix_read_pair(buf);
+    int32_t l = __SMLAD(x, gl, AUDIO_MIX_GAIN_ROUND) >> AUDIO_MIX_GAIN_SHIFT;
+    int32_t r = __SMLADX(x, gr, AUDIO_MIX_GAIN_ROUND) >> AUDIO_MIX_GAIN_SHIFT;
+
+    audio_mix_write_pair(buf, __PKHBT(__SSAT(l, 16), __SSAT(r, 16), 16));
+    buf += 2;
+  }
+#else
+  audio_mix_scale_channel_16(buf, frames, audio_mix_factor(gain_l));
+  audio_mix_scale_channel_16(buf + 1, frames, audio_mix_factor(gain_r));
+#endif
+}
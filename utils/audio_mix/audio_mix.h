@@ -0,0 +1,76 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#ifndef __AUDIO_MIX_H__
+#define __AUDIO_MIX_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Mixing kernels for the prompt mixer, the ring merge and the L/R balance.
+//
+// 16-bit samples are handled as dual 16-bit lanes with the Cortex-M4 DSP
+// instructions when the compiler targets them (__ARM_FEATURE_DSP), and by
+// plain C otherwise. Both builds produce bit-exact results.
+//
+// 24-bit samples are right aligned and sign extended in 32-bit words. A
+// 16-bit mono source mixed into them is shifted left by 8 first.
+//
+// Gains are Q30, as in af_dsp.h, and frame n uses gain + n * step, which
+// must stay between -2 and 2 exclusive. The 16-bit kernels round it to a
+// Q14 factor, which is exact to 1/4 LSB of the samples, and the 24-bit ones
+// use it as is. The products are rounded to nearest and saturated to the
+// sample width. With both gains at 1 and no step, a mix is a plain
+// saturating add.
+
+#define AUDIO_MIX_GAIN_Q30_ONE (1 << 30)
+
+struct AUDIO_MIX_GAIN_T {
+    // gain of the next frame
+    int32_t gain;
+    // added to gain after each frame
+    int32_t step;
+};
+
+// Q30 gain of a factor, clamped to [0, 2)
+int32_t audio_mix_gain_q30(float factor);
+
+// dst = dst * dst_gain + mono * mono_gain, on chans interleaved channels
+// with the same mono sample for all channels of a frame. Both gains are
+// advanced by frames steps.
+void audio_mix_mono_16(int16_t *dst, const int16_t *mono, uint32_t frames,
+                       uint32_t chans, struct AUDIO_MIX_GAIN_T *dst_gain,
+                       struct AUDIO_MIX_GAIN_T *mono_gain);
+void audio_mix_mono_24(int32_t *dst, const int16_t *mono, uint32_t frames,
+                       uint32_t chans, struct AUDIO_MIX_GAIN_T *dst_gain,
+                       struct AUDIO_MIX_GAIN_T *mono_gain);
+
+// dst = (dst + (src << (bits - 16))) / 2, rounded down, as the ring merge
+// mixes the ring into the stream. The halves cannot saturate.
+void audio_mix_avg_16(int16_t *dst, const int16_t *src, uint32_t samples);
+void audio_mix_avg_24(int32_t *dst, const int16_t *src, uint32_t samples);
+
+// Scales the left and right channels of stereo frames by constant gains
+void audio_mix_scale_stereo_16(int16_t *buf, uint32_t frames, int32_t gain_l,
+                               int32_t gain_r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
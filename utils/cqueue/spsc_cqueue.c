@@ -0,0 +1,115 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+/***
+ * spsc_cqueue.c - single producer / single consumer lock-free circle queue
+ */
+
+#include "spsc_cqueue.h"
+#include "cmsis.h"
+#include "plat_types.h"
+#include <string.h>
+
+int InitSpscCQueue(SpscCQueue *Q, unsigned int size, CQItemType *buf) {
+  Q->read = Q->write = 0;
+  Q->base = buf;
+  if (!buf || size == 0) {
+    Q->size = 0;
+    return CQ_ERR;
+  }
+
+  while (size & (size - 1))
+    size &= size - 1;
+  Q->size = size;
+
+  return CQ_OK;
+}
+
+unsigned int LengthOfSpscCQueue(SpscCQueue *Q) { return Q->write - Q->read; }
+
+unsigned int AvailableOfSpscCQueue(SpscCQueue *Q) {
+  return Q->size - (Q->write - Q->read);
+}
+
+int EnSpscCQueue(SpscCQueue *Q, const CQItemType *e, unsigned int len) {
+  unsigned int write = Q->write;
+  unsigned int off, l;
+
+  if (Q->size - (write - Q->read) < len)
+    return CQ_ERR;
+
+  /* the read index was sampled above, do not let the copy overtake it */
+  __DMB();
+  off = write & (Q->size - 1);
+  l = MIN(len, Q->size - off);
+  memcpy(&Q->base[off], e, l);
+  memcpy(&Q->base[0], e + l, len - l);
+
+  /* data must land before the consumer can see the new write index */
+  __DMB();
+  Q->write = write + len;
+
+  return CQ_OK;
+}
+
+int PeekSpscCQueue(SpscCQueue *Q, unsigned int len_want, CQItemType **e1,
+                   unsigned int *len1, CQItemType **e2, unsigned int *len2) {
+  unsigned int read = Q->read;
+  unsigned int off;
+
+  if (Q->write - read < len_want)
+    return CQ_ERR;
+
+  /* pairs with the barrier before the producer publishes write */
+  __DMB();
+  off = read & (Q->size - 1);
+  *e1 = &Q->base[off];
+  if (Q->size - off >= len_want) {
+    *len1 = len_want;
+    *e2 = NULL;
+    *len2 = 0;
+  } else {
+    *len1 = Q->size - off;
+    *e2 = &Q->base[0];
+    *len2 = len_want - *len1;
+  }
+
+  return CQ_OK;
+}
+
+int DeSpscCQueue(SpscCQueue *Q, CQItemType *e, unsigned int len) {
+  CQItemType *e1, *e2;
+  unsigned int len1, len2;
+
+  if (PeekSpscCQueue(Q, len, &e1, &len1, &e2, &len2) != CQ_OK)
+    return CQ_ERR;
+
+  if (e != NULL) {
+    memcpy(e, e1, len1);
+    memcpy(e + len1, e2, len2);
+  }
+
+  /* finish reading before handing the space back to the producer */
+  __DMB();
+  Q->read += len;
+
+  return CQ_OK;
+}
+
+int PullSpscCQueue(SpscCQueue *Q, CQItemType *e, unsigned int len) {
+  return DeSpscCQueue(Q, e, len);
+}
+
+void ResetSpscCQueue(SpscCQueue *Q) { Q->read = Q->write = 0; }
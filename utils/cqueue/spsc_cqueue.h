@@ -0,0 +1,66 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+/***
+* spsc_cqueue.h - single producer / single consumer lock-free circle queue
+*
+* One context may push (EnSpscCQueue) while another context pops
+* (PeekSpscCQueue/DeSpscCQueue/PullSpscCQueue) without any lock. The two
+* sides only share the free-running read/write indexes, which are
+* published with a memory barrier after the data they cover.
+*
+* Size is rounded down to a power of two so indexes wrap with a mask.
+* Init and Reset are not concurrent-safe; call them while the queue is idle.
+*/
+
+#ifndef SPSC_C_QUEUE_H
+#define SPSC_C_QUEUE_H 1
+
+#include "cqueue.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct __SpscCQueue
+{
+    volatile unsigned int read;     /* written by consumer only */
+    volatile unsigned int write;    /* written by producer only */
+    unsigned int size;
+    CQItemType *base;
+}SpscCQueue;
+
+/* Init Queue, size is rounded down to a power of two */
+int InitSpscCQueue(SpscCQueue *Q, unsigned int size, CQItemType *buf);
+/* Filled Length Of Queue */
+unsigned int LengthOfSpscCQueue(SpscCQueue *Q);
+/* Empty Length Of Queue */
+unsigned int AvailableOfSpscCQueue(SpscCQueue *Q);
+/* Producer: Push Data Into Queue (Tail) */
+int EnSpscCQueue(SpscCQueue *Q, const CQItemType *e, unsigned int len);
+/* Consumer: Pop Data From Queue (Front), e may be NULL to discard */
+int DeSpscCQueue(SpscCQueue *Q, CQItemType *e, unsigned int len);
+/* Consumer: Peek But Not Pop Data From Queue (Front) */
+int PeekSpscCQueue(SpscCQueue *Q, unsigned int len_want, CQItemType **e1, unsigned int *len1, CQItemType **e2, unsigned int *len2);
+/* Consumer: Copy Out And Pop Data From Queue (Front) */
+int PullSpscCQueue(SpscCQueue *Q, CQItemType *e, unsigned int len);
+
+void ResetSpscCQueue(SpscCQueue *Q);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* SPSC_C_QUEUE_H */
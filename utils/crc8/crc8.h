@@ -0,0 +1,56 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#ifndef __CRC8_H__
+#define __CRC8_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// SBC/mSBC frame check (A2DP spec, appendix B): x^8 + x^4 + x^3 + x^2 + 1,
+// MSB first, initial value 0x0F. It covers the header bytes after the
+// syncword, except the CRC byte, and the join/scale factor bits.
+
+#define CRC8_SBC_INIT (0x0F)
+#define CRC8_SBC_SYNCWORD (0x9C)
+#define CRC8_MSBC_SYNCWORD (0xAD)
+
+extern const uint8_t crc8_sbc_table[256];
+
+static inline uint8_t crc8_sbc_byte(uint8_t crc, uint8_t data) {
+  return crc8_sbc_table[crc ^ data];
+}
+
+uint8_t crc8_sbc(uint8_t crc, const uint8_t *buf, uint32_t len);
+
+// Same as crc8_sbc(), but len is in bits. The last partial byte is taken
+// from its most significant bits.
+uint8_t crc8_sbc_bits(uint8_t crc, const uint8_t *buf, uint32_t bits);
+
+// Checks the CRC of the SBC (0x9C) or mSBC (0xAD) frame at frame. len is
+// the number of bytes readable at frame; only the header and the scale
+// factors are read.
+// Returns 0 if the CRC matches, -1 if it is not an SBC/mSBC frame or is
+// too short, -2 on CRC mismatch.
+int crc8_sbc_frame_check(const uint8_t *frame, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
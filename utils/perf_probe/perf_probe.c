@@ -0,0 +1,173 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#include "perf_probe.h"
+#include "cmsis.h"
+#include "hal_location.h"
+#include "hal_trace.h"
+#include "string.h"
+
+#if defined(__arm__) || defined(__ARM_ARCH)
+// Not cleared at boot, see the .perf_probe section in the linker scripts
+#define PERF_PROBE_RAM_LOC __attribute__((section(".perf_probe")))
+#define PERF_PROBE_UNIT "cycles"
+#else
+#define PERF_PROBE_RAM_LOC
+#define PERF_PROBE_UNIT "ns"
+#endif
+
+#define PERF_PROBE_MAGIC                                                       \
+  (0x50500000 | (PERF_PROBE_QTY << 8) | PERF_PROBE_BUCKETS)
+
+struct PERF_PROBE_RAM_T {
+  uint32_t magic;
+  struct PERF_PROBE_STAT_T stat[PERF_PROBE_QTY];
+};
+
+static struct PERF_PROBE_RAM_T PERF_PROBE_RAM_LOC perf_probe_ram;
+
+static const char *const perf_probe_name[PERF_PROBE_QTY] = {
+    "a2dp_decode", "speech_tx", "speech_rx", "audio_process",
+    "af_handler",  "af_post",   "user0",     "user1",
+};
+
+static inline uint32_t perf_probe_bucket(uint32_t duration) {
+  if (duration == 0) {
+    return 0;
+  }
+  return 32 - __builtin_clz(duration);
+}
+
+void SRAM_TEXT_LOC perf_probe_record(enum PERF_PROBE_ID_T id,
+                                     uint32_t duration) {
+  struct PERF_PROBE_STAT_T *stat;
+
+  if ((uint32_t)id >= PERF_PROBE_QTY) {
+    return;
+  }
+  stat = &perf_probe_ram.stat[id];
+  stat->count++;
+  stat->sum += duration;
+  if (stat->max < duration) {
+    stat->max = duration;
+  }
+  stat->hist[perf_probe_bucket(duration)]++;
+}
+
+void perf_probe_get(enum PERF_PROBE_ID_T id, struct PERF_PROBE_STAT_T *stat) {
+  uint32_t lock;
+
+  if ((uint32_t)id >= PERF_PROBE_QTY) {
+    memset(stat, 0, sizeof(*stat));
+    return;
+  }
+  lock = int_lock();
+  *stat = perf_probe_ram.stat[id];
+  int_unlock(lock);
+}
+
+void perf_probe_reset(void) {
+  uint32_t lock;
+
+  lock = int_lock();
+  memset(perf_probe_ram.stat, 0, sizeof(perf_probe_ram.stat));
+  perf_probe_ram.magic = PERF_PROBE_MAGIC;
+  int_unlock(lock);
+}
+
+// Upper bound of the bucket holding the sample of rank count * num / den
+static uint32_t perf_probe_percentile(const struct PERF_PROBE_STAT_T *stat,
+                                      uint32_t num, uint32_t den) {
+  uint64_t rank;
+  uint64_t acc = 0;
+  uint32_t i, upper;
+
+  rank = ((uint64_t)stat->count * num + den - 1) / den;
+  for (i = 0; i < PERF_PROBE_BUCKETS; i++) {
+    acc += stat->hist[i];
+    if (acc >= rank) {
+      break;
+    }
+  }
+  if (i == 0) {
+    return 0;
+  }
+  upper = (i >= 32) ? stat->max : (1U << i) - 1;
+  return (upper < stat->max) ? upper : stat->max;
+}
+
+void perf_probe_dump(void) {
+  struct PERF_PROBE_STAT_T stat;
+  uint32_t id, i;
+
+  for (id = 0; id < PERF_PROBE_QTY; id++) {
+    perf_probe_get((enum PERF_PROBE_ID_T)id, &stat);
+    if (stat.count == 0) {
+      continue;
+    }
+    TRACE(7,
+          "[PROBE] %s (" PERF_PROBE_UNIT ") cnt=%u avg=%u p50<=%u p99<=%u "
+          "p99.9<=%u max=%u",
+          perf_probe_name[id], stat.count, (uint32_t)(stat.sum / stat.count),
+          perf_probe_percentile(&stat, 50, 100),
+          perf_probe_percentile(&stat, 99, 100),
+          perf_probe_percentile(&stat, 999, 1000), stat.max);
+    for (i = 0; i < PERF_PROBE_BUCKETS; i++) {
+      if (stat.hist[i]) {
+        TRACE(3, "[PROBE]   <2^%-2u %10u %10u", i, stat.hist[i],
+              (uint32_t)((uint64_t)stat.hist[i] * 1000 / stat.count));
+      }
+    }
+  }
+}
+
+#ifdef HAL_TRACE_RX_ENABLE
+static unsigned int perf_probe_rx_callback(unsigned char *buf,
+                                           unsigned int len) {
+  if (len >= 4 && memcmp(buf, "dump", 4) == 0) {
+    perf_probe_dump();
+  } else if (len >= 5 && memcmp(buf, "reset", 5) == 0) {
+    perf_probe_reset();
+    TRACE(0, "[PROBE] reset");
+  } else {
+    TRACE(0, "[PROBE] usage: [perf_probe,dump] or [perf_probe,reset]");
+    return 1;
+  }
+  return 0;
+}
+#endif
+
+void perf_probe_init(void) {
+  uint32_t id, count = 0;
+
+#if defined(__arm__) || defined(__ARM_ARCH)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+  if (perf_probe_ram.magic != PERF_PROBE_MAGIC) {
+    perf_probe_reset();
+  } else {
+    for (id = 0; id < PERF_PROBE_QTY; id++) {
+      count += perf_probe_ram.stat[id].count;
+    }
+    TRACE(1, "[PROBE] %u samples kept from before reset", count);
+  }
+
+#ifdef HAL_TRACE_RX_ENABLE
+  hal_trace_rx_register("perf_probe",
+                        (HAL_TRACE_RX_CALLBACK_T)perf_probe_rx_callback);
+#endif
+}
@@ -0,0 +1,110 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#ifndef __PERF_PROBE_H__
+#define __PERF_PROBE_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hot-path latency probes.
+//
+//   PERF_PROBE_BEGIN(PERF_PROBE_AUDIO_PROCESS);
+//   ...
+//   PERF_PROBE_END(PERF_PROBE_AUDIO_PROCESS);
+//
+// Each probe keeps a log2 histogram of its durations, plus the count, sum
+// and maximum. Bucket 0 counts durations of 0, bucket n (n > 0) durations
+// in [2^(n-1), 2^n). Durations are CPU cycles from the DWT cycle counter on
+// target and nanoseconds on host.
+//
+// BEGIN and END must be in the same block. A probe ID must only be used
+// from one context at a time; updates are not locked.
+//
+// The histograms live in a NOLOAD section that is not cleared at boot, so
+// the counts from before a warm reset (e.g. a crash) can still be dumped.
+// They are dumped or cleared with the trace rx commands
+// "[perf_probe,dump]" and "[perf_probe,reset]".
+//
+// Probes compile to nothing unless PERF_PROBE_ENABLED is defined.
+
+enum PERF_PROBE_ID_T {
+  PERF_PROBE_A2DP_DECODE,
+  PERF_PROBE_SPEECH_TX,
+  PERF_PROBE_SPEECH_RX,
+  PERF_PROBE_AUDIO_PROCESS,
+  PERF_PROBE_AF_HANDLER,
+  PERF_PROBE_AF_POST,
+  PERF_PROBE_USER0,
+  PERF_PROBE_USER1,
+
+  PERF_PROBE_QTY
+};
+
+#define PERF_PROBE_BUCKETS 33
+
+struct PERF_PROBE_STAT_T {
+  uint32_t count;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t hist[PERF_PROBE_BUCKETS];
+};
+
+#ifdef PERF_PROBE_ENABLED
+
+#if defined(__arm__) || defined(__ARM_ARCH)
+#include "cmsis.h"
+
+static inline uint32_t perf_probe_now(void) { return DWT->CYCCNT; }
+#else
+#include <time.h>
+
+static inline uint32_t perf_probe_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+#endif
+
+#define PERF_PROBE_BEGIN(id) uint32_t _perf_probe_start_##id = perf_probe_now()
+#define PERF_PROBE_END(id)                                                     \
+  perf_probe_record(id, perf_probe_now() - _perf_probe_start_##id)
+
+#else
+
+#define PERF_PROBE_BEGIN(id)
+#define PERF_PROBE_END(id)
+
+#endif
+
+void perf_probe_init(void);
+
+void perf_probe_record(enum PERF_PROBE_ID_T id, uint32_t duration);
+
+void perf_probe_get(enum PERF_PROBE_ID_T id, struct PERF_PROBE_STAT_T *stat);
+
+void perf_probe_reset(void);
+
+void perf_probe_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
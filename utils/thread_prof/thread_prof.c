@@ -0,0 +1,165 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#include "thread_prof.h"
+#include "hal_location.h"
+#include "string.h"
+
+#define THREAD_PROF_OTHER (&prof_entry[THREAD_PROF_MAX_THREADS])
+
+static struct THREAD_PROF_ENTRY_T prof_entry[THREAD_PROF_MAX_THREADS + 1];
+static uint32_t prof_num;
+static struct THREAD_PROF_ENTRY_T *prof_curr;
+
+static uint32_t prof_last;
+static uint64_t prof_total;
+static uint64_t prof_isr;
+static uint32_t prof_irq_cnt;
+static uint32_t prof_irq_depth;
+
+static void SRAM_TEXT_LOC thread_prof_charge(uint32_t now) {
+  uint32_t delta = now - prof_last;
+
+  prof_last = now;
+  prof_total += delta;
+  if (prof_irq_depth) {
+    prof_isr += delta;
+  } else if (prof_curr) {
+    prof_curr->run += delta;
+  }
+}
+
+static struct THREAD_PROF_ENTRY_T *SRAM_TEXT_LOC
+thread_prof_lookup(const void *id, const char *name) {
+  struct THREAD_PROF_ENTRY_T *e;
+  uint32_t i;
+
+  for (i = 0; i < prof_num; i++) {
+    e = &prof_entry[i];
+    if (e->id == id) {
+      if (e->name != name) {
+        memset(e, 0, sizeof(*e));
+        e->id = id;
+        e->name = name;
+      }
+      return e;
+    }
+  }
+
+  if (prof_num >= THREAD_PROF_MAX_THREADS) {
+    THREAD_PROF_OTHER->name = "other";
+    return THREAD_PROF_OTHER;
+  }
+
+  e = &prof_entry[prof_num++];
+  memset(e, 0, sizeof(*e));
+  e->id = id;
+  e->name = name;
+  return e;
+}
+
+void thread_prof_reset(uint32_t now) {
+  uint32_t i;
+
+  for (i = 0; i <= THREAD_PROF_MAX_THREADS; i++) {
+    prof_entry[i].run = 0;
+    prof_entry[i].switches = 0;
+  }
+  prof_last = now;
+  prof_total = 0;
+  prof_isr = 0;
+  prof_irq_cnt = 0;
+}
+
+void SRAM_TEXT_LOC thread_prof_switch(const void *id, const char *name,
+                                      uint32_t now) {
+  thread_prof_charge(now);
+  if (prof_curr && prof_curr->id == id && prof_curr->name == name) {
+    return;
+  }
+  prof_curr = thread_prof_lookup(id, name);
+  prof_curr->switches++;
+}
+
+void SRAM_TEXT_LOC thread_prof_irq_enter(uint32_t now) {
+  if (prof_irq_depth == 0) {
+    thread_prof_charge(now);
+    prof_irq_cnt++;
+  }
+  prof_irq_depth++;
+}
+
+void SRAM_TEXT_LOC thread_prof_irq_exit(uint32_t now) {
+  if (prof_irq_depth == 0) {
+    return;
+  }
+  if (prof_irq_depth == 1) {
+    thread_prof_charge(now);
+  }
+  prof_irq_depth--;
+}
+
+void thread_prof_set_stack(const void *id, const char *name, uint32_t size,
+                           uint32_t used) {
+  struct THREAD_PROF_ENTRY_T *e;
+
+  e = thread_prof_lookup(id, name);
+  if (e == THREAD_PROF_OTHER) {
+    return;
+  }
+  e->stack_size = size;
+  if (e->stack_used < used) {
+    e->stack_used = used;
+  }
+}
+
+void thread_prof_sample(struct THREAD_PROF_SAMPLE_T *s, uint32_t now,
+                        bool restart) {
+  uint32_t i, n;
+
+  thread_prof_charge(now);
+
+  s->total = prof_total;
+  s->isr = prof_isr;
+  s->irq_cnt = prof_irq_cnt;
+  memcpy(s->entry, prof_entry, prof_num * sizeof(prof_entry[0]));
+  s->num = prof_num;
+  if (THREAD_PROF_OTHER->run || THREAD_PROF_OTHER->switches) {
+    s->entry[s->num++] = *THREAD_PROF_OTHER;
+  }
+
+  if (!restart) {
+    return;
+  }
+
+  // Keep the running thread and the threads that ran, in order
+  n = 0;
+  for (i = 0; i < prof_num; i++) {
+    if (prof_entry[i].run == 0 && prof_entry[i].switches == 0 &&
+        &prof_entry[i] != prof_curr) {
+      continue;
+    }
+    if (n != i) {
+      if (&prof_entry[i] == prof_curr) {
+        prof_curr = &prof_entry[n];
+      }
+      prof_entry[n] = prof_entry[i];
+    }
+    n++;
+  }
+  prof_num = n;
+
+  thread_prof_reset(now);
+}
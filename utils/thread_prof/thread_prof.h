@@ -0,0 +1,119 @@
+/***************************************************************************
+ *
+ * Copyright 2015-2019 BES.
+ * All rights reserved. All unpublished rights reserved.
+ *
+ * No part of this work may be used or reproduced in any form or by any
+ * means, or stored in a database or retrieval system, without prior written
+ * permission of BES.
+ *
+ * Use of this work is governed by a license granted by BES.
+ * This work contains confidential and proprietary information of
+ * BES. which is protected by copyright, trade secret,
+ * trademark and other intellectual property rights.
+ *
+ ****************************************************************************/
+#ifndef __THREAD_PROF_H__
+#define __THREAD_PROF_H__
+
+#include "plat_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Per-thread CPU time and stack high-water accounting.
+//
+// The accounting core below only sees events stamped with a free running
+// 32-bit tick counter: thread switches, the outermost IRQ entry and exit,
+// and stack usage reported by the RTOS port. Time between two events is
+// charged to the IRQs if one is active, else to the running thread. The
+// core takes no locks: the caller serialises all calls, e.g. with
+// interrupts disabled.
+
+#ifndef THREAD_PROF_MAX_THREADS
+#define THREAD_PROF_MAX_THREADS 20
+#endif
+
+struct THREAD_PROF_ENTRY_T {
+  const void *id;
+  const char *name;
+  uint64_t run;        // ticks
+  uint32_t switches;   // times switched in
+  uint32_t stack_size; // bytes, 0 if not reported
+  uint32_t stack_used; // bytes
+};
+
+struct THREAD_PROF_SAMPLE_T {
+  uint64_t total;    // ticks since the window start
+  uint64_t isr;      // ticks spent in IRQs
+  uint32_t irq_cnt;  // outermost IRQ entries
+  uint32_t num;      // valid entries
+  // Threads that do not fit the table share a last entry with id NULL.
+  struct THREAD_PROF_ENTRY_T entry[THREAD_PROF_MAX_THREADS + 1];
+};
+
+// Starts a new window. Thread names and stack usage are kept.
+void thread_prof_reset(uint32_t now);
+
+// The thread id (named name) runs from now on. Switching to the running
+// thread is not counted. An id seen with a new name belongs to a new thread
+// and starts a fresh entry.
+void thread_prof_switch(const void *id, const char *name, uint32_t now);
+
+// Outermost IRQ entry and exit. Nested calls are counted and ignored.
+void thread_prof_irq_enter(uint32_t now);
+void thread_prof_irq_exit(uint32_t now);
+
+void thread_prof_set_stack(const void *id, const char *name, uint32_t size,
+                           uint32_t used);
+
+// Copies the current window into s. With restart, a new window starts and
+// the entries of threads that did not run are dropped.
+void thread_prof_sample(struct THREAD_PROF_SAMPLE_T *s, uint32_t now,
+                        bool restart);
+
+// RTOS port (rtos/rtx5/rtx_thread_prof.c)
+
+#define THREAD_PROF_STATS_VERSION 1
+
+#define THREAD_PROF_NAME_LEN 12
+
+#define THREAD_PROF_FLAG_IDLE (1 << 0)
+#define THREAD_PROF_FLAG_OTHER (1 << 1)
+
+typedef struct {
+  char name[THREAD_PROF_NAME_LEN]; // NUL terminated, truncated
+  uint16_t cpu;                    // permille of the window
+  uint16_t stack_size;             // bytes
+  uint16_t stack_used;             // bytes, high-water mark
+  uint8_t flags;
+  uint8_t reserved;
+  uint32_t switches;
+} __attribute__((packed)) THREAD_PROF_STATS_ENTRY_T;
+
+typedef struct {
+  uint8_t version;
+  uint8_t num;
+  uint16_t load;     // permille of the window not spent idle
+  uint16_t isr;      // permille of the window spent in IRQs
+  uint16_t sysfreq;  // enum HAL_CMU_FREQ_T at the time of the sample
+  uint32_t window;   // ms
+  uint32_t irq_cnt;
+  THREAD_PROF_STATS_ENTRY_T entry[THREAD_PROF_MAX_THREADS + 1];
+} __attribute__((packed)) THREAD_PROF_STATS_T;
+
+void thread_prof_start(void);
+
+// Fills stats and returns the number of valid bytes in it.
+uint32_t thread_prof_stats_get(THREAD_PROF_STATS_T *stats, bool restart);
+
+// Traces one line with the load, the IRQ share and the busiest threads, or
+// one line per thread if verbose.
+void thread_prof_print(bool verbose, bool restart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif